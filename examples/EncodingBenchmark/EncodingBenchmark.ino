@@ -0,0 +1,182 @@
+/**
+ * @file EncodingBenchmark.ino
+ * @brief Compares JSON, MessagePack and CBOR bodies for sensor documents
+ *
+ * This example:
+ * - Builds three representative documents: a single compact reading, the
+ *   nested report of the IoTSensorData example and a 32-sample series
+ * - Prints the body size in each encoding and the time to measure and
+ *   serialize it, as post(url, JsonDocument&) does
+ * - Then posts the nested report ITEMS_PER_ROUND times per encoding and
+ *   reports how long the queue takes to drain
+ *
+ * Point benchmarkUrl at a local server that accepts all three
+ * Content-Types (application/json, application/msgpack, application/cbor).
+ */
+
+#include <WiFi.h>
+#include <PostQueue.h>
+#include <ArduinoJson.h>
+
+// WiFi credentials
+const char* ssid = "YOUR_WIFI_SSID";
+const char* password = "YOUR_WIFI_PASSWORD";
+
+// Local endpoint that answers POST requests quickly
+const char* benchmarkUrl = "http://192.168.1.10:8080/ingest";
+
+// Serializations timed per document and encoding
+const int SERIALIZE_ITERATIONS = 200;
+
+// Number of requests per send round
+const int ITEMS_PER_ROUND = 50;
+
+const char* encodingNames[] = { "JSON", "MessagePack", "CBOR" };
+
+PostQueue benchQueue(ITEMS_PER_ROUND);
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.println("\n\n=== PostQueue Encoding Benchmark ===");
+
+  StaticJsonDocument<256> reading;
+  buildReading(reading);
+  StaticJsonDocument<512> report;
+  buildReport(report);
+  StaticJsonDocument<1024> series;
+  buildSeries(series);
+
+  Serial.println("\nDocument      Encoding       Bytes   Saved  Serialize (us)");
+  compareSizes("reading", reading);
+  compareSizes("report", report);
+  compareSizes("series", series);
+
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println("\nWiFi connected!");
+
+  benchQueue.setConnectionPool(1);
+  if (!benchQueue.begin()) {
+    Serial.println("Failed to initialize PostQueue!");
+    return;
+  }
+  benchQueue.setTimeout(5000);
+
+  runRound(ENCODING_JSON, report);
+  runRound(ENCODING_MSGPACK, report);
+  runRound(ENCODING_CBOR, report);
+}
+
+void loop() {
+  delay(1000);
+}
+
+void buildReading(JsonDocument& doc) {
+  doc["id"] = "ESP32-SENSOR-001";
+  doc["ts"] = 1760601234UL;
+  doc["t"] = 22.37;
+  doc["h"] = 48.2;
+  doc["p"] = 1013.25;
+}
+
+void buildReport(JsonDocument& doc) {
+  doc["device_id"] = "ESP32-SENSOR-001";
+  doc["location"] = "Office";
+  doc["timestamp"] = 1760601234UL;
+
+  JsonObject sensors = doc.createNestedObject("sensors");
+  sensors["temperature"]["value"] = 22.37;
+  sensors["temperature"]["unit"] = "celsius";
+  sensors["humidity"]["value"] = 48.2;
+  sensors["humidity"]["unit"] = "percent";
+  sensors["pressure"]["value"] = 1013.25;
+  sensors["pressure"]["unit"] = "hPa";
+
+  JsonObject health = doc.createNestedObject("health");
+  health["uptime"] = 86400;
+  health["free_heap"] = 182344;
+  health["wifi_rssi"] = -61;
+  health["wifi_quality"] = 78;
+}
+
+void buildSeries(JsonDocument& doc) {
+  doc["id"] = "ESP32-SENSOR-001";
+  doc["t0"] = 1760601234UL;
+  doc["dt"] = 1000;
+  JsonArray temperatures = doc.createNestedArray("temp");
+  for (int i = 0; i < 32; i++) {
+    temperatures.add(21.0 + i * 0.13);
+  }
+}
+
+// Measure and serialize like post(url, JsonDocument&) does, into a reused buffer
+size_t encode(JsonDocument& doc, PayloadEncoding encoding, uint8_t* buffer, size_t size) {
+  switch (encoding) {
+    case ENCODING_MSGPACK:
+      return measureMsgPack(doc) < size ? serializeMsgPack(doc, buffer, size) : 0;
+    case ENCODING_CBOR:
+      return measureCbor(doc.as<JsonVariantConst>()) < size
+                 ? serializeCbor(doc.as<JsonVariantConst>(), buffer, size)
+                 : 0;
+    default:
+      return measureJson(doc) < size ? serializeJson(doc, (char*)buffer, size) : 0;
+  }
+}
+
+void compareSizes(const char* name, JsonDocument& doc) {
+  static uint8_t buffer[1024];
+  size_t jsonBytes = 0;
+
+  for (int encoding = ENCODING_JSON; encoding <= ENCODING_CBOR; encoding++) {
+    uint32_t start = micros();
+    size_t bytes = 0;
+    for (int i = 0; i < SERIALIZE_ITERATIONS; i++) {
+      bytes = encode(doc, (PayloadEncoding)encoding, buffer, sizeof(buffer));
+    }
+    uint32_t elapsed = micros() - start;
+
+    if (encoding == ENCODING_JSON) {
+      jsonBytes = bytes;
+    }
+    Serial.printf("%-13s %-13s %6u %6.0f%% %15.1f\n", name, encodingNames[encoding], (unsigned)bytes,
+                  jsonBytes > 0 ? 100.0f - 100.0f * bytes / jsonBytes : 0.0f,
+                  (float)elapsed / SERIALIZE_ITERATIONS);
+  }
+}
+
+void runRound(PayloadEncoding encoding, JsonDocument& doc) {
+  uint32_t processedBefore, successfulBefore, failedBefore;
+  benchQueue.getStats(processedBefore, successfulBefore, failedBefore);
+
+  // Enqueue everything first so the worker always has work available
+  uint32_t enqueueStart = micros();
+  int queued = 0;
+  for (int i = 0; i < ITEMS_PER_ROUND; i++) {
+    if (benchQueue.post(benchmarkUrl, doc, false, NULL, 0, POST_PRIORITY_NORMAL, encoding)) {
+      queued++;
+    }
+  }
+  uint32_t enqueueMicros = micros() - enqueueStart;
+  uint32_t drainStart = millis();
+
+  // Wait for the worker to finish every queued item
+  uint32_t processed, successful, failed;
+  do {
+    delay(1);
+    benchQueue.getStats(processed, successful, failed);
+  } while (processed - processedBefore < (uint32_t)queued && millis() - drainStart < 120000);
+
+  uint32_t drainMillis = millis() - drainStart;
+
+  Serial.printf("\n--- Round: %s ---\n", encodingNames[encoding]);
+  Serial.printf("Queued: %d items\n", queued);
+  Serial.printf("Enqueue latency: %.1f us/item\n", queued > 0 ? (float)enqueueMicros / queued : 0.0f);
+  Serial.printf("Drained: %u items in %u ms\n", processed - processedBefore, drainMillis);
+  Serial.printf("Throughput: %.1f items/s\n", drainMillis > 0 ? (processed - processedBefore) * 1000.0f / drainMillis : 0.0f);
+  Serial.printf("Failed: %u\n", failed - failedBefore);
+}
@@ -69,6 +69,8 @@ void setup() {
   sensorQueue.setMaxRedirects(3);          // Allow some redirects
   sensorQueue.setSSLVerification(false);   // Skip SSL verification for testing
   sensorQueue.setCallback(onDataSent);     // Set callback
+  // To send readings as JSON arrays instead of one request each, enable batching:
+  // sensorQueue.setBatching(10, 4096, 30000);
 
   Serial.println("PostQueue ready for sensor data!");
   Serial.println("Starting sensor readings...\n");
@@ -0,0 +1,251 @@
+/**
+ * @file QueueBenchmark.ino
+ * @brief Measures how fast PostQueue drains queued requests
+ * 
+ * This example:
+ * - Churns the 1.0.0 item layout (a struct plus three strdup copies) and
+ *   the current single-block layout through the same random allocation
+ *   pattern, reporting free heap and the largest free block for each, so
+ *   the fragmentation comparison runs on any version of the library
+ * - Fills the queue with small JSON payloads aimed at a LAN endpoint
+ * - Measures enqueue latency and drain throughput (items/s)
+ * - Runs each round unpaced and with 10 ms pacing, which reproduces
+ *   the fixed per-item delay of the 1.0.0 worker for comparison
+ * - Then soaks the queue with variable-size payloads forever, reporting
+ *   free heap and the largest free block to track heap fragmentation
+ * 
+ * Point benchmarkUrl at a fast local server (e.g. `python3 -m http.server`
+ * behind a tiny POST handler) so the network is not the bottleneck.
+ */
+
+#include <WiFi.h>
+#include <PostQueue.h>
+
+// WiFi credentials
+const char* ssid = "YOUR_WIFI_SSID";
+const char* password = "YOUR_WIFI_PASSWORD";
+
+// Local endpoint that answers POST requests quickly
+const char* benchmarkUrl = "http://192.168.1.10:8080/ingest";
+
+// Number of requests per round
+const int ITEMS_PER_ROUND = 50;
+
+// Heap report interval during the soak phase (1 minute)
+const unsigned long SOAK_REPORT_INTERVAL = 60000;
+unsigned long lastSoakReport = 0;
+uint32_t soakSequence = 0;
+uint32_t lowestLargestBlock = UINT32_MAX;
+
+// Replacements per layout in the layout comparison
+const uint32_t LAYOUT_ITERATIONS = 20000;
+
+PostQueue benchQueue(ITEMS_PER_ROUND);
+
+// The 1.0.0 item: a struct and a separate copy of each string
+struct LegacyItem {
+  char* url;
+  char* jsonPayload;
+  char* customHeaders;
+  bool useSSL;
+  uint32_t timestamp;
+};
+
+// The current item: lengths in a header, the strings inline behind it
+struct SingleBlockItem {
+  uint16_t urlLength;
+  uint16_t headersLength;
+  uint32_t payloadLength;
+  bool useSSL;
+  uint32_t timestamp;
+};
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.println("\n\n=== PostQueue Drain Benchmark ===");
+
+  // Heap only, so it runs before WiFi takes its share
+  compareLayouts();
+
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println("\nWiFi connected!");
+
+  if (!benchQueue.begin()) {
+    Serial.println("Failed to initialize PostQueue!");
+    return;
+  }
+  benchQueue.setTimeout(5000);
+
+  runRound("unpaced", 0);
+  runRound("10 ms pacing (1.0.0 behaviour)", 10);
+
+  benchQueue.setPacing(0);
+  Serial.println("\n--- Heap soak (runs forever) ---");
+  reportHeap();
+}
+
+void loop() {
+  // Keep the queue busy with payloads of varying size so long-lived and
+  // short-lived allocations interleave the way they do in the field
+  if (!benchQueue.isFull()) {
+    soakSequence++;
+    int padding = random(16, 1024);
+    char payload[1100];
+    int length = snprintf(payload, sizeof(payload), "{\"seq\":%u,\"pad\":\"", soakSequence);
+    for (int i = 0; i < padding && length < (int)sizeof(payload) - 3; i++) {
+      payload[length++] = 'x';
+    }
+    payload[length++] = '"';
+    payload[length++] = '}';
+    payload[length] = '\0';
+
+    const char* headers = (soakSequence % 2) ? "X-Soak: 1\nX-Sequence: odd" : NULL;
+    benchQueue.post(benchmarkUrl, payload, false, headers);
+  }
+
+  if (millis() - lastSoakReport >= SOAK_REPORT_INTERVAL) {
+    reportHeap();
+  }
+
+  delay(5);
+}
+
+void reportHeap() {
+  lastSoakReport = millis();
+
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  if (largestBlock < lowestLargestBlock) {
+    lowestLargestBlock = largestBlock;
+  }
+
+  uint32_t processed, successful, failed;
+  benchQueue.getStats(processed, successful, failed);
+
+  Serial.printf("[%lu s] processed: %u, free heap: %u, largest block: %u (lowest %u)\n",
+                millis() / 1000, processed, ESP.getFreeHeap(), largestBlock, lowestLargestBlock);
+}
+
+void* allocLegacy(const char* url, const char* payload, const char* headers) {
+  LegacyItem* item = new LegacyItem();
+  item->url = strdup(url);
+  item->jsonPayload = strdup(payload);
+  item->customHeaders = headers ? strdup(headers) : NULL;
+  item->useSSL = false;
+  item->timestamp = millis();
+  return item;
+}
+
+void freeLegacy(void* block) {
+  LegacyItem* item = (LegacyItem*)block;
+  free(item->url);
+  free(item->jsonPayload);
+  free(item->customHeaders);
+  delete item;
+}
+
+void* allocSingleBlock(const char* url, const char* payload, const char* headers) {
+  size_t urlLength = strlen(url);
+  size_t payloadLength = strlen(payload);
+  size_t headersLength = headers ? strlen(headers) : 0;
+  SingleBlockItem* item = (SingleBlockItem*)malloc(sizeof(SingleBlockItem) + urlLength + payloadLength +
+                                                   headersLength + 3);
+  if (item == NULL) {
+    return NULL;
+  }
+  item->urlLength = urlLength;
+  item->payloadLength = payloadLength;
+  item->headersLength = headersLength;
+  item->useSSL = false;
+  item->timestamp = millis();
+  char* data = (char*)(item + 1);
+  memcpy(data, url, urlLength + 1);
+  memcpy(data + urlLength + 1, payload, payloadLength + 1);
+  memcpy(data + urlLength + payloadLength + 2, headers ? headers : "", headersLength + 1);
+  return item;
+}
+
+// Replaces random items of a full queue with payloads of random size, the way
+// the soak phase does, and reports the heap while the queue is still full
+void churnLayout(const char* name, bool singleBlock) {
+  static char payload[1100];
+  void* items[ITEMS_PER_ROUND] = {};
+
+  randomSeed(1); // Same sequence for both layouts
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < LAYOUT_ITERATIONS; i++) {
+    int slot = random(ITEMS_PER_ROUND);
+    if (items[slot] != NULL) {
+      singleBlock ? free(items[slot]) : freeLegacy(items[slot]);
+    }
+
+    int length = snprintf(payload, sizeof(payload), "{\"seq\":%u,\"pad\":\"", i);
+    int padding = random(16, 1024);
+    memset(payload + length, 'x', padding);
+    length += padding;
+    strcpy(payload + length, "\"}");
+
+    const char* headers = (i % 2) ? "X-Soak: 1\nX-Sequence: odd" : NULL;
+    items[slot] = singleBlock ? allocSingleBlock(benchmarkUrl, payload, headers)
+                              : allocLegacy(benchmarkUrl, payload, headers);
+  }
+  uint32_t elapsed = micros() - start;
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+
+  for (int slot = 0; slot < ITEMS_PER_ROUND; slot++) {
+    if (items[slot] != NULL) {
+      singleBlock ? free(items[slot]) : freeLegacy(items[slot]);
+    }
+  }
+
+  Serial.printf("%-22s %10.2f %10u %14u\n", name, (float)elapsed / LAYOUT_ITERATIONS, freeHeap, largestBlock);
+}
+
+void compareLayouts() {
+  Serial.printf("\n--- Item layouts, %u replacements in a %d-item queue ---\n", LAYOUT_ITERATIONS, ITEMS_PER_ROUND);
+  Serial.println("Layout                 us/replace  free heap  largest block");
+  churnLayout("1.0.0 (4 allocations)", false);
+  churnLayout("single block", true);
+}
+
+void runRound(const char* name, uint32_t pacing) {
+  benchQueue.setPacing(pacing);
+
+  uint32_t processedBefore, successfulBefore, failedBefore;
+  benchQueue.getStats(processedBefore, successfulBefore, failedBefore);
+
+  // Enqueue everything first so the worker always has work available
+  uint32_t enqueueStart = micros();
+  int queued = 0;
+  for (int i = 0; i < ITEMS_PER_ROUND; i++) {
+    char payload[64];
+    snprintf(payload, sizeof(payload), "{\"seq\":%d,\"round\":\"%s\"}", i, name);
+    if (benchQueue.post(benchmarkUrl, payload, false)) {
+      queued++;
+    }
+  }
+  uint32_t enqueueMicros = micros() - enqueueStart;
+  uint32_t drainStart = millis();
+
+  // Wait for the worker to finish every queued item
+  uint32_t processed, successful, failed;
+  do {
+    delay(1);
+    benchQueue.getStats(processed, successful, failed);
+  } while (processed - processedBefore < (uint32_t)queued && millis() - drainStart < 120000);
+
+  uint32_t drainMillis = millis() - drainStart;
+
+  Serial.printf("\n--- Round: %s ---\n", name);
+  Serial.printf("Queued: %d items\n", queued);
+  Serial.printf("Enqueue latency: %.1f us/item\n", queued > 0 ? (float)enqueueMicros / queued : 0.0f);
+  Serial.printf("Drained: %u items in %u ms\n", processed - processedBefore, drainMillis);
+  Serial.printf("Throughput: %.1f items/s\n", drainMillis > 0 ? (processed - processedBefore) * 1000.0f / drainMillis : 0.0f);
+  Serial.printf("Failed: %u\n", failed - failedBefore);
+}
@@ -0,0 +1,504 @@
+/**
+ * @file PostQueueBench.cpp
+ * @brief Host benchmark for PostQueue: enqueue latency, drain throughput and allocations per item
+ *
+ * Runs PostQueue against an in-process loopback HTTP server that answers
+ * every POST with "200 ok" on a keep-alive connection, so the numbers show
+ * the library's own overhead rather than the network. Retry rounds have the
+ * server answer a share of requests with "503" instead, and latency rounds
+ * have it wait before answering, once for all requests that arrived
+ * together, like a network round trip. Each configuration enqueues a burst
+ * of items, from one or several producer threads, and waits for every
+ * completion callback.
+ *
+ * Usage: postqueue_bench [items] [payloadBytes]
+ */
+
+#include <PostQueue.h>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Allocation counting: glibc's malloc is wrapped for the whole process, and
+// threads that belong to the benchmark harness opt out of the count.
+// ---------------------------------------------------------------------------
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void __libc_free(void* pointer);
+
+static std::atomic<bool> countingEnabled(false);
+static std::atomic<uint64_t> allocationCount(0);
+static thread_local bool harnessThread = false;
+
+static inline void countAllocation() {
+    if (countingEnabled.load(std::memory_order_relaxed) && !harnessThread) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+extern "C" void* malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) {
+    __libc_free(pointer);
+}
+
+// ---------------------------------------------------------------------------
+// Loopback HTTP stand-in
+// ---------------------------------------------------------------------------
+
+class LoopbackServer {
+public:
+    LoopbackServer() : _listenFd(-1), _port(0), _requests(0), _failEvery(0), _delay(0), _bodySize(0) {}
+
+    bool begin() {
+        _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (_listenFd < 0) {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        if (bind(_listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+            listen(_listenFd, 16) != 0 ||
+            getsockname(_listenFd, (struct sockaddr*)&address, &length) != 0) {
+            return false;
+        }
+        _port = ntohs(address.sin_port);
+
+        std::thread(&LoopbackServer::acceptLoop, this).detach();
+        return true;
+    }
+
+    uint16_t port() const { return _port; }
+    uint32_t requests() const { return _requests.load(); }
+
+    // Answer every nth request with 503 (0 = never)
+    void setFailEvery(uint32_t every) { _failEvery = every; }
+
+    // Wait this many milliseconds after each read before answering the requests it completed
+    void setDelay(uint32_t milliseconds) { _delay = milliseconds; }
+
+    // Answer successes with a body of this many bytes instead of "ok" (0 = "ok")
+    void setBodySize(uint32_t bytes) { _bodySize = bytes; }
+
+private:
+    int _listenFd;
+    uint16_t _port;
+    std::atomic<uint32_t> _requests;
+    std::atomic<uint32_t> _failEvery;
+    std::atomic<uint32_t> _delay;
+    std::atomic<uint32_t> _bodySize;
+
+    void acceptLoop() {
+        harnessThread = true;
+        while (true) {
+            int fd = accept(_listenFd, NULL, NULL);
+            if (fd < 0) {
+                return;
+            }
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            std::thread(&LoopbackServer::serve, this, fd).detach();
+        }
+    }
+
+    // Length of the chunked body at data, or 0 while it is incomplete
+    static size_t chunkedLength(const char* data, size_t available) {
+        size_t used = 0;
+        while (true) {
+            const char* lineEnd = (const char*)memmem(data + used, available - used, "\r\n", 2);
+            if (lineEnd == NULL) {
+                return 0;
+            }
+            size_t size = strtoul(data + used, NULL, 16);
+            used = (size_t)(lineEnd - data) + 2 + size + 2;
+            if (used > available) {
+                return 0;
+            }
+            if (size == 0) {
+                return used; // PostQueue sends no trailers
+            }
+        }
+    }
+
+    // Answers pipelined or sequential requests framed by Content-Length or chunked encoding
+    void serve(int fd) {
+        harnessThread = true;
+        static const char response[] =
+            "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok";
+        static const char unavailable[] =
+            "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 0\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+        char buffer[16384];
+        size_t used = 0;
+
+        while (true) {
+            ssize_t count = recv(fd, buffer + used, sizeof(buffer) - used, 0);
+            if (count <= 0) {
+                break;
+            }
+            used += (size_t)count;
+            bool delayed = false;
+
+            while (true) {
+                buffer[used < sizeof(buffer) ? used : sizeof(buffer) - 1] = '\0';
+                char* headEnd = strstr(buffer, "\r\n\r\n");
+                if (headEnd == NULL) {
+                    break;
+                }
+                size_t headLength = (size_t)(headEnd - buffer) + 4;
+                size_t bodyLength = 0;
+                const char* lengthHeader = strcasestr(buffer, "\r\nContent-Length:");
+                const char* chunkedHeader = strcasestr(buffer, "\r\nTransfer-Encoding: chunked");
+                if (lengthHeader != NULL && lengthHeader < headEnd) {
+                    bodyLength = strtoul(lengthHeader + 17, NULL, 10);
+                } else if (chunkedHeader != NULL && chunkedHeader < headEnd) {
+                    bodyLength = chunkedLength(buffer + headLength, used - headLength);
+                    if (bodyLength == 0) {
+                        break;
+                    }
+                }
+                if (used < headLength + bodyLength) {
+                    break;
+                }
+
+                const char* connection = strcasestr(buffer, "\r\nConnection: close");
+                bool close = connection != NULL && connection < headEnd;
+                uint32_t request = ++_requests;
+                uint32_t failEvery = _failEvery.load();
+                bool fail = failEvery > 0 && request % failEvery == 0;
+                const char* reply = fail ? unavailable : response;
+                size_t replyLength = fail ? sizeof(unavailable) - 1 : sizeof(response) - 1;
+                std::string sized;
+                uint32_t bodySize = _bodySize.load();
+                if (!fail && bodySize > 0) {
+                    sized = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " +
+                            std::to_string(bodySize) + "\r\nConnection: keep-alive\r\n\r\n";
+                    sized.append(bodySize, 'x');
+                    reply = sized.c_str();
+                    replyLength = sized.size();
+                }
+
+                // Like a round trip: requests completed by the same read are answered after one delay
+                uint32_t delay = _delay.load();
+                if (delay > 0 && !delayed) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                    delayed = true;
+                }
+                if (send(fd, reply, replyLength, MSG_NOSIGNAL) < 0 || close) {
+                    ::close(fd);
+                    return;
+                }
+
+                memmove(buffer, buffer + headLength + bodyLength, used - headLength - bodyLength);
+                used -= headLength + bodyLength;
+            }
+
+            if (used >= sizeof(buffer) - 1) {
+                break; // Request larger than the buffer
+            }
+        }
+        ::close(fd);
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Benchmark rounds
+// ---------------------------------------------------------------------------
+
+static std::atomic<uint32_t> completed(0);
+static std::atomic<uint32_t> failed(0);
+
+static void onComplete(bool success, int httpCode, const String& response) {
+    (void)httpCode;
+    (void)response;
+    if (!success) {
+        failed++;
+    }
+    completed++;
+}
+
+struct RoundConfig {
+    const char* name;
+    uint8_t workers;
+    uint8_t pooledConnections;
+    bool withHeaders;           ///< Send BENCH_HEADERS with every item
+    bool withHeaderSet;         ///< Send BENCH_HEADERS as a registered header set
+    QueueBackend backend;
+    uint8_t producers;          ///< Threads calling post() concurrently
+    bool fromISR;               ///< Post raw records with postFromISR() instead of JSON
+    uint8_t lanes;              ///< Priority lanes; producer p posts at priority p % lanes
+    uint32_t failEvery;         ///< Server answers every nth request with 503 (0 = never)
+    uint8_t retryAttempts;      ///< Attempts per item (1 = no retries)
+    uint32_t serverDelay;       ///< Server waits this many milliseconds before each answer
+    uint8_t maxInFlight;        ///< Requests each worker keeps in flight
+    uint8_t pipelineDepth;      ///< Requests written ahead on each connection
+    uint32_t replyBytes;        ///< Body size of the server's answers (0 = "ok")
+    ResponseMode responseMode;  ///< What workers do with those bodies
+    CompressionFormat compression; ///< Content-Encoding of request bodies
+};
+
+static const char BENCH_HEADERS[] = "Authorization: Bearer 0123456789abcdef\nX-Device-Id: bench-01\nX-Firmware: 1.0.0";
+
+#define MAX_PRODUCERS 8
+
+static uint64_t nowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Enqueue latency and rejections seen by one producer thread
+ */
+struct ProducerResult {
+    uint64_t enqueueTotal;
+    uint64_t enqueueMax;
+    uint32_t rejected;
+};
+
+// Formats the 8-byte {sequence, value} records posted in fromISR rounds
+static size_t formatSample(const uint8_t* data, size_t length, char* json, size_t size) {
+    uint32_t sample[2];
+    if (length != sizeof(sample)) {
+        return 0;
+    }
+    memcpy(sample, data, sizeof(sample));
+    return (size_t)snprintf(json, size, "{\"seq\":%u,\"value\":%u}", (unsigned)sample[0], (unsigned)sample[1]);
+}
+
+static void produce(PostQueue* queue, const char* url, const char* payload, const char* headers,
+                    uint8_t headerSet, uint8_t recordChannel, uint8_t priority, uint32_t count,
+                    ProducerResult* result) {
+    result->enqueueTotal = 0;
+    result->enqueueMax = 0;
+    result->rejected = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t sample[2] = { i, i * 7 };
+        uint64_t before = nowNanos();
+        bool queued = recordChannel != 0 ? queue->postFromISR(recordChannel, sample, sizeof(sample))
+                                         : queue->post(url, payload, false, headers, headerSet, priority);
+        uint64_t elapsed = nowNanos() - before;
+        result->enqueueTotal += elapsed;
+        if (elapsed > result->enqueueMax) {
+            result->enqueueMax = elapsed;
+        }
+        if (!queued) {
+            result->rejected++;
+        }
+    }
+}
+
+static void runRound(const RoundConfig& config, LoopbackServer& server, const char* url, uint32_t items,
+                     const char* payload) {
+    PostQueue queue(items, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, config.workers, tskNO_AFFINITY,
+                    config.backend);
+    server.setFailEvery(config.failEvery);
+    server.setDelay(config.serverDelay);
+    server.setBodySize(config.replyBytes);
+    queue.setRetry(config.retryAttempts, 1, 10);
+    queue.setRetryQueueSize(64);
+    queue.setConnectionPool(config.pooledConnections);
+    queue.setMaxInFlight(config.maxInFlight);
+    queue.setPipelining(config.pipelineDepth);
+    queue.setResponseMode(config.responseMode);
+    queue.setCompression(config.compression, 64);
+    queue.setCallback(onComplete);
+    uint8_t headerSet = config.withHeaderSet ? queue.addHeaderSet(BENCH_HEADERS) : 0;
+    const char* headers = config.withHeaders ? BENCH_HEADERS : NULL;
+    uint8_t recordChannel = 0;
+    if (config.fromISR) {
+        recordChannel = queue.addRecordChannel(url, formatSample, false);
+        queue.setRecordQueueSize(items);
+    }
+    uint8_t lanes = config.lanes < 1 ? 1 : config.lanes;
+    queue.setPriorityLanes(lanes);
+    if (!queue.begin()) {
+        printf("%-28s failed to start\n", config.name);
+        return;
+    }
+
+    completed = 0;
+    failed = 0;
+    uint64_t enqueueTotal = 0;
+    uint64_t enqueueMax = 0;
+    uint32_t rejected = 0;
+
+    allocationCount = 0;
+    countingEnabled = true;
+    uint64_t start = nowNanos();
+
+    // Producers split the items; extra threads count as library threads for allocations
+    ProducerResult results[MAX_PRODUCERS];
+    std::thread threads[MAX_PRODUCERS];
+    uint8_t producers = config.producers < 1 ? 1 : (config.producers > MAX_PRODUCERS ? MAX_PRODUCERS : config.producers);
+    for (uint8_t p = 1; p < producers; p++) {
+        threads[p] = std::thread(produce, &queue, url, payload, headers, headerSet, recordChannel,
+                                 (uint8_t)(p % lanes), items / producers, &results[p]);
+    }
+    produce(&queue, url, payload, headers, headerSet, recordChannel, 0,
+            items - (producers - 1) * (items / producers), &results[0]);
+    for (uint8_t p = 0; p < producers; p++) {
+        if (p > 0) {
+            threads[p].join();
+        }
+        enqueueTotal += results[p].enqueueTotal;
+        if (results[p].enqueueMax > enqueueMax) {
+            enqueueMax = results[p].enqueueMax;
+        }
+        rejected += results[p].rejected;
+    }
+
+    // Records a worker could not queue never complete, so count them as rejected
+    uint32_t recordsPosted = 0;
+    uint32_t recordsDropped = 0;
+    while (completed.load() + rejected + recordsDropped < items) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        queue.getRecordStats(recordsPosted, recordsDropped);
+    }
+    rejected += recordsDropped;
+    uint64_t drainNanos = nowNanos() - start;
+    countingEnabled = false;
+
+    // Longest time an item waited in each lane, highest priority first
+    char laneWaits[64] = "";
+    size_t used = 0;
+    for (uint8_t lane = lanes; lanes > 1 && lane-- > 0;) {
+        LaneStats stats;
+        if (queue.getLaneStats(lane, stats)) {
+            used += snprintf(laneWaits + used, sizeof(laneWaits) - used, " %u", (unsigned)stats.maxWait);
+        }
+    }
+
+    RetryStats retries;
+    queue.getRetryStats(retries);
+    uint32_t compressed;
+    uint32_t bytesIn;
+    uint32_t bytesOut;
+    queue.getCompressionStats(compressed, bytesIn, bytesOut);
+    StatsSnapshot stats;
+    queue.getStatsSnapshot(stats);
+
+    queue.end();
+    server.setFailEvery(0);
+    server.setDelay(0);
+    server.setBodySize(0);
+
+    double seconds = drainNanos / 1e9;
+    printf("%-28s %9.2f %9.2f %11.0f %11.2f %8u %8u\n",
+           config.name,
+           enqueueTotal / 1e3 / items,
+           enqueueMax / 1e3,
+           (items - rejected) / seconds,
+           (double)allocationCount.load() / items,
+           failed.load(),
+           rejected);
+    if (lanes > 1) {
+        printf("%-28s max wait per lane, high to low (ms):%s\n", "", laneWaits);
+    }
+    if (config.retryAttempts > 1) {
+        printf("%-28s %u retries, %.3f attempts per success, %u refused by budget\n", "",
+               (unsigned)retries.scheduled, retries.attemptsPerSuccess, (unsigned)retries.budgetDenied);
+    }
+    if (config.serverDelay > 0) {
+        printf("%-28s p50/p99 ms: queue wait %.1f/%.1f, first byte %.2f/%.2f, total %.2f/%.2f\n", "",
+               stats.queueWait.percentile(50) / 1e3, stats.queueWait.percentile(99) / 1e3,
+               stats.firstByte.percentile(50) / 1e3, stats.firstByte.percentile(99) / 1e3,
+               stats.total.percentile(50) / 1e3, stats.total.percentile(99) / 1e3);
+    }
+    if (compressed > 0) {
+        printf("%-28s %u bodies compressed, %u -> %u bytes (%.2fx)\n", "", (unsigned)compressed,
+               (unsigned)bytesIn, (unsigned)bytesOut, bytesOut > 0 ? (double)bytesIn / bytesOut : 0.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    harnessThread = true;
+
+    uint32_t items = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : 2000;
+    size_t payloadBytes = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 128;
+    if (items == 0 || payloadBytes < 16) {
+        fprintf(stderr, "usage: %s [items > 0] [payloadBytes >= 16]\n", argv[0]);
+        return 1;
+    }
+
+    LoopbackServer server;
+    if (!server.begin()) {
+        fprintf(stderr, "failed to start loopback server\n");
+        return 1;
+    }
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/ingest", (unsigned)server.port());
+
+    // {"seq":1,"pad":"xxxx...."} padded to the requested size
+    std::string payload = "{\"seq\":1,\"pad\":\"";
+    payload.append(payloadBytes - payload.size() - 2, 'x');
+    payload += "\"}";
+
+    static const RoundConfig rounds[] = {
+        { "1 worker, no pool", 1, 0, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, pooled", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "2 workers, pooled", 2, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 workers, pooled", 4, 4, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 3 headers", 1, 2, true, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 3-header set", 1, 2, false, true, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, pooled, ring", 1, 2, false, false, QUEUE_BACKEND_RING, 1, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 producers, 2 workers", 2, 2, false, false, QUEUE_BACKEND_FREERTOS, 4, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 producers, 2 workers, ring", 2, 2, false, false, QUEUE_BACKEND_RING, 4, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "8 producers, 4 workers", 4, 4, false, false, QUEUE_BACKEND_FREERTOS, 8, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "8 producers, 4 workers, ring", 4, 4, false, false, QUEUE_BACKEND_RING, 8, false, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, postFromISR", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, true, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, postFromISR, ring", 1, 2, false, false, QUEUE_BACKEND_RING, 1, true, 1, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 producers, 2 lanes", 2, 2, false, false, QUEUE_BACKEND_FREERTOS, 4, false, 2, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 producers, 2 lanes, ring", 2, 2, false, false, QUEUE_BACKEND_RING, 4, false, 2, 0, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 5% 503, no retry", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 20, 1, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 5% 503, 3 tries", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 20, 3, 0, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 2 ms server", 1, 4, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 2, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "4 workers, 2 ms server", 4, 4, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 2, 1, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 2 ms, 4 in flight", 1, 4, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 2, 4, 1, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 2 ms, pipeline 4", 1, 1, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 2, 1, 4, 0, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 4 KB replies", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 4096, RESPONSE_CAPTURE, COMPRESSION_NONE },
+        { "1 worker, 4 KB, discard", 1, 2, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 0, 1, 1, 4096, RESPONSE_DISCARD, COMPRESSION_NONE },
+        { "1 worker, 2 ms, 4 flt, gzip", 1, 4, false, false, QUEUE_BACKEND_FREERTOS, 1, false, 1, 0, 1, 2, 4, 1, 0, RESPONSE_CAPTURE, COMPRESSION_GZIP },
+    };
+
+    printf("PostQueue host benchmark: %u items, %u-byte payloads, server %s\n\n",
+           (unsigned)items, (unsigned)payloadBytes, url);
+    printf("%-28s %9s %9s %11s %11s %8s %8s\n",
+           "configuration", "enq avg", "enq max", "drain", "allocs", "failed", "rejected");
+    printf("%-28s %9s %9s %11s %11s %8s %8s\n", "", "(us)", "(us)", "(items/s)", "(/item)", "", "");
+
+    for (const RoundConfig& round : rounds) {
+        runRound(round, server, url, items, payload.c_str());
+    }
+
+    printf("\nserver handled %u requests\n", (unsigned)server.requests());
+    return 0;
+}
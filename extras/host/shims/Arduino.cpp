@@ -0,0 +1,46 @@
+/**
+ * @file Arduino.cpp
+ * @brief Implementation of the Arduino core host shim
+ */
+
+#include "Arduino.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <random>
+#include <sched.h>
+
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void yield() {
+    sched_yield();
+}
+
+uint32_t esp_random() {
+    static thread_local std::mt19937 generator(std::random_device{}());
+    return (uint32_t)generator();
+}
+
+long random(long max) {
+    return max > 0 ? (long)(esp_random() % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
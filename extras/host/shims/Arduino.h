@@ -0,0 +1,37 @@
+/**
+ * @file Arduino.h
+ * @brief Host shim for the subset of the ESP32 Arduino core used by PostQueue
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+#include "freertos/FreeRTOS.h"
+
+#define IRAM_ATTR
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+uint32_t esp_random();
+
+#endif // HOST_ARDUINO_H
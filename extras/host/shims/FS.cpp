@@ -0,0 +1,150 @@
+/**
+ * @file FS.cpp
+ * @brief Implementation of the directory-backed filesystem host shim
+ */
+
+#include "FS.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs {
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    // Empty writes may pass a NULL buffer, which fwrite() does not accept
+    return _file && size > 0 ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+void File::flush() {
+    if (_file) {
+        fflush(_file.get());
+    }
+}
+
+int File::available() {
+    return _file ? (int)(size() - position()) : 0;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return _file ? fread(buffer, 1, size, _file.get()) : 0;
+}
+
+int File::peek() {
+    if (!_file) {
+        return -1;
+    }
+    int c = fgetc(_file.get());
+    if (c != EOF) {
+        ungetc(c, _file.get());
+    }
+    return c == EOF ? -1 : c;
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    return _file && fseek(_file.get(), position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+    return _file ? (size_t)ftell(_file.get()) : 0;
+}
+
+size_t File::size() const {
+    if (!_file) {
+        return 0;
+    }
+    fflush(_file.get());
+    struct stat info;
+    return fstat(fileno(_file.get()), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+void File::close() {
+    _file.reset();
+    _directory.reset();
+}
+
+const char* File::name() const {
+    const char* slash = strrchr(_path.c_str(), '/');
+    return slash != NULL ? slash + 1 : _path.c_str();
+}
+
+File File::openNextFile(const char* mode) {
+    if (!_directory) {
+        return File();
+    }
+
+    struct dirent* entry;
+    DIR* directory = static_cast<DIR*>(_directory.get());
+    while ((entry = readdir(directory)) != NULL &&
+           (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)) {
+    }
+    if (entry == NULL) {
+        return File();
+    }
+
+    String path = _path;
+    if (!path.endsWith("/")) {
+        path += "/";
+    }
+    path += entry->d_name;
+    String hostRoot = _hostPath.substring(0, _hostPath.length() - _path.length());
+    return FS(hostRoot.c_str()).open(path.c_str(), mode);
+}
+
+FS::FS(const char* root) : _root(root) {
+    if (_root.endsWith("/")) {
+        _root = _root.substring(0, _root.length() - 1);
+    }
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    (void)create;
+    File file;
+    file._path = path;
+    file._hostPath = _root + path;
+
+    struct stat info;
+    if (stat(file._hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR* directory = opendir(file._hostPath.c_str());
+        if (directory != NULL) {
+            file._directory = std::shared_ptr<void>(directory, [](void* d) { closedir(static_cast<DIR*>(d)); });
+        }
+        return file;
+    }
+
+    const char* hostMode = (strcmp(mode, FILE_WRITE) == 0) ? "wb" : (strcmp(mode, FILE_APPEND) == 0) ? "ab" : "rb";
+    FILE* handle = fopen(file._hostPath.c_str(), hostMode);
+    if (handle != NULL) {
+        file._file = std::shared_ptr<FILE>(handle, fclose);
+    }
+    return file;
+}
+
+bool FS::exists(const char* path) {
+    struct stat info;
+    return stat((_root + path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return ::unlink((_root + path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename((_root + from).c_str(), (_root + to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir((_root + path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir((_root + path).c_str()) == 0;
+}
+
+} // namespace fs
@@ -0,0 +1,91 @@
+/**
+ * @file FS.h
+ * @brief Host shim for the ESP32 fs::FS and fs::File classes, backed by a directory
+ *
+ * An fs::FS is rooted at a host directory, so code written against LittleFS
+ * or SPIFFS runs unchanged on a Linux build.
+ */
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <memory>
+#include <stdio.h>
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File : public Stream {
+public:
+    File() {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    int available() override;
+    int read() override;
+    size_t read(uint8_t* buffer, size_t size);
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override { return read((uint8_t*)buffer, length); }
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const { return _file || _directory; }
+
+    const char* path() const { return _path.c_str(); }
+    const char* name() const;
+    bool isDirectory() const { return (bool)_directory; }
+    File openNextFile(const char* mode = FILE_READ);
+
+private:
+    friend class FS;
+
+    std::shared_ptr<FILE> _file;    ///< Open file (NULL for directories)
+    std::shared_ptr<void> _directory; ///< Open directory stream (NULL for files)
+    String _path;                   ///< Path inside the filesystem
+    String _hostPath;               ///< Path on the host
+};
+
+class FS {
+public:
+    /**
+     * @brief Create a filesystem rooted at a host directory
+     * @param root Existing host directory
+     */
+    explicit FS(const char* root);
+
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+    bool rmdir(const char* path);
+
+private:
+    String _root;                   ///< Host directory backing the filesystem
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // HOST_FS_H
@@ -0,0 +1,254 @@
+/**
+ * @file FreeRTOS.cpp
+ * @brief pthread-backed implementation of the FreeRTOS host shim
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+struct HostQueue {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<uint8_t> storage;
+    size_t itemSize;
+    size_t length;
+    size_t head;
+    size_t count;
+};
+
+struct HostTask {
+    pthread_t thread;
+    TaskFunction_t function;
+    void* parameter;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications;
+};
+
+static thread_local HostTask* currentTask = NULL;
+
+// Waits on a condition until it holds or the tick timeout expires
+template <typename Predicate>
+static bool waitFor(std::condition_variable& condition, std::unique_lock<std::mutex>& lock,
+                    TickType_t ticks, Predicate predicate) {
+    if (ticks == portMAX_DELAY) {
+        condition.wait(lock, predicate);
+        return true;
+    }
+    return condition.wait_for(lock, std::chrono::milliseconds(ticks), predicate);
+}
+
+void vPortCPUInitializeMutex(portMUX_TYPE* mux) {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mux->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+TickType_t xTaskGetTickCount() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (length == 0) {
+        return NULL;
+    }
+    HostQueue* queue = new HostQueue();
+    queue->itemSize = itemSize;
+    queue->length = length;
+    queue->head = 0;
+    queue->count = 0;
+    queue->storage.resize((size_t)length * itemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait, bool toFront) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->notFull, lock, ticksToWait, [queue] { return queue->count < queue->length; })) {
+        return errQUEUE_FULL;
+    }
+
+    size_t slot;
+    if (toFront) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->itemSize > 0) {
+        memcpy(&queue->storage[slot * queue->itemSize], item, queue->itemSize);
+    }
+    queue->count++;
+    queue->notEmpty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return queueSend(queue, item, ticksToWait, true);
+}
+
+static BaseType_t queueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait, bool remove) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue] { return queue->count > 0; })) {
+        return pdFALSE;
+    }
+
+    if (queue->itemSize > 0) {
+        memcpy(buffer, &queue->storage[queue->head * queue->itemSize], queue->itemSize);
+    }
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        queue->notFull.notify_one();
+    } else {
+        queue->notEmpty.notify_one(); // Let another waiter see the item too
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    return queueReceive(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    return queueReceive(queue, buffer, ticksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)(queue->length - queue->count);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+    queue->notFull.notify_all();
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t semaphore = xQueueCreate(1, 0);
+    if (semaphore != NULL) {
+        xQueueSendToBack(semaphore, NULL, 0);
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+    if (semaphore != NULL) {
+        for (UBaseType_t i = 0; i < initialCount; i++) {
+            xQueueSendToBack(semaphore, NULL, 0);
+        }
+    }
+    return semaphore;
+}
+
+static void* runTask(void* argument) {
+    currentTask = static_cast<HostTask*>(argument);
+    currentTask->function(currentTask->parameter);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+    (void)name;
+    (void)stackDepth;
+    (void)priority;
+    (void)core;
+
+    HostTask* task = new HostTask();
+    task->function = function;
+    task->parameter = parameter;
+    task->notifications = 0;
+    if (handle != NULL) {
+        *handle = task; // Set before the task runs, as FreeRTOS does
+    }
+
+    if (pthread_create(&task->thread, NULL, runTask, task) != 0) {
+        if (handle != NULL) {
+            *handle = NULL;
+        }
+        delete task;
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == currentTask) {
+        // The handle is leaked rather than freed: other threads may still notify it
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec duration;
+    duration.tv_sec = ticks / 1000;
+    duration.tv_nsec = (long)(ticks % 1000) * 1000000L;
+    nanosleep(&duration, NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (currentTask == NULL) {
+        // Threads not created through the shim (such as main) get a handle on first use
+        currentTask = new HostTask();
+        currentTask->thread = pthread_self();
+        currentTask->function = NULL;
+        currentTask->parameter = NULL;
+        currentTask->notifications = 0;
+    }
+    return currentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    HostTask* task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitFor(task->notified, lock, ticksToWait, [task] { return task->notifications > 0; });
+
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->notified.notify_one();
+    return pdPASS;
+}
@@ -0,0 +1,431 @@
+/**
+ * @file HTTPClient.cpp
+ * @brief Implementation of the HTTPClient host shim
+ */
+
+#include "HTTPClient.h"
+
+#include <poll.h>
+
+HTTPClient::HTTPClient()
+    : _client(NULL),
+      _port(80),
+      _collectCount(0),
+      _size(-1),
+      _chunked(false),
+      _bodyPending(false),
+      _reuse(true),
+      _canReuse(false),
+      _tcpTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT),
+      _connectTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT),
+      _followRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS),
+      _redirectLimit(10) {
+}
+
+HTTPClient::~HTTPClient() {
+    if (_client != NULL) {
+        _client->stop();
+    }
+}
+
+bool HTTPClient::begin(WiFiClient& client, const String& url) {
+    _client = &client;
+    _headers = "";
+    return parseUrl(url);
+}
+
+bool HTTPClient::parseUrl(const String& url) {
+    int schemeEnd = url.indexOf("://");
+    if (schemeEnd < 0) {
+        return false;
+    }
+    _port = url.startsWith("https") ? 443 : 80;
+
+    String rest = url.substring(schemeEnd + 3);
+    int pathStart = rest.indexOf('/');
+    String host = (pathStart >= 0) ? rest.substring(0, pathStart) : rest;
+    _uri = (pathStart >= 0) ? rest.substring(pathStart) : String("/");
+
+    int at = host.indexOf('@');
+    if (at >= 0) {
+        host = host.substring(at + 1);
+    }
+    int colon = host.indexOf(':');
+    if (colon >= 0) {
+        _port = (uint16_t)host.substring(colon + 1).toInt();
+        host = host.substring(0, colon);
+    }
+    _host = host;
+    return _host.length() > 0;
+}
+
+void HTTPClient::end() {
+    if (_client != NULL && _client->connected()) {
+        // Drop any unread response bytes so the next request starts clean
+        uint8_t buffer[64];
+        while (_client->available() > 0 && _client->read(buffer, sizeof(buffer)) > 0) {
+        }
+        // A body still on its way would be taken for the next response
+        if (!_reuse || !_canReuse || _bodyPending) {
+            _client->stop();
+        }
+    }
+    _client = NULL;
+    _bodyPending = false;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+    // Same string handling as the ESP32 implementation, so allocation counts match
+    String headerLine = name;
+    headerLine += ": ";
+    if (replace) {
+        int headerStart = _headers.indexOf(headerLine.c_str());
+        if (headerStart != -1 && (headerStart == 0 || _headers[headerStart - 1] == '\n')) {
+            int headerEnd = _headers.indexOf('\n', headerStart);
+            _headers = _headers.substring(0, headerStart) + _headers.substring(headerEnd + 1);
+        }
+    }
+    headerLine += value;
+    headerLine += "\r\n";
+    if (first) {
+        _headers = headerLine + _headers;
+    } else {
+        _headers += headerLine;
+    }
+}
+
+void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
+    _collectCount = headerKeysCount < HTTPCLIENT_MAX_COLLECTED_HEADERS ? headerKeysCount
+                                                                       : HTTPCLIENT_MAX_COLLECTED_HEADERS;
+    for (size_t i = 0; i < _collectCount; i++) {
+        _collectKeys[i] = headerKeys[i];
+        _collectValues[i] = "";
+    }
+}
+
+String HTTPClient::header(const char* name) {
+    for (size_t i = 0; i < _collectCount; i++) {
+        if (strcasecmp(_collectKeys[i], name) == 0) {
+            return _collectValues[i];
+        }
+    }
+    return String();
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+    return header(name).length() > 0;
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+    int code = sendOnce(type, payload, size);
+    uint16_t redirects = 0;
+
+    while (_followRedirects != HTTPC_DISABLE_FOLLOW_REDIRECTS && redirects < _redirectLimit &&
+           (code == 301 || code == 302 || code == 303 || code == 307 || code == 308) &&
+           _location.length() > 0) {
+        redirects++;
+        String location = _location;
+        if (location.startsWith("/")) {
+            _uri = location;
+        } else {
+            _client->stop();
+            if (!parseUrl(location)) {
+                break;
+            }
+        }
+        if (code == 303) {
+            type = "GET";
+            payload = NULL;
+            size = 0;
+        }
+        readBody(NULL);
+        code = sendOnce(type, payload, size);
+    }
+    return code;
+}
+
+bool HTTPClient::connect() {
+    if (_client == NULL) {
+        return false;
+    }
+    if (_client->connected()) {
+        uint8_t buffer[64];
+        while (_client->available() > 0 && _client->read(buffer, sizeof(buffer)) > 0) {
+        }
+        return true;
+    }
+    return _client->connect(_host.c_str(), _port, _connectTimeout) == 1;
+}
+
+int HTTPClient::sendOnce(const char* type, const uint8_t* payload, size_t size) {
+    _location = "";
+    _size = -1;
+    _chunked = false;
+    _bodyPending = false;
+    for (size_t i = 0; i < _collectCount; i++) {
+        _collectValues[i] = "";
+    }
+    _canReuse = false;
+
+    if (!connect()) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    String head;
+    head.reserve(128 + _uri.length() + _headers.length());
+    head += type;
+    head += " ";
+    head += _uri;
+    head += " HTTP/1.1\r\nHost: ";
+    head += _host;
+    if (_port != 80 && _port != 443) {
+        head += ":";
+        head += (unsigned int)_port;
+    }
+    head += "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: ";
+    head += _reuse ? "keep-alive" : "close";
+    if (payload != NULL || strcmp(type, "POST") == 0) {
+        head += "\r\nContent-Length: ";
+        head += (unsigned long)size;
+    }
+    head += "\r\n";
+    head += _headers;
+    head += "\r\n";
+
+    if (_client->write((const uint8_t*)head.c_str(), head.length()) != head.length()) {
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (size > 0 && _client->write(payload, size) != size) {
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+
+    return readResponse();
+}
+
+int HTTPClient::readResponse() {
+    String line;
+    int code = 0;
+
+    // Skip interim 1xx responses
+    do {
+        if (!readLine(line)) {
+            return line.length() == 0 && !_client->connected() ? HTTPC_ERROR_CONNECTION_LOST
+                                                                : HTTPC_ERROR_READ_TIMEOUT;
+        }
+        if (!line.startsWith("HTTP/") || line.indexOf(' ') < 0) {
+            return HTTPC_ERROR_NO_HTTP_SERVER;
+        }
+        code = (int)line.substring(line.indexOf(' ') + 1).toInt();
+        _canReuse = _reuse && !line.startsWith("HTTP/1.0");
+
+        while (readLine(line) && line.length() > 0) {
+            int colon = line.indexOf(':');
+            if (colon <= 0) {
+                continue;
+            }
+            String name = line.substring(0, colon);
+            String value = line.substring(colon + 1);
+            value.trim();
+            if (name.equalsIgnoreCase("Content-Length")) {
+                _size = (int)value.toInt();
+            } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+                _chunked = value.indexOf("chunked") >= 0;
+            } else if (name.equalsIgnoreCase("Connection")) {
+                value.toLowerCase();
+                if (value.indexOf("close") >= 0) {
+                    _canReuse = false;
+                } else if (value.indexOf("keep-alive") >= 0) {
+                    _canReuse = _reuse;
+                }
+            } else if (name.equalsIgnoreCase("Location")) {
+                _location = value;
+            }
+            for (size_t i = 0; i < _collectCount; i++) {
+                if (name.equalsIgnoreCase(_collectKeys[i])) {
+                    _collectValues[i] = value;
+                }
+            }
+        }
+    } while (code >= 100 && code < 200);
+
+    // Like the ESP32 class, the body is left on the connection for getString() or writeToStream()
+    if (code == 204 || code == 304 || (!_chunked && _size == 0)) {
+        return code;
+    }
+    if (!_chunked && _size < 0) {
+        _canReuse = false; // No framing: the body runs until the server closes the connection
+    }
+    _bodyPending = true;
+    return code;
+}
+
+int HTTPClient::readBody(Stream* stream) {
+    if (!_bodyPending) {
+        return 0;
+    }
+    _bodyPending = false;
+
+    String line;
+    int total = 0;
+    if (_chunked) {
+        while (true) {
+            if (!readLine(line)) {
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            size_t chunk = strtoul(line.c_str(), NULL, 16);
+            if (chunk == 0) {
+                while (readLine(line) && line.length() > 0) {
+                }
+                break;
+            }
+            if (!readExactly(chunk, stream) || !readLine(line)) {
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            total += (int)chunk;
+        }
+    } else if (_size >= 0) {
+        if (!readExactly((size_t)_size, stream)) {
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        total = _size;
+    } else {
+        uint8_t buffer[256];
+        while (waitForData()) {
+            int count = _client->read(buffer, sizeof(buffer));
+            if (count <= 0) {
+                break;
+            }
+            if (stream != NULL) {
+                stream->write(buffer, (size_t)count);
+            }
+            total += count;
+        }
+    }
+    return total;
+}
+
+bool HTTPClient::waitForData() {
+    if (_client->available() > 0) {
+        return true;
+    }
+    struct pollfd entry = { _client->fd(), POLLIN, 0 };
+    return entry.fd >= 0 && poll(&entry, 1, _tcpTimeout) == 1 && _client->connected();
+}
+
+bool HTTPClient::readLine(String& line) {
+    line = "";
+    while (waitForData()) {
+        int c = _client->read();
+        if (c < 0) {
+            return false;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        if (c != '\r') {
+            line += (char)c;
+        }
+    }
+    return false;
+}
+
+bool HTTPClient::readExactly(size_t length, Stream* stream) {
+    uint8_t buffer[256];
+    while (length > 0) {
+        if (!waitForData()) {
+            return false;
+        }
+        int count = _client->read(buffer, length < sizeof(buffer) ? length : sizeof(buffer));
+        if (count <= 0) {
+            return false;
+        }
+        if (stream != NULL) {
+            stream->write(buffer, (size_t)count);
+        }
+        length -= (size_t)count;
+    }
+    return true;
+}
+
+// Collects a body into a String, as StreamString does for the ESP32 class
+class StringSink : public Stream {
+public:
+    explicit StringSink(String& target) : _target(target) {}
+
+    size_t write(uint8_t data) override {
+        return _target.concat((char)data) ? 1 : 0;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return _target.concat((const char*)buffer, size) ? size : 0;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    String& _target;
+};
+
+String HTTPClient::getString() {
+    String body;
+    if (_size > 0) {
+        body.reserve(_size);
+    }
+    StringSink sink(body);
+    writeToStream(&sink);
+    return body;
+}
+
+int HTTPClient::writeToStream(Stream* stream) {
+    if (stream == NULL) {
+        return HTTPC_ERROR_NO_STREAM;
+    }
+    return readBody(stream);
+}
+
+WiFiClient& HTTPClient::getStream() {
+    return *_client;
+}
+
+bool HTTPClient::connected() {
+    return _client != NULL && _client->connected();
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED:
+            return String("connection refused");
+        case HTTPC_ERROR_SEND_HEADER_FAILED:
+            return String("send header failed");
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+            return String("send payload failed");
+        case HTTPC_ERROR_NOT_CONNECTED:
+            return String("not connected");
+        case HTTPC_ERROR_CONNECTION_LOST:
+            return String("connection lost");
+        case HTTPC_ERROR_NO_STREAM:
+            return String("no stream");
+        case HTTPC_ERROR_NO_HTTP_SERVER:
+            return String("no HTTP server");
+        case HTTPC_ERROR_TOO_LESS_RAM:
+            return String("too less ram");
+        case HTTPC_ERROR_ENCODING:
+            return String("Transfer-Encoding not supported");
+        case HTTPC_ERROR_STREAM_WRITE:
+            return String("Stream write error");
+        case HTTPC_ERROR_READ_TIMEOUT:
+            return String("read Timeout");
+        default:
+            return String();
+    }
+}
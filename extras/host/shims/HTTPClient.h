@@ -0,0 +1,99 @@
+/**
+ * @file HTTPClient.h
+ * @brief Host shim for the subset of the ESP32 HTTPClient used by PostQueue
+ *
+ * Speaks plain HTTP/1.1 over a WiFiClient with the same connection reuse,
+ * redirect and error-code behaviour as the ESP32 class, so PostQueue can be
+ * run against a local HTTP server.
+ */
+
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_STREAM           (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM        (-8)
+#define HTTPC_ERROR_ENCODING            (-9)
+#define HTTPC_ERROR_STREAM_WRITE        (-10)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT (5000)
+
+#define HTTPCLIENT_MAX_COLLECTED_HEADERS 4
+
+typedef enum {
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS
+} followRedirects_t;
+
+class HTTPClient {
+public:
+    HTTPClient();
+    ~HTTPClient();
+
+    bool begin(WiFiClient& client, const String& url);
+    void end();
+
+    void setReuse(bool reuse) { _reuse = reuse; }
+    void setTimeout(uint16_t timeout) { _tcpTimeout = timeout; }
+    void setConnectTimeout(int32_t timeout) { _connectTimeout = timeout; }
+    void setFollowRedirects(followRedirects_t follow) { _followRedirects = follow; }
+    void setRedirectLimit(uint16_t limit) { _redirectLimit = limit; }
+
+    void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    String header(const char* name);
+    bool hasHeader(const char* name);
+
+    int POST(uint8_t* payload, size_t size);
+    int POST(const String& payload);
+    int sendRequest(const char* type, uint8_t* payload = NULL, size_t size = 0);
+
+    String getString();
+    int writeToStream(Stream* stream);
+    int getSize() { return _size; }
+    WiFiClient& getStream();
+    bool connected();
+
+    static String errorToString(int error);
+
+private:
+    WiFiClient* _client;            ///< Client the request is sent on
+    String _host;                   ///< Host from the URL
+    uint16_t _port;                 ///< Port from the URL
+    String _uri;                    ///< Path and query from the URL
+    String _headers;                ///< Extra request header lines
+    String _location;               ///< Location header of the last response
+    const char* _collectKeys[HTTPCLIENT_MAX_COLLECTED_HEADERS]; ///< Response headers to keep
+    String _collectValues[HTTPCLIENT_MAX_COLLECTED_HEADERS]; ///< Their values in the last response
+    size_t _collectCount;           ///< Number of response headers to keep
+    int _size;                      ///< Content-Length of the last response (-1 if absent)
+    bool _chunked;                  ///< Whether the last response uses chunked encoding
+    bool _bodyPending;              ///< Whether its body is still unread on the connection
+    bool _reuse;                    ///< Whether to keep the connection open after end()
+    bool _canReuse;                 ///< Whether the server allows keeping it open
+    uint16_t _tcpTimeout;           ///< Read timeout in milliseconds
+    int32_t _connectTimeout;        ///< Connect timeout in milliseconds
+    followRedirects_t _followRedirects; ///< Redirect policy
+    uint16_t _redirectLimit;        ///< Maximum redirects to follow
+
+    bool parseUrl(const String& url);
+    bool connect();
+    int sendOnce(const char* type, const uint8_t* payload, size_t size);
+    int readResponse();
+    bool readLine(String& line);
+    int readBody(Stream* stream);
+    bool readExactly(size_t length, Stream* stream);
+    bool waitForData();
+};
+
+#endif // HOST_HTTP_CLIENT_H
@@ -0,0 +1,43 @@
+/**
+ * @file HardwareSerial.h
+ * @brief Host shim for the Arduino Serial port, printing to stdout
+ *
+ * Like a real board, nothing is shown until Serial.begin() is called, so
+ * benchmarks stay quiet unless they opt in to the library's log output.
+ */
+
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include "Stream.h"
+
+class HardwareSerial : public Stream {
+public:
+    HardwareSerial() : _enabled(false) {}
+
+    void begin(unsigned long baud) { (void)baud; _enabled = true; }
+    void end() { _enabled = false; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (_enabled) {
+            fwrite(buffer, 1, size, stdout);
+        }
+        return size;
+    }
+    using Print::write;
+    void flush() override { fflush(stdout); }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    explicit operator bool() const { return true; }
+
+private:
+    bool _enabled;                  ///< Whether output is shown
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_HARDWARE_SERIAL_H
@@ -0,0 +1,64 @@
+/**
+ * @file Print.h
+ * @brief Host shim for the Arduino Print base class
+ */
+
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (written < size && write(buffer[written]) == 1) {
+            written++;
+        }
+        return written;
+    }
+    size_t write(const char* str) { return str != NULL ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str(), str.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { size_t n = print(value); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0) {
+            return 0;
+        }
+        if ((size_t)length < sizeof(buffer)) {
+            return write((const uint8_t*)buffer, length);
+        }
+
+        std::string large(length + 1, '\0');
+        va_start(args, format);
+        vsnprintf(&large[0], large.size(), format, args);
+        va_end(args);
+        return write((const uint8_t*)large.data(), length);
+    }
+};
+
+#endif // HOST_PRINT_H
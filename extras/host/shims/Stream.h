@@ -0,0 +1,47 @@
+/**
+ * @file Stream.h
+ * @brief Host shim for the Arduino Stream base class
+ */
+
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+class Stream : public Print {
+public:
+    Stream() : _timeout(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    virtual size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        unsigned long start = millis();
+        while (count < length) {
+            int c = read();
+            if (c >= 0) {
+                buffer[count++] = (char)c;
+                start = millis();
+            } else if (millis() - start >= _timeout) {
+                break;
+            } else {
+                delay(1);
+            }
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+
+protected:
+    unsigned long _timeout;         ///< Timeout in milliseconds for readBytes()
+};
+
+#endif // HOST_STREAM_H
@@ -0,0 +1,97 @@
+/**
+ * @file WString.h
+ * @brief Host shim for the Arduino String class, backed by std::string
+ */
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+
+class String {
+public:
+    String() {}
+    String(const char* cstr) : _s(cstr != NULL ? cstr : "") {}
+    String(const char* cstr, unsigned int length) : _s(cstr, length) {}
+    String(const std::string& s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(int value) : _s(std::to_string(value)) {}
+    explicit String(unsigned int value) : _s(std::to_string(value)) {}
+    explicit String(long value) : _s(std::to_string(value)) {}
+    explicit String(unsigned long value) : _s(std::to_string(value)) {}
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+
+    bool concat(const char* cstr, unsigned int length) { _s.append(cstr, length); return true; }
+    bool concat(const char* cstr) { _s.append(cstr); return true; }
+    bool concat(const String& other) { _s.append(other._s); return true; }
+    bool concat(char c) { _s.push_back(c); return true; }
+    bool concat(int value) { _s.append(std::to_string(value)); return true; }
+    bool concat(unsigned int value) { _s.append(std::to_string(value)); return true; }
+    bool concat(long value) { _s.append(std::to_string(value)); return true; }
+    bool concat(unsigned long value) { _s.append(std::to_string(value)); return true; }
+
+    template <typename T>
+    String& operator+=(const T& value) { concat(value); return *this; }
+
+    char operator[](unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return find(_s.find(c, from)); }
+    int indexOf(const char* str, unsigned int from = 0) const { return find(_s.find(str, from)); }
+    int lastIndexOf(char c) const { return find(_s.rfind(c)); }
+
+    String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            unsigned int t = from; from = to; to = t;
+        }
+        return from < _s.size() ? String(_s.substr(from, to - from)) : String();
+    }
+
+    void trim() {
+        size_t start = _s.find_first_not_of(" \t\r\n");
+        size_t end = _s.find_last_not_of(" \t\r\n");
+        _s = (start == std::string::npos) ? std::string() : _s.substr(start, end - start + 1);
+    }
+    void toLowerCase() { for (char& c : _s) { if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; } }
+
+    bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+    bool equals(const String& other) const { return _s == other._s; }
+    bool equalsIgnoreCase(const String& other) const {
+        if (_s.size() != other._s.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < _s.size(); i++) {
+            if (tolower((unsigned char)_s[i]) != tolower((unsigned char)other._s[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    long toInt() const { return atol(_s.c_str()); }
+
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator==(const char* other) const { return _s == (other != NULL ? other : ""); }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b._s); }
+
+private:
+    std::string _s;
+
+    static int find(size_t position) { return position == std::string::npos ? -1 : (int)position; }
+};
+
+#endif // HOST_WSTRING_H
@@ -0,0 +1,156 @@
+/**
+ * @file WiFiClient.cpp
+ * @brief Implementation of the WiFiClient host shim
+ */
+
+#include "WiFiClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct WiFiClient::Socket {
+    int fd;
+
+    explicit Socket(int descriptor) : fd(descriptor) {}
+    ~Socket() { close(fd); }
+};
+
+WiFiClient::WiFiClient() {}
+
+WiFiClient::~WiFiClient() {}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, 3000);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0 || addresses == NULL) {
+        return 0;
+    }
+
+    int fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(addresses);
+        return 0;
+    }
+
+    // Connect without blocking so the timeout applies
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int result = ::connect(fd, addresses->ai_addr, addresses->ai_addrlen);
+    freeaddrinfo(addresses);
+
+    if (result < 0 && errno == EINPROGRESS) {
+        struct pollfd entry = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (poll(&entry, 1, timeout) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+            result = 0;
+        }
+    }
+    if (result < 0) {
+        close(fd);
+        return 0;
+    }
+
+    fcntl(fd, F_SETFL, flags);
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    _socket = std::make_shared<Socket>(fd);
+    return 1;
+}
+
+size_t WiFiClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    if (!_socket) {
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = send(_socket->fd, buffer + written, size - written, MSG_NOSIGNAL);
+        if (result <= 0) {
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        written += (size_t)result;
+    }
+    return written;
+}
+
+int WiFiClient::available() {
+    if (!_socket) {
+        return 0;
+    }
+    int count = 0;
+    if (ioctl(_socket->fd, FIONREAD, &count) < 0) {
+        return 0;
+    }
+    return count;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (!_socket) {
+        return -1;
+    }
+    ssize_t result = recv(_socket->fd, buffer, size, MSG_DONTWAIT);
+    return result > 0 ? (int)result : -1;
+}
+
+int WiFiClient::peek() {
+    if (!_socket) {
+        return -1;
+    }
+    uint8_t c;
+    return recv(_socket->fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+    _socket.reset();
+}
+
+uint8_t WiFiClient::connected() {
+    if (!_socket) {
+        return 0;
+    }
+
+    // Pending data counts as connected; an orderly shutdown reads as 0 bytes
+    uint8_t c;
+    ssize_t result = recv(_socket->fd, &c, 1, MSG_DONTWAIT | MSG_PEEK);
+    if (result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+int WiFiClient::fd() const {
+    return _socket ? _socket->fd : -1;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file WiFiClient.h
+ * @brief Host shim for the ESP32 WiFiClient, backed by a POSIX TCP socket
+ *
+ * Copies share the socket, as on the ESP32. Nagle's algorithm is disabled so
+ * separate header and body writes do not stall on delayed ACKs over loopback.
+ */
+
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+#include <memory>
+#include "Arduino.h"
+#include "Client.h"
+
+class WiFiClient : public Client {
+public:
+    WiFiClient();
+    virtual ~WiFiClient();
+
+    int connect(const char* host, uint16_t port) override;
+    int connect(const char* host, uint16_t port, int32_t timeout);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+    /**
+     * @brief Get the socket descriptor
+     * @return Descriptor, or -1 if not connected
+     */
+    int fd() const;
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> _socket; ///< Socket shared between copies
+};
+
+#endif // HOST_WIFI_CLIENT_H
@@ -0,0 +1,20 @@
+/**
+ * @file WiFiClientSecure.h
+ * @brief Host shim for the ESP32 WiFiClientSecure
+ *
+ * TLS is not emulated: connections are plain TCP, so host benchmarks point
+ * https URLs at the loopback stand-in like any other.
+ */
+
+#ifndef HOST_WIFI_CLIENT_SECURE_H
+#define HOST_WIFI_CLIENT_SECURE_H
+
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() {}
+    void setCACert(const char* rootCA) { (void)rootCA; }
+};
+
+#endif // HOST_WIFI_CLIENT_SECURE_H
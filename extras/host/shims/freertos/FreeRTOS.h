@@ -0,0 +1,47 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim for the FreeRTOS types and port macros used by PostQueue
+ *
+ * One tick is one millisecond. Critical sections are recursive pthread
+ * mutexes instead of interrupt-masking spinlocks.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_FULL 0
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+void vPortCPUInitializeMutex(portMUX_TYPE* mux);
+
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
+
+// Interrupts are ordinary threads on the host
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR() ((void)0)
+
+TickType_t xTaskGetTickCount();
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,30 @@
+/**
+ * @file queue.h
+ * @brief Host shim for FreeRTOS queues, backed by a mutex and condition variables
+ */
+
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+typedef struct HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* buffer, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks) xQueueSendToBack(queue, item, ticks)
+
+// Interrupts are ordinary threads on the host, so the ISR variants never block
+// and never ask for a context switch
+#define xQueueSendToBackFromISR(queue, item, woken) ((void)(woken), xQueueSendToBack(queue, item, 0))
+#define xQueueSendFromISR(queue, item, woken) xQueueSendToBackFromISR(queue, item, woken)
+
+#endif // HOST_FREERTOS_QUEUE_H
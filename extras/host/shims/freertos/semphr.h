@@ -0,0 +1,21 @@
+/**
+ * @file semphr.h
+ * @brief Host shim for FreeRTOS mutexes and counting semaphores, built on one-slot queues as FreeRTOS does
+ */
+
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive(semaphore, NULL, ticks)
+#define xSemaphoreGive(semaphore) xQueueSendToBack(semaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSendToBackFromISR(semaphore, NULL, woken)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+
+#endif // HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,29 @@
+/**
+ * @file task.h
+ * @brief Host shim for FreeRTOS tasks and direct-to-task notifications, backed by pthreads
+ *
+ * Core affinity and priorities are accepted and ignored. A task can only
+ * delete itself: a pthread cannot be stopped safely from outside, so
+ * deleting another task leaves it running.
+ */
+
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameter);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif // HOST_FREERTOS_TASK_H
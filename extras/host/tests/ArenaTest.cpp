@@ -0,0 +1,125 @@
+/**
+ * @file ArenaTest.cpp
+ * @brief Checks of the preallocated item arena: slot sizing, exhaustion and reuse
+ */
+
+#include <PostQueue.h>
+
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+// A JSON string payload of exactly length bytes
+static std::string payloadOf(size_t length) {
+    return "\"" + std::string(length - 2, 'x') + "\"";
+}
+
+TEST(Arena, CapacityAccountsForHeaderFields) {
+    PostQueue queue(4);
+    CHECK_EQUAL(0, queue.getArenaSlotCapacity());
+
+    REQUIRE(queue.setArena(256));
+    CHECK_EQUAL(256 - sizeof(PostItem) - 3, queue.getArenaSlotCapacity());
+    CHECK_EQUAL(256 - sizeof(PostItem) - 2 * sizeof(HeaderField) - 3, queue.getArenaSlotCapacity(2));
+
+    // Slots are rounded up to keep item headers aligned
+    REQUIRE(queue.setArena(254));
+    CHECK_EQUAL(256 - sizeof(PostItem) - 3, queue.getArenaSlotCapacity());
+
+    // A slot that cannot even hold its own field table has no capacity
+    REQUIRE(queue.setArena(sizeof(PostItem) + 4));
+    CHECK_EQUAL(0, queue.getArenaSlotCapacity(1));
+}
+
+TEST(Arena, BudgetSplitsAcrossEverySlot) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    PostQueue queue(4);
+    queue.setRetry(3);
+    queue.setRetryQueueSize(2);
+
+    // Four lane entries, one in-flight item and two retry slots share the budget
+    REQUIRE(queue.setArenaBudget(7 * 200 + 5));
+    CHECK_EQUAL(200 - sizeof(PostItem) - 3, queue.getArenaSlotCapacity());
+    REQUIRE(queue.begin());
+
+    std::string url = server.url();
+    std::string headers = "X-Arena: 1"; // Normalized to "X-Arena: 1\r\n"
+    size_t plain = queue.getArenaSlotCapacity() - url.size();
+    size_t withHeader = queue.getArenaSlotCapacity(1) - url.size() - (headers.size() + 2);
+
+    CHECK(queue.post(url.c_str(), payloadOf(plain).c_str(), false));
+    CHECK(!queue.post(url.c_str(), payloadOf(plain + 1).c_str(), false));
+    CHECK(queue.post(url.c_str(), payloadOf(withHeader).c_str(), false, headers.c_str()));
+    CHECK(!queue.post(url.c_str(), payloadOf(withHeader + 1).c_str(), false, headers.c_str()));
+
+    REQUIRE(server.waitForRequests(2));
+    delay(20);
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 2);
+    CHECK(bodies[0] == payloadOf(plain));
+    CHECK(bodies[1] == payloadOf(withHeader));
+
+    // A rejected oversized item gives its lane reservation back
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(POST_PRIORITY_NORMAL, lane));
+    CHECK_EQUAL(0, lane.queued);
+    queue.end();
+}
+
+TEST(Arena, ExhaustionRejectsUntilSlotsReturn) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+    PostQueue queue(4);
+    queue.setConnectionPool(1);
+    REQUIRE(queue.setArena(256));
+    REQUIRE(queue.begin());
+    std::string url = server.url();
+
+    // One slot is held by the worker, four by the lane
+    REQUIRE(queue.post(url.c_str(), "{\"i\":0}", false));
+    REQUIRE(server.waitForRequests(1));
+    for (int i = 1; i <= 4; i++) {
+        CHECK(queue.post(url.c_str(), "{\"i\":1}", false));
+    }
+    CHECK(queue.isFull());
+    CHECK(!queue.post(url.c_str(), "{\"i\":5}", false));
+
+    server.release();
+    REQUIRE(server.waitForRequests(5));
+    uint32_t start = millis();
+    while (queue.isFull() && millis() - start < 1000) {
+        delay(1);
+    }
+    CHECK(!queue.isFull());
+    queue.end();
+}
+
+TEST(Arena, SlotsAreReused) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    PostQueue queue(2);
+    REQUIRE(queue.setArena(256));
+    REQUIRE(queue.begin());
+    std::string url = server.url();
+
+    // Far more posts than the three slots, each round waiting for the last to be sent
+    size_t sent = 0;
+    for (int round = 0; round < 20; round++) {
+        CHECK(queue.post(url.c_str(), "{\"r\":1}", false));
+        CHECK(queue.post(url.c_str(), "{\"r\":2}", false));
+        sent += 2;
+        REQUIRE(server.waitForRequests(sent));
+    }
+
+    uint32_t start = millis();
+    while (queue.getQueueSize() > 0 && millis() - start < 1000) {
+        delay(1);
+    }
+    CHECK(!queue.isFull());
+    CHECK(queue.post(url.c_str(), "{\"r\":3}", false));
+    REQUIRE(server.waitForRequests(sent + 1));
+    queue.end();
+}
@@ -0,0 +1,137 @@
+/**
+ * @file BatchingTest.cpp
+ * @brief Checks that processBatch() joins only items bound for the same request
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static std::atomic<uint32_t> callbackSuccesses(0);
+
+static void countSuccess(bool success, int httpCode, const String& response) {
+    (void)response;
+    if (success && httpCode == 200) {
+        callbackSuccesses++;
+    }
+}
+
+static bool postTo(PostQueue& queue, TestServer& server, const char* path, int i, const char* headers = NULL) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"i\":%d}", i);
+    return queue.post(server.url(path).c_str(), body, false, headers);
+}
+
+// Starts a batching single-connection queue whose worker is parked on a held first request
+static bool beginHeld(PostQueue& queue, TestServer& server, uint8_t maxItems, size_t maxBytes = DEFAULT_BATCH_MAX_BYTES) {
+    server.reset();
+    server.hold();
+    queue.setConnectionPool(1);
+    queue.setBatching(maxItems, maxBytes);
+    if (!queue.begin()) {
+        return false;
+    }
+    return postTo(queue, server, "/a", 0) && server.waitForRequests(1);
+}
+
+static bool hasHeader(const TestRequest& request, const char* line) {
+    return request.head.find(std::string("\r\n") + line + "\r\n") != std::string::npos;
+}
+
+TEST(Batching, JoinsConsecutiveItemsForTheSameRequest) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(16);
+    callbackSuccesses = 0;
+    queue.setCallback(countSuccess);
+    REQUIRE(beginHeld(queue, server, 8));
+
+    CHECK(postTo(queue, server, "/a", 1));
+    CHECK(postTo(queue, server, "/a", 2));
+    CHECK(postTo(queue, server, "/a", 3));
+    CHECK(postTo(queue, server, "/b", 4));
+    CHECK(postTo(queue, server, "/b", 5));
+    CHECK(postTo(queue, server, "/a", 6, "X-Batch: one"));
+    CHECK(postTo(queue, server, "/a", 7, "X-Batch: two"));
+    CHECK(postTo(queue, server, "/a", 8));
+
+    server.release();
+    REQUIRE(server.waitForRequests(6));
+    delay(20);
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests.size() == 6);
+
+    CHECK(requests[0].path == "/a");
+    CHECK(requests[0].body == "[{\"i\":0}]");
+    CHECK(requests[1].path == "/a");
+    CHECK(requests[1].body == "[{\"i\":1},{\"i\":2},{\"i\":3}]");
+    CHECK(requests[2].path == "/b");
+    CHECK(requests[2].body == "[{\"i\":4},{\"i\":5}]");
+
+    // Same URL, different custom headers: one request each, with its own header
+    CHECK(requests[3].path == "/a");
+    CHECK(requests[3].body == "[{\"i\":6}]");
+    CHECK(hasHeader(requests[3], "X-Batch: one"));
+    CHECK(requests[4].body == "[{\"i\":7}]");
+    CHECK(hasHeader(requests[4], "X-Batch: two"));
+    CHECK(requests[5].body == "[{\"i\":8}]");
+    CHECK(requests[5].head.find("X-Batch") == std::string::npos);
+
+    uint32_t batchesSent, itemsBatched;
+    queue.getBatchStats(batchesSent, itemsBatched);
+    CHECK_EQUAL(6, batchesSent);
+    CHECK_EQUAL(9, itemsBatched);
+
+    // The batch result reaches every item's callback
+    uint32_t start = millis();
+    while (callbackSuccesses < 9 && millis() - start < 1000) {
+        delay(1);
+    }
+    CHECK_EQUAL(9, callbackSuccesses.load());
+    queue.end();
+}
+
+TEST(Batching, ByteLimitSplitsABatch) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(16);
+    // "[" + three 7-byte items + two commas + "]" is 25 bytes, one more than allowed
+    REQUIRE(beginHeld(queue, server, 4, 24));
+
+    for (int i = 1; i <= 7; i++) {
+        CHECK(postTo(queue, server, "/a", i));
+    }
+
+    server.release();
+    REQUIRE(server.waitForRequests(5));
+    delay(20);
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 5);
+    CHECK(bodies[1] == "[{\"i\":1},{\"i\":2}]");
+    CHECK(bodies[2] == "[{\"i\":3},{\"i\":4}]");
+    CHECK(bodies[3] == "[{\"i\":5},{\"i\":6}]");
+    CHECK(bodies[4] == "[{\"i\":7}]");
+    queue.end();
+}
+
+TEST(Batching, ItemLimitCapsABatch) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(16);
+    REQUIRE(beginHeld(queue, server, 3));
+
+    for (int i = 1; i <= 7; i++) {
+        CHECK(postTo(queue, server, "/a", i));
+    }
+
+    server.release();
+    REQUIRE(server.waitForRequests(4));
+    delay(20);
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 4);
+    CHECK(bodies[1] == "[{\"i\":1},{\"i\":2},{\"i\":3}]");
+    CHECK(bodies[2] == "[{\"i\":4},{\"i\":5},{\"i\":6}]");
+    CHECK(bodies[3] == "[{\"i\":7}]");
+    queue.end();
+}
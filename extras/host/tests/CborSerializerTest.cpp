@@ -0,0 +1,107 @@
+/**
+ * @file CborSerializerTest.cpp
+ * @brief Checks of CborSerializer output against the RFC 8949 Appendix A examples
+ */
+
+#include <CborSerializer.h>
+
+#include <string>
+#include <vector>
+
+#include "HostTest.h"
+
+// Parses json and returns its CBOR encoding, checking that measureCbor() agrees
+static std::vector<uint8_t> encode(const char* json) {
+    StaticJsonDocument<1024> document;
+    if (deserializeJson(document, json)) {
+        return std::vector<uint8_t>();
+    }
+    size_t measured = measureCbor(document.as<JsonVariantConst>());
+    std::vector<uint8_t> output(measured);
+    size_t written = serializeCbor(document.as<JsonVariantConst>(), output.data(), output.size());
+    CHECK_EQUAL(measured, written);
+    return output;
+}
+
+// Checks the encoding of json against the expected bytes
+static void checkBytes(const char* json, std::initializer_list<uint8_t> expected) {
+    std::vector<uint8_t> output = encode(json);
+    bool same = output == std::vector<uint8_t>(expected);
+    if (!same) {
+        std::string actual;
+        for (uint8_t byte : output) {
+            char hex[4];
+            snprintf(hex, sizeof(hex), "%02x ", byte);
+            actual += hex;
+        }
+        printf("    %s encoded as %s\n", json, actual.c_str());
+    }
+    CHECK(same);
+}
+
+TEST(CborSerializer, Integers) {
+    checkBytes("0", { 0x00 });
+    checkBytes("23", { 0x17 });
+    checkBytes("24", { 0x18, 0x18 });
+    checkBytes("255", { 0x18, 0xff });
+    checkBytes("1000", { 0x19, 0x03, 0xe8 });
+    checkBytes("1000000", { 0x1a, 0x00, 0x0f, 0x42, 0x40 });
+    checkBytes("1000000000000", { 0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4, 0xa5, 0x10, 0x00 });
+    checkBytes("-1", { 0x20 });
+    checkBytes("-100", { 0x38, 0x63 });
+    checkBytes("-1000", { 0x39, 0x03, 0xe7 });
+}
+
+TEST(CborSerializer, Floats) {
+    // Single precision while in range, as serializeMsgPack() does
+    checkBytes("1.5", { 0xfa, 0x3f, 0xc0, 0x00, 0x00 });
+    checkBytes("-4.1", { 0xfa, 0xc0, 0x83, 0x33, 0x33 });
+    checkBytes("100000.0", { 0xfa, 0x47, 0xc3, 0x50, 0x00 });
+    checkBytes("1.0e+300", { 0xfb, 0x7e, 0x37, 0xe4, 0x3c, 0x88, 0x00, 0x75, 0x9c });
+}
+
+TEST(CborSerializer, SimpleValues) {
+    checkBytes("false", { 0xf4 });
+    checkBytes("true", { 0xf5 });
+    checkBytes("null", { 0xf6 });
+}
+
+TEST(CborSerializer, Strings) {
+    checkBytes("\"\"", { 0x60 });
+    checkBytes("\"IETF\"", { 0x64, 0x49, 0x45, 0x54, 0x46 });
+    checkBytes("\"\\u00fc\"", { 0x62, 0xc3, 0xbc });
+
+    // A 24-byte string needs a one-byte length
+    std::vector<uint8_t> output = encode("\"abcdefghijklmnopqrstuvwx\"");
+    REQUIRE(output.size() == 26);
+    CHECK_EQUAL(0x78, output[0]);
+    CHECK_EQUAL(24, output[1]);
+}
+
+TEST(CborSerializer, ArraysAndMaps) {
+    checkBytes("[]", { 0x80 });
+    checkBytes("[1,2,3]", { 0x83, 0x01, 0x02, 0x03 });
+    checkBytes("[1,[2,3],[4,5]]", { 0x83, 0x01, 0x82, 0x02, 0x03, 0x82, 0x04, 0x05 });
+    checkBytes("{}", { 0xa0 });
+    checkBytes("{\"a\":1,\"b\":[2,3]}", { 0xa2, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, 0x03 });
+    checkBytes("[\"a\",{\"b\":\"c\"}]", { 0x82, 0x61, 0x61, 0xa1, 0x61, 0x62, 0x61, 0x63 });
+
+    // 25 elements need a one-byte count
+    std::vector<uint8_t> output = encode("[1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25]");
+    REQUIRE(output.size() == 29);
+    CHECK_EQUAL(0x98, output[0]);
+    CHECK_EQUAL(25, output[1]);
+    CHECK_EQUAL(0x18, output[25]);
+    CHECK_EQUAL(0x18, output[26]);
+}
+
+TEST(CborSerializer, RejectsSmallBuffer) {
+    StaticJsonDocument<256> document;
+    REQUIRE(!deserializeJson(document, "{\"sensor\":\"temperature\",\"value\":21.5}"));
+    size_t measured = measureCbor(document.as<JsonVariantConst>());
+
+    std::vector<uint8_t> output(measured + 1, 0xEE);
+    CHECK_EQUAL(0, serializeCbor(document.as<JsonVariantConst>(), output.data(), measured - 1));
+    CHECK_EQUAL(measured, serializeCbor(document.as<JsonVariantConst>(), output.data(), measured));
+    CHECK_EQUAL(0xEE, output[measured]); // Nothing written past the end
+}
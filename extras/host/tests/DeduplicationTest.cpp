@@ -0,0 +1,251 @@
+/**
+ * @file DeduplicationTest.cpp
+ * @brief Checks of last-value-wins posts with postLatest()
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static bool postValue(PostQueue& queue, TestServer& server, uint32_t key, int value) {
+    char body[48];
+    snprintf(body, sizeof(body), "{\"k\":%u,\"v\":%d}", (unsigned)key, value);
+    return queue.postLatest(key, server.url().c_str(), body, false);
+}
+
+static std::string valueBody(uint32_t key, int value) {
+    return "{\"k\":" + std::to_string(key) + ",\"v\":" + std::to_string(value) + "}";
+}
+
+// Starts a single-connection queue whose worker is parked on a held request for key 1
+static bool beginHeld(PostQueue& queue, TestServer& server) {
+    server.reset();
+    server.hold();
+    queue.setConnectionPool(1);
+    queue.setDeduplication(true);
+    if (!queue.begin()) {
+        return false;
+    }
+    return postValue(queue, server, 1, 0) && server.waitForRequests(1);
+}
+
+// Releases the server and checks that exactly the expected bodies arrive, in order
+static void checkDelivered(TestServer& server, std::initializer_list<std::string> expected) {
+    server.release();
+    REQUIRE(server.waitForRequests(expected.size()));
+    delay(20); // Let anything unexpected arrive too
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == expected.size());
+    size_t index = 0;
+    for (const std::string& body : expected) {
+        CHECK(bodies[index++] == body);
+    }
+}
+
+TEST(Deduplication, ReplacesInPlaceInFullArena) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    REQUIRE(queue.setArena(192));
+    REQUIRE(beginHeld(queue, server));
+
+    // Key 1 is in flight, so a new post with it is queued again
+    for (uint32_t key = 1; key <= 4; key++) {
+        CHECK(postValue(queue, server, key, 1));
+    }
+    CHECK(queue.isFull());
+
+    // Every key is rewritten in its arena slot: no slot, no allocation
+    for (int value = 2; value <= 3; value++) {
+        for (uint32_t key = 1; key <= 4; key++) {
+            CHECK(postValue(queue, server, key, value));
+        }
+    }
+    CHECK(!queue.post(server.url().c_str(), "{}", false));
+
+    uint32_t replaced;
+    size_t keysQueued;
+    queue.getDeduplicationStats(replaced, keysQueued);
+    CHECK_EQUAL(8, replaced);
+    CHECK_EQUAL(4, keysQueued);
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(1, overflow.rejected);
+
+    checkDelivered(server, { valueBody(1, 0), valueBody(1, 3), valueBody(2, 3), valueBody(3, 3), valueBody(4, 3) });
+    queue.getDeduplicationStats(replaced, keysQueued);
+    CHECK_EQUAL(0, keysQueued);
+    queue.end();
+}
+
+TEST(Deduplication, LongerValueSupersedesHeapItem) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    REQUIRE(beginHeld(queue, server));
+
+    CHECK(postValue(queue, server, 2, 1));
+    CHECK(postValue(queue, server, 3, 1));
+    CHECK(postValue(queue, server, 2, 1000000)); // Longer than the queued heap block
+    CHECK(postValue(queue, server, 2, 7));       // Fits the new block
+
+    uint32_t replaced;
+    size_t keysQueued;
+    queue.getDeduplicationStats(replaced, keysQueued);
+    CHECK_EQUAL(2, replaced);
+    CHECK_EQUAL(2, keysQueued);
+
+    // The superseded item is dropped unsent and the newest value goes out behind key 3
+    checkDelivered(server, { valueBody(1, 0), valueBody(3, 1), valueBody(2, 7) });
+    queue.end();
+}
+
+TEST(Deduplication, DropOldestMovesRefreshedItemsBack) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    queue.setOverflowPolicy(OVERFLOW_DROP_OLDEST);
+    REQUIRE(beginHeld(queue, server));
+
+    for (uint32_t key = 2; key <= 5; key++) {
+        CHECK(postValue(queue, server, key, 1));
+    }
+    CHECK(postValue(queue, server, 2, 2)); // Key 2 is oldest in place but holds new data
+
+    // Room for key 6 comes from key 3, the oldest item not refreshed since it was queued
+    CHECK(postValue(queue, server, 6, 1));
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(1, overflow.evicted);
+    uint32_t replaced;
+    size_t keysQueued;
+    queue.getDeduplicationStats(replaced, keysQueued);
+    CHECK_EQUAL(1, replaced);
+    CHECK_EQUAL(4, keysQueued);
+
+    checkDelivered(server, { valueBody(1, 0), valueBody(4, 1), valueBody(5, 1), valueBody(2, 2), valueBody(6, 1) });
+    queue.end();
+}
+
+TEST(Deduplication, LastValueWinsUnderContention) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    PostQueue queue(8);
+    REQUIRE(queue.setArena(192));
+    queue.setDeduplication(true);
+    REQUIRE(queue.begin());
+
+    // Each producer owns two keys, so the last value posted per key is known
+    const int producers = 4;
+    const int rounds = 2000;
+    std::thread threads[producers];
+    for (int t = 0; t < producers; t++) {
+        threads[t] = std::thread([&queue, &server, t]() {
+            for (int value = 1; value <= rounds; value++) {
+                uint32_t key = 1 + 2 * t + value % 2;
+                while (!postValue(queue, server, key, value)) {
+                    delay(1);
+                }
+            }
+        });
+    }
+    for (int t = 0; t < producers; t++) {
+        threads[t].join();
+    }
+
+    // Wait for the queue to drain
+    uint32_t start = millis();
+    uint32_t replaced;
+    size_t keysQueued;
+    do {
+        delay(5);
+        queue.getDeduplicationStats(replaced, keysQueued);
+    } while ((keysQueued > 0 || !queue.isEmpty()) && millis() - start < 10000);
+    REQUIRE(keysQueued == 0);
+    delay(50);
+
+    int last[2 * producers + 1] = { 0 };
+    for (const std::string& body : server.bodies()) {
+        unsigned key;
+        int value;
+        REQUIRE(sscanf(body.c_str(), "{\"k\":%u,\"v\":%d}", &key, &value) == 2);
+        REQUIRE(key >= 1 && key <= 2 * producers);
+        CHECK(value > last[key]); // Values of a key never go back in time
+        last[key] = value;
+    }
+    for (uint32_t key = 1; key <= 2 * producers; key++) {
+        CHECK_EQUAL(key % 2 == 0 ? rounds - 1 : rounds, last[key]);
+    }
+    queue.end();
+}
+
+TEST(Deduplication, DropOldestWithRefreshedKeysOnRing) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setDelay(1);
+    PostQueue queue(4, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, 3, tskNO_AFFINITY, QUEUE_BACKEND_RING);
+    queue.setConnectionPool(3);
+    queue.setOverflowPolicy(OVERFLOW_DROP_OLDEST);
+    queue.setDeduplication(true);
+    REQUIRE(queue.begin());
+
+    // Producers keep refreshing more keys than the queue holds, so evictions keep
+    // meeting refreshed items that must be moved back or dropped with their index entry
+    const int producers = 4;
+    const int rounds = 1500;
+    const uint32_t keys = 12;
+    std::atomic<uint32_t> refused(0);
+    std::thread threads[producers];
+    for (int t = 0; t < producers; t++) {
+        threads[t] = std::thread([&queue, &server, &refused, t]() {
+            for (int value = 1; value <= rounds; value++) {
+                uint32_t key = 1 + (uint32_t)(t * 7 + value) % keys;
+                if (!postValue(queue, server, key, value)) {
+                    refused++;
+                }
+            }
+        });
+    }
+    for (int t = 0; t < producers; t++) {
+        threads[t].join();
+    }
+
+    uint32_t start = millis();
+    uint32_t replaced;
+    size_t keysQueued;
+    do {
+        delay(5);
+        queue.getDeduplicationStats(replaced, keysQueued);
+    } while ((keysQueued > 0 || !queue.isEmpty()) && millis() - start < 10000);
+    CHECK_EQUAL(0, keysQueued);
+    CHECK(queue.isEmpty());
+    CHECK_EQUAL(0, queue.getQueueSize());
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK(overflow.evicted > 0);
+    CHECK_EQUAL(refused.load(), overflow.rejected); // Only when every entry looked at was refreshed
+
+    // No index entry was left behind for a freed item: each key posted once more goes out
+    delay(50);
+    size_t before = server.requests().size();
+    for (uint32_t key = 1; key <= keys; key++) {
+        CHECK(postValue(queue, server, key, rounds + 1));
+        delay(5); // Stay under the queue size so nothing is evicted
+    }
+    REQUIRE(server.waitForRequests(before + keys));
+    delay(20);
+    std::vector<std::string> bodies = server.bodies();
+    CHECK_EQUAL(before + keys, bodies.size());
+    for (uint32_t key = 1; key <= keys; key++) {
+        size_t seen = 0;
+        for (size_t i = before; i < bodies.size(); i++) {
+            seen += bodies[i] == valueBody(key, rounds + 1);
+        }
+        CHECK_EQUAL(1, seen);
+    }
+    queue.end();
+}
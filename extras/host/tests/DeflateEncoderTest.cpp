@@ -0,0 +1,177 @@
+/**
+ * @file DeflateEncoderTest.cpp
+ * @brief Round trips of DeflateEncoder output through zlib's inflate
+ *
+ * Built only when CMake finds zlib.
+ */
+
+#include <DeflateEncoder.h>
+#include <PostQueue.h>
+
+#include <string>
+#include <zlib.h>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+/**
+ * @brief Collects compressed output; can be told to fail after some calls
+ */
+struct Collected {
+    std::string data;
+    int callsLeft;              ///< Calls before the sink fails (-1 = never)
+};
+
+static bool collect(const uint8_t* data, size_t length, void* context) {
+    Collected* collected = static_cast<Collected*>(context);
+    if (collected->callsLeft == 0) {
+        return false;
+    }
+    if (collected->callsLeft > 0) {
+        collected->callsLeft--;
+    }
+    collected->data.append((const char*)data, length);
+    return true;
+}
+
+// zlib window bits that select each framing
+static int windowBitsFor(DeflateFormat format) {
+    switch (format) {
+        case DEFLATE_FORMAT_RAW:
+            return -15;
+        case DEFLATE_FORMAT_ZLIB:
+            return 15;
+        default:
+            return 15 + 16;
+    }
+}
+
+// Inflates a whole stream, verifying its checksum; returns false if zlib rejects it
+static bool inflateAll(const std::string& compressed, DeflateFormat format, std::string& output) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, windowBitsFor(format)) != Z_OK) {
+        return false;
+    }
+    stream.next_in = (Bytef*)compressed.data();
+    stream.avail_in = (uInt)compressed.size();
+
+    output.clear();
+    int result;
+    do {
+        uint8_t buffer[4096];
+        stream.next_out = buffer;
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        output.append((const char*)buffer, sizeof(buffer) - stream.avail_out);
+    } while (result == Z_OK);
+    bool consumedAll = stream.avail_in == 0;
+    inflateEnd(&stream);
+    return result == Z_STREAM_END && consumedAll;
+}
+
+// Compresses input in writes of step bytes
+static std::string deflateAll(const std::string& input, DeflateFormat format, size_t step) {
+    static DeflateEncoder encoder; // Too large for a comfortable stack frame on a device
+    Collected collected = { std::string(), -1 };
+    encoder.begin(format, collect, &collected);
+    for (size_t offset = 0; offset < input.size(); offset += step) {
+        size_t count = input.size() - offset < step ? input.size() - offset : step;
+        encoder.write((const uint8_t*)input.data() + offset, count);
+    }
+    encoder.finish();
+    if (encoder.bytesIn() != input.size() || encoder.bytesOut() != collected.data.size()) {
+        return std::string("counts differ");
+    }
+    return collected.data;
+}
+
+static void checkRoundTrip(const std::string& input) {
+    for (DeflateFormat format : { DEFLATE_FORMAT_RAW, DEFLATE_FORMAT_ZLIB, DEFLATE_FORMAT_GZIP }) {
+        for (size_t step : { (size_t)1, (size_t)100, input.size() + 1 }) {
+            std::string output;
+            bool inflated = inflateAll(deflateAll(input, format, step), format, output);
+            CHECK(inflated);
+            CHECK(output == input);
+        }
+    }
+}
+
+TEST(DeflateEncoder, EmptyInput) {
+    checkRoundTrip(std::string());
+}
+
+TEST(DeflateEncoder, RepetitiveJson) {
+    std::string input;
+    for (int i = 0; i < 200; i++) {
+        input += "{\"sensor\":\"temperature\",\"value\":" + std::to_string(20 + i % 7) + ",\"unit\":\"C\"},";
+    }
+    checkRoundTrip(input);
+
+    // Repetitive input must actually shrink
+    std::string compressed = deflateAll(input, DEFLATE_FORMAT_GZIP, input.size());
+    CHECK(compressed.size() * 3 < input.size());
+}
+
+TEST(DeflateEncoder, LongRunsAndWindowSlides) {
+    // Runs longer than the longest match, then distinct data past several windows
+    std::string input(5000, 'a');
+    uint32_t state = 12345;
+    for (int i = 0; i < 20000; i++) {
+        state = state * 1103515245u + 12345u;
+        input += (char)('a' + (state >> 16) % 4);
+    }
+    input += std::string(300, 'z');
+    checkRoundTrip(input);
+}
+
+TEST(DeflateEncoder, IncompressibleBytes) {
+    std::string input;
+    uint32_t state = 99;
+    for (int i = 0; i < 9000; i++) {
+        state = state * 1664525u + 1013904223u;
+        input += (char)(state >> 24);
+    }
+    checkRoundTrip(input);
+}
+
+TEST(DeflateEncoder, StopsWhenSinkFails) {
+    static DeflateEncoder encoder;
+    Collected collected = { std::string(), 1 };
+    encoder.begin(DEFLATE_FORMAT_GZIP, collect, &collected);
+
+    std::string input;
+    uint32_t state = 7;
+    for (int i = 0; i < 4000; i++) {
+        state = state * 1664525u + 1013904223u;
+        input += (char)(state >> 24);
+    }
+    bool written = encoder.write((const uint8_t*)input.data(), input.size());
+    bool finished = encoder.finish();
+    CHECK(!(written && finished));
+}
+
+TEST(DeflateEncoder, QueueSendsCompressedBodies) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    PostQueue queue(8);
+    queue.setCompression(COMPRESSION_GZIP, 64);
+    REQUIRE(queue.begin());
+
+    std::string large = "[";
+    for (int i = 0; i < 40; i++) {
+        large += "{\"i\":" + std::to_string(i) + ",\"status\":\"ok\"},";
+    }
+    large.back() = ']';
+    CHECK(queue.post(server.url().c_str(), large.c_str(), false));
+    CHECK(queue.post(server.url().c_str(), "{\"small\":1}", false)); // Below the minimum size
+    REQUIRE(server.waitForRequests(2));
+
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 2);
+    std::string inflated;
+    CHECK(inflateAll(bodies[0], DEFLATE_FORMAT_GZIP, inflated));
+    CHECK(inflated == large);
+    CHECK(bodies[1] == "{\"small\":1}");
+    queue.end();
+}
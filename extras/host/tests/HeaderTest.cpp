@@ -0,0 +1,142 @@
+/**
+ * @file HeaderTest.cpp
+ * @brief Checks of custom header parsing and header sets as they reach the wire
+ *
+ * Each case runs on the HTTPClient path and on the raw path, which writes
+ * the normalized header block to the socket itself.
+ */
+
+#include <PostQueue.h>
+
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+// Starts a queue on the HTTPClient path, or on the raw path through the in-flight loop
+static bool beginOnPath(PostQueue& queue, TestServer& server, bool raw) {
+    server.reset();
+    if (raw) {
+        queue.setMaxInFlight(2);
+    }
+    return queue.begin();
+}
+
+// Posts one item and returns the head the server received, or "" if it was not sent
+static std::string sentHead(PostQueue& queue, TestServer& server, const char* headers, uint8_t headerSet = 0) {
+    size_t before = server.requests().size();
+    if (!queue.post(server.url().c_str(), "{}", false, headers, headerSet) || !server.waitForRequests(before + 1)) {
+        return "";
+    }
+    return server.requests()[before].head;
+}
+
+static bool hasLine(const std::string& head, const char* line) {
+    return head.find(std::string("\r\n") + line + "\r\n") != std::string::npos;
+}
+
+// "X-H0: 0\nX-H1: 1\n..." with count fields
+static std::string manyHeaders(int count) {
+    std::string headers;
+    for (int i = 0; i < count; i++) {
+        headers += "X-H" + std::to_string(i) + ": " + std::to_string(i) + "\n";
+    }
+    return headers;
+}
+
+static void checkTrimsAndSkips(bool raw) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, server, raw));
+
+    std::string head = sentHead(queue, server,
+                                "  X-One :  1  \r\n\r\nX-Two:two\nnot a header\n\n: nameless\nX-Three:\t3");
+    REQUIRE(head.size() > 0);
+    // Only HTTPClient adds a User-Agent, so this tells which path sent the request
+    CHECK_EQUAL(raw, head.find("User-Agent:") == std::string::npos);
+    CHECK(hasLine(head, "X-One: 1"));
+    CHECK(hasLine(head, "X-Two: two"));
+    CHECK(hasLine(head, "X-Three: 3"));
+    CHECK(head.find("not a header") == std::string::npos);
+    CHECK(head.find("nameless") == std::string::npos);
+    CHECK(head.find("\r\n\r\n") == std::string::npos); // No blank line ends the head early
+    queue.end();
+}
+
+TEST(Header, TrimsAndSkipsLines) {
+    checkTrimsAndSkips(false);
+}
+
+TEST(Header, TrimsAndSkipsLinesOnRawPath) {
+    checkTrimsAndSkips(true);
+}
+
+static void checkFieldLimit(bool raw) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, server, raw));
+
+    std::string head = sentHead(queue, server, manyHeaders(MAX_HEADER_FIELDS).c_str());
+    REQUIRE(head.size() > 0);
+    CHECK(hasLine(head, "X-H0: 0"));
+    CHECK(hasLine(head, "X-H15: 15"));
+
+    // Lines without a name do not count against the limit
+    std::string padded = manyHeaders(MAX_HEADER_FIELDS) + "no colon\n: nameless\n";
+    CHECK(queue.post(server.url().c_str(), "{}", false, padded.c_str()));
+    CHECK(!queue.post(server.url().c_str(), "{}", false, manyHeaders(MAX_HEADER_FIELDS + 1).c_str()));
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(POST_PRIORITY_NORMAL, lane));
+    CHECK_EQUAL(2, lane.enqueued);
+    REQUIRE(server.waitForRequests(2));
+    queue.end();
+}
+
+TEST(Header, FieldLimit) {
+    checkFieldLimit(false);
+}
+
+TEST(Header, FieldLimitOnRawPath) {
+    checkFieldLimit(true);
+}
+
+static void checkHeaderSets(bool raw) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4);
+    uint8_t device = queue.addHeaderSet(" Authorization : Bearer token \nX-Device: d1");
+    uint8_t empty = queue.addHeaderSet("no fields here");
+    CHECK_EQUAL(1, device);
+    CHECK_EQUAL(2, empty);
+    CHECK_EQUAL(0, queue.addHeaderSet(manyHeaders(MAX_HEADER_FIELDS + 1).c_str()));
+    REQUIRE(beginOnPath(queue, server, raw));
+    CHECK_EQUAL(0, queue.addHeaderSet("X-Late: 1"));
+
+    // Set headers come first, then the item's own
+    std::string head = sentHead(queue, server, "X-Custom: c", device);
+    REQUIRE(head.size() > 0);
+    size_t authorization = head.find("\r\nAuthorization: Bearer token\r\n");
+    size_t deviceLine = head.find("\r\nX-Device: d1\r\n");
+    size_t custom = head.find("\r\nX-Custom: c\r\n");
+    CHECK(authorization != std::string::npos);
+    CHECK(deviceLine != std::string::npos);
+    CHECK(custom != std::string::npos);
+    CHECK(authorization < deviceLine);
+    CHECK(deviceLine < custom);
+
+    head = sentHead(queue, server, NULL, empty);
+    REQUIRE(head.size() > 0);
+    CHECK(head.find("Authorization") == std::string::npos);
+    CHECK(head.find("no fields") == std::string::npos);
+
+    CHECK(!queue.post(server.url().c_str(), "{}", false, NULL, 3));
+    queue.end();
+}
+
+TEST(Header, HeaderSets) {
+    checkHeaderSets(false);
+}
+
+TEST(Header, HeaderSetsOnRawPath) {
+    checkHeaderSets(true);
+}
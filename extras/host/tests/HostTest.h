@@ -0,0 +1,132 @@
+/**
+ * @file HostTest.h
+ * @brief Minimal test harness for the host build
+ *
+ * Each <Suite>Test.cpp file defines cases with TEST(Suite, name). The
+ * postqueue_tests executable runs every case, or only those of the suite
+ * named on its command line, and exits non-zero if any check failed. CMake
+ * registers one CTest test per file, so `ctest` reports suites separately.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief One registered test case
+ */
+struct TestCase {
+    const char* suite;          ///< Suite name, matching the file <Suite>Test.cpp
+    const char* name;           ///< Case name
+    void (*run)();              ///< Case body
+    TestCase* next;             ///< Next registered case
+};
+
+/**
+ * @brief Registry of test cases and failed checks
+ */
+class HostTest {
+public:
+    /**
+     * @brief Add a case; called by the TEST() macro before main()
+     */
+    static void add(TestCase* test) {
+        test->next = NULL;
+        TestCase** tail = &head();
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+        *tail = test;
+    }
+
+    /**
+     * @brief Record a failed check and print where it happened
+     */
+    static void fail(const char* file, int line, const char* expression) {
+        printf("    %s:%d: check failed: %s\n", file, line, expression);
+        failures()++;
+    }
+
+    /**
+     * @brief Registered cases, in registration order
+     */
+    static TestCase*& head() {
+        static TestCase* first = NULL;
+        return first;
+    }
+
+    /**
+     * @brief Failed checks so far
+     */
+    static uint32_t& failures() {
+        static uint32_t count = 0;
+        return count;
+    }
+};
+
+/**
+ * @brief Registers a case at static initialization
+ */
+struct TestRegistration {
+    TestRegistration(TestCase* test) { HostTest::add(test); }
+};
+
+/**
+ * @brief Define a test case belonging to a suite
+ */
+#define TEST(suite, name)                                                          \
+    static void suite##_##name();                                                  \
+    static TestCase suite##_##name##_case = { #suite, #name, suite##_##name, NULL }; \
+    static TestRegistration suite##_##name##_registration(&suite##_##name##_case); \
+    static void suite##_##name()
+
+/**
+ * @brief Define a PostQueue case that runs on both queue backends
+ *
+ * Registers suite.name for QUEUE_BACKEND_FREERTOS and suite.nameOnRing for
+ * QUEUE_BACKEND_RING; the body receives the backend as `backend`.
+ */
+#define TEST_BACKENDS(suite, name)                                                 \
+    static void suite##_##name##_body(QueueBackend backend);                       \
+    TEST(suite, name) { suite##_##name##_body(QUEUE_BACKEND_FREERTOS); }           \
+    TEST(suite, name##OnRing) { suite##_##name##_body(QUEUE_BACKEND_RING); }       \
+    static void suite##_##name##_body(QueueBackend backend)
+
+/**
+ * @brief Check a condition, continuing the case if it fails
+ */
+#define CHECK(condition)                                                           \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            HostTest::fail(__FILE__, __LINE__, #condition);                        \
+        }                                                                          \
+    } while (0)
+
+/**
+ * @brief Check two integers for equality, printing both when they differ
+ */
+#define CHECK_EQUAL(expected, actual)                                              \
+    do {                                                                           \
+        long long expectedValue = (long long)(expected);                           \
+        long long actualValue = (long long)(actual);                               \
+        if (expectedValue != actualValue) {                                        \
+            printf("    expected %lld, got %lld\n", expectedValue, actualValue);   \
+            HostTest::fail(__FILE__, __LINE__, #expected " == " #actual);          \
+        }                                                                          \
+    } while (0)
+
+/**
+ * @brief Check a condition and leave the case if it fails
+ */
+#define REQUIRE(condition)                                                         \
+    do {                                                                           \
+        if (!(condition)) {                                                        \
+            HostTest::fail(__FILE__, __LINE__, #condition);                        \
+            return;                                                                \
+        }                                                                          \
+    } while (0)
+
+#endif // HOST_TEST_H
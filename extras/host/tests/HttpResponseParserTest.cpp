@@ -0,0 +1,162 @@
+/**
+ * @file HttpResponseParserTest.cpp
+ * @brief Checks of response framing in the incremental HTTP parser
+ */
+
+#include <HttpResponseParser.h>
+
+#include <string>
+
+#include "HostTest.h"
+
+static void appendBody(const uint8_t* data, size_t length, void* context) {
+    static_cast<std::string*>(context)->append((const char*)data, length);
+}
+
+// Feeds text in slices of step bytes until the parser stops consuming; returns the bytes consumed
+static size_t feedAll(HttpResponseParser& parser, const std::string& text, size_t step) {
+    size_t consumed = 0;
+    while (consumed < text.size() && !parser.isComplete() && !parser.hasError()) {
+        size_t count = text.size() - consumed < step ? text.size() - consumed : step;
+        consumed += parser.feed((const uint8_t*)text.data() + consumed, count);
+    }
+    return consumed;
+}
+
+TEST(HttpResponseParser, ContentLengthLeavesNextResponse) {
+    std::string first = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+    std::string second = "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n";
+
+    // Byte by byte and in one piece must agree
+    for (size_t step : { (size_t)1, (size_t)4096 }) {
+        std::string body;
+        HttpResponseParser parser;
+        parser.reset(appendBody, &body);
+        CHECK_EQUAL(first.size(), feedAll(parser, first + second, step));
+        CHECK(parser.isComplete());
+        CHECK_EQUAL(200, parser.statusCode());
+        CHECK(parser.keepAlive());
+        CHECK(body == "hello");
+
+        parser.reset(appendBody, &body);
+        CHECK_EQUAL(second.size(), feedAll(parser, second, step));
+        CHECK(parser.isComplete());
+        CHECK_EQUAL(201, parser.statusCode());
+    }
+}
+
+TEST(HttpResponseParser, Chunked) {
+    std::string response =
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5;ext=1\r\nhello\r\n"
+        "7\r\n, world\r\n"
+        "0\r\nX-Trailer: yes\r\n\r\n";
+    std::string next = "HTTP/1.1 200 OK\r\n";
+
+    for (size_t step : { (size_t)1, (size_t)3, (size_t)4096 }) {
+        std::string body;
+        HttpResponseParser parser;
+        parser.reset(appendBody, &body);
+        CHECK_EQUAL(response.size(), feedAll(parser, response + next, step));
+        CHECK(parser.isComplete());
+        CHECK(parser.keepAlive());
+        CHECK(body == "hello, world");
+    }
+}
+
+TEST(HttpResponseParser, RejectsBadChunkFraming) {
+    HttpResponseParser parser;
+    feedAll(parser, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n", 4096);
+    CHECK(parser.hasError());
+
+    parser.reset();
+    feedAll(parser, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 4096);
+    CHECK(parser.hasError());
+}
+
+TEST(HttpResponseParser, SkipsInterimResponses) {
+    std::string body;
+    HttpResponseParser parser;
+    parser.reset(appendBody, &body);
+    std::string response =
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 102 Processing\r\nX-Progress: 1\r\n\r\n"
+        "HTTP/1.1 202 Accepted\r\nContent-Length: 2\r\n\r\nok";
+    CHECK_EQUAL(response.size(), feedAll(parser, response, 7));
+    CHECK(parser.isComplete());
+    CHECK_EQUAL(202, parser.statusCode());
+    CHECK(body == "ok");
+}
+
+TEST(HttpResponseParser, NoBodyStatuses) {
+    // 204 and 304 never have a body, whatever the headers say
+    for (const char* status : { "204 No Content", "304 Not Modified" }) {
+        std::string head = std::string("HTTP/1.1 ") + status + "\r\nContent-Length: 10\r\n\r\n";
+        HttpResponseParser parser;
+        CHECK_EQUAL(head.size(), feedAll(parser, head + "HTTP/1.1", 4096));
+        CHECK(parser.isComplete());
+        CHECK(parser.keepAlive());
+    }
+}
+
+TEST(HttpResponseParser, BodyUntilClose) {
+    std::string body;
+    HttpResponseParser parser;
+    parser.reset(appendBody, &body);
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nstreamed until close";
+    CHECK_EQUAL(response.size(), feedAll(parser, response, 5));
+    CHECK(!parser.isComplete());
+    CHECK(!parser.keepAlive());
+
+    parser.finish();
+    CHECK(parser.isComplete());
+    CHECK(!parser.hasError());
+    CHECK(body == "streamed until close");
+}
+
+TEST(HttpResponseParser, TruncatedBodyFails) {
+    HttpResponseParser parser;
+    feedAll(parser, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", 4096);
+    CHECK(!parser.isComplete());
+    parser.finish();
+    CHECK(parser.hasError());
+}
+
+TEST(HttpResponseParser, ConnectionAndRetryAfter) {
+    HttpResponseParser parser;
+    feedAll(parser, "HTTP/1.1 503 Unavailable\r\nRetry-After: 7\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", 4096);
+    CHECK(parser.isComplete());
+    CHECK_EQUAL(503, parser.statusCode());
+    CHECK_EQUAL(7, parser.retryAfter());
+    CHECK(!parser.keepAlive());
+
+    parser.reset();
+    feedAll(parser, "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n", 4096);
+    CHECK(!parser.keepAlive());
+
+    parser.reset();
+    feedAll(parser, "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 0\r\n\r\n", 4096);
+    CHECK(parser.keepAlive());
+
+    // A date form is not parsed
+    parser.reset();
+    feedAll(parser, "HTTP/1.1 429 Too Many\r\nRetry-After: Wed, 21 Oct 2026 07:28:00 GMT\r\nContent-Length: 0\r\n\r\n", 4096);
+    CHECK_EQUAL(0, parser.retryAfter());
+}
+
+TEST(HttpResponseParser, HeadersOnly) {
+    std::string body;
+    HttpResponseParser parser;
+    parser.reset(appendBody, &body, true);
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n";
+    CHECK_EQUAL(head.size(), feedAll(parser, head + "hello", 4096));
+    CHECK(parser.isComplete());
+    CHECK(!parser.keepAlive()); // The body is still on the connection
+    CHECK(body.empty());
+}
+
+TEST(HttpResponseParser, RejectsGarbage) {
+    HttpResponseParser parser;
+    feedAll(parser, "\r\nSSH-2.0-OpenSSH\r\n", 4096);
+    CHECK(parser.hasError());
+}
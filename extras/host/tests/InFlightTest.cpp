@@ -0,0 +1,157 @@
+/**
+ * @file InFlightTest.cpp
+ * @brief End-to-end checks of several requests in flight per worker against a slow server
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static std::atomic<uint32_t> completions(0);
+static std::atomic<uint32_t> successes(0);
+static std::atomic<int> lastCode(0);
+
+static void recordOutcome(bool success, int httpCode, const String& response) {
+    (void)response;
+    lastCode = httpCode;
+    if (success) {
+        successes++;
+    }
+    completions++;
+}
+
+// Starts a queue whose one worker keeps up to four requests in flight
+static bool beginInFlight(PostQueue& queue) {
+    completions = 0;
+    successes = 0;
+    lastCode = 0;
+    queue.setMaxInFlight(4);
+    queue.setConnectionPool(4);
+    queue.setCallback(recordOutcome);
+    return queue.begin();
+}
+
+static bool waitForCompletions(uint32_t count, uint32_t timeout = 5000) {
+    uint32_t start = millis();
+    while (completions < count) {
+        if (millis() - start > timeout) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+static bool postNumbered(PostQueue& queue, TestServer& server, int i) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"i\":%d}", i);
+    return queue.post(server.url().c_str(), body, false);
+}
+
+TEST_BACKENDS(InFlight, SlowAnswersOverlap) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setDelay(200);
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginInFlight(queue));
+
+    // One at a time these would take 800 ms
+    uint32_t start = millis();
+    for (int i = 1; i <= 4; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(server.waitForRequests(4, 150));
+    REQUIRE(waitForCompletions(4));
+    uint32_t elapsed = millis() - start;
+    CHECK(elapsed >= 199);
+    CHECK(elapsed < 400);
+    CHECK_EQUAL(4, successes.load());
+    CHECK_EQUAL(200, lastCode.load());
+
+    uint32_t processed, successful, failed;
+    queue.getStats(processed, successful, failed);
+    CHECK_EQUAL(4, successful);
+    CHECK_EQUAL(0, failed);
+    queue.end();
+}
+
+TEST_BACKENDS(InFlight, MoreItemsThanSlotsWaitForAFreeOne) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setDelay(100);
+    PostQueue queue(16, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginInFlight(queue));
+
+    // Two rounds of four, the second on the connections the first opened
+    uint32_t start = millis();
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(server.waitForRequests(4));
+    delay(50);
+    CHECK_EQUAL(4, server.requests().size());
+    REQUIRE(waitForCompletions(8));
+    uint32_t elapsed = millis() - start;
+    CHECK(elapsed >= 199);
+    CHECK(elapsed < 350);
+    delay(20);
+    CHECK_EQUAL(8, completions.load());
+    CHECK_EQUAL(8, successes.load());
+
+    // Every body arrived exactly once
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 8);
+    for (int i = 1; i <= 8; i++) {
+        std::string body = "{\"i\":" + std::to_string(i) + "}";
+        size_t seen = 0;
+        for (const std::string& received : bodies) {
+            seen += received == body;
+        }
+        CHECK_EQUAL(1, seen);
+    }
+
+    uint32_t hits, misses;
+    queue.getConnectionStats(hits, misses);
+    CHECK_EQUAL(4, misses);
+    CHECK_EQUAL(4, hits);
+    queue.end();
+}
+
+TEST_BACKENDS(InFlight, SlowAnswersTimeOut) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setDelay(300);
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setTimeout(100);
+    REQUIRE(beginInFlight(queue));
+
+    // Every request times out on its own, not one after another
+    uint32_t start = millis();
+    for (int i = 1; i <= 4; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(waitForCompletions(4));
+    uint32_t elapsed = millis() - start;
+    CHECK(elapsed >= 99);
+    CHECK(elapsed < 250);
+    CHECK_EQUAL(0, successes.load());
+    CHECK_EQUAL(HTTPC_ERROR_READ_TIMEOUT, lastCode.load());
+
+    uint32_t processed, successful, failed;
+    queue.getStats(processed, successful, failed);
+    CHECK_EQUAL(4, failed);
+
+    // The timed-out connections are dropped; fresh ones deliver once the server is quick again
+    server.setDelay(0);
+    for (int i = 5; i <= 8; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(waitForCompletions(8));
+    CHECK_EQUAL(4, successes.load());
+    CHECK_EQUAL(200, lastCode.load());
+    queue.end();
+}
@@ -0,0 +1,111 @@
+/**
+ * @file KeyIndexTest.cpp
+ * @brief Checks of the key index, including deletion by backward shift
+ */
+
+#include <KeyIndex.h>
+
+#include <map>
+
+#include "HostTest.h"
+
+// Checks every key of a universe against the reference contents
+static bool matches(const KeyIndex& index, const std::map<uint32_t, void*>& reference, uint32_t universe) {
+    for (uint32_t key = 1; key <= universe; key++) {
+        std::map<uint32_t, void*>::const_iterator found = reference.find(key);
+        void* expected = found != reference.end() ? found->second : NULL;
+        if (index.find(key) != expected) {
+            return false;
+        }
+    }
+    return index.size() == reference.size();
+}
+
+TEST(KeyIndex, InsertFindErase) {
+    KeyIndex index;
+    CHECK(!index.isOpen());
+    CHECK(index.find(1) == NULL);
+    REQUIRE(index.begin(4));
+
+    int values[4];
+    for (uint32_t key = 1; key <= 4; key++) {
+        CHECK(index.insert(key * 1000, &values[key - 1]));
+    }
+    CHECK_EQUAL(4, index.size());
+    CHECK(index.find(3000) == &values[2]);
+    CHECK(index.find(5000) == NULL);
+
+    // Replacing a value takes no room; a fifth key does not fit
+    CHECK(index.insert(3000, &values[0]));
+    CHECK(index.find(3000) == &values[0]);
+    CHECK(!index.insert(5000, &values[0]));
+    CHECK_EQUAL(4, index.size());
+
+    CHECK(index.erase(1000));
+    CHECK(!index.erase(1000));
+    CHECK(index.find(1000) == NULL);
+    CHECK(index.insert(5000, &values[3]));
+    CHECK(index.find(5000) == &values[3]);
+
+    // Key 0 marks empty slots and is never stored
+    CHECK(!index.insert(0, &values[0]));
+    CHECK(!index.erase(0));
+    CHECK(index.find(0) == NULL);
+
+    index.end();
+    CHECK(!index.isOpen());
+    CHECK(index.find(5000) == NULL);
+}
+
+TEST(KeyIndex, EraseKeepsProbeRunsIntact) {
+    // A small table over a small key space collides constantly, so nearly every
+    // erase has to shift later entries of a probe run back
+    KeyIndex index;
+    REQUIRE(index.begin(8));
+    std::map<uint32_t, void*> reference;
+    const uint32_t universe = 64;
+    static int values[universe + 1];
+
+    uint32_t state = 1;
+    for (int step = 0; step < 20000; step++) {
+        state = state * 1664525u + 1013904223u;
+        uint32_t key = 1 + (state >> 8) % universe;
+        if ((state >> 28) < 9) {
+            bool fits = reference.size() < index.capacity() || reference.count(key) > 0;
+            CHECK_EQUAL(fits, index.insert(key, &values[key]));
+            if (fits) {
+                reference[key] = &values[key];
+            }
+        } else {
+            CHECK_EQUAL(reference.erase(key), index.erase(key));
+        }
+        if (!matches(index, reference, universe)) {
+            CHECK(false);
+            return;
+        }
+    }
+
+    // Emptying the table leaves nothing behind
+    for (uint32_t key = 1; key <= universe; key++) {
+        index.erase(key);
+    }
+    CHECK_EQUAL(0, index.size());
+    reference.clear();
+    CHECK(matches(index, reference, universe));
+}
+
+TEST(KeyIndex, ConsecutiveKeys) {
+    // Sensor ids are usually consecutive; all of them must fit at full capacity
+    KeyIndex index;
+    REQUIRE(index.begin(100));
+    static int values[101];
+    for (uint32_t key = 1; key <= 100; key++) {
+        CHECK(index.insert(key, &values[key]));
+    }
+    for (uint32_t key = 1; key <= 100; key += 2) {
+        CHECK(index.erase(key));
+    }
+    for (uint32_t key = 1; key <= 100; key++) {
+        CHECK(index.find(key) == (key % 2 == 0 ? &values[key] : NULL));
+    }
+}
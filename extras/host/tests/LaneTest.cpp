@@ -0,0 +1,185 @@
+/**
+ * @file LaneTest.cpp
+ * @brief Checks of priority lanes: strict and weighted service order, starvation and per-lane limits
+ */
+
+#include <PostQueue.h>
+
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static bool postToLane(PostQueue& queue, TestServer& server, uint8_t priority, int i) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"l\":%u,\"i\":%d}", (unsigned)priority, i);
+    return queue.post(server.url().c_str(), body, false, NULL, 0, priority);
+}
+
+// Starts a single-connection queue whose worker is parked on a held lane 0 request
+static bool beginHeld(PostQueue& queue, TestServer& server) {
+    server.reset();
+    server.hold();
+    queue.setConnectionPool(1);
+    if (!queue.begin()) {
+        return false;
+    }
+    return postToLane(queue, server, 0, 0) && server.waitForRequests(1);
+}
+
+// Releases the server and returns the lane of each request after the held one, e.g. "2211"
+static std::string serviceOrder(TestServer& server, size_t count) {
+    server.release();
+    if (!server.waitForRequests(count + 1)) {
+        return "";
+    }
+    delay(20); // Let anything unexpected arrive too
+    std::string order;
+    std::vector<std::string> bodies = server.bodies();
+    for (size_t i = 1; i < bodies.size(); i++) {
+        order += bodies[i][5]; // The digit in {"l":N,...
+    }
+    return order;
+}
+
+TEST_BACKENDS(Lane, StrictServesHighestLaneFirst) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(3, LANE_SCHEDULING_STRICT));
+    queue.setStarvationLimit(0);
+    REQUIRE(beginHeld(queue, server));
+
+    for (int i = 1; i <= 3; i++) {
+        CHECK(postToLane(queue, server, 0, i));
+        CHECK(postToLane(queue, server, 1, i));
+        CHECK(postToLane(queue, server, 2, i));
+    }
+    CHECK(serviceOrder(server, 9) == "222111000");
+
+    // Within a lane items keep their posting order
+    std::vector<std::string> bodies = server.bodies();
+    CHECK(bodies[1] == "{\"l\":2,\"i\":1}");
+    CHECK(bodies[3] == "{\"l\":2,\"i\":3}");
+    CHECK(bodies[9] == "{\"l\":0,\"i\":3}");
+    queue.end();
+}
+
+TEST_BACKENDS(Lane, StarvedLaneGoesFirst) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(16, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(2, LANE_SCHEDULING_STRICT));
+    queue.setStarvationLimit(200);
+    REQUIRE(beginHeld(queue, server));
+
+    CHECK(postToLane(queue, server, 0, 1));
+    CHECK(postToLane(queue, server, 0, 2));
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postToLane(queue, server, 1, i));
+    }
+    delay(250); // Past the starvation limit for lane 0
+
+    // One lane 0 item jumps the queue, then it must wait out the limit again
+    CHECK(serviceOrder(server, 10) == "0111111110");
+    queue.end();
+}
+
+TEST_BACKENDS(Lane, ZeroStarvationLimitIsPureStrict) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(16, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(2, LANE_SCHEDULING_STRICT));
+    queue.setStarvationLimit(0);
+    REQUIRE(beginHeld(queue, server));
+
+    CHECK(postToLane(queue, server, 0, 1));
+    CHECK(postToLane(queue, server, 0, 2));
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postToLane(queue, server, 1, i));
+    }
+    delay(250);
+
+    CHECK(serviceOrder(server, 10) == "1111111100");
+    queue.end();
+}
+
+TEST_BACKENDS(Lane, WeightedServesInProportion) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(2, LANE_SCHEDULING_WEIGHTED));
+    queue.setLaneWeight(0, 1);
+    queue.setLaneWeight(1, 3);
+    REQUIRE(beginHeld(queue, server));
+
+    // The held lane 0 item used lane 0's turn; then three from lane 1 for each one
+    // from lane 0 while both have items, and lane 0 alone once lane 1 is empty
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postToLane(queue, server, 0, i));
+        CHECK(postToLane(queue, server, 1, i));
+    }
+    CHECK(serviceOrder(server, 16) == "1110111011000000");
+    queue.end();
+}
+
+TEST_BACKENDS(Lane, WeightedWithThreeLanes) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(3, LANE_SCHEDULING_WEIGHTED));
+    queue.setLaneWeight(0, 1);
+    queue.setLaneWeight(1, 2);
+    queue.setLaneWeight(2, 4);
+    REQUIRE(beginHeld(queue, server));
+
+    for (int i = 1; i <= 6; i++) {
+        CHECK(postToLane(queue, server, 0, i));
+        CHECK(postToLane(queue, server, 1, i));
+        CHECK(postToLane(queue, server, 2, i));
+    }
+
+    // Turns run from the top lane down: 4 from lane 2, 2 from lane 1, 1 from lane 0.
+    // An empty lane passes its turn to the next lane that has items.
+    CHECK(serviceOrder(server, 18) == "222211022110110000");
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(2, lane));
+    CHECK_EQUAL(6, lane.dequeued);
+    REQUIRE(queue.getLaneStats(0, lane));
+    CHECK_EQUAL(7, lane.dequeued);
+    queue.end();
+}
+
+TEST_BACKENDS(Lane, PerLaneLimits) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(10, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(queue.setPriorityLanes(2));
+    queue.setLaneLimit(0, 2);
+    queue.setLaneLimit(1, 4);
+    REQUIRE(beginHeld(queue, server));
+
+    CHECK(postToLane(queue, server, 0, 1));
+    CHECK(postToLane(queue, server, 0, 2));
+    CHECK(!postToLane(queue, server, 0, 3));
+    CHECK(queue.isFull(0));
+    CHECK(!queue.isFull(1));
+
+    // Priorities above the top lane go to the top lane
+    CHECK(postToLane(queue, server, 1, 1));
+    CHECK(postToLane(queue, server, 1, 2));
+    CHECK(postToLane(queue, server, POST_PRIORITY_CRITICAL, 3));
+    CHECK(postToLane(queue, server, 1, 4));
+    CHECK(!postToLane(queue, server, 1, 5));
+    CHECK(queue.isFull(1));
+    CHECK(queue.isFull(POST_PRIORITY_CRITICAL));
+    CHECK_EQUAL(6, queue.getQueueSize());
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(0, lane));
+    CHECK_EQUAL(2, lane.queued);
+    CHECK_EQUAL(1, lane.rejected);
+    REQUIRE(queue.getLaneStats(1, lane));
+    CHECK_EQUAL(4, lane.queued);
+    CHECK_EQUAL(4, lane.enqueued);
+    CHECK_EQUAL(1, lane.rejected);
+    CHECK(!queue.getLaneStats(2, lane));
+
+    CHECK(serviceOrder(server, 6) == "112100"); // The critical item carries "l":2
+    queue.end();
+}
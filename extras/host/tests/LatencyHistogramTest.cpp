@@ -0,0 +1,135 @@
+/**
+ * @file LatencyHistogramTest.cpp
+ * @brief Checks of the latency histogram: bucket edges, the range ends and percentile estimates
+ */
+
+#include <LatencyHistogram.h>
+
+#include "HostTest.h"
+
+// The bucket a single duration lands in, or LATENCY_BUCKETS if none counted it
+static uint8_t bucketOf(uint32_t duration) {
+    LatencyHistogram histogram;
+    histogram.record(duration);
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        if (histogram.bucketCount(bucket) > 0) {
+            return bucket;
+        }
+    }
+    return LATENCY_BUCKETS;
+}
+
+TEST(LatencyHistogram, Empty) {
+    LatencyHistogram histogram;
+    CHECK_EQUAL(0, histogram.count());
+    CHECK_EQUAL(0, histogram.max());
+    CHECK_EQUAL(0, histogram.mean());
+    CHECK_EQUAL(0, histogram.percentile(50));
+    CHECK_EQUAL(0, histogram.percentile(99));
+    CHECK_EQUAL(0, histogram.bucketCount(LATENCY_BUCKETS));
+}
+
+TEST(LatencyHistogram, BucketEdgesAtTheBottomOfTheRange) {
+    // Everything under 128 us shares the first bucket
+    CHECK_EQUAL(0, LatencyHistogram::bucketStart(0));
+    CHECK_EQUAL(0, bucketOf(0));
+    CHECK_EQUAL(0, bucketOf(127));
+
+    // The first octave, 128 to 255 us, in four steps of 32 us
+    CHECK_EQUAL(128, LatencyHistogram::bucketStart(1));
+    CHECK_EQUAL(160, LatencyHistogram::bucketStart(2));
+    CHECK_EQUAL(192, LatencyHistogram::bucketStart(3));
+    CHECK_EQUAL(224, LatencyHistogram::bucketStart(4));
+    CHECK_EQUAL(256, LatencyHistogram::bucketStart(5));
+    CHECK_EQUAL(1, bucketOf(128));
+    CHECK_EQUAL(1, bucketOf(159));
+    CHECK_EQUAL(2, bucketOf(160));
+    CHECK_EQUAL(4, bucketOf(255));
+    CHECK_EQUAL(5, bucketOf(256));
+}
+
+TEST(LatencyHistogram, BucketEdgesAtTheTopOfTheRange) {
+    // The last octave ends at 2^27 us, about 134 s
+    const uint32_t top = 1UL << (LATENCY_MIN_BITS + LATENCY_OCTAVES);
+    CHECK_EQUAL(134217728, top);
+    CHECK_EQUAL(top, LatencyHistogram::bucketStart(LATENCY_BUCKETS - 1));
+    CHECK_EQUAL(top - top / 8, LatencyHistogram::bucketStart(LATENCY_BUCKETS - 2));
+    CHECK_EQUAL(LATENCY_BUCKETS - 2, bucketOf(top - 1));
+    CHECK_EQUAL(LATENCY_BUCKETS - 1, bucketOf(top));
+}
+
+TEST(LatencyHistogram, EveryBucketStartsWhereThePreviousEnds) {
+    for (uint8_t bucket = 1; bucket < LATENCY_BUCKETS; bucket++) {
+        uint32_t start = LatencyHistogram::bucketStart(bucket);
+        CHECK(start > LatencyHistogram::bucketStart(bucket - 1));
+        CHECK_EQUAL(bucket, bucketOf(start));
+        CHECK_EQUAL(bucket - 1, bucketOf(start - 1));
+    }
+}
+
+TEST(LatencyHistogram, OverflowIsClampedIntoTheTopBucket) {
+    LatencyHistogram histogram;
+    histogram.record(1UL << 27);
+    histogram.record(3000000000UL);
+    histogram.record(UINT32_MAX);
+    CHECK_EQUAL(3, histogram.count());
+    CHECK_EQUAL(3, histogram.bucketCount(LATENCY_BUCKETS - 1));
+    CHECK_EQUAL(UINT32_MAX, histogram.max());
+
+    // The 64-bit sum does not wrap
+    CHECK_EQUAL(((1ULL << 27) + 3000000000ULL + UINT32_MAX) / 3, histogram.mean());
+
+    // Percentiles in the open-ended top bucket stay between its start and the longest duration
+    uint32_t p50 = histogram.percentile(50);
+    CHECK(p50 >= (1UL << 27));
+    CHECK(p50 <= UINT32_MAX);
+    CHECK_EQUAL(UINT32_MAX, histogram.percentile(100));
+    CHECK_EQUAL(UINT32_MAX, histogram.percentile(1000)); // Clamped to 100
+}
+
+TEST(LatencyHistogram, KnownPercentilesOfAnEvenSpread) {
+    // One duration for each of 256..511 us: four buckets of 64 durations each
+    LatencyHistogram histogram;
+    for (uint32_t duration = 256; duration < 512; duration++) {
+        histogram.record(duration);
+    }
+    CHECK_EQUAL(256, histogram.count());
+    CHECK_EQUAL(383, histogram.mean());
+    CHECK_EQUAL(511, histogram.max());
+
+    // p50 is rank 128, the last of the 320..383 bucket, interpolated to its end
+    CHECK_EQUAL(384, histogram.percentile(50));
+    // p99 is rank 253, the 61st of 64 in 448..511, interpolated up to the longest duration
+    CHECK_EQUAL(448 + (511 - 448) * 61 / 64, histogram.percentile(99));
+    CHECK_EQUAL(508, histogram.percentile(99));
+    // Anything below rank 1 is rank 1
+    CHECK_EQUAL(257, histogram.percentile(0));
+    CHECK_EQUAL(257, histogram.percentile(-5));
+}
+
+TEST(LatencyHistogram, PercentilesStayWithinABucketOfTheTruth) {
+    // 1 ms to 100 ms in 1 ms steps: p50 is 50 ms and p99 is 99 ms
+    LatencyHistogram histogram;
+    for (uint32_t ms = 100; ms >= 1; ms--) {
+        histogram.record(ms * 1000);
+    }
+    uint32_t p50 = histogram.percentile(50);
+    uint32_t p99 = histogram.percentile(99);
+    CHECK(p50 >= 50000 - 50000 / LATENCY_SUB_BUCKETS);
+    CHECK(p50 <= 50000 + 50000 / LATENCY_SUB_BUCKETS);
+    CHECK(p99 >= 99000 - 99000 / LATENCY_SUB_BUCKETS);
+    CHECK(p99 <= 100000);
+    CHECK_EQUAL(50500, histogram.mean());
+
+    // A few slow outliers move p99 but not p50
+    for (int i = 0; i < 3; i++) {
+        histogram.record(5000000);
+    }
+    CHECK(histogram.percentile(50) <= 50000 + 50000 / LATENCY_SUB_BUCKETS);
+    CHECK(histogram.percentile(99) >= 4000000);
+    CHECK_EQUAL(5000000, histogram.max());
+
+    histogram.reset();
+    CHECK_EQUAL(0, histogram.count());
+    CHECK_EQUAL(0, histogram.percentile(99));
+}
@@ -0,0 +1,171 @@
+/**
+ * @file OverflowTest.cpp
+ * @brief Checks of the overflow policies, decimation and their drop counters
+ */
+
+#include <PostQueue.h>
+
+#include <string>
+#include <thread>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+// Starts a single-connection queue whose worker is parked on a held first request
+static bool beginHeld(PostQueue& queue, TestServer& server) {
+    server.reset();
+    server.hold();
+    queue.setConnectionPool(1);
+    if (!queue.begin()) {
+        return false;
+    }
+    return queue.post(server.url().c_str(), "{\"i\":0}", false) && server.waitForRequests(1);
+}
+
+static bool postNumbered(PostQueue& queue, TestServer& server, int i) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"i\":%d}", i);
+    return queue.post(server.url().c_str(), body, false);
+}
+
+// Releases the server and checks that exactly the numbered bodies arrive, in order
+static void checkDelivered(TestServer& server, std::initializer_list<int> expected) {
+    server.release();
+    REQUIRE(server.waitForRequests(expected.size()));
+    delay(20); // Let anything unexpected arrive too
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == expected.size());
+    size_t index = 0;
+    for (int i : expected) {
+        CHECK(bodies[index++] == "{\"i\":" + std::to_string(i) + "}");
+    }
+}
+
+TEST_BACKENDS(Overflow, RejectCountsRefusedPosts) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginHeld(queue, server));
+
+    for (int i = 1; i <= 6; i++) {
+        CHECK_EQUAL(i <= 4, postNumbered(queue, server, i));
+    }
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(2, overflow.rejected);
+    CHECK_EQUAL(0, overflow.evicted);
+    CHECK_EQUAL(0, overflow.decimated);
+    CHECK_EQUAL(0, overflow.blocked);
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(POST_PRIORITY_NORMAL, lane));
+    CHECK_EQUAL(4, lane.queued);
+    CHECK_EQUAL(5, lane.enqueued);
+    CHECK_EQUAL(2, lane.rejected);
+
+    checkDelivered(server, { 0, 1, 2, 3, 4 });
+    queue.end();
+}
+
+TEST_BACKENDS(Overflow, DropOldestKeepsNewest) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(4, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setOverflowPolicy(OVERFLOW_DROP_OLDEST);
+    REQUIRE(beginHeld(queue, server));
+
+    for (int i = 1; i <= 9; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(5, overflow.evicted);
+    CHECK_EQUAL(0, overflow.rejected);
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(POST_PRIORITY_NORMAL, lane));
+    CHECK_EQUAL(4, lane.queued);
+    CHECK_EQUAL(5, lane.evicted);
+
+    checkDelivered(server, { 0, 6, 7, 8, 9 });
+    queue.end();
+}
+
+TEST_BACKENDS(Overflow, BlockTimesOut) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(2, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setOverflowPolicy(OVERFLOW_BLOCK, 50);
+    REQUIRE(beginHeld(queue, server));
+    CHECK(postNumbered(queue, server, 1));
+    CHECK(postNumbered(queue, server, 2));
+
+    uint32_t start = millis();
+    CHECK(!postNumbered(queue, server, 3));
+    CHECK(millis() - start >= 45);
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(1, overflow.blocked);
+    CHECK_EQUAL(1, overflow.rejected);
+
+    checkDelivered(server, { 0, 1, 2 });
+    queue.end();
+}
+
+TEST_BACKENDS(Overflow, BlockWaitsForRoom) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(2, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setOverflowPolicy(OVERFLOW_BLOCK, OVERFLOW_WAIT_FOREVER);
+    REQUIRE(beginHeld(queue, server));
+    CHECK(postNumbered(queue, server, 1));
+    CHECK(postNumbered(queue, server, 2));
+
+    std::thread releaser([&server]() {
+        delay(30);
+        server.release();
+    });
+    CHECK(postNumbered(queue, server, 3));
+    releaser.join();
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(1, overflow.blocked);
+    CHECK_EQUAL(0, overflow.rejected);
+
+    checkDelivered(server, { 0, 1, 2, 3 });
+    queue.end();
+}
+
+TEST_BACKENDS(Overflow, DecimationKeepsEveryNth) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(10, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setDecimation(50, 3);
+    REQUIRE(beginHeld(queue, server));
+
+    // Below half full every post is kept; from then on the first and every third
+    for (int i = 1; i <= 14; i++) {
+        bool kept = i <= 6 || i == 9 || i == 12;
+        CHECK_EQUAL(kept, postNumbered(queue, server, i));
+    }
+
+    OverflowStats overflow;
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(6, overflow.decimated);
+    CHECK_EQUAL(0, overflow.rejected);
+
+    LaneStats lane;
+    REQUIRE(queue.getLaneStats(POST_PRIORITY_NORMAL, lane));
+    CHECK_EQUAL(8, lane.queued);
+    CHECK_EQUAL(6, lane.decimated);
+
+    checkDelivered(server, { 0, 1, 2, 3, 4, 5, 6, 9, 12 });
+
+    // Once drained below the threshold the count restarts and every post is kept
+    for (int i = 15; i <= 17; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(server.waitForRequests(12));
+    queue.getOverflowStats(overflow);
+    CHECK_EQUAL(6, overflow.decimated);
+    queue.end();
+}
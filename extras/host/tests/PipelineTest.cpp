@@ -0,0 +1,157 @@
+/**
+ * @file PipelineTest.cpp
+ * @brief End-to-end checks of HTTP/1.1 pipelining, including a server that closes partway through
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static std::atomic<uint32_t> completions(0);
+static std::atomic<uint32_t> successes(0);
+
+static void recordOutcome(bool success, int httpCode, const String& response) {
+    (void)httpCode;
+    (void)response;
+    if (success) {
+        successes++;
+    }
+    completions++;
+}
+
+static bool waitForCompletions(uint32_t count, uint32_t timeout = 5000) {
+    uint32_t start = millis();
+    while (completions < count) {
+        if (millis() - start > timeout) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+static bool postNumbered(PostQueue& queue, TestServer& server, int i) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"i\":%d}", i);
+    return queue.post(server.url().c_str(), body, false);
+}
+
+// Starts a queue pipelining four deep on one connection, with the first request held
+// and items 2 to count written behind it
+static bool beginPipelined(PostQueue& queue, TestServer& server, int count) {
+    completions = 0;
+    successes = 0;
+    server.reset();
+    server.hold();
+    queue.setPipelining(4);
+    queue.setConnectionPool(1);
+    queue.setCallback(recordOutcome);
+    if (!queue.begin() || !postNumbered(queue, server, 1) || !server.waitForRequests(1)) {
+        return false;
+    }
+    for (int i = 2; i <= count; i++) {
+        if (!postNumbered(queue, server, i)) {
+            return false;
+        }
+    }
+    delay(50); // Let the worker write what fits behind the held request
+    return true;
+}
+
+// Number of times the body of item i reached the server
+static size_t arrivals(TestServer& server, int i) {
+    std::string body = "{\"i\":" + std::to_string(i) + "}";
+    size_t count = 0;
+    for (const std::string& received : server.bodies()) {
+        count += received == body;
+    }
+    return count;
+}
+
+TEST_BACKENDS(Pipeline, RequestsShareOneConnection) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginPipelined(queue, server, 8));
+
+    // Three went out behind the held one; the rest wait for room in the pipeline
+    uint32_t pipelined, resent;
+    queue.getPipelineStats(pipelined, resent);
+    CHECK_EQUAL(3, pipelined);
+
+    server.release();
+    REQUIRE(waitForCompletions(8));
+    CHECK_EQUAL(8, successes.load());
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(bodies[i] == "{\"i\":" + std::to_string(i + 1) + "}");
+    }
+
+    queue.getPipelineStats(pipelined, resent);
+    CHECK(pipelined >= 3);
+    CHECK_EQUAL(0, resent);
+    uint32_t hits, misses;
+    queue.getConnectionStats(hits, misses);
+    CHECK_EQUAL(1, misses);
+    queue.end();
+}
+
+// The server answers the held request and answered - 1 more, then closes
+static void checkCloseAfter(QueueBackend backend, size_t answered) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginPipelined(queue, server, 5));
+    server.closeAfter(answered);
+    server.release();
+
+    // The unanswered pipelined requests are sent again, not failed, and only once
+    REQUIRE(waitForCompletions(5));
+    delay(20);
+    CHECK_EQUAL(5, completions.load());
+    CHECK_EQUAL(5, successes.load());
+    for (int i = 1; i <= 5; i++) {
+        CHECK_EQUAL(1, arrivals(server, i));
+    }
+
+    // Item 5 may also have been written behind the others once the first was answered
+    uint32_t pipelined, resent;
+    queue.getPipelineStats(pipelined, resent);
+    CHECK(pipelined >= 3);
+    CHECK(resent >= 4 - answered);
+    CHECK(resent <= 5 - answered);
+    queue.end();
+}
+
+TEST_BACKENDS(Pipeline, ClosingAfterOneAnswerResendsTheRest) {
+    checkCloseAfter(backend, 1);
+}
+
+TEST_BACKENDS(Pipeline, ClosingAfterThreeAnswersResendsTheLast) {
+    checkCloseAfter(backend, 3);
+}
+
+TEST_BACKENDS(Pipeline, UnansweredHeadIsAFailedAttempt) {
+    TestServer& server = TestServer::shared();
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    REQUIRE(beginPipelined(queue, server, 4));
+    server.closeAfter(0);
+    server.release();
+
+    // The head reached the server, so it counts as an attempt; those behind it did not
+    REQUIRE(waitForCompletions(4));
+    delay(20);
+    CHECK_EQUAL(4, completions.load());
+    CHECK_EQUAL(3, successes.load());
+    for (int i = 1; i <= 4; i++) {
+        CHECK_EQUAL(1, arrivals(server, i));
+    }
+
+    uint32_t pipelined, resent;
+    queue.getPipelineStats(pipelined, resent);
+    CHECK_EQUAL(3, resent);
+    queue.end();
+}
@@ -0,0 +1,224 @@
+/**
+ * @file PostQueueLogTest.cpp
+ * @brief Checks of the log ring: order, overwriting, the cursor after a wrap, dump() and torn lines
+ *
+ * The ring is process-wide, so each case starts reading where the previous ones stopped.
+ */
+
+#include <PostQueueLog.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostTest.h"
+
+// Collects printed text
+class CapturePrint : public Print {
+public:
+    std::string text;
+
+    size_t write(uint8_t c) override {
+        text += (char)c;
+        return 1;
+    }
+};
+
+// Logs to the ring at INFO and returns a cursor past every line already in it
+static uint32_t startReading() {
+    PostQueueLog::setOutput(LOG_OUTPUT_RING);
+    PostQueueLog::setLevel(POSTQUEUE_LOG_LEVEL_INFO);
+    uint32_t cursor = 0;
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    while (PostQueueLog::readLine(cursor, line, sizeof(line))) {
+    }
+    return cursor;
+}
+
+// Drops the "<millis> " prefix of a ring line
+static std::string withoutTime(const char* line) {
+    const char* space = strchr(line, ' ');
+    return space != NULL ? std::string(space + 1) : std::string();
+}
+
+static std::string numbered(int i) {
+    return "I line " + std::to_string(i);
+}
+
+TEST(PostQueueLog, ReadsLinesInOrder) {
+    uint32_t cursor = startReading();
+    uint32_t start = cursor;
+    uint32_t before = millis();
+    for (int i = 0; i < 5; i++) {
+        POSTQUEUE_LOG_INFO("line %d", i);
+    }
+
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    for (int i = 0; i < 5; i++) {
+        REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+        CHECK(withoutTime(line) == numbered(i));
+        CHECK(strtoul(line, NULL, 10) >= before);
+        CHECK_EQUAL(start + i + 1, cursor);
+    }
+    CHECK(!PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK_EQUAL(start + 5, cursor);
+}
+
+TEST(PostQueueLog, LevelsAndTruncation) {
+    uint32_t cursor = startReading();
+    POSTQUEUE_LOG_ERROR("broken");
+    POSTQUEUE_LOG_WARN("odd");
+    PostQueueLog::setLevel(POSTQUEUE_LOG_LEVEL_WARN);
+    POSTQUEUE_LOG_INFO("quiet");
+    PostQueueLog::write(POSTQUEUE_LOG_LEVEL_WARN, "%s", std::string(200, 'x').c_str());
+
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == "E broken");
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == "W odd");
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == "W " + std::string(POSTQUEUE_LOG_LINE_SIZE - 1, 'x'));
+    CHECK(!PostQueueLog::readLine(cursor, line, sizeof(line)));
+
+    // A short destination gets the start of the line
+    POSTQUEUE_LOG_WARN("abcdefghij");
+    char shortLine[8];
+    REQUIRE(PostQueueLog::readLine(cursor, shortLine, sizeof(shortLine)));
+    CHECK_EQUAL(7, strlen(shortLine));
+}
+
+TEST(PostQueueLog, OverwrittenLinesAreSkipped) {
+    uint32_t cursor = startReading();
+    uint32_t start = cursor;
+    const int extra = 10;
+    for (int i = 0; i < POSTQUEUE_LOG_RING_LINES + extra; i++) {
+        POSTQUEUE_LOG_INFO("line %d", i);
+    }
+
+    // The first lines were overwritten, so reading starts at the oldest that is left
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == numbered(extra));
+    CHECK_EQUAL(start + extra + 1, cursor);
+
+    int read = 1;
+    while (PostQueueLog::readLine(cursor, line, sizeof(line))) {
+        CHECK(withoutTime(line) == numbered(extra + read));
+        read++;
+    }
+    CHECK_EQUAL(POSTQUEUE_LOG_RING_LINES, read);
+}
+
+TEST(PostQueueLog, CursorJumpsAfterTheRingWraps) {
+    uint32_t cursor = startReading();
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    for (int i = 0; i < 5; i++) {
+        POSTQUEUE_LOG_INFO("line %d", i);
+    }
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    }
+    uint32_t before = cursor;
+
+    // While the reader is away, the ring wraps past the two lines it had not read
+    for (int i = 5; i < 5 + POSTQUEUE_LOG_RING_LINES + 4; i++) {
+        POSTQUEUE_LOG_INFO("line %d", i);
+    }
+
+    // Lines 3 to 8 are gone; a jump of more than one tells the reader it lost lines
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == numbered(9));
+    CHECK_EQUAL(before + 7, cursor);
+    REQUIRE(PostQueueLog::readLine(cursor, line, sizeof(line)));
+    CHECK(withoutTime(line) == numbered(10));
+    CHECK_EQUAL(before + 8, cursor);
+}
+
+TEST(PostQueueLog, DumpPrintsTheRingOldestFirst) {
+    startReading();
+    for (int i = 0; i < POSTQUEUE_LOG_RING_LINES + 7; i++) {
+        POSTQUEUE_LOG_INFO("line %d", i);
+    }
+
+    CapturePrint out;
+    CHECK_EQUAL(POSTQUEUE_LOG_RING_LINES, PostQueueLog::dump(out));
+    std::vector<std::string> lines;
+    size_t start = 0;
+    size_t end;
+    while ((end = out.text.find("\r\n", start)) != std::string::npos) {
+        lines.push_back(withoutTime(out.text.substr(start, end - start).c_str()));
+        start = end + 2;
+    }
+    REQUIRE(lines.size() == POSTQUEUE_LOG_RING_LINES);
+    for (int i = 0; i < POSTQUEUE_LOG_RING_LINES; i++) {
+        CHECK(lines[i] == numbered(i + 7));
+    }
+
+    // dump() reads from the oldest line each time and leaves the ring as it was
+    CapturePrint again;
+    CHECK_EQUAL(POSTQUEUE_LOG_RING_LINES, PostQueueLog::dump(again));
+    CHECK(again.text == out.text);
+}
+
+TEST(PostQueueLog, TornLinesAreNeverReturned) {
+    static const int WRITERS = 4;
+
+    // Each line repeats one letter picked by its number, so a copy that mixes
+    // two lines shows up as a change of letter partway through. Tears need a
+    // writer running alongside the copy, so they come up on multi-core hosts.
+    uint32_t cursor = startReading();
+    std::atomic<bool> writing(true);
+    std::vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; w++) {
+        writers.emplace_back([&writing, w]() {
+            char text[POSTQUEUE_LOG_LINE_SIZE];
+            for (int n = w; writing; n += WRITERS) {
+                memset(text, 'a' + n % 26, sizeof(text) - 1);
+                text[sizeof(text) - 1] = '\0';
+                POSTQUEUE_LOG_INFO("%d %s", n, text);
+            }
+        });
+    }
+
+    uint32_t torn = 0;
+    uint32_t read = 0;
+    uint32_t jumps = 0;
+    uint32_t backwards = 0;
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    uint32_t start = millis();
+    while (millis() - start < 500) {
+        uint32_t before = cursor;
+        if (!PostQueueLog::readLine(cursor, line, sizeof(line))) {
+            backwards += cursor < before;
+            continue;
+        }
+        read++;
+        backwards += cursor <= before;
+        jumps += cursor - before > 1;
+
+        // "<millis> I <n> <letters>"
+        std::string text = withoutTime(line);
+        size_t space = text.find(' ', 2);
+        if (text.compare(0, 2, "I ") != 0 || space == std::string::npos) {
+            torn++;
+            continue;
+        }
+        int n = atoi(text.c_str() + 2);
+        std::string letters = text.substr(space + 1);
+        if (letters.empty() || letters.find_first_not_of((char)('a' + n % 26)) != std::string::npos) {
+            torn++;
+        }
+    }
+    writing = false;
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+
+    CHECK(read > 0);
+    CHECK_EQUAL(0, torn);
+    CHECK_EQUAL(0, backwards);
+    CHECK(jumps > 0); // The writers outran the reader at least once
+    PostQueueLog::setOutput(LOG_OUTPUT_SERIAL);
+}
@@ -0,0 +1,107 @@
+/**
+ * @file PostQueueTest.cpp
+ * @brief End-to-end checks of queueing and delivery against the loopback server
+ */
+
+#include <PostQueue.h>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+// Waits until the queue has finished count requests in total
+static bool waitForProcessed(PostQueue& queue, uint32_t count, uint32_t timeout = 5000) {
+    uint32_t start = millis();
+    uint32_t processed, successful, failed;
+    do {
+        queue.getStats(processed, successful, failed);
+        if (processed >= count) {
+            return true;
+        }
+        delay(1);
+    } while (millis() - start < timeout);
+    return false;
+}
+
+TEST_BACKENDS(PostQueue, DeliversInOrder) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    PostQueue queue(64, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setConnectionPool(1);
+    REQUIRE(queue.begin());
+
+    char body[32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(body, sizeof(body), "{\"i\":%d}", i);
+        CHECK(queue.post(server.url().c_str(), body, false));
+    }
+    REQUIRE(waitForProcessed(queue, 50));
+
+    uint32_t processed, successful, failed;
+    queue.getStats(processed, successful, failed);
+    CHECK_EQUAL(50, successful);
+    CHECK_EQUAL(0, failed);
+
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 50);
+    for (int i = 0; i < 50; i++) {
+        snprintf(body, sizeof(body), "{\"i\":%d}", i);
+        CHECK(bodies[i] == body);
+    }
+    queue.end();
+}
+
+TEST(PostQueue, RejectsBeforeBegin) {
+    PostQueue queue(4);
+    CHECK(!queue.post("http://127.0.0.1:1/", "{}", false));
+    CHECK(queue.isEmpty());
+}
+
+TEST_BACKENDS(PostQueue, RejectsWhenFull) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+    PostQueue queue(4, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setConnectionPool(1);
+    REQUIRE(queue.begin());
+
+    // The worker takes the first item and waits for the held answer
+    CHECK(queue.post(server.url().c_str(), "{\"i\":0}", false));
+    REQUIRE(server.waitForRequests(1));
+    for (int i = 1; i <= 4; i++) {
+        CHECK(queue.post(server.url().c_str(), "{}", false));
+    }
+    CHECK(queue.isFull());
+    CHECK(!queue.post(server.url().c_str(), "{}", false));
+
+    server.release();
+    CHECK(waitForProcessed(queue, 5));
+    CHECK_EQUAL(5, server.bodies().size());
+    queue.end();
+}
+
+TEST(PostQueue, QueueWaitIsMeasuredInMicroseconds) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+    PostQueue queue(8);
+    queue.setConnectionPool(1);
+    REQUIRE(queue.begin());
+
+    // The first item is taken at once; the second waits behind the held answer
+    CHECK(queue.post(server.url().c_str(), "{\"i\":0}", false));
+    REQUIRE(server.waitForRequests(1));
+    CHECK(queue.post(server.url().c_str(), "{\"i\":1}", false));
+    delay(40);
+    server.release();
+    REQUIRE(waitForProcessed(queue, 2));
+
+    // Whole milliseconds scaled up would make the longest wait a multiple of 1000 us
+    // and the mean of the two a multiple of 500 us
+    StatsSnapshot stats;
+    queue.getStatsSnapshot(stats);
+    CHECK_EQUAL(2, stats.queueWait.count());
+    CHECK(stats.queueWait.max() >= 40000);
+    CHECK(stats.queueWait.max() < 1000000);
+    CHECK(stats.queueWait.max() % 1000 != 0 || stats.queueWait.mean() % 500 != 0);
+    queue.end();
+}
@@ -0,0 +1,203 @@
+/**
+ * @file PostRingTest.cpp
+ * @brief Checks of the lock-free MPMC ring: capacity, order, wrap-around and concurrent use
+ */
+
+#include <PostRing.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "HostTest.h"
+
+// Items are small integers carried in the pointer; 0 would read as NULL, so values start at 1
+static void* token(uintptr_t value) {
+    return reinterpret_cast<void*>(value);
+}
+
+static uintptr_t valueOf(void* item) {
+    return reinterpret_cast<uintptr_t>(item);
+}
+
+TEST(PostRing, CapacityNeedNotBeAPowerOfTwo) {
+    PostRing ring;
+    REQUIRE(ring.begin(5));
+    CHECK_EQUAL(5, ring.capacity());
+
+    // Eight cells back the ring, but only five items fit
+    for (uintptr_t i = 1; i <= 5; i++) {
+        CHECK(ring.push(token(i)));
+    }
+    CHECK(!ring.push(token(6)));
+    BaseType_t woken = pdFALSE;
+    CHECK(!ring.pushFromISR(token(6), &woken));
+    CHECK_EQUAL(5, ring.size());
+
+    void* item;
+    CHECK(ring.pop(item));
+    CHECK_EQUAL(1, valueOf(item));
+    CHECK(ring.push(token(6)));
+    CHECK(!ring.push(token(7)));
+    CHECK_EQUAL(5, ring.size());
+}
+
+TEST(PostRing, FullAndEmpty) {
+    PostRing ring;
+    CHECK(!ring.isOpen());
+    CHECK(!ring.begin(0));
+    REQUIRE(ring.begin(4));
+    CHECK(ring.isOpen());
+
+    void* item = NULL;
+    CHECK(!ring.pop(item));
+    CHECK_EQUAL(0, ring.size());
+
+    uint32_t start = millis();
+    CHECK(!ring.pop(item, 20));
+    CHECK(millis() - start >= 15);
+
+    for (uintptr_t i = 1; i <= 4; i++) {
+        CHECK(ring.push(token(i)));
+    }
+    CHECK(!ring.push(token(5)));
+    CHECK_EQUAL(4, ring.size());
+
+    for (uintptr_t i = 1; i <= 4; i++) {
+        CHECK(ring.pop(item));
+        CHECK_EQUAL(i, valueOf(item));
+    }
+    CHECK(!ring.pop(item));
+    CHECK_EQUAL(0, ring.size());
+}
+
+TEST(PostRing, WrapsAroundInOrder) {
+    PostRing ring;
+    REQUIRE(ring.begin(3));
+
+    // Positions run through the cells many times over, with the ring at every fill level
+    uintptr_t pushed = 0;
+    uintptr_t popped = 0;
+    for (int round = 0; round < 1000; round++) {
+        size_t batch = 1 + round % 3;
+        for (size_t i = 0; i < batch; i++) {
+            CHECK(ring.push(token(++pushed)));
+        }
+        CHECK_EQUAL(batch, ring.size());
+        void* item;
+        while (ring.pop(item)) {
+            CHECK_EQUAL(++popped, valueOf(item));
+        }
+    }
+    CHECK_EQUAL(pushed, popped);
+}
+
+TEST(PostRing, PopWakesOnPush) {
+    PostRing ring;
+    REQUIRE(ring.begin(2));
+
+    std::thread producer([&ring]() {
+        delay(20);
+        ring.push(token(1));
+    });
+    void* item = NULL;
+    CHECK(ring.pop(item, 2000));
+    CHECK_EQUAL(1, valueOf(item));
+    producer.join();
+}
+
+TEST(PostRing, ConcurrentProducersAndConsumers) {
+    static const int PRODUCERS = 4;
+    static const int CONSUMERS = 4;
+    static const uintptr_t PER_PRODUCER = 50000;
+
+    PostRing ring;
+    REQUIRE(ring.begin(13, CONSUMERS));
+    std::vector<std::atomic<uint8_t>> seen(PRODUCERS * PER_PRODUCER);
+    std::atomic<int> producing(PRODUCERS);
+    std::atomic<uint32_t> outOfOrder(0);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < PRODUCERS; p++) {
+        threads.emplace_back([&ring, &producing, p]() {
+            for (uintptr_t i = 0; i < PER_PRODUCER; i++) {
+                while (!ring.push(token(p * PER_PRODUCER + i + 1))) {
+                    std::this_thread::yield();
+                }
+            }
+            producing--;
+        });
+    }
+    for (int c = 0; c < CONSUMERS; c++) {
+        threads.emplace_back([&ring, &producing, &seen, &outOfOrder]() {
+            // Each producer's items must reach any one consumer in the order they were pushed
+            uintptr_t last[PRODUCERS] = {};
+            void* item;
+            while (true) {
+                if (ring.pop(item, 1)) {
+                    uintptr_t value = valueOf(item) - 1;
+                    seen[value]++;
+                    uintptr_t producer = value / PER_PRODUCER;
+                    if (value + 1 <= last[producer]) {
+                        outOfOrder++;
+                    }
+                    last[producer] = value + 1;
+                } else if (producing == 0 && ring.size() == 0) {
+                    return;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    uint32_t lost = 0;
+    uint32_t duplicated = 0;
+    for (std::atomic<uint8_t>& count : seen) {
+        lost += count == 0;
+        duplicated += count > 1;
+    }
+    CHECK_EQUAL(0, lost);
+    CHECK_EQUAL(0, duplicated);
+    CHECK_EQUAL(0, outOfOrder.load());
+    CHECK_EQUAL(0, ring.size());
+}
+
+TEST(PostRing, PushWithRoomNeverFails) {
+    static const int THREADS = 8;
+    static const int ROUNDS = 50000;
+
+    // Like the arena free list: every item belongs in the ring, so a push always
+    // has room, even when it lands on a cell a preempted consumer has not released
+    PostRing ring;
+    REQUIRE(ring.begin(4));
+    for (uintptr_t i = 1; i <= 4; i++) {
+        REQUIRE(ring.push(token(i)));
+    }
+
+    std::atomic<uint32_t> failedPushes(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&ring, &failedPushes]() {
+            void* item;
+            for (int i = 0; i < ROUNDS; i++) {
+                if (ring.pop(item) && !ring.push(item)) {
+                    failedPushes++;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    CHECK_EQUAL(0, failedPushes.load());
+    CHECK_EQUAL(4, ring.size());
+    uintptr_t sum = 0;
+    void* item;
+    while (ring.pop(item)) {
+        sum += valueOf(item);
+    }
+    CHECK_EQUAL(1 + 2 + 3 + 4, sum);
+}
@@ -0,0 +1,173 @@
+/**
+ * @file RecordTest.cpp
+ * @brief Checks of postFromISR(): formatting on the workers, drops and the shared wake marker
+ */
+
+#include <PostQueue.h>
+
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+// Formats a one-byte record as {"v":n}; 0 is dropped and 255 overflows the buffer
+static size_t formatValue(const uint8_t* data, size_t length, char* json, size_t size) {
+    if (length != 1 || data[0] == 0) {
+        return 0;
+    }
+    if (data[0] == 255) {
+        return size;
+    }
+    return snprintf(json, size, "{\"v\":%u}", (unsigned)data[0]);
+}
+
+static bool postRecord(PostQueue& queue, uint8_t channel, uint8_t value) {
+    return queue.postFromISR(channel, &value, 1);
+}
+
+static std::string valueBody(int value) {
+    return "{\"v\":" + std::to_string(value) + "}";
+}
+
+// Waits until records have been formatted into requests or dropped
+static void waitForRecords(PostQueue& queue, uint32_t count, uint32_t& posted, uint32_t& dropped) {
+    uint32_t start = millis();
+    do {
+        queue.getRecordStats(posted, dropped);
+        if (posted + dropped >= count) {
+            return;
+        }
+        delay(1);
+    } while (millis() - start < 5000);
+}
+
+TEST_BACKENDS(Record, FormatterOutputIsDelivered) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    std::string url = server.url("/records");
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    uint8_t channel = queue.addRecordChannel(url.c_str(), formatValue, false, "X-Source: isr");
+    REQUIRE(channel == 1);
+    REQUIRE(queue.begin());
+
+    CHECK(postRecord(queue, channel, 1));
+    CHECK(postRecord(queue, channel, 2));
+    CHECK(postRecord(queue, channel, 3));
+    REQUIRE(server.waitForRequests(3));
+
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests.size() == 3);
+    for (int i = 0; i < 3; i++) {
+        CHECK(requests[i].path == "/records");
+        CHECK(requests[i].body == valueBody(i + 1));
+        CHECK(requests[i].head.find("\r\nX-Source: isr\r\n") != std::string::npos);
+    }
+
+    uint32_t posted, dropped;
+    queue.getRecordStats(posted, dropped);
+    CHECK_EQUAL(3, posted);
+    CHECK_EQUAL(0, dropped);
+
+    // Records with bad arguments are refused and counted as dropped
+    uint8_t value = 1;
+    CHECK(!queue.postFromISR(0, &value, 1));
+    CHECK(!queue.postFromISR(channel + 1, &value, 1));
+    CHECK(!queue.postFromISR(channel, &value, POST_RECORD_SIZE + 1));
+    queue.getRecordStats(posted, dropped);
+    CHECK_EQUAL(3, dropped);
+
+    // Records the formatter rejects or overflows are counted as dropped
+    CHECK(postRecord(queue, channel, 0));
+    CHECK(postRecord(queue, channel, 255));
+    CHECK(postRecord(queue, channel, 4));
+    REQUIRE(server.waitForRequests(4));
+    waitForRecords(queue, 9, posted, dropped);
+    CHECK_EQUAL(4, posted);
+    CHECK_EQUAL(5, dropped);
+    CHECK(server.bodies()[3] == valueBody(4));
+    queue.end();
+}
+
+TEST_BACKENDS(Record, FullRecordQueueCountsDrops) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+    std::string url = server.url("/records");
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setConnectionPool(1);
+    queue.setRecordQueueSize(2);
+    uint8_t channel = queue.addRecordChannel(url.c_str(), formatValue, false);
+    REQUIRE(queue.begin());
+
+    // With the only worker parked on a held request, nothing drains the record queue
+    REQUIRE(queue.post(server.url().c_str(), "{}", false));
+    REQUIRE(server.waitForRequests(1));
+    CHECK(postRecord(queue, channel, 1));
+    CHECK(postRecord(queue, channel, 2));
+    CHECK(!postRecord(queue, channel, 3));
+
+    uint32_t posted, dropped;
+    queue.getRecordStats(posted, dropped);
+    CHECK_EQUAL(0, posted);
+    CHECK_EQUAL(1, dropped);
+
+    server.release();
+    REQUIRE(server.waitForRequests(3));
+    delay(20);
+    std::vector<std::string> bodies = server.bodies();
+    REQUIRE(bodies.size() == 3);
+    CHECK(bodies[1] == valueBody(1));
+    CHECK(bodies[2] == valueBody(2));
+    queue.getRecordStats(posted, dropped);
+    CHECK_EQUAL(2, posted);
+    CHECK_EQUAL(1, dropped);
+    queue.end();
+}
+
+TEST_BACKENDS(Record, OneMarkerServicesManyRecords) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+    std::string url = server.url("/records");
+    PostQueue queue(8, DEFAULT_TASK_STACK_SIZE, DEFAULT_TASK_PRIORITY, DEFAULT_WORKER_COUNT, tskNO_AFFINITY, backend);
+    queue.setConnectionPool(1);
+    uint8_t channel = queue.addRecordChannel(url.c_str(), formatValue, false);
+    REQUIRE(queue.begin());
+
+    REQUIRE(queue.post(server.url().c_str(), "{}", false));
+    REQUIRE(server.waitForRequests(1));
+
+    // Eight records share one marker in the item queue, so a full lane's worth of
+    // ordinary posts still fits behind it
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postRecord(queue, channel, (uint8_t)i));
+    }
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.post(server.url().c_str(), "{}", false));
+    }
+    CHECK(queue.isFull());
+
+    server.release();
+    REQUIRE(server.waitForRequests(17));
+    delay(20);
+    std::vector<TestRequest> requests = server.requests();
+    CHECK_EQUAL(17, requests.size());
+
+    // Records were formatted in order, a lane's worth at a time as room appeared
+    std::vector<std::string> records;
+    for (const TestRequest& request : requests) {
+        if (request.path == "/records") {
+            records.push_back(request.body);
+        }
+    }
+    REQUIRE(records.size() == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(records[i] == valueBody(i + 1));
+    }
+
+    uint32_t posted, dropped;
+    queue.getRecordStats(posted, dropped);
+    CHECK_EQUAL(8, posted);
+    CHECK_EQUAL(0, dropped);
+    queue.end();
+}
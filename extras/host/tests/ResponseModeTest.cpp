@@ -0,0 +1,235 @@
+/**
+ * @file ResponseModeTest.cpp
+ * @brief Checks of each response mode: capture with and without a limit, discard,
+ *        status-only and streaming to the chunk callback
+ *
+ * Each case runs on the three paths that read responses: HTTPClient, the
+ * in-flight loop, and the raw one-at-a-time path compressed requests take.
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+enum ResponsePath {
+    PATH_HTTP_CLIENT,           ///< performPost() and readResponseBody()
+    PATH_IN_FLIGHT,             ///< inFlightWorkerLoop() and pollResponse()
+    PATH_COMPRESSED             ///< performRawPost() and readResponse()
+};
+
+static std::atomic<uint32_t> completions(0);
+static std::atomic<int> lastCode(0);
+static std::string lastResponse;
+
+static std::mutex streamMutex;
+static std::string streamed;
+static uint32_t chunks = 0;
+static int chunkCode = 0;
+
+static void recordOutcome(bool success, int httpCode, const String& response) {
+    (void)success;
+    lastResponse = std::string(response.c_str(), response.length());
+    lastCode = httpCode;
+    completions++;
+}
+
+static void recordChunk(int httpCode, const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(streamMutex);
+    streamed.append((const char*)data, length);
+    chunkCode = httpCode;
+    chunks++;
+}
+
+// Starts a single-connection queue in the given mode that sends on the given path
+static bool beginOnPath(PostQueue& queue, ResponsePath path, ResponseMode mode, size_t captureLimit = 0) {
+    completions = 0;
+    lastCode = 0;
+    lastResponse.clear();
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        streamed.clear();
+        chunks = 0;
+        chunkCode = 0;
+    }
+    if (path == PATH_IN_FLIGHT) {
+        queue.setMaxInFlight(2);
+    } else if (path == PATH_COMPRESSED) {
+        queue.setCompression(COMPRESSION_GZIP, 1);
+    }
+    queue.setConnectionPool(1);
+    queue.setCallback(recordOutcome);
+    queue.setResponseChunkCallback(recordChunk);
+    queue.setResponseMode(mode, captureLimit);
+    return queue.begin();
+}
+
+// Posts one item and waits for its callback
+static bool postAndWait(PostQueue& queue, TestServer& server) {
+    uint32_t expected = completions + 1;
+    if (!queue.post(server.url().c_str(), "{\"v\":1}", false)) {
+        return false;
+    }
+    uint32_t start = millis();
+    while (completions < expected) {
+        if (millis() - start > 5000) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+// Checks that every request went out on the expected path
+static void checkPath(TestServer& server, ResponsePath path) {
+    for (const TestRequest& request : server.requests()) {
+        // Only HTTPClient adds a User-Agent, and only compressed requests have a Content-Encoding
+        CHECK_EQUAL(path == PATH_HTTP_CLIENT, request.head.find("User-Agent:") != std::string::npos);
+        CHECK_EQUAL(path == PATH_COMPRESSED, request.head.find("Content-Encoding:") != std::string::npos);
+    }
+}
+
+// Whether the server received both requests on one connection
+static bool sharedConnection(TestServer& server) {
+    std::vector<TestRequest> requests = server.requests();
+    return requests.size() == 2 && requests[0].connection == requests[1].connection;
+}
+
+// A body longer than one read, so it reaches the collector in several pieces
+static std::string longBody() {
+    std::string body;
+    for (int i = 0; body.size() < 5000; i++) {
+        body += std::to_string(i) + ",";
+    }
+    return body;
+}
+
+#define TEST_PATHS(suite, name)                                                    \
+    static void suite##_##name##_body(ResponsePath path);                          \
+    TEST(suite, name) { suite##_##name##_body(PATH_HTTP_CLIENT); }                 \
+    TEST(suite, name##InFlight) { suite##_##name##_body(PATH_IN_FLIGHT); }         \
+    TEST(suite, name##Compressed) { suite##_##name##_body(PATH_COMPRESSED); }      \
+    static void suite##_##name##_body(ResponsePath path)
+
+TEST_PATHS(ResponseMode, CaptureKeepsTheWholeBody) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    std::string body = longBody();
+    server.setResponse(TestResponse(200, body));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_CAPTURE));
+
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(200, lastCode.load());
+    CHECK(lastResponse == body);
+    REQUIRE(postAndWait(queue, server));
+    CHECK(lastResponse == body);
+    CHECK(sharedConnection(server));
+    checkPath(server, path);
+    queue.end();
+}
+
+TEST_PATHS(ResponseMode, CaptureLimitTruncates) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    std::string body = longBody();
+    server.queueResponse(TestResponse(200, body));
+    server.setResponse(TestResponse(200, "abc"));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_CAPTURE, 100));
+
+    // The rest of the body is read and dropped, so the connection carries the next request
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(200, lastCode.load());
+    CHECK(lastResponse == body.substr(0, 100));
+
+    // Shorter bodies are kept whole
+    REQUIRE(postAndWait(queue, server));
+    CHECK(lastResponse == "abc");
+    CHECK(sharedConnection(server));
+    checkPath(server, path);
+    queue.end();
+}
+
+TEST_PATHS(ResponseMode, DiscardKeepsTheConnection) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(201, longBody()));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_DISCARD));
+
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(201, lastCode.load());
+    CHECK(lastResponse.empty());
+    REQUIRE(postAndWait(queue, server));
+    CHECK(lastResponse.empty());
+    CHECK(sharedConnection(server));
+    CHECK_EQUAL(0, chunks);
+    checkPath(server, path);
+    queue.end();
+}
+
+TEST_PATHS(ResponseMode, StatusOnlyClosesAConnectionWithABody) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(202, "accepted"));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_STATUS_ONLY));
+
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(202, lastCode.load());
+    CHECK(lastResponse.empty());
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(202, lastCode.load());
+    CHECK(!sharedConnection(server));
+    checkPath(server, path);
+    queue.end();
+}
+
+TEST_PATHS(ResponseMode, StatusOnlyKeepsAConnectionWithoutABody) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(200, ""));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_STATUS_ONLY));
+
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(200, lastCode.load());
+    REQUIRE(postAndWait(queue, server));
+    CHECK(sharedConnection(server));
+    checkPath(server, path);
+    queue.end();
+}
+
+TEST_PATHS(ResponseMode, StreamHandsOverTheWholeBody) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    std::string body = longBody();
+    server.setResponse(TestResponse(200, body));
+    PostQueue queue(4);
+    REQUIRE(beginOnPath(queue, path, RESPONSE_STREAM));
+
+    REQUIRE(postAndWait(queue, server));
+    CHECK_EQUAL(200, lastCode.load());
+    CHECK(lastResponse.empty());
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        CHECK(streamed == body);
+        CHECK(chunks > 1);
+        CHECK_EQUAL(200, chunkCode);
+        streamed.clear();
+    }
+
+    REQUIRE(postAndWait(queue, server));
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        CHECK(streamed == body);
+    }
+    CHECK(sharedConnection(server));
+    checkPath(server, path);
+    queue.end();
+}
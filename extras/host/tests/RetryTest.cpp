@@ -0,0 +1,288 @@
+/**
+ * @file RetryTest.cpp
+ * @brief Checks of the retry engine against scripted 5xx and 429 answers: backoff,
+ *        jitter, Retry-After, the retry budget, the retry queue and exhaustion
+ */
+
+#include <PostQueue.h>
+
+#include <atomic>
+#include <string>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+static std::atomic<uint32_t> completions(0);
+static std::atomic<uint32_t> successes(0);
+static std::atomic<int> lastCode(0);
+
+static void recordOutcome(bool success, int httpCode, const String& response) {
+    (void)response;
+    lastCode = httpCode;
+    if (success) {
+        successes++;
+    }
+    completions++;
+}
+
+// Starts a single-connection queue that reports outcomes to recordOutcome()
+static bool beginRetrying(PostQueue& queue) {
+    completions = 0;
+    successes = 0;
+    lastCode = 0;
+    queue.setConnectionPool(1);
+    queue.setCallback(recordOutcome);
+    return queue.begin();
+}
+
+static bool waitForCompletions(uint32_t count, uint32_t timeout = 5000) {
+    uint32_t start = millis();
+    while (completions < count) {
+        if (millis() - start > timeout) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+static bool postNumbered(PostQueue& queue, TestServer& server, int i) {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"i\":%d}", i);
+    return queue.post(server.url().c_str(), body, false);
+}
+
+// Milliseconds between consecutive arrivals of the same body
+static std::vector<uint32_t> gapsFor(TestServer& server, int i) {
+    std::string body = "{\"i\":" + std::to_string(i) + "}";
+    std::vector<uint32_t> gaps;
+    uint32_t previous = 0;
+    bool seen = false;
+    for (const TestRequest& request : server.requests()) {
+        if (request.body != body) {
+            continue;
+        }
+        if (seen) {
+            gaps.push_back(request.arrivedAt - previous);
+        }
+        previous = request.arrivedAt;
+        seen = true;
+    }
+    return gaps;
+}
+
+TEST(Retry, BackoffDoublesUpToTheCap) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.queueResponse(TestResponse(503, "busy"), 4);
+    PostQueue queue(4);
+    queue.setRetry(5, 40, 100, 0);
+    REQUIRE(beginRetrying(queue));
+
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    CHECK_EQUAL(1, successes.load());
+    CHECK_EQUAL(200, lastCode.load());
+
+    // 40, 80, then 160 and 320 capped at 100
+    std::vector<uint32_t> gaps = gapsFor(server, 1);
+    REQUIRE(gaps.size() == 4);
+    const uint32_t expected[] = { 40, 80, 100, 100 };
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(gaps[i] >= expected[i] - 1);
+        CHECK(gaps[i] < expected[i] + 40);
+    }
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(4, stats.scheduled);
+    CHECK_EQUAL(0, stats.exhausted);
+    CHECK_EQUAL(0, stats.pending);
+    CHECK_EQUAL(1, stats.succeededAfter[4]);
+    CHECK(stats.attemptsPerSuccess == 5.0f);
+    queue.end();
+}
+
+TEST(Retry, JitterStaysWithinItsShare) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.queueResponse(TestResponse(500, "error"), 8);
+    PostQueue queue(8);
+    queue.setRetry(2, 100, 1000, 50);
+    REQUIRE(beginRetrying(queue));
+
+    for (int i = 1; i <= 8; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(waitForCompletions(8));
+    CHECK_EQUAL(8, successes.load());
+
+    // Each delay is 100 ms less a random 0 to 50 ms
+    uint32_t shortest = UINT32_MAX;
+    for (int i = 1; i <= 8; i++) {
+        std::vector<uint32_t> gaps = gapsFor(server, i);
+        REQUIRE(gaps.size() == 1);
+        CHECK(gaps[0] >= 49);
+        CHECK(gaps[0] < 100 + 40);
+        shortest = gaps[0] < shortest ? gaps[0] : shortest;
+    }
+    CHECK(shortest < 95);
+    queue.end();
+}
+
+static void checkRetryAfter(int status, bool honoured) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.queueResponse(TestResponse(status, "later", "Retry-After: 1\r\n"));
+    PostQueue queue(4);
+    queue.setRetry(3, 20, 100, 0);
+    REQUIRE(beginRetrying(queue));
+
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    CHECK_EQUAL(1, successes.load());
+    std::vector<uint32_t> gaps = gapsFor(server, 1);
+    REQUIRE(gaps.size() == 1);
+    if (honoured) {
+        CHECK(gaps[0] >= 999);
+    } else {
+        CHECK(gaps[0] < 500);
+    }
+    queue.end();
+}
+
+TEST(Retry, RetryAfterOn429SetsTheMinimumDelay) {
+    checkRetryAfter(429, true);
+}
+
+TEST(Retry, RetryAfterOn503SetsTheMinimumDelay) {
+    checkRetryAfter(503, true);
+}
+
+TEST(Retry, RetryAfterIsIgnoredOnOther5xx) {
+    checkRetryAfter(500, false);
+}
+
+TEST(Retry, RetryAfterBeyondTheLimitExhausts) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.queueResponse(TestResponse(503, "later", "Retry-After: " + std::to_string(MAX_RETRY_AFTER / 1000 + 1) + "\r\n"));
+    PostQueue queue(4);
+    queue.setRetry(3, 20, 100, 0);
+    REQUIRE(beginRetrying(queue));
+
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    CHECK_EQUAL(0, successes.load());
+    CHECK_EQUAL(503, lastCode.load());
+    CHECK_EQUAL(1, server.requests().size());
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(0, stats.scheduled);
+    CHECK_EQUAL(1, stats.exhausted);
+    queue.end();
+}
+
+TEST(Retry, AttemptsRunOut) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(502, "bad gateway"));
+    PostQueue queue(4);
+    queue.setRetry(3, 10, 20, 0);
+    REQUIRE(beginRetrying(queue));
+
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    delay(50); // Let any extra attempt arrive
+    CHECK_EQUAL(3, server.requests().size());
+    CHECK_EQUAL(0, successes.load());
+    CHECK_EQUAL(502, lastCode.load());
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(2, stats.scheduled);
+    CHECK_EQUAL(1, stats.exhausted);
+    CHECK_EQUAL(0, stats.pending);
+    CHECK(stats.attemptsPerSuccess == 0.0f);
+    queue.end();
+}
+
+TEST(Retry, ClientErrorsAreNotRetried) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(400, "bad request"));
+    PostQueue queue(4);
+    queue.setRetry(3, 10, 20, 0);
+    REQUIRE(beginRetrying(queue));
+
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    delay(50);
+    CHECK_EQUAL(1, server.requests().size());
+    CHECK_EQUAL(400, lastCode.load());
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(0, stats.scheduled);
+    CHECK_EQUAL(0, stats.exhausted);
+    queue.end();
+}
+
+TEST(Retry, BudgetDeniesRetries) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(503, "busy"));
+    PostQueue queue(4);
+    queue.setRetry(3, 10, 20, 0);
+    // One retry banked; each first attempt earns a tenth of one
+    queue.setRetryBudget(10, 1);
+    REQUIRE(beginRetrying(queue));
+
+    // The first item spends the banked retry and is denied its second
+    REQUIRE(postNumbered(queue, server, 1));
+    REQUIRE(waitForCompletions(1));
+    CHECK_EQUAL(2, server.requests().size());
+
+    // The second has earned only a tenth of a retry and is denied at once
+    REQUIRE(postNumbered(queue, server, 2));
+    REQUIRE(waitForCompletions(2));
+    CHECK_EQUAL(3, server.requests().size());
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(1, stats.scheduled);
+    CHECK_EQUAL(2, stats.budgetDenied);
+    CHECK_EQUAL(0, stats.exhausted);
+    queue.end();
+}
+
+TEST(Retry, FullRetryQueueRefundsTheBudget) {
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.setResponse(TestResponse(503, "busy"));
+    PostQueue queue(4);
+    queue.setRetry(3, 10000, 10000, 0);
+    queue.setRetryQueueSize(1);
+    // Two retries banked and practically nothing earned
+    queue.setRetryBudget(1, 2);
+    REQUIRE(beginRetrying(queue));
+
+    // The first item takes the only retry slot for ten seconds. The others find it
+    // full; without the refund the third would be denied by the spent budget.
+    for (int i = 1; i <= 4; i++) {
+        CHECK(postNumbered(queue, server, i));
+    }
+    REQUIRE(waitForCompletions(3));
+    delay(20);
+
+    RetryStats stats;
+    queue.getRetryStats(stats);
+    CHECK_EQUAL(1, stats.scheduled);
+    CHECK_EQUAL(1, stats.pending);
+    CHECK_EQUAL(3, stats.overflowed);
+    CHECK_EQUAL(0, stats.budgetDenied);
+    CHECK_EQUAL(3, completions.load());
+    CHECK_EQUAL(503, lastCode.load());
+    queue.end();
+}
@@ -0,0 +1,370 @@
+/**
+ * @file SpillLogTest.cpp
+ * @brief Checks of the spill log against a temporary directory-backed filesystem
+ *
+ * Covers appends, peek/read/pop, segment sealing and deletion, cursor
+ * recovery, torn tails and CRC failures on SpillLog directly, then a queue
+ * spilling to it while the server is held.
+ */
+
+#include <PostQueue.h>
+#include <SpillLog.h>
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HostTest.h"
+#include "TestServer.h"
+
+#define TEST_URL "http://127.0.0.1/ingest"
+#define TEST_HEADERS "X-Test: 1"
+
+// Empty host directory for one case, removed with everything in it afterwards
+class TempDirectory {
+public:
+    TempDirectory() {
+        char root[] = "/tmp/postqueue-spill-XXXXXX";
+        if (mkdtemp(root) != NULL) {
+            path = root;
+        }
+    }
+
+    ~TempDirectory() {
+        if (!path.empty()) {
+            nftw(path.c_str(), removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+    std::string path;
+
+private:
+    static int removeEntry(const char* entry, const struct stat*, int, struct FTW*) {
+        return remove(entry);
+    }
+};
+
+// Host path of a segment file, named like SpillLog::segmentPath()
+static std::string segmentFile(const std::string& root, uint32_t segment) {
+    char name[32];
+    snprintf(name, sizeof(name), "/spill/%08x.seg", (unsigned)segment);
+    return root + name;
+}
+
+static bool fileExists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+static bool appendRecord(SpillLog& log, int index) {
+    char payload[32];
+    int length = snprintf(payload, sizeof(payload), "{\"i\":%d}", index);
+    return log.append(TEST_URL, strlen(TEST_URL), payload, (size_t)length, TEST_HEADERS,
+                      strlen(TEST_HEADERS), (uint8_t)index, 1);
+}
+
+// Reads and pops the oldest record; returns its index, -1 if empty or -2 if it failed its CRC
+static int takeRecord(SpillLog& log) {
+    SpillRecordHeader header;
+    if (!log.peek(header)) {
+        return -1;
+    }
+    std::string url(header.urlLength, '\0');
+    std::string payload(header.payloadLength, '\0');
+    std::string headers(header.headersLength, '\0');
+    bool intact = log.read(&url[0], &payload[0], &headers[0]);
+    log.pop();
+    if (!intact) {
+        return -2;
+    }
+    if (url != TEST_URL || headers != TEST_HEADERS || header.headerCount != 1) {
+        return -3;
+    }
+    int index = -4;
+    sscanf(payload.c_str(), "{\"i\":%d}", &index);
+    return header.flags == (uint8_t)index ? index : -5;
+}
+
+TEST(SpillLog, AppendPeekReadPop) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK(log.isEmpty());
+
+    for (int i = 0; i < 3; i++) {
+        CHECK(appendRecord(log, i));
+    }
+    CHECK(!log.isEmpty());
+    CHECK(log.pendingBytes() > 0);
+
+    // peek() does not consume
+    SpillRecordHeader first, again;
+    REQUIRE(log.peek(first));
+    REQUIRE(log.peek(again));
+    CHECK_EQUAL(first.payloadLength, again.payloadLength);
+
+    for (int i = 0; i < 3; i++) {
+        CHECK_EQUAL(i, takeRecord(log));
+    }
+    CHECK_EQUAL(-1, takeRecord(log));
+    CHECK(log.isEmpty());
+    CHECK_EQUAL(0, log.corruptedRecords());
+    log.end();
+}
+
+TEST(SpillLog, RejectsAppendsPastBudget) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    SpillLog log;
+    size_t recordBytes = sizeof(SpillRecordHeader) + strlen(TEST_URL) + strlen("{\"i\":0}") + strlen(TEST_HEADERS);
+    REQUIRE(log.begin(fs, "/spill", recordBytes * 2));
+
+    CHECK(appendRecord(log, 0));
+    CHECK(appendRecord(log, 1));
+    CHECK(!appendRecord(log, 2));
+    CHECK_EQUAL(recordBytes * 2, log.pendingBytes());
+    log.end();
+}
+
+TEST(SpillLog, DeletesDrainedSegments) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    SpillLog log;
+    // Room for two records per segment
+    size_t recordBytes = sizeof(SpillRecordHeader) + strlen(TEST_URL) + strlen("{\"i\":0}") + strlen(TEST_HEADERS);
+    REQUIRE(log.begin(fs, "/spill", 65536, recordBytes * 2));
+
+    for (int i = 0; i < 6; i++) {
+        CHECK(appendRecord(log, i));
+    }
+    CHECK(fileExists(segmentFile(root, 1)));
+    CHECK(fileExists(segmentFile(root, 2)));
+    CHECK(fileExists(segmentFile(root, 3)));
+
+    CHECK_EQUAL(0, takeRecord(log));
+    CHECK_EQUAL(1, takeRecord(log));
+    CHECK(fileExists(segmentFile(root, 1)));
+
+    // Moving past the end of a sealed segment deletes it
+    CHECK_EQUAL(2, takeRecord(log));
+    CHECK(!fileExists(segmentFile(root, 1)));
+    CHECK_EQUAL(recordBytes * 4, log.pendingBytes());
+
+    for (int i = 3; i < 6; i++) {
+        CHECK_EQUAL(i, takeRecord(log));
+    }
+    CHECK(!fileExists(segmentFile(root, 2)));
+    CHECK(log.isEmpty());
+    log.end();
+}
+
+TEST(SpillLog, ResumesFromSavedCursor) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    {
+        SpillLog log;
+        REQUIRE(log.begin(fs, "/spill", 65536));
+        for (int i = 0; i < 10; i++) {
+            CHECK(appendRecord(log, i));
+        }
+        for (int i = 0; i < 4; i++) {
+            CHECK_EQUAL(i, takeRecord(log));
+        }
+        log.end(); // Saves the cursor
+    }
+
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK(appendRecord(log, 10)); // Goes to a fresh segment behind the old ones
+    for (int i = 4; i <= 10; i++) {
+        CHECK_EQUAL(i, takeRecord(log));
+    }
+    CHECK(log.isEmpty());
+    log.end();
+}
+
+TEST(SpillLog, RedeliversAfterCrash) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    int drained = SPILL_CURSOR_INTERVAL + 3;
+    {
+        SpillLog log;
+        REQUIRE(log.begin(fs, "/spill", 65536));
+        for (int i = 0; i < drained + 5; i++) {
+            CHECK(appendRecord(log, i));
+        }
+        for (int i = 0; i < drained; i++) {
+            CHECK_EQUAL(i, takeRecord(log));
+        }
+        // No end(): the last cursor save was after SPILL_CURSOR_INTERVAL pops
+    }
+
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK_EQUAL(SPILL_CURSOR_INTERVAL, takeRecord(log));
+    log.end();
+}
+
+TEST(SpillLog, IgnoresCorruptedCursor) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    {
+        SpillLog log;
+        REQUIRE(log.begin(fs, "/spill", 65536));
+        for (int i = 0; i < 3; i++) {
+            CHECK(appendRecord(log, i));
+        }
+        CHECK_EQUAL(0, takeRecord(log));
+        log.end();
+    }
+
+    FILE* cursor = fopen((root + "/spill/cursor").c_str(), "r+b");
+    REQUIRE(cursor != NULL);
+    fseek(cursor, 4, SEEK_SET);
+    fputc(0x7f, cursor);
+    fclose(cursor);
+
+    // Without a valid cursor everything left on flash is delivered again
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK_EQUAL(0, takeRecord(log));
+    log.end();
+}
+
+TEST(SpillLog, SkipsTornTail) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    {
+        SpillLog log;
+        REQUIRE(log.begin(fs, "/spill", 65536));
+        for (int i = 0; i < 3; i++) {
+            CHECK(appendRecord(log, i));
+        }
+        log.end();
+    }
+
+    // Power loss in the middle of the last record
+    std::string segment = segmentFile(root, 1);
+    struct stat info;
+    REQUIRE(stat(segment.c_str(), &info) == 0);
+    REQUIRE(truncate(segment.c_str(), info.st_size - 5) == 0);
+
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK(appendRecord(log, 3));
+    CHECK_EQUAL(0, takeRecord(log));
+    CHECK_EQUAL(1, takeRecord(log));
+    CHECK_EQUAL(3, takeRecord(log)); // The torn record ends its segment
+    CHECK_EQUAL(1, log.corruptedRecords());
+    CHECK(!fileExists(segment));
+    CHECK(log.isEmpty());
+    log.end();
+}
+
+TEST(SpillLog, RejectsCorruptedRecord) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    {
+        SpillLog log;
+        REQUIRE(log.begin(fs, "/spill", 65536));
+        for (int i = 0; i < 3; i++) {
+            CHECK(appendRecord(log, i));
+        }
+        log.end();
+    }
+
+    // Flip a payload byte of the second record
+    size_t recordBytes = sizeof(SpillRecordHeader) + strlen(TEST_URL) + strlen("{\"i\":0}") + strlen(TEST_HEADERS);
+    FILE* file = fopen(segmentFile(root, 1).c_str(), "r+b");
+    REQUIRE(file != NULL);
+    long offset = (long)(recordBytes + sizeof(SpillRecordHeader) + strlen(TEST_URL) + 2);
+    fseek(file, offset, SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(byte ^ 0x01, file);
+    fclose(file);
+
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    CHECK_EQUAL(0, takeRecord(log));
+    CHECK_EQUAL(-2, takeRecord(log));
+    CHECK_EQUAL(1, log.corruptedRecords());
+    CHECK_EQUAL(2, takeRecord(log));
+    log.end();
+}
+
+TEST(SpillLog, ClearDeletesEverything) {
+    TempDirectory temp;
+    const std::string& root = temp.path;
+    REQUIRE(!root.empty());
+    fs::FS fs(root.c_str());
+    SpillLog log;
+    REQUIRE(log.begin(fs, "/spill", 65536));
+    for (int i = 0; i < 3; i++) {
+        CHECK(appendRecord(log, i));
+    }
+    log.clear();
+    CHECK(log.isEmpty());
+    CHECK_EQUAL(0, log.pendingBytes());
+    CHECK(!fileExists(segmentFile(root, 1)));
+    CHECK_EQUAL(-1, takeRecord(log));
+
+    CHECK(appendRecord(log, 4));
+    CHECK_EQUAL(4, takeRecord(log));
+    log.end();
+}
+
+TEST(SpillLog, QueueSpillsWhenFullAndDrains) {
+    TempDirectory temp;
+    REQUIRE(!temp.path.empty());
+    fs::FS fs(temp.path.c_str());
+    TestServer& server = TestServer::shared();
+    server.reset();
+    server.hold();
+
+    PostQueue queue(2);
+    queue.setConnectionPool(1);
+    REQUIRE(queue.enableSpill(fs, "/spill", 65536));
+    REQUIRE(queue.begin());
+
+    char body[32];
+    std::string url = server.url();
+    for (int i = 0; i < 10; i++) {
+        snprintf(body, sizeof(body), "{\"i\":%d}", i);
+        CHECK(queue.post(url.c_str(), body, false));
+    }
+    size_t pendingBytes;
+    uint32_t spilled, corrupted;
+    queue.getSpillStats(pendingBytes, spilled, corrupted);
+    CHECK(spilled >= 7); // One item at the held server and at most two in the lane
+    CHECK_EQUAL(0, corrupted);
+
+    server.release();
+    REQUIRE(server.waitForRequests(10));
+    std::vector<std::string> bodies = server.bodies();
+    for (int i = 0; i < 10; i++) {
+        snprintf(body, sizeof(body), "{\"i\":%d}", i);
+        CHECK(bodies[i] == body);
+    }
+    queue.end();
+}
@@ -0,0 +1,36 @@
+/**
+ * @file TestMain.cpp
+ * @brief Runs the registered host test cases
+ *
+ * Usage: postqueue_tests [suite]
+ */
+
+#include "HostTest.h"
+
+int main(int argc, char** argv) {
+    const char* suite = argc > 1 ? argv[1] : NULL;
+    uint32_t run = 0;
+    uint32_t failed = 0;
+
+    for (TestCase* test = HostTest::head(); test != NULL; test = test->next) {
+        if (suite != NULL && strcmp(suite, test->suite) != 0) {
+            continue;
+        }
+        uint32_t failuresBefore = HostTest::failures();
+        printf("%s.%s\n", test->suite, test->name);
+        fflush(stdout);
+        test->run();
+        run++;
+        if (HostTest::failures() != failuresBefore) {
+            printf("    FAILED\n");
+            failed++;
+        }
+    }
+
+    if (run == 0) {
+        printf("no test cases%s%s\n", suite != NULL ? " in suite " : "", suite != NULL ? suite : "");
+        return 1;
+    }
+    printf("%u of %u cases passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}
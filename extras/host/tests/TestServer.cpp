@@ -0,0 +1,258 @@
+/**
+ * @file TestServer.cpp
+ * @brief Implementation of the loopback test server
+ */
+
+#include "TestServer.h"
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+TestServer::TestServer() : _listenFd(-1), _port(0), _held(false), _delay(0), _closing(false), _answersBeforeClose(0) {}
+
+TestServer& TestServer::shared() {
+    static TestServer* server = NULL;
+    if (server == NULL) {
+        server = new TestServer();
+        if (!server->begin()) {
+            fprintf(stderr, "TestServer: cannot listen on loopback\n");
+            exit(1);
+        }
+    }
+    return *server;
+}
+
+void TestServer::reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requests.clear();
+    _response = TestResponse();
+    _queuedResponses.clear();
+    _held = false;
+    _delay = 0;
+    _closing = false;
+    _changed.notify_all();
+}
+
+bool TestServer::begin() {
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listenFd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(_listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(_listenFd, 16) != 0 ||
+        getsockname(_listenFd, (struct sockaddr*)&address, &length) != 0) {
+        return false;
+    }
+    _port = ntohs(address.sin_port);
+
+    std::thread(&TestServer::acceptLoop, this).detach();
+    return true;
+}
+
+std::string TestServer::url(const char* path) const {
+    return "http://127.0.0.1:" + std::to_string(_port) + path;
+}
+
+void TestServer::hold() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _held = true;
+}
+
+void TestServer::release() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _held = false;
+    _changed.notify_all();
+}
+
+void TestServer::setDelay(uint32_t ms) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _delay = ms;
+}
+
+void TestServer::closeAfter(size_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closing = true;
+    _answersBeforeClose = count;
+}
+
+void TestServer::setResponse(const TestResponse& response) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _response = response;
+}
+
+void TestServer::queueResponse(const TestResponse& response, size_t times) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queuedResponses.insert(_queuedResponses.end(), times, response);
+}
+
+TestResponse TestServer::nextResponse() {
+    if (_queuedResponses.empty()) {
+        return _response;
+    }
+    TestResponse response = _queuedResponses.front();
+    _queuedResponses.pop_front();
+    return response;
+}
+
+bool TestServer::waitForRequests(size_t count, uint32_t timeout) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _changed.wait_for(lock, std::chrono::milliseconds(timeout),
+                             [this, count]() { return _requests.size() >= count; });
+}
+
+std::vector<std::string> TestServer::bodies() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::string> bodies;
+    for (const TestRequest& request : _requests) {
+        bodies.push_back(request.body);
+    }
+    return bodies;
+}
+
+std::vector<TestRequest> TestServer::requests() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests;
+}
+
+void TestServer::acceptLoop() {
+    uint32_t connections = 0;
+    while (true) {
+        int fd = accept(_listenFd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        std::thread(&TestServer::serve, this, fd, ++connections).detach();
+    }
+}
+
+// Decodes a complete chunked body at data into body; returns the bytes used, or 0 while incomplete
+static size_t dechunk(const char* data, size_t available, std::string& body) {
+    size_t used = 0;
+    body.clear();
+    while (true) {
+        const char* lineEnd = (const char*)memmem(data + used, available - used, "\r\n", 2);
+        if (lineEnd == NULL) {
+            return 0;
+        }
+        size_t size = strtoul(data + used, NULL, 16);
+        size_t start = (size_t)(lineEnd - data) + 2;
+        if (start + size + 2 > available) {
+            return 0;
+        }
+        body.append(data + start, size);
+        used = start + size + 2;
+        if (size == 0) {
+            return used;
+        }
+    }
+}
+
+// Serializes a response; it keeps the connection open unless its headers say otherwise
+static std::string serialize(const TestResponse& response) {
+    std::string text = "HTTP/1.1 " + std::to_string(response.status) +
+                       (response.status == 200 ? " OK" : " Status") +
+                       "\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(response.body.size()) + "\r\n";
+    if (strcasestr(response.headers.c_str(), "Connection:") == NULL) {
+        text += "Connection: keep-alive\r\n";
+    }
+    return text + response.headers + "\r\n" + response.body;
+}
+
+void TestServer::serve(int fd, uint32_t connection) {
+    std::string buffer;
+    char chunk[4096];
+
+    while (true) {
+        ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+        if (count <= 0) {
+            break;
+        }
+        buffer.append(chunk, (size_t)count);
+
+        while (true) {
+            size_t headEnd = buffer.find("\r\n\r\n");
+            if (headEnd == std::string::npos) {
+                break;
+            }
+            std::string head = buffer.substr(0, headEnd + 2);
+            size_t headLength = headEnd + 4;
+            std::string body;
+            size_t bodyLength = 0;
+            const char* lengthHeader = strcasestr(head.c_str(), "\r\nContent-Length:");
+            if (lengthHeader != NULL) {
+                bodyLength = strtoul(lengthHeader + 17, NULL, 10);
+                if (buffer.size() < headLength + bodyLength) {
+                    break;
+                }
+                body = buffer.substr(headLength, bodyLength);
+            } else if (strcasestr(head.c_str(), "\r\nTransfer-Encoding: chunked") != NULL) {
+                bodyLength = dechunk(buffer.data() + headLength, buffer.size() - headLength, body);
+                if (bodyLength == 0) {
+                    break;
+                }
+            }
+            buffer.erase(0, headLength + bodyLength);
+
+            TestRequest request;
+            size_t pathStart = head.find(' ') + 1;
+            request.path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+            request.head = head;
+            request.body = body;
+            request.arrivedAt = (uint32_t)millis();
+            request.connection = connection;
+            TestResponse response;
+            uint32_t wait;
+            bool last = false;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_closing && _answersBeforeClose == 0) {
+                    _closing = false;
+                    close(fd); // Drop this request and everything behind it
+                    return;
+                }
+                _requests.push_back(request);
+                _changed.notify_all();
+                _changed.wait(lock, [this]() { return !_held; });
+                if (_closing && _answersBeforeClose == 0) {
+                    _closing = false;
+                    close(fd); // closeAfter(0) while this one was held
+                    return;
+                }
+                response = nextResponse();
+                wait = _delay;
+                if (_closing && --_answersBeforeClose == 0) {
+                    _closing = false;
+                    last = true;
+                }
+            }
+            if (wait > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+            }
+            std::string text = serialize(response);
+            if (send(fd, text.data(), text.size(), MSG_NOSIGNAL) < 0 || last ||
+                strcasestr(response.headers.c_str(), "Connection: close") != NULL) {
+                close(fd);
+                return;
+            }
+        }
+    }
+    close(fd);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file TestServer.h
+ * @brief Loopback HTTP server for host tests that records request bodies
+ *
+ * Answers every POST with "200 ok" on a keep-alive connection, or with
+ * scripted responses, and keeps each request, its body de-chunked, in
+ * arrival order. While held, requests are
+ * read and recorded but not answered, so a test can keep the workers busy
+ * and fill the queue behind them. A delay makes every answer late, as from a
+ * slow server, and closeAfter() drops a connection partway through a pipeline. Serving threads are detached, so tests
+ * share one server for the whole run and reset() it between cases.
+ */
+
+#ifndef TEST_SERVER_H
+#define TEST_SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One request as received by the TestServer
+ */
+struct TestRequest {
+    std::string path;           ///< Request target from the request line
+    std::string head;           ///< Request line and header lines, each ending in CRLF
+    std::string body;           ///< Body, de-chunked
+    uint32_t arrivedAt;         ///< millis() when the whole request had arrived
+    uint32_t connection;        ///< Serial number of the connection it arrived on
+};
+
+/**
+ * @brief A response the TestServer sends
+ */
+struct TestResponse {
+    int status;                 ///< Status code
+    std::string body;           ///< Body, sent with a Content-Length
+    std::string headers;        ///< Extra header lines, each ending in CRLF
+
+    TestResponse(int status = 200, const std::string& body = "ok", const std::string& headers = "")
+        : status(status), body(body), headers(headers) {}
+};
+
+class TestServer {
+public:
+    /**
+     * @brief Get the server shared by all cases, listening on an ephemeral loopback port
+     */
+    static TestServer& shared();
+
+    /**
+     * @brief Forget the requests received so far, stop holding and answer "200 ok" at once again
+     */
+    void reset();
+
+    /**
+     * @brief Build a URL on this server
+     * @param path Path starting with '/'
+     */
+    std::string url(const char* path = "/ingest") const;
+
+    /**
+     * @brief Hold answers until release() (default: answer at once)
+     */
+    void hold();
+
+    /**
+     * @brief Answer held requests and stop holding
+     */
+    void release();
+
+    /**
+     * @brief Wait this long before sending each answer; each connection waits on its own
+     * @param ms Milliseconds, 0 to answer at once (default)
+     */
+    void setDelay(uint32_t ms);
+
+    /**
+     * @brief Answer the next count requests, then close the connection that sent the
+     *        last of them without answering anything else it sent
+     *
+     * Requests that connection sent behind them are not recorded either, except one
+     * already held when count is 0. Applies once; reset() cancels it.
+     * @param count Requests answered first; 0 closes instead of the next answer
+     */
+    void closeAfter(size_t count);
+
+    /**
+     * @brief Answer every request with this response, after any queued ones
+     */
+    void setResponse(const TestResponse& response);
+
+    /**
+     * @brief Answer the next requests with this response, then fall back to the default
+     * @param times Number of requests it answers
+     */
+    void queueResponse(const TestResponse& response, size_t times = 1);
+
+    /**
+     * @brief Wait until at least count requests have arrived
+     * @param timeout Milliseconds to wait
+     * @return true if they arrived in time
+     */
+    bool waitForRequests(size_t count, uint32_t timeout = 5000);
+
+    /**
+     * @brief Get the bodies received so far, oldest first
+     */
+    std::vector<std::string> bodies();
+
+    /**
+     * @brief Get the requests received so far, oldest first
+     */
+    std::vector<TestRequest> requests();
+
+private:
+    TestServer();
+
+    /**
+     * @brief Listen on an ephemeral loopback port
+     * @return true if listening
+     */
+    bool begin();
+
+    int _listenFd;
+    uint16_t _port;
+    bool _held;
+    uint32_t _delay;
+    bool _closing;
+    size_t _answersBeforeClose;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<TestRequest> _requests;
+    TestResponse _response;
+    std::deque<TestResponse> _queuedResponses;
+
+    void acceptLoop();
+    void serve(int fd, uint32_t connection);
+
+    /**
+     * @brief Take the response for the next request; call with _mutex held
+     */
+    TestResponse nextResponse();
+};
+
+#endif // TEST_SERVER_H
@@ -0,0 +1,159 @@
+/**
+ * @file CborSerializer.cpp
+ * @brief Implementation of the CBOR serializer
+ */
+
+#include "CborSerializer.h"
+#include <float.h>
+#include <math.h>
+
+// CBOR major types (RFC 8949 3.1)
+static const uint8_t CBOR_UNSIGNED = 0;
+static const uint8_t CBOR_NEGATIVE = 1;
+static const uint8_t CBOR_TEXT = 3;
+static const uint8_t CBOR_ARRAY = 4;
+static const uint8_t CBOR_MAP = 5;
+
+// Simple values and float markers (RFC 8949 3.3)
+static const uint8_t CBOR_FALSE = 0xF4;
+static const uint8_t CBOR_TRUE = 0xF5;
+static const uint8_t CBOR_NULL = 0xF6;
+static const uint8_t CBOR_FLOAT32 = 0xFA;
+static const uint8_t CBOR_FLOAT64 = 0xFB;
+
+/**
+ * @brief Writes CBOR to a buffer, or only counts bytes when the buffer is NULL
+ */
+class CborWriter {
+public:
+    CborWriter(uint8_t* output, size_t size) : _output(output), _size(size), _length(0) {}
+
+    /**
+     * @brief Write a value and, recursively, its members
+     */
+    void write(JsonVariantConst value) {
+        if (value.is<bool>()) {
+            writeByte(value.as<bool>() ? CBOR_TRUE : CBOR_FALSE);
+        } else if (value.is<unsigned long long>()) {
+            writeHead(CBOR_UNSIGNED, value.as<unsigned long long>());
+        } else if (value.is<long long>()) {
+            // Non-negative integers were taken above; CBOR stores -1 - n
+            writeHead(CBOR_NEGATIVE, (uint64_t)(-1 - value.as<long long>()));
+        } else if (value.is<double>()) {
+            writeFloat(value.as<double>());
+        } else if (value.is<const char*>()) {
+            const char* text = value.as<const char*>();
+            size_t length = strlen(text);
+            writeHead(CBOR_TEXT, length);
+            writeBytes((const uint8_t*)text, length);
+        } else if (value.is<JsonArrayConst>()) {
+            JsonArrayConst array = value.as<JsonArrayConst>();
+            writeHead(CBOR_ARRAY, array.size());
+            for (JsonVariantConst element : array) {
+                write(element);
+            }
+        } else if (value.is<JsonObjectConst>()) {
+            JsonObjectConst object = value.as<JsonObjectConst>();
+            writeHead(CBOR_MAP, object.size());
+            for (JsonPairConst pair : object) {
+                JsonString key = pair.key();
+                writeHead(CBOR_TEXT, key.size());
+                writeBytes((const uint8_t*)key.c_str(), key.size());
+                write(pair.value());
+            }
+        } else {
+            writeByte(CBOR_NULL);
+        }
+    }
+
+    /**
+     * @brief Get the number of bytes written or counted
+     */
+    size_t length() const { return _length; }
+
+private:
+    uint8_t* _output;       ///< Destination, or NULL to only count
+    size_t _size;           ///< Capacity of _output
+    size_t _length;         ///< Bytes written or counted so far
+
+    /**
+     * @brief Write a major type with its argument in the shortest form
+     */
+    void writeHead(uint8_t major, uint64_t argument) {
+        major <<= 5;
+        if (argument < 24) {
+            writeByte(major | (uint8_t)argument);
+        } else if (argument <= 0xFF) {
+            writeByte(major | 24);
+            writeBigEndian(argument, 1);
+        } else if (argument <= 0xFFFF) {
+            writeByte(major | 25);
+            writeBigEndian(argument, 2);
+        } else if (argument <= 0xFFFFFFFFULL) {
+            writeByte(major | 26);
+            writeBigEndian(argument, 4);
+        } else {
+            writeByte(major | 27);
+            writeBigEndian(argument, 8);
+        }
+    }
+
+    /**
+     * @brief Write a float, in single precision when it is in range
+     */
+    void writeFloat(double value) {
+        if (fabs(value) <= FLT_MAX || isnan(value) || isinf(value)) {
+            float single = (float)value;
+            uint32_t bits;
+            memcpy(&bits, &single, sizeof(bits));
+            writeByte(CBOR_FLOAT32);
+            writeBigEndian(bits, 4);
+        } else {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            writeByte(CBOR_FLOAT64);
+            writeBigEndian(bits, 8);
+        }
+    }
+
+    /**
+     * @brief Write the low bytes of a value, most significant first
+     */
+    void writeBigEndian(uint64_t value, uint8_t bytes) {
+        while (bytes-- > 0) {
+            writeByte((uint8_t)(value >> (8 * bytes)));
+        }
+    }
+
+    /**
+     * @brief Write raw bytes
+     */
+    void writeBytes(const uint8_t* data, size_t length) {
+        if (_output != NULL && _length + length <= _size) {
+            memcpy(_output + _length, data, length);
+        }
+        _length += length;
+    }
+
+    /**
+     * @brief Write one byte
+     */
+    void writeByte(uint8_t value) {
+        if (_output != NULL && _length < _size) {
+            _output[_length] = value;
+        }
+        _length++;
+    }
+};
+
+size_t measureCbor(JsonVariantConst source) {
+    CborWriter writer(NULL, 0);
+    writer.write(source);
+    return writer.length();
+}
+
+size_t serializeCbor(JsonVariantConst source, uint8_t* output, size_t size) {
+    CborWriter writer(output, size);
+    writer.write(source);
+    return writer.length() <= size ? writer.length() : 0;
+}
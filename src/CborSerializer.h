@@ -0,0 +1,35 @@
+/**
+ * @file CborSerializer.h
+ * @brief CBOR (RFC 8949) serialization of ArduinoJson documents
+ *
+ * ArduinoJson writes JSON and MessagePack but not CBOR, so these functions walk
+ * a document and write it as CBOR with the same shape, mirroring measureMsgPack()
+ * and serializeMsgPack(). Integers take their shortest encoding and floats are
+ * written in single precision when in range, as serializeMsgPack() does, so the
+ * two binary encodings carry the same values. Raw (serialized()) values have no
+ * CBOR form and are written as null.
+ */
+
+#ifndef CBOR_SERIALIZER_H
+#define CBOR_SERIALIZER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * @brief Compute the length of the CBOR encoding of a value
+ * @param source Document or variant to measure
+ * @return Number of bytes serializeCbor() writes
+ */
+size_t measureCbor(JsonVariantConst source);
+
+/**
+ * @brief Write a value as CBOR
+ * @param source Document or variant to write
+ * @param output Destination buffer
+ * @param size Capacity of output in bytes
+ * @return Number of bytes written, or 0 if output is too small
+ */
+size_t serializeCbor(JsonVariantConst source, uint8_t* output, size_t size);
+
+#endif // CBOR_SERIALIZER_H
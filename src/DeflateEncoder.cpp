@@ -0,0 +1,295 @@
+/**
+ * @file DeflateEncoder.cpp
+ * @brief Implementation of the streaming DEFLATE compressor
+ */
+
+#include "DeflateEncoder.h"
+
+#if DEFLATE_WINDOW_BITS < 9 || DEFLATE_WINDOW_BITS > 14
+#error "DEFLATE_WINDOW_BITS must be between 9 and 14"
+#endif
+
+// Base values and extra bits of the length symbols 257-285 and distance codes 0-29 (RFC 1951 3.2.5)
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+DeflateEncoder::DeflateEncoder() {
+    begin(DEFLATE_FORMAT_RAW, NULL, NULL);
+}
+
+void DeflateEncoder::begin(DeflateFormat format, DeflateSink sink, void* context) {
+    memset(_head, 0xFF, sizeof(_head));
+    memset(_prev, 0xFF, sizeof(_prev));
+    _length = 0;
+    _position = 0;
+    _outputLength = 0;
+    _bitBuffer = 0;
+    _bitCount = 0;
+    _format = format;
+    _sink = sink;
+    _context = context;
+    _started = false;
+    _failed = false;
+    _checksum = (format == DEFLATE_FORMAT_ZLIB) ? 1 : 0;
+    _bytesIn = 0;
+    _bytesOut = 0;
+}
+
+bool DeflateEncoder::write(const uint8_t* data, size_t length) {
+    start();
+    updateChecksum(data, length);
+    _bytesIn += length;
+
+    while (length > 0 && !_failed) {
+        if (_length == BUFFER_SIZE) {
+            slide();
+        }
+        size_t count = BUFFER_SIZE - _length;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(_window + _length, data, count);
+        _length += count;
+        data += count;
+        length -= count;
+        compress(false);
+    }
+    return !_failed;
+}
+
+bool DeflateEncoder::finish() {
+    start();
+    compress(true);
+    putSymbol(256); // End of block
+    if (_bitCount > 0) {
+        putBits(0, 8 - _bitCount);
+    }
+
+    if (_format == DEFLATE_FORMAT_GZIP) {
+        for (uint8_t shift = 0; shift < 32; shift += 8) {
+            putByte((uint8_t)(_checksum >> shift));
+        }
+        for (uint8_t shift = 0; shift < 32; shift += 8) {
+            putByte((uint8_t)(_bytesIn >> shift));
+        }
+    } else if (_format == DEFLATE_FORMAT_ZLIB) {
+        for (int8_t shift = 24; shift >= 0; shift -= 8) {
+            putByte((uint8_t)(_checksum >> shift));
+        }
+    }
+    flushOutput();
+    return !_failed;
+}
+
+void DeflateEncoder::start() {
+    if (_started) {
+        return;
+    }
+    _started = true;
+
+    if (_format == DEFLATE_FORMAT_GZIP) {
+        // Deflate method, no flags, no modification time, unknown OS
+        static const uint8_t header[10] = { 0x1F, 0x8B, 0x08, 0, 0, 0, 0, 0, 0, 0xFF };
+        for (uint8_t i = 0; i < sizeof(header); i++) {
+            putByte(header[i]);
+        }
+    } else if (_format == DEFLATE_FORMAT_ZLIB) {
+        putByte(0x78); // Deflate with a window of at most 32 KB
+        putByte(0x01); // Fastest level; makes the header a multiple of 31
+    }
+
+    // One final block with fixed Huffman codes carries the whole stream
+    putBits(1, 1);
+    putBits(1, 2);
+}
+
+void DeflateEncoder::compress(bool flush) {
+    while (_position < _length && (flush || _length - _position >= MAX_MATCH) && !_failed) {
+        uint16_t available = _length - _position;
+        uint16_t bestLength = 0;
+        uint16_t bestDistance = 0;
+
+        if (available >= MIN_MATCH) {
+            uint16_t maxLength = available < MAX_MATCH ? available : MAX_MATCH;
+            uint16_t hash = hashAt(_position);
+            uint16_t candidate = _head[hash];
+            const uint8_t* current = _window + _position;
+
+            for (uint8_t chain = 0; candidate != NO_POSITION && chain < DEFLATE_MAX_CHAIN; chain++) {
+                const uint8_t* earlier = _window + candidate;
+                if (earlier[bestLength] == current[bestLength]) {
+                    uint16_t length = 0;
+                    while (length < maxLength && earlier[length] == current[length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = _position - candidate;
+                        if (length == maxLength) {
+                            break;
+                        }
+                    }
+                }
+
+                // A slot reused by a newer position ends the chain
+                uint16_t next = _prev[candidate & (WINDOW_SIZE - 1)];
+                if (next >= candidate) {
+                    break;
+                }
+                candidate = next;
+            }
+            insert(_position, hash);
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            putMatch(bestLength, bestDistance);
+            for (uint16_t i = 1; i < bestLength; i++) {
+                uint16_t position = _position + i;
+                if (_length - position >= MIN_MATCH) {
+                    insert(position, hashAt(position));
+                }
+            }
+            _position += bestLength;
+        } else {
+            putLiteral(_window[_position]);
+            _position++;
+        }
+    }
+}
+
+void DeflateEncoder::slide() {
+    // compress() leaves less than a match of lookahead, so the oldest window is all history
+    memmove(_window, _window + WINDOW_SIZE, _length - WINDOW_SIZE);
+    _length -= WINDOW_SIZE;
+    _position -= WINDOW_SIZE;
+
+    for (uint16_t i = 0; i < HASH_SIZE; i++) {
+        _head[i] = (_head[i] == NO_POSITION || _head[i] < WINDOW_SIZE) ? NO_POSITION : _head[i] - WINDOW_SIZE;
+    }
+    for (uint16_t i = 0; i < WINDOW_SIZE; i++) {
+        _prev[i] = (_prev[i] == NO_POSITION || _prev[i] < WINDOW_SIZE) ? NO_POSITION : _prev[i] - WINDOW_SIZE;
+    }
+}
+
+uint16_t DeflateEncoder::hashAt(uint16_t position) const {
+    uint32_t bytes = _window[position] | ((uint32_t)_window[position + 1] << 8) |
+                     ((uint32_t)_window[position + 2] << 16);
+    return (uint16_t)((bytes * 2654435761u) >> (32 - DEFLATE_HASH_BITS));
+}
+
+void DeflateEncoder::insert(uint16_t position, uint16_t hash) {
+    _prev[position & (WINDOW_SIZE - 1)] = _head[hash];
+    _head[hash] = position;
+}
+
+void DeflateEncoder::putLiteral(uint8_t value) {
+    if (value < 144) {
+        putCode(0x30 + value, 8);
+    } else {
+        putCode(0x190 + value - 144, 9);
+    }
+}
+
+void DeflateEncoder::putSymbol(uint16_t symbol) {
+    if (symbol < 280) {
+        putCode(symbol - 256, 7);
+    } else {
+        putCode(0xC0 + symbol - 280, 8);
+    }
+}
+
+void DeflateEncoder::putMatch(uint16_t length, uint16_t distance) {
+    uint8_t code = 28;
+    while (LENGTH_BASE[code] > length) {
+        code--;
+    }
+    putSymbol(257 + code);
+    putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DISTANCE_BASE[code] > distance) {
+        code--;
+    }
+    putCode(code, 5);
+    putBits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+void DeflateEncoder::putCode(uint16_t code, uint8_t bits) {
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    putBits(reversed, bits);
+}
+
+void DeflateEncoder::putBits(uint32_t value, uint8_t bits) {
+    _bitBuffer |= value << _bitCount;
+    _bitCount += bits;
+    while (_bitCount >= 8) {
+        putByte((uint8_t)_bitBuffer);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+void DeflateEncoder::putByte(uint8_t value) {
+    _output[_outputLength++] = value;
+    if (_outputLength == sizeof(_output)) {
+        flushOutput();
+    }
+}
+
+void DeflateEncoder::flushOutput() {
+    if (_outputLength > 0 && !_failed) {
+        if (_sink == NULL || !_sink(_output, _outputLength, _context)) {
+            _failed = true;
+        }
+        _bytesOut += _outputLength;
+    }
+    _outputLength = 0;
+}
+
+void DeflateEncoder::updateChecksum(const uint8_t* data, size_t length) {
+    if (_format == DEFLATE_FORMAT_GZIP) {
+        // Nibble-wise CRC-32, as in SpillLog, avoids a 1 KB table
+        static const uint32_t table[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+        };
+        uint32_t crc = ~_checksum;
+        for (size_t i = 0; i < length; i++) {
+            crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+            crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+        }
+        _checksum = ~crc;
+    } else if (_format == DEFLATE_FORMAT_ZLIB) {
+        uint32_t a = _checksum & 0xFFFF;
+        uint32_t b = _checksum >> 16;
+        while (length > 0) {
+            // 5552 bytes is the most that can be summed before b may overflow
+            size_t block = length < 5552 ? length : 5552;
+            length -= block;
+            while (block-- > 0) {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        _checksum = (b << 16) | a;
+    }
+}
@@ -0,0 +1,193 @@
+/**
+ * @file DeflateEncoder.h
+ * @brief Streaming DEFLATE compressor with gzip and zlib framing for request bodies
+ *
+ * The encoder is fed a body in pieces of any size and passes compressed bytes to
+ * a sink as they are produced, so a body is never held twice. It emits a single
+ * block with the fixed Huffman codes of RFC 1951 and finds matches with a small
+ * hash chain over a fixed window. That gives up some ratio against zlib but
+ * needs no heap after construction and about 10 KB of state with the default
+ * window, where the miniz compressor in the ESP32 ROM needs over 300 KB.
+ */
+
+#ifndef DEFLATE_ENCODER_H
+#define DEFLATE_ENCODER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief log2 of the match window; the encoder buffers twice this much input (9 to 14)
+ */
+#ifndef DEFLATE_WINDOW_BITS
+#define DEFLATE_WINDOW_BITS 11
+#endif
+
+/**
+ * @brief log2 of the number of match hash chains
+ */
+#ifndef DEFLATE_HASH_BITS
+#define DEFLATE_HASH_BITS 10
+#endif
+
+/**
+ * @brief Earlier positions tried per match; more compresses better but slower
+ */
+#ifndef DEFLATE_MAX_CHAIN
+#define DEFLATE_MAX_CHAIN 8
+#endif
+
+/**
+ * @brief Compressed bytes collected before each call to the sink
+ */
+#ifndef DEFLATE_OUTPUT_SIZE
+#define DEFLATE_OUTPUT_SIZE 256
+#endif
+
+/**
+ * @brief Framing around the compressed data
+ */
+enum DeflateFormat {
+    DEFLATE_FORMAT_RAW,         ///< Bare DEFLATE data (RFC 1951)
+    DEFLATE_FORMAT_ZLIB,        ///< zlib header and Adler-32 (RFC 1950), HTTP "deflate"
+    DEFLATE_FORMAT_GZIP         ///< gzip header and CRC-32 (RFC 1952), HTTP "gzip"
+};
+
+/**
+ * @brief Callback receiving compressed bytes
+ * @param data Compressed bytes
+ * @param length Number of bytes
+ * @param context User pointer passed to begin()
+ * @return true to continue, false to stop with an error
+ */
+typedef bool (*DeflateSink)(const uint8_t* data, size_t length, void* context);
+
+/**
+ * @brief Streaming fixed-Huffman DEFLATE compressor
+ */
+class DeflateEncoder {
+public:
+    DeflateEncoder();
+
+    /**
+     * @brief Start a new compressed stream
+     * @param format Framing to emit
+     * @param sink Callback receiving compressed bytes
+     * @param context User pointer passed to the sink
+     */
+    void begin(DeflateFormat format, DeflateSink sink, void* context);
+
+    /**
+     * @brief Compress more input
+     * @return false if the sink failed
+     */
+    bool write(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Compress the remaining input and end the stream
+     * @return false if the sink failed
+     */
+    bool finish();
+
+    /**
+     * @brief Get the number of bytes passed to write()
+     */
+    uint32_t bytesIn() const { return _bytesIn; }
+
+    /**
+     * @brief Get the number of bytes passed to the sink, framing included
+     */
+    uint32_t bytesOut() const { return _bytesOut; }
+
+private:
+    static const uint16_t WINDOW_SIZE = 1 << DEFLATE_WINDOW_BITS;
+    static const uint16_t BUFFER_SIZE = 2 * WINDOW_SIZE;
+    static const uint16_t HASH_SIZE = 1 << DEFLATE_HASH_BITS;
+    static const uint16_t NO_POSITION = 0xFFFF;
+    static const uint16_t MIN_MATCH = 3;
+    static const uint16_t MAX_MATCH = 258;
+
+    uint8_t _window[BUFFER_SIZE];   ///< Recent input: up to a window of history and the lookahead
+    uint16_t _head[HASH_SIZE];      ///< Latest position of each hash chain
+    uint16_t _prev[WINDOW_SIZE];    ///< Previous position in the chain, by position modulo the window
+    uint8_t _output[DEFLATE_OUTPUT_SIZE]; ///< Compressed bytes not yet passed to the sink
+    uint16_t _length;               ///< Bytes held in _window
+    uint16_t _position;             ///< Next byte of _window to encode
+    uint16_t _outputLength;         ///< Bytes held in _output
+    uint32_t _bitBuffer;            ///< Bits not yet forming a whole byte
+    uint8_t _bitCount;              ///< Number of bits in _bitBuffer
+    DeflateFormat _format;          ///< Framing
+    DeflateSink _sink;              ///< Output callback
+    void* _context;                 ///< Output callback context
+    bool _started;                  ///< Whether the header has been written
+    bool _failed;                   ///< Whether the sink failed
+    uint32_t _checksum;             ///< Running CRC-32 (gzip) or Adler-32 (zlib) of the input
+    uint32_t _bytesIn;              ///< Input bytes
+    uint32_t _bytesOut;             ///< Output bytes
+
+    /**
+     * @brief Write the stream header and the block header once
+     */
+    void start();
+
+    /**
+     * @brief Encode buffered input, keeping a full match of lookahead unless flushing
+     */
+    void compress(bool flush);
+
+    /**
+     * @brief Drop the oldest window of input to make room
+     */
+    void slide();
+
+    /**
+     * @brief Hash of the three bytes at a position
+     */
+    uint16_t hashAt(uint16_t position) const;
+
+    /**
+     * @brief Make a position the latest of its hash chain
+     */
+    void insert(uint16_t position, uint16_t hash);
+
+    /**
+     * @brief Emit a literal byte
+     */
+    void putLiteral(uint8_t value);
+
+    /**
+     * @brief Emit a length or end-of-block symbol (256 to 285)
+     */
+    void putSymbol(uint16_t symbol);
+
+    /**
+     * @brief Emit a back-reference
+     */
+    void putMatch(uint16_t length, uint16_t distance);
+
+    /**
+     * @brief Emit a Huffman code, most significant bit first
+     */
+    void putCode(uint16_t code, uint8_t bits);
+
+    /**
+     * @brief Emit bits, least significant bit first
+     */
+    void putBits(uint32_t value, uint8_t bits);
+
+    /**
+     * @brief Append a byte to the output
+     */
+    void putByte(uint8_t value);
+
+    /**
+     * @brief Pass collected output to the sink
+     */
+    void flushOutput();
+
+    /**
+     * @brief Add input to the checksum of the framing
+     */
+    void updateChecksum(const uint8_t* data, size_t length);
+};
+
+#endif // DEFLATE_ENCODER_H
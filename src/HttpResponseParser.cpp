@@ -0,0 +1,186 @@
+/**
+ * @file HttpResponseParser.cpp
+ * @brief Implementation of the incremental HTTP/1.1 response parser
+ */
+
+#include "HttpResponseParser.h"
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+void HttpResponseParser::reset(HttpBodySink sink, void* context, bool headersOnly) {
+    _state = STATE_STATUS_LINE;
+    _lineLength = 0;
+    _statusCode = 0;
+    _keepAlive = true;
+    _chunked = false;
+    _contentLength = -1;
+    _retryAfter = 0;
+    _remaining = 0;
+    _headersOnly = headersOnly;
+    _sink = sink;
+    _sinkContext = context;
+}
+
+size_t HttpResponseParser::feed(const uint8_t* data, size_t length) {
+    size_t consumed = 0;
+
+    while (consumed < length && _state != STATE_DONE && _state != STATE_FAILED) {
+        if (_state == STATE_BODY_LENGTH || _state == STATE_CHUNK_DATA) {
+            size_t count = length - consumed;
+            if (count > _remaining) {
+                count = _remaining;
+            }
+            emit(data + consumed, count);
+            consumed += count;
+            _remaining -= count;
+
+            if (_remaining == 0) {
+                _state = (_state == STATE_CHUNK_DATA) ? STATE_CHUNK_END : STATE_DONE;
+            }
+            continue;
+        }
+
+        if (_state == STATE_BODY_UNTIL_CLOSE) {
+            emit(data + consumed, length - consumed);
+            consumed = length;
+            continue;
+        }
+
+        // Line-oriented states: accumulate up to '\n', dropping '\r' and overflow
+        char c = (char)data[consumed++];
+        if (c == '\n') {
+            _line[_lineLength] = '\0';
+            handleLine();
+            _lineLength = 0;
+        } else if (c != '\r' && _lineLength < HTTP_MAX_LINE_LENGTH - 1) {
+            _line[_lineLength++] = c;
+        }
+    }
+
+    return consumed;
+}
+
+void HttpResponseParser::finish() {
+    if (_state == STATE_BODY_UNTIL_CLOSE) {
+        _state = STATE_DONE;
+    } else if (_state != STATE_DONE) {
+        _state = STATE_FAILED;
+    }
+    _keepAlive = false;
+}
+
+void HttpResponseParser::handleLine() {
+    switch (_state) {
+        case STATE_STATUS_LINE:
+            // "HTTP/1.1 200 OK"; tolerate stray blank lines before it
+            if (_lineLength == 0) {
+                return;
+            }
+            if (strncmp(_line, "HTTP/", 5) != 0 || strchr(_line, ' ') == NULL) {
+                _state = STATE_FAILED;
+                return;
+            }
+            _keepAlive = (strncmp(_line, "HTTP/1.0", 8) != 0);
+            _statusCode = atoi(strchr(_line, ' ') + 1);
+            _state = STATE_HEADER_LINE;
+            break;
+
+        case STATE_HEADER_LINE:
+            if (_lineLength == 0) {
+                beginBody();
+            } else {
+                handleHeader();
+            }
+            break;
+
+        case STATE_CHUNK_SIZE: {
+            char* end = NULL;
+            unsigned long size = strtoul(_line, &end, 16);
+            if (end == _line) {
+                _state = STATE_FAILED;
+            } else if (size == 0) {
+                _state = STATE_TRAILER;
+            } else {
+                _remaining = (uint32_t)size;
+                _state = STATE_CHUNK_DATA;
+            }
+            break;
+        }
+
+        case STATE_CHUNK_END:
+            _state = (_lineLength == 0) ? STATE_CHUNK_SIZE : STATE_FAILED;
+            break;
+
+        case STATE_TRAILER:
+            if (_lineLength == 0) {
+                _state = STATE_DONE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void HttpResponseParser::handleHeader() {
+    char* colon = strchr(_line, ':');
+    if (colon == NULL) {
+        return;
+    }
+    *colon = '\0';
+    const char* value = colon + 1;
+    while (*value == ' ' || *value == '\t') {
+        value++;
+    }
+
+    if (strcasecmp(_line, "Content-Length") == 0) {
+        _contentLength = atol(value);
+    } else if (strcasecmp(_line, "Transfer-Encoding") == 0) {
+        _chunked = (strstr(value, "chunked") != NULL);
+    } else if (strcasecmp(_line, "Connection") == 0) {
+        if (strncasecmp(value, "close", 5) == 0) {
+            _keepAlive = false;
+        } else if (strncasecmp(value, "keep-alive", 10) == 0) {
+            _keepAlive = true;
+        }
+    } else if (strcasecmp(_line, "Retry-After") == 0) {
+        _retryAfter = (uint32_t)strtoul(value, NULL, 10); // An HTTP date parses as 0
+    }
+}
+
+void HttpResponseParser::beginBody() {
+    // Interim 1xx responses are followed by the real one
+    if (_statusCode >= 100 && _statusCode < 200) {
+        bool keepAlive = _keepAlive;
+        reset(_sink, _sinkContext, _headersOnly);
+        _keepAlive = keepAlive;
+        return;
+    }
+
+    if (_statusCode == 204 || _statusCode == 304) {
+        _state = STATE_DONE;
+    } else if (_chunked) {
+        _state = STATE_CHUNK_SIZE;
+    } else if (_contentLength >= 0) {
+        _remaining = (uint32_t)_contentLength;
+        _state = (_remaining > 0) ? STATE_BODY_LENGTH : STATE_DONE;
+    } else {
+        // No framing: the body ends when the server closes the connection
+        _keepAlive = false;
+        _state = STATE_BODY_UNTIL_CLOSE;
+    }
+
+    if (_headersOnly && _state != STATE_DONE) {
+        // The unread body is still on the connection
+        _keepAlive = false;
+        _state = STATE_DONE;
+    }
+}
+
+void HttpResponseParser::emit(const uint8_t* data, size_t length) {
+    if (_sink != NULL && length > 0) {
+        _sink(data, length, _sinkContext);
+    }
+}
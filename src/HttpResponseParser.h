@@ -0,0 +1,144 @@
+/**
+ * @file HttpResponseParser.h
+ * @brief Incremental HTTP/1.1 response parser used by the PostQueue raw send path
+ *
+ * The parser is fed bytes as they arrive from a socket and never blocks or
+ * allocates. It understands Content-Length, chunked transfer encoding and
+ * read-until-close bodies, and stops consuming input at the end of a response
+ * so bytes belonging to a following response are left for the caller.
+ */
+
+#ifndef HTTP_RESPONSE_PARSER_H
+#define HTTP_RESPONSE_PARSER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Maximum length of a status or header line kept by the parser (longer lines are truncated)
+ */
+#ifndef HTTP_MAX_LINE_LENGTH
+#define HTTP_MAX_LINE_LENGTH 128
+#endif
+
+/**
+ * @brief Callback receiving decoded response body bytes
+ * @param data Body bytes
+ * @param length Number of bytes
+ * @param context User pointer passed to reset()
+ */
+typedef void (*HttpBodySink)(const uint8_t* data, size_t length, void* context);
+
+/**
+ * @brief Incremental parser for a single HTTP/1.1 response
+ */
+class HttpResponseParser {
+public:
+    HttpResponseParser();
+
+    /**
+     * @brief Prepare the parser for a new response
+     * @param sink Callback receiving body bytes (NULL to discard the body)
+     * @param context User pointer passed to the sink
+     * @param headersOnly Stop after the headers; a response with a body then leaves
+     *                    the connection unusable (keepAlive() is false)
+     */
+    void reset(HttpBodySink sink = NULL, void* context = NULL, bool headersOnly = false);
+
+    /**
+     * @brief Feed received bytes to the parser
+     * @param data Received bytes
+     * @param length Number of bytes
+     * @return Number of bytes consumed; less than length once the response is complete
+     */
+    size_t feed(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Signal that the peer closed the connection
+     */
+    void finish();
+
+    /**
+     * @brief Check whether the whole response has been parsed
+     * @return true if complete, false otherwise
+     */
+    bool isComplete() const { return _state == STATE_DONE; }
+
+    /**
+     * @brief Check whether the response was malformed or truncated
+     * @return true on error, false otherwise
+     */
+    bool hasError() const { return _state == STATE_FAILED; }
+
+    /**
+     * @brief Check whether the status line and headers have been parsed
+     * @return true once the body (if any) is being read
+     */
+    bool headersComplete() const { return _state > STATE_HEADER_LINE; }
+
+    /**
+     * @brief Get the response status code
+     * @return HTTP status code, or 0 if not parsed yet
+     */
+    int statusCode() const { return _statusCode; }
+
+    /**
+     * @brief Check whether the connection can carry another request afterwards
+     * @return true if the server keeps the connection open
+     */
+    bool keepAlive() const { return _keepAlive; }
+
+    /**
+     * @brief Get the Retry-After delay of the response
+     * @return Delay in seconds, or 0 if absent or given as an HTTP date
+     */
+    uint32_t retryAfter() const { return _retryAfter; }
+
+private:
+    enum State {
+        STATE_STATUS_LINE,
+        STATE_HEADER_LINE,
+        STATE_BODY_LENGTH,
+        STATE_CHUNK_SIZE,
+        STATE_CHUNK_DATA,
+        STATE_CHUNK_END,
+        STATE_TRAILER,
+        STATE_BODY_UNTIL_CLOSE,
+        STATE_DONE,
+        STATE_FAILED
+    };
+
+    State _state;                   ///< Current parser state
+    char _line[HTTP_MAX_LINE_LENGTH]; ///< Current status/header/chunk-size line
+    size_t _lineLength;             ///< Bytes stored in _line
+    int _statusCode;                ///< Response status code
+    bool _keepAlive;                ///< Whether the connection stays open
+    bool _chunked;                  ///< Whether the body uses chunked encoding
+    int32_t _contentLength;         ///< Declared body length (-1 if absent)
+    uint32_t _retryAfter;           ///< Retry-After in seconds (0 if absent)
+    uint32_t _remaining;            ///< Bytes left in the body or current chunk
+    bool _headersOnly;              ///< Whether to stop after the headers
+    HttpBodySink _sink;             ///< Body callback
+    void* _sinkContext;             ///< Body callback context
+
+    /**
+     * @brief Handle a complete line in one of the line-oriented states
+     */
+    void handleLine();
+
+    /**
+     * @brief Handle one header line
+     */
+    void handleHeader();
+
+    /**
+     * @brief Choose the body framing once headers are complete
+     */
+    void beginBody();
+
+    /**
+     * @brief Pass body bytes to the sink
+     */
+    void emit(const uint8_t* data, size_t length);
+};
+
+#endif // HTTP_RESPONSE_PARSER_H
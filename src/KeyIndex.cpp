@@ -0,0 +1,97 @@
+/**
+ * @file KeyIndex.cpp
+ * @brief Implementation of the key index
+ */
+
+#include "KeyIndex.h"
+
+KeyIndex::KeyIndex()
+    : _entries(NULL),
+      _bits(0),
+      _count(0),
+      _capacity(0) {
+}
+
+KeyIndex::~KeyIndex() {
+    end();
+}
+
+bool KeyIndex::begin(size_t capacity) {
+    end();
+    _bits = 3;
+    while (((size_t)1 << _bits) < 2 * capacity) {
+        _bits++;
+    }
+    _entries = (Entry*)calloc((size_t)1 << _bits, sizeof(Entry));
+    _count = 0;
+    _capacity = capacity;
+    return _entries != NULL;
+}
+
+void KeyIndex::end() {
+    free(_entries);
+    _entries = NULL;
+    _count = 0;
+    _capacity = 0;
+}
+
+void* KeyIndex::find(uint32_t key) const {
+    if (key == 0 || _entries == NULL) {
+        return NULL;
+    }
+    return _entries[findSlot(key)].value;
+}
+
+bool KeyIndex::insert(uint32_t key, void* value) {
+    if (key == 0 || _entries == NULL) {
+        return false;
+    }
+    Entry& entry = _entries[findSlot(key)];
+    if (entry.key == 0) {
+        if (_count >= _capacity) {
+            return false;
+        }
+        entry.key = key;
+        _count++;
+    }
+    entry.value = value;
+    return true;
+}
+
+bool KeyIndex::erase(uint32_t key) {
+    if (key == 0 || _entries == NULL) {
+        return false;
+    }
+    size_t hole = findSlot(key);
+    if (_entries[hole].key == 0) {
+        return false;
+    }
+
+    size_t mask = ((size_t)1 << _bits) - 1;
+    for (size_t next = (hole + 1) & mask; _entries[next].key != 0; next = (next + 1) & mask) {
+        // An entry moves back into the hole unless the hole lies before its home slot
+        size_t home = homeSlot(_entries[next].key);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            _entries[hole] = _entries[next];
+            hole = next;
+        }
+    }
+    _entries[hole].key = 0;
+    _entries[hole].value = NULL;
+    _count--;
+    return true;
+}
+
+size_t KeyIndex::homeSlot(uint32_t key) const {
+    // Fibonacci hashing: the top bits of key * 2^32 / phi
+    return (uint32_t)(key * 2654435769u) >> (32 - _bits);
+}
+
+size_t KeyIndex::findSlot(uint32_t key) const {
+    size_t mask = ((size_t)1 << _bits) - 1;
+    size_t slot = homeSlot(key);
+    while (_entries[slot].key != 0 && _entries[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
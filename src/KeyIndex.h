@@ -0,0 +1,105 @@
+/**
+ * @file KeyIndex.h
+ * @brief Fixed-size hash index from non-zero 32-bit keys to pointers
+ *
+ * Holds the queued item for each postLatest() key. The table is allocated
+ * once, at least twice the number of keys it must hold, so it is never more
+ * than half full and lookups stay short. Keys are placed by Fibonacci hashing,
+ * which spreads consecutive keys such as sensor ids, and collisions probe
+ * linearly. Erasing shifts later entries of the probe run back into the hole
+ * instead of leaving tombstones, so the table never degrades with churn.
+ *
+ * The index takes no lock; PostQueue guards it with its own spinlock.
+ */
+
+#ifndef KEY_INDEX_H
+#define KEY_INDEX_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Open-addressing map from non-zero uint32_t keys to pointers
+ */
+class KeyIndex {
+public:
+    KeyIndex();
+    ~KeyIndex();
+
+    /**
+     * @brief Allocate an empty table
+     * @param capacity Most keys held at once; the table gets at least twice as many slots
+     * @return true if allocated, false otherwise
+     */
+    bool begin(size_t capacity);
+
+    /**
+     * @brief Free the table
+     */
+    void end();
+
+    /**
+     * @brief Get the value stored for a key
+     * @param key Non-zero key
+     * @return The value, or NULL if the key is absent
+     */
+    void* find(uint32_t key) const;
+
+    /**
+     * @brief Store a value for a key, replacing any value it had
+     * @param key Non-zero key
+     * @param value Value to store
+     * @return true if stored, false for key 0 or when a new key would exceed the capacity
+     */
+    bool insert(uint32_t key, void* value);
+
+    /**
+     * @brief Remove a key, shifting later entries of its probe run back
+     * @param key Non-zero key
+     * @return true if the key was present, false otherwise
+     */
+    bool erase(uint32_t key);
+
+    /**
+     * @brief Get the number of keys held
+     * @return Keys inserted and not erased
+     */
+    size_t size() const { return _count; }
+
+    /**
+     * @brief Get the capacity passed to begin()
+     * @return Most keys held at once
+     */
+    size_t capacity() const { return _capacity; }
+
+    /**
+     * @brief Check whether the table is allocated
+     * @return true after a successful begin()
+     */
+    bool isOpen() const { return _entries != NULL; }
+
+private:
+    /**
+     * @brief One slot; key 0 marks it empty
+     */
+    struct Entry {
+        uint32_t key;
+        void* value;
+    };
+
+    Entry* _entries;                        ///< Slot array, a power of two long
+    uint8_t _bits;                          ///< log2 of the slot count
+    size_t _count;                          ///< Keys held
+    size_t _capacity;                       ///< Most keys held at once
+
+    /**
+     * @brief Get the slot where the probe for a key starts
+     */
+    size_t homeSlot(uint32_t key) const;
+
+    /**
+     * @brief Find the slot holding a key, or the empty slot that ends its probe run
+     */
+    size_t findSlot(uint32_t key) const;
+};
+
+#endif // KEY_INDEX_H
@@ -0,0 +1,98 @@
+/**
+ * @file LatencyHistogram.cpp
+ * @brief Implementation of the latency histogram
+ */
+
+#include "LatencyHistogram.h"
+
+#if LATENCY_MIN_BITS + LATENCY_OCTAVES > 31
+#error "LATENCY_MIN_BITS + LATENCY_OCTAVES must be at most 31"
+#endif
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::record(uint32_t duration) {
+    _buckets[bucketFor(duration)]++;
+    _count++;
+    _sum += duration;
+    if (duration > _max) {
+        _max = duration;
+    }
+}
+
+void LatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+uint32_t LatencyHistogram::mean() const {
+    return _count > 0 ? (uint32_t)(_sum / _count) : 0;
+}
+
+uint32_t LatencyHistogram::percentile(float percent) const {
+    if (_count == 0) {
+        return 0;
+    }
+    if (percent < 0) {
+        percent = 0;
+    } else if (percent > 100) {
+        percent = 100;
+    }
+
+    // Rank of the duration asked for, counting from 1
+    uint64_t rank = (uint64_t)(percent / 100.0f * _count + 0.5f);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t below = 0;
+    for (uint8_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        if (below + _buckets[bucket] < rank) {
+            below += _buckets[bucket];
+            continue;
+        }
+
+        // Assume the durations in the bucket are spread evenly across it
+        uint32_t start = bucketStart(bucket);
+        uint32_t end = (bucket + 1 < LATENCY_BUCKETS) ? bucketStart(bucket + 1) : _max;
+        if (end > _max) {
+            end = _max; // No duration went past the longest one
+        }
+        if (end <= start) {
+            return end;
+        }
+        return start + (uint32_t)((uint64_t)(end - start) * (rank - below) / _buckets[bucket]);
+    }
+    return _max;
+}
+
+uint32_t LatencyHistogram::bucketStart(uint8_t bucket) {
+    if (bucket == 0) {
+        return 0;
+    }
+    if (bucket >= LATENCY_BUCKETS - 1) {
+        return 1UL << (LATENCY_MIN_BITS + LATENCY_OCTAVES);
+    }
+    uint8_t octave = (bucket - 1) / LATENCY_SUB_BUCKETS;
+    uint8_t step = (bucket - 1) % LATENCY_SUB_BUCKETS;
+    uint32_t octaveStart = 1UL << (LATENCY_MIN_BITS + octave);
+    return octaveStart + step * (octaveStart / LATENCY_SUB_BUCKETS);
+}
+
+uint8_t LatencyHistogram::bucketFor(uint32_t duration) {
+    if (duration < (1UL << LATENCY_MIN_BITS)) {
+        return 0;
+    }
+    uint8_t highBit = 31 - __builtin_clz(duration);
+    uint8_t octave = highBit - LATENCY_MIN_BITS;
+    if (octave >= LATENCY_OCTAVES) {
+        return LATENCY_BUCKETS - 1;
+    }
+    uint32_t octaveStart = 1UL << highBit;
+    uint8_t step = (uint8_t)((duration - octaveStart) / (octaveStart / LATENCY_SUB_BUCKETS));
+    return 1 + octave * LATENCY_SUB_BUCKETS + step;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file LatencyHistogram.h
+ * @brief Fixed-size, log-scaled latency histogram with percentile estimates
+ *
+ * Durations in microseconds fall into buckets that double in width every
+ * octave, each octave split into LATENCY_SUB_BUCKETS linear steps, so any
+ * recorded value is known to within 1 / LATENCY_SUB_BUCKETS of itself from
+ * 128 us up to about 134 s. The histogram is a plain value with no heap or
+ * lock: record() is a few instructions, and copying it is a memcpy, so an
+ * owner can keep it inside an existing critical section and hand out copies.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief log2 of the shortest duration, in microseconds, with its own bucket (128 us)
+ */
+#define LATENCY_MIN_BITS 7
+
+/**
+ * @brief Octaves covered above the shortest duration (up to 2^27 us, about 134 s)
+ */
+#define LATENCY_OCTAVES 20
+
+/**
+ * @brief Linear steps per octave
+ */
+#define LATENCY_SUB_BUCKETS 4
+
+/**
+ * @brief Total buckets: one below the range, the octaves, and one above the range
+ */
+#define LATENCY_BUCKETS (2 + LATENCY_OCTAVES * LATENCY_SUB_BUCKETS)
+
+/**
+ * @brief Log-scaled histogram of durations in microseconds
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    /**
+     * @brief Add one duration
+     * @param duration Duration in microseconds
+     */
+    void record(uint32_t duration);
+
+    /**
+     * @brief Remove every duration
+     */
+    void reset();
+
+    /**
+     * @brief Get the number of durations recorded
+     */
+    uint64_t count() const { return _count; }
+
+    /**
+     * @brief Get the longest duration recorded, in microseconds
+     */
+    uint32_t max() const { return _max; }
+
+    /**
+     * @brief Get the mean duration, in microseconds (0 if empty)
+     */
+    uint32_t mean() const;
+
+    /**
+     * @brief Estimate a percentile, interpolating within its bucket
+     * @param percent Percentile from 0 to 100, e.g. 99 for p99
+     * @return Duration in microseconds at or below which percent of durations fall (0 if empty)
+     */
+    uint32_t percentile(float percent) const;
+
+    /**
+     * @brief Get the number of durations in one bucket
+     * @param bucket Bucket index, below LATENCY_BUCKETS
+     */
+    uint32_t bucketCount(uint8_t bucket) const { return bucket < LATENCY_BUCKETS ? _buckets[bucket] : 0; }
+
+    /**
+     * @brief Get the shortest duration a bucket holds, in microseconds
+     * @param bucket Bucket index, below LATENCY_BUCKETS
+     */
+    static uint32_t bucketStart(uint8_t bucket);
+
+private:
+    uint32_t _buckets[LATENCY_BUCKETS]; ///< Durations per bucket
+    uint64_t _count;                ///< Durations recorded
+    uint64_t _sum;                  ///< Sum of the durations, in microseconds
+    uint32_t _max;                  ///< Longest duration, in microseconds
+
+    /**
+     * @brief Get the bucket a duration falls in
+     */
+    static uint8_t bucketFor(uint32_t duration);
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -4,25 +4,166 @@
  */
 
 #include "PostQueue.h"
+#include <new>
 
-PostQueue::PostQueue(size_t maxQueueSize, size_t taskStackSize, UBaseType_t taskPriority)
-    : _queue(NULL),
-      _taskHandle(NULL),
+// Spilled records keep the header set in five bits of their flags
+#if MAX_HEADER_SETS > 31
+#error "MAX_HEADER_SETS must be at most 31"
+#endif
+
+// Queued in place of an item to wake a worker for records from postFromISR()
+static uint8_t recordWakeMarker;
+static PostItem* const RECORD_WAKE = reinterpret_cast<PostItem*>(&recordWakeMarker);
+
+// Lets HTTPClient::writeToStream() hand a response body to a body sink
+class BodySinkStream : public Stream {
+public:
+    BodySinkStream(HttpBodySink sink, void* context) : _sink(sink), _context(context) {}
+
+    size_t write(uint8_t data) override {
+        _sink(&data, 1, _context);
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        _sink(buffer, size, _context);
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    HttpBodySink _sink;
+    void* _context;
+};
+
+PostQueue::PostQueue(size_t maxQueueSize, size_t taskStackSize, UBaseType_t taskPriority,
+                     uint8_t workerCount, BaseType_t workerCore, QueueBackend backend)
+    : _backend(backend),
+      _laneCount(1),
+      _laneScheduling(LANE_SCHEDULING_STRICT),
+      _starvationLimit(DEFAULT_LANE_STARVATION_LIMIT),
+      _turnLane(0),
+      _turnCredit(0),
+      _overflowPolicy(OVERFLOW_REJECT),
+      _overflowTimeout(0),
+      _blockedPosts(0),
+      _postsBlocked(0),
+      _decimationThreshold(100),
+      _decimationKeepEvery(0),
+      _deduplication(false),
+      _itemsReplaced(0),
+      _watermarkCallback(NULL),
+      _highWatermark(0),
+      _lowWatermark(0),
+      _aboveWatermark(false),
       _maxQueueSize(maxQueueSize),
       _taskStackSize(taskStackSize),
       _taskPriority(taskPriority),
+      _workerCount(workerCount == 0 ? 1 : (workerCount > MAX_WORKERS ? MAX_WORKERS : workerCount)),
+      _workerCore(workerCore),
+      _maxInFlight(DEFAULT_MAX_IN_FLIGHT),
+      _pipelineDepth(DEFAULT_PIPELINE_DEPTH),
+      _poolLock(NULL),
+      _callbackLock(NULL),
+      _nextSendTime(0),
+      _arena(NULL),
+      _arenaSlotSize(0),
+      _arenaSlotCount(0),
+      _arenaFree(NULL),
       _httpTimeout(DEFAULT_HTTP_TIMEOUT),
       _maxRedirects(DEFAULT_MAX_REDIRECTS),
       _verifySSL(false),
+      _pacingInterval(0),
+      _batchMaxItems(0),
+      _batchMaxBytes(DEFAULT_BATCH_MAX_BYTES),
+      _batchLinger(DEFAULT_BATCH_LINGER),
       _callback(NULL),
+      _responseMode(RESPONSE_CAPTURE),
+      _responseCaptureLimit(0),
+      _responseChunkCallback(NULL),
+      _compression(COMPRESSION_NONE),
+      _compressionMinSize(DEFAULT_COMPRESSION_MIN_SIZE),
+      _encoding(ENCODING_JSON),
+      _encodersInUse(0),
       _totalProcessed(0),
       _totalSuccessful(0),
       _totalFailed(0),
-      _running(false) {
+      _batchesSent(0),
+      _itemsBatched(0),
+      _requestsPipelined(0),
+      _pipelineResent(0),
+      _itemsCompressed(0),
+      _compressionBytesIn(0),
+      _compressionBytesOut(0),
+      _retryMaxAttempts(DEFAULT_RETRY_ATTEMPTS),
+      _retryBaseDelay(DEFAULT_RETRY_BASE_DELAY),
+      _retryMaxDelay(DEFAULT_RETRY_MAX_DELAY),
+      _retryJitter(DEFAULT_RETRY_JITTER),
+      _retryBudgetPercent(DEFAULT_RETRY_BUDGET_PERCENT),
+      _retryBudgetBurst(DEFAULT_RETRY_BUDGET_BURST),
+      _retryTokens(0),
+      _retryQueueSize(DEFAULT_RETRY_QUEUE_SIZE),
+      _retryItems(NULL),
+      _retryCount(0),
+      _retryLock(NULL),
+      _retriesScheduled(0),
+      _retriesExhausted(0),
+      _retriesBudgetDenied(0),
+      _retriesOverflowed(0),
+      _maxPooledConnections(DEFAULT_POOLED_CONNECTIONS),
+      _connectionIdleTimeout(DEFAULT_CONNECTION_IDLE_TIMEOUT),
+      _poolHits(0),
+      _poolMisses(0),
+      _spillFs(NULL),
+      _spillDirectory(DEFAULT_SPILL_DIRECTORY),
+      _spillMaxBytes(DEFAULT_SPILL_MAX_BYTES),
+      _spillLock(NULL),
+      _spillBusy(false),
+      _spillBackoff(false),
+      _spillRetryTime(0),
+      _spilledItems(0),
+      _headerSetCount(0),
+      _recordChannelCount(0),
+      _recordQueueSize(DEFAULT_RECORD_QUEUE_SIZE),
+      _records(NULL),
+      _recordWakePending(false),
+      _recordsPosted(0),
+      _recordsDropped(0),
+      _running(false),
+      _stopNotifyTask(NULL) {
+    memset(_taskHandles, 0, sizeof(_taskHandles));
+    memset(_encoders, 0, sizeof(_encoders));
+    memset(_pool, 0, sizeof(_pool));
+    memset(_headerSets, 0, sizeof(_headerSets));
+    memset(_succeededAfter, 0, sizeof(_succeededAfter));
+    for (uint8_t i = 0; i < MAX_PRIORITY_LANES; i++) {
+        PriorityLane& lane = _lanes[i];
+        lane.queue = NULL;
+        lane.occupied = 0;
+        lane.limit = 0;
+        lane.weight = (uint8_t)(1 << i);
+        lane.lastServed = 0;
+        lane.enqueued = 0;
+        lane.rejected = 0;
+        lane.evicted = 0;
+        lane.decimated = 0;
+        lane.decimationCount = 0;
+        lane.dequeued = 0;
+        lane.maxWait = 0;
+    }
+    vPortCPUInitializeMutex(&_statsMux);
+    vPortCPUInitializeMutex(&_keyMux);
 }
 
 PostQueue::~PostQueue() {
     end();
+
+    for (uint8_t i = 0; i < _headerSetCount; i++) {
+        free(_headerSets[i]);
+    }
 }
 
 bool PostQueue::begin() {
@@ -30,32 +171,126 @@ bool PostQueue::begin() {
         return true; // Already running
     }
 
-    // Create FreeRTOS queue
-    _queue = xQueueCreate(_maxQueueSize, sizeof(PostItem*));
-    if (_queue == NULL) {
-        Serial.println("PostQueue: Failed to create queue");
+    // Create a queue per lane, the top one with a spare slot for the postFromISR() wake
+    // marker; every worker may sleep at once, on the ring or on all lanes
+    bool created = _laneCount == 1 || _laneSignal.begin(_workerCount);
+    for (uint8_t i = 0; i < _laneCount && created; i++) {
+        PriorityLane& lane = _lanes[i];
+        size_t length = laneLimit(i) + ((i == _laneCount - 1 && _recordChannelCount > 0) ? 1 : 0);
+        lane.lastServed = millis();
+        lane.occupied = 0;
+        if (_backend == QUEUE_BACKEND_RING) {
+            created = lane.ring.begin(length, _workerCount);
+        } else {
+            lane.queue = xQueueCreate(length, sizeof(PostItem*));
+            created = lane.queue != NULL;
+        }
+        // Each freed slot wakes at most one waiting producer
+        if (created && _overflowPolicy == OVERFLOW_BLOCK) {
+            created = lane.space.begin((uint8_t)(laneLimit(i) < 255 ? laneLimit(i) : 255));
+        }
+    }
+    _blockedPosts = 0;
+    _aboveWatermark = false;
+    _turnLane = _laneCount - 1;
+    _turnCredit = _lanes[_turnLane].weight;
+    if (!created) {
+        POSTQUEUE_LOG_ERROR("Failed to create queue");
+        destroyLanes();
+        return false;
+    }
+
+    _poolLock = xSemaphoreCreateMutex();
+    _callbackLock = xSemaphoreCreateMutex();
+    _spillLock = xSemaphoreCreateMutex();
+    _running = true;
+
+    if (_poolLock == NULL || _callbackLock == NULL || _spillLock == NULL) {
+        POSTQUEUE_LOG_ERROR("Failed to create locks");
+        end();
         return false;
     }
 
-    // Create worker task
-    BaseType_t result = xTaskCreate(
-        workerTask,
-        "PostQueueWorker",
-        _taskStackSize,
-        this,
-        _taskPriority,
-        &_taskHandle
-    );
+    if (!createArena()) {
+        POSTQUEUE_LOG_ERROR("Failed to allocate item arena");
+        end();
+        return false;
+    }
 
-    if (result != pdPASS) {
-        Serial.println("PostQueue: Failed to create worker task");
-        vQueueDelete(_queue);
-        _queue = NULL;
+    // Every queued item may carry a distinct key
+    if (_deduplication && !_keyIndex.begin(queueCapacity())) {
+        POSTQUEUE_LOG_ERROR("Failed to allocate key index");
+        end();
         return false;
     }
 
-    _running = true;
-    Serial.println("PostQueue: Initialized successfully");
+    if (_retryMaxAttempts > 1) {
+        _retryItems = (PostItem**)malloc(_retryQueueSize * sizeof(PostItem*));
+        _retryLock = xSemaphoreCreateMutex();
+        _retryCount = 0;
+        _retryTokens = (uint32_t)_retryBudgetBurst * 100;
+        if (_retryItems == NULL || _retryLock == NULL) {
+            POSTQUEUE_LOG_ERROR("Failed to create retry queue");
+            end();
+            return false;
+        }
+    }
+
+    if (_recordChannelCount > 0) {
+        _records = xQueueCreate(_recordQueueSize, sizeof(PostRecord));
+        _recordWakePending = false;
+        if (_records == NULL) {
+            POSTQUEUE_LOG_ERROR("Failed to create record queue");
+            end();
+            return false;
+        }
+    }
+
+    if (_spillFs != NULL) {
+        _spillBusy = false;
+        _spillBackoff = false;
+        if (!_spill.begin(*_spillFs, _spillDirectory, _spillMaxBytes)) {
+            POSTQUEUE_LOG_ERROR("Failed to open spill log");
+            end();
+            return false;
+        }
+    }
+
+    // One compressor per worker: a worker compresses one body at a time
+    if (_compression != COMPRESSION_NONE) {
+        _encodersInUse = 0;
+        for (uint8_t i = 0; i < _workerCount; i++) {
+            _encoders[i] = new (std::nothrow) DeflateEncoder();
+            if (_encoders[i] == NULL) {
+                POSTQUEUE_LOG_ERROR("Failed to allocate compressors");
+                end();
+                return false;
+            }
+        }
+    }
+
+    // Create worker tasks, all draining the same queue
+    for (uint8_t i = 0; i < _workerCount; i++) {
+        BaseType_t core = (_workerCore == WORKER_CORES_SPREAD) ? (BaseType_t)(i % portNUM_PROCESSORS) : _workerCore;
+        BaseType_t result = xTaskCreatePinnedToCore(
+            workerTask,
+            "PostQueueWorker",
+            _taskStackSize,
+            this,
+            _taskPriority,
+            &_taskHandles[i],
+            core
+        );
+
+        if (result != pdPASS) {
+            POSTQUEUE_LOG_ERROR("Failed to create worker task");
+            _taskHandles[i] = NULL;
+            end();
+            return false;
+        }
+    }
+
+    POSTQUEUE_LOG_INFO("Initialized successfully");
     return true;
 }
 
@@ -64,267 +299,3079 @@ void PostQueue::end() {
         return;
     }
 
+    // Workers exit as soon as they see _running cleared, so count them and say whom
+    // to notify first
+    uint8_t workers = 0;
+    for (uint8_t i = 0; i < MAX_WORKERS; i++) {
+        if (_taskHandles[i] != NULL) {
+            workers++;
+        }
+    }
+    _stopNotifyTask = xTaskGetCurrentTaskHandle();
     _running = false;
 
     // Clear the queue
     clear();
 
-    // Delete the task
-    if (_taskHandle != NULL) {
-        vTaskDelete(_taskHandle);
-        _taskHandle = NULL;
+    // Wake producers waiting for room; they see the running flag cleared and give up
+    while (_blockedPosts > 0) {
+        for (uint8_t i = 0; i < _laneCount; i++) {
+            _lanes[i].space.wake(1);
+        }
+        vTaskDelay(1);
+    }
+
+    // Wake each sleeping worker and let the others finish their current request
+    if (_laneCount > 1) {
+        _laneSignal.wake(workers);
+    } else if (_backend == QUEUE_BACKEND_RING) {
+        _lanes[0].ring.wake(workers);
+    } else {
+        PostItem* stop = NULL;
+        for (uint8_t i = 0; i < workers; i++) {
+            xQueueSendToFront(_lanes[0].queue, &stop, pdMS_TO_TICKS(100));
+        }
+    }
+
+    uint32_t deadline = millis() + _httpTimeout + WORKER_STOP_MARGIN;
+    for (uint8_t stopped = 0; stopped < workers; stopped++) {
+        int32_t remaining = (int32_t)(deadline - millis());
+        if (remaining <= 0 || ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(remaining)) == 0) {
+            break;
+        }
+    }
+
+    for (uint8_t i = 0; i < MAX_WORKERS; i++) {
+        if (_taskHandles[i] != NULL) {
+            POSTQUEUE_LOG_WARN("Worker did not stop in time, deleting it");
+            vTaskDelete(_taskHandles[i]);
+            _taskHandles[i] = NULL;
+        }
+    }
+    ulTaskNotifyTake(pdTRUE, 0); // Drop notifications from workers that raced the deadline
+    _stopNotifyTask = NULL;
+
+    // Free anything queued while the workers were stopping
+    clear();
+
+    // Spilled requests stay on flash for the next begin()
+    _spill.end();
+
+    // Close pooled connections
+    for (uint8_t i = 0; i < MAX_POOLED_CONNECTIONS; i++) {
+        closeConnection(&_pool[i]);
+    }
+
+    // Delete the queues
+    destroyLanes();
+
+    if (_poolLock != NULL) {
+        vSemaphoreDelete(_poolLock);
+        _poolLock = NULL;
+    }
+    if (_callbackLock != NULL) {
+        vSemaphoreDelete(_callbackLock);
+        _callbackLock = NULL;
+    }
+    if (_spillLock != NULL) {
+        vSemaphoreDelete(_spillLock);
+        _spillLock = NULL;
+    }
+    if (_retryLock != NULL) {
+        vSemaphoreDelete(_retryLock);
+        _retryLock = NULL;
+    }
+    free(_retryItems);
+    _retryItems = NULL;
+
+    // Clearing the lanes took every keyed item out of the index
+    _keyIndex.end();
+
+    for (uint8_t i = 0; i < MAX_WORKERS; i++) {
+        delete _encoders[i];
+        _encoders[i] = NULL;
     }
 
-    // Delete the queue
-    if (_queue != NULL) {
-        vQueueDelete(_queue);
-        _queue = NULL;
+    // Interrupts were detached before end(), so no record can arrive any more
+    if (_records != NULL) {
+        vQueueDelete(_records);
+        _records = NULL;
     }
 
-    Serial.println("PostQueue: Stopped");
+    // Every item has been returned by now, so the arena can go
+    if (_arenaFree != NULL) {
+        vQueueDelete(_arenaFree);
+        _arenaFree = NULL;
+    }
+    _arenaRing.end();
+    if (_arena != NULL) {
+        free(_arena);
+        _arena = NULL;
+    }
+
+    POSTQUEUE_LOG_INFO("Stopped");
+}
+
+bool PostQueue::post(const char* url, const char* jsonPayload, bool useSSL, const char* customHeaders,
+                     uint8_t headerSet, uint8_t priority) {
+    return postLatest(0, url, jsonPayload, useSSL, customHeaders, headerSet, priority);
+}
+
+bool PostQueue::post(const char* url, JsonDocument& jsonDoc, bool useSSL, const char* customHeaders,
+                     uint8_t headerSet, uint8_t priority, PayloadEncoding encoding) {
+    return postLatest(0, url, jsonDoc, useSSL, customHeaders, headerSet, priority, encoding);
 }
 
-bool PostQueue::post(const char* url, const char* jsonPayload, bool useSSL, const char* customHeaders) {
-    if (!_running || _queue == NULL) {
-        Serial.println("PostQueue: Not initialized");
+bool PostQueue::postLatest(uint32_t key, const char* url, const char* jsonPayload, bool useSSL,
+                           const char* customHeaders, uint8_t headerSet, uint8_t priority) {
+    // Allocate and populate PostItem, or take over the queued item with this key
+    size_t payloadLength = strlen(jsonPayload);
+    bool reserved;
+    PostItem* item = prepareItem(key, url, payloadLength, useSSL, customHeaders, headerSet, laneFor(priority),
+                                 reserved);
+    if (item == NULL) {
         return false;
     }
+    memcpy(item->jsonPayload(), jsonPayload, payloadLength + 1);
 
-    // Check if queue is full
-    if (uxQueueSpacesAvailable(_queue) == 0) {
-        Serial.println("PostQueue: Queue is full");
-        return false;
+    return queuePreparedItem(item, reserved);
+}
+
+bool PostQueue::postLatest(uint32_t key, const char* url, JsonDocument& jsonDoc, bool useSSL,
+                           const char* customHeaders, uint8_t headerSet, uint8_t priority,
+                           PayloadEncoding encoding) {
+    if (encoding == ENCODING_DEFAULT) {
+        encoding = _encoding;
     }
 
-    // Allocate and populate PostItem
-    PostItem* item = new PostItem();
+    // Serialize straight into the queued item, sized up front
+    size_t payloadLength;
+    if (encoding == ENCODING_MSGPACK) {
+        payloadLength = measureMsgPack(jsonDoc);
+    } else if (encoding == ENCODING_CBOR) {
+        payloadLength = measureCbor(jsonDoc.as<JsonVariantConst>());
+    } else {
+        payloadLength = measureJson(jsonDoc);
+    }
+    bool reserved;
+    PostItem* item = prepareItem(key, url, payloadLength, useSSL, customHeaders, headerSet, laneFor(priority),
+                                 reserved);
     if (item == NULL) {
-        Serial.println("PostQueue: Failed to allocate PostItem");
         return false;
     }
 
-    item->url = strdup(url);
-    item->jsonPayload = strdup(jsonPayload);
-    item->customHeaders = customHeaders ? strdup(customHeaders) : NULL;
-    item->useSSL = useSSL;
-    item->timestamp = millis();
+    char* payload = item->jsonPayload();
+    if (encoding == ENCODING_MSGPACK) {
+        serializeMsgPack(jsonDoc, payload, payloadLength);
+    } else if (encoding == ENCODING_CBOR) {
+        serializeCbor(jsonDoc.as<JsonVariantConst>(), (uint8_t*)payload, payloadLength);
+    } else {
+        serializeJson(jsonDoc, payload, payloadLength + 1);
+    }
+    payload[payloadLength] = '\0'; // Items keep the terminator whatever the encoding
+    item->encoding = encoding;
 
-    // Check if allocations succeeded
-    if (item->url == NULL || item->jsonPayload == NULL) {
-        Serial.println("PostQueue: Failed to allocate memory for item data");
-        freePostItem(item);
+    return queuePreparedItem(item, reserved);
+}
+
+bool PostQueue::postStream(const char* url, BodyProducer producer, void* context, size_t contentLength,
+                           bool useSSL, const char* customHeaders, uint8_t headerSet, uint8_t priority) {
+    uint8_t lane = laneFor(priority);
+    bool reserved;
+    if (producer == NULL || !reserveSlot(lane, reserved)) {
         return false;
     }
 
-    // Add to queue
-    if (xQueueSend(_queue, &item, 0) != pdTRUE) {
-        Serial.println("PostQueue: Failed to add item to queue");
-        freePostItem(item);
+    PostItem* item = createPostItem(url, 0, useSSL, customHeaders, headerSet, lane);
+    if (item == NULL) {
+        if (reserved) {
+            releaseSlot(lane);
+        }
         return false;
     }
+    item->jsonPayload()[0] = '\0';
+    item->producer = producer;
+    item->producerContext = context;
+    item->contentLength = (uint32_t)contentLength;
 
-    return true;
+    return enqueuePostItem(item, reserved);
 }
 
-bool PostQueue::post(const char* url, JsonDocument& jsonDoc, bool useSSL, const char* customHeaders) {
-    String jsonString;
-    serializeJson(jsonDoc, jsonString);
-    return post(url, jsonString.c_str(), useSSL, customHeaders);
+static size_t readBodyFromStream(uint8_t* buffer, size_t size, void* context) {
+    return static_cast<Stream*>(context)->readBytes(buffer, size);
 }
 
-size_t PostQueue::getQueueSize() {
-    if (_queue == NULL) {
+bool PostQueue::postStream(const char* url, Stream& body, size_t contentLength, bool useSSL,
+                           const char* customHeaders, uint8_t headerSet, uint8_t priority) {
+    return postStream(url, readBodyFromStream, &body, contentLength, useSSL, customHeaders, headerSet, priority);
+}
+
+uint8_t PostQueue::addHeaderSet(const char* headers) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Header sets must be added before begin()");
         return 0;
     }
-    return uxQueueMessagesWaiting(_queue);
+    if (_headerSetCount >= MAX_HEADER_SETS) {
+        POSTQUEUE_LOG_ERROR("Too many header sets");
+        return 0;
+    }
+
+    size_t length;
+    uint8_t count;
+    if (!parseHeaders(headers, NULL, NULL, length, count)) {
+        POSTQUEUE_LOG_ERROR("Too many custom headers");
+        return 0;
+    }
+
+    HeaderSet* set = (HeaderSet*)malloc(sizeof(HeaderSet) + count * sizeof(HeaderField) + length + 1);
+    if (set == NULL) {
+        POSTQUEUE_LOG_ERROR("Failed to allocate header set");
+        return 0;
+    }
+    set->length = (uint16_t)length;
+    set->count = count;
+    char* output = const_cast<char*>(set->headers());
+    parseHeaders(headers, output, const_cast<HeaderField*>(set->fields()), length, count);
+    output[length] = '\0';
+
+    _headerSets[_headerSetCount++] = set;
+    return _headerSetCount;
 }
 
-bool PostQueue::isEmpty() {
-    return getQueueSize() == 0;
+bool IRAM_ATTR PostQueue::postFromISR(uint8_t channel, const void* data, size_t length,
+                                      BaseType_t* higherPriorityTaskWoken) {
+    BaseType_t woken = pdFALSE;
+    bool queued = false;
+
+    if (_records != NULL && channel >= 1 && channel <= _recordChannelCount && length <= POST_RECORD_SIZE) {
+        PostRecord record;
+        record.channel = channel;
+        record.length = (uint8_t)length;
+        memcpy(record.data, data, length);
+        queued = xQueueSendToBackFromISR(_records, &record, &woken) == pdTRUE;
+    }
+
+    if (!queued) {
+        portENTER_CRITICAL_ISR(&_statsMux);
+        _recordsDropped++;
+        portEXIT_CRITICAL_ISR(&_statsMux);
+    } else if (!_recordWakePending.exchange(true)) {
+        // One marker in the top lane wakes a worker for every record behind it
+        PriorityLane& top = _lanes[_laneCount - 1];
+        bool sent;
+        if (_backend == QUEUE_BACKEND_RING) {
+            sent = top.ring.pushFromISR(RECORD_WAKE, &woken);
+        } else {
+            sent = xQueueSendToBackFromISR(top.queue, &RECORD_WAKE, &woken) == pdTRUE;
+        }
+        if (!sent) {
+            _recordWakePending = false; // Busy workers pick the record up after their current item
+        } else if (_laneCount > 1) {
+            _laneSignal.notifyFromISR(&woken);
+        }
+    }
+
+    if (higherPriorityTaskWoken != NULL) {
+        if (woken == pdTRUE) {
+            *higherPriorityTaskWoken = pdTRUE;
+        }
+    } else if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+    return queued;
 }
 
-bool PostQueue::isFull() {
-    if (_queue == NULL) {
-        return false;
+uint8_t PostQueue::addRecordChannel(const char* url, RecordFormatter formatter, bool useSSL,
+                                    const char* customHeaders, uint8_t headerSet, uint8_t priority) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Record channels must be added before begin()");
+        return 0;
     }
-    return uxQueueSpacesAvailable(_queue) == 0;
+    if (_recordChannelCount >= MAX_RECORD_CHANNELS || url == NULL || formatter == NULL) {
+        POSTQUEUE_LOG_ERROR("Cannot add record channel");
+        return 0;
+    }
+
+    RecordChannel& recordChannel = _recordChannels[_recordChannelCount];
+    recordChannel.url = url;
+    recordChannel.formatter = formatter;
+    recordChannel.useSSL = useSSL;
+    recordChannel.customHeaders = customHeaders;
+    recordChannel.headerSet = headerSet;
+    recordChannel.priority = priority;
+    return ++_recordChannelCount;
 }
 
-void PostQueue::clear() {
-    if (_queue == NULL) {
+void PostQueue::setRecordQueueSize(size_t size) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Record queue size must be set before begin()");
         return;
     }
+    _recordQueueSize = size == 0 ? 1 : size;
+}
 
-    PostItem* item;
-    while (xQueueReceive(_queue, &item, 0) == pdTRUE) {
-        freePostItem(item);
+void PostQueue::getRecordStats(uint32_t& posted, uint32_t& dropped) {
+    portENTER_CRITICAL(&_statsMux);
+    posted = _recordsPosted;
+    dropped = _recordsDropped;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::drainRecords() {
+    PostRecord record;
+    char json[RECORD_JSON_MAX_SIZE];
+
+    while (_records != NULL && xQueuePeek(_records, &record, 0) == pdTRUE) {
+        // Leave records for a full lane queued; the worker drains again after its next item
+        uint8_t lane = laneFor(_recordChannels[record.channel - 1].priority);
+        bool reserved = tryReserveSlot(lane);
+        if (!reserved && !_spill.isOpen()) {
+            break;
+        }
+        if (xQueueReceive(_records, &record, 0) != pdTRUE) {
+            if (reserved) {
+                releaseSlot(lane);
+            }
+            break;
+        }
+
+        const RecordChannel& channel = _recordChannels[record.channel - 1];
+        bool queued = false;
+
+        size_t length = channel.formatter(record.data, record.length, json, sizeof(json));
+        if (length > 0 && length < sizeof(json)) {
+            PostItem* item = createPostItem(channel.url, length, channel.useSSL, channel.customHeaders,
+                                            channel.headerSet, laneFor(channel.priority));
+            if (item != NULL) {
+                memcpy(item->jsonPayload(), json, length);
+                item->jsonPayload()[length] = '\0';
+                queued = enqueuePostItem(item, reserved);
+                reserved = false;
+            }
+        } else if (length > 0) {
+            POSTQUEUE_LOG_ERROR("Record JSON exceeds RECORD_JSON_MAX_SIZE");
+        }
+        if (reserved) {
+            releaseSlot(lane); // The record produced no item
+        }
+
+        portENTER_CRITICAL(&_statsMux);
+        if (queued) {
+            _recordsPosted++;
+        } else {
+            _recordsDropped++;
+        }
+        portEXIT_CRITICAL(&_statsMux);
     }
 }
 
-void PostQueue::setTimeout(uint32_t timeout) {
-    _httpTimeout = timeout;
+bool PostQueue::reserveSlot(uint8_t lane, bool& reserved) {
+    reserved = false;
+    if (!_running) {
+        POSTQUEUE_LOG_ERROR("Not initialized");
+        return false;
+    }
+
+    if (_decimationKeepEvery > 1 && !passesDecimation(lane)) {
+        portENTER_CRITICAL(&_statsMux);
+        _lanes[lane].decimated++;
+        portEXIT_CRITICAL(&_statsMux);
+        return false;
+    }
+
+    // Claim room before anything is allocated, so a full lane costs no allocation and
+    // concurrent producers cannot both take the last slot
+    reserved = tryReserveSlot(lane);
+
+    // With spilling enabled a full lane overflows to flash instead
+    if (!reserved && !_spill.isOpen()) {
+        if (_overflowPolicy == OVERFLOW_BLOCK) {
+            reserved = waitForSlot(lane);
+        } else if (_overflowPolicy == OVERFLOW_DROP_OLDEST) {
+            while (!reserved && evictOldest(lane)) {
+                reserved = tryReserveSlot(lane);
+            }
+        }
+
+        if (!reserved) {
+            POSTQUEUE_LOG_WARN("Queue is full");
+            portENTER_CRITICAL(&_statsMux);
+            _lanes[lane].rejected++;
+            portEXIT_CRITICAL(&_statsMux);
+            return false;
+        }
+    }
+
+    return true;
 }
 
-void PostQueue::setMaxRedirects(uint8_t maxRedirects) {
-    _maxRedirects = maxRedirects;
+bool PostQueue::tryReserveSlot(uint8_t lane) {
+    std::atomic<uint32_t>& occupied = _lanes[lane].occupied;
+    uint32_t limit = (uint32_t)laneLimit(lane);
+    uint32_t count = occupied.load(std::memory_order_relaxed);
+    do {
+        if (count >= limit) {
+            return false;
+        }
+    } while (!occupied.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                             std::memory_order_relaxed));
+
+    if (_highWatermark > 0) {
+        checkWatermarks();
+    }
+    return true;
 }
 
-void PostQueue::setCallback(PostCallback callback) {
-    _callback = callback;
+void PostQueue::releaseSlot(uint8_t lane) {
+    _lanes[lane].occupied.fetch_sub(1, std::memory_order_release);
+    if (_overflowPolicy == OVERFLOW_BLOCK) {
+        _lanes[lane].space.notify();
+    }
+    if (_highWatermark > 0) {
+        checkWatermarks();
+    }
 }
 
-void PostQueue::setSSLVerification(bool verify) {
-    _verifySSL = verify;
+bool PostQueue::passesDecimation(uint8_t lane) {
+    PriorityLane& target = _lanes[lane];
+    size_t occupied = target.occupied.load(std::memory_order_relaxed);
+    if (occupied * 100 < laneLimit(lane) * _decimationThreshold) {
+        if (target.decimationCount.load(std::memory_order_relaxed) != 0) {
+            target.decimationCount.store(0, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // The first post past the threshold is kept, then one in every keepEvery
+    return target.decimationCount.fetch_add(1, std::memory_order_relaxed) % _decimationKeepEvery == 0;
 }
 
-void PostQueue::getStats(uint32_t& totalProcessed, uint32_t& totalSuccessful, uint32_t& totalFailed) {
-    totalProcessed = _totalProcessed;
-    totalSuccessful = _totalSuccessful;
-    totalFailed = _totalFailed;
+bool PostQueue::waitForSlot(uint8_t lane) {
+    PriorityLane& target = _lanes[lane];
+    uint32_t start = millis();
+    bool reserved = false;
+
+    portENTER_CRITICAL(&_statsMux);
+    _postsBlocked++;
+    portEXIT_CRITICAL(&_statsMux);
+    _blockedPosts++;
+    while (_running) {
+        // Announce the wait before re-checking, so a worker freeing a slot meanwhile wakes us
+        target.space.prepareWait();
+        reserved = tryReserveSlot(lane);
+        bool expired = false;
+        if (!reserved) {
+            uint32_t elapsed = millis() - start;
+            if (_overflowTimeout == OVERFLOW_WAIT_FOREVER) {
+                target.space.sleep(portMAX_DELAY);
+            } else if (elapsed < _overflowTimeout) {
+                TickType_t ticks = pdMS_TO_TICKS(_overflowTimeout - elapsed);
+                target.space.sleep(ticks > 0 ? ticks : 1);
+            } else {
+                expired = true;
+            }
+        }
+        target.space.finishWait();
+
+        if (reserved || expired) {
+            break;
+        }
+    }
+    _blockedPosts--;
+    return reserved;
 }
 
-void PostQueue::workerTask(void* parameter) {
-    PostQueue* queue = static_cast<PostQueue*>(parameter);
+bool PostQueue::evictOldest(uint8_t lane) {
+    // Each entry is looked at once at most: refreshed items lose the flag when moved back
     PostItem* item;
+    for (size_t attempt = 0; attempt <= laneLimit(lane) + 1; attempt++) {
+        if (!pullLane(lane, item)) {
+            return false;
+        }
+        if (item == RECORD_WAKE) {
+            // The postFromISR() wake marker is not an item; put it back behind the others.
+            // If it is lost, the next record queues a new one and workers drain records anyway.
+            if (!requeueItem(lane, item)) {
+                _recordWakePending = false;
+            }
+            continue;
+        }
+
+        bool superseded = false;
+        if (item->key != 0 && _keyIndex.isOpen()) {
+            lockKeyedItem(item);
+            superseded = item->superseded;
+            bool refreshed = item->refreshed && !superseded;
+            if (refreshed) {
+                item->refreshed = false;
+            } else if (_keyIndex.find(item->key) == item) {
+                _keyIndex.erase(item->key);
+            }
+            portEXIT_CRITICAL(&_keyMux);
 
-    Serial.println("PostQueue: Worker task started");
+            if (refreshed) {
+                // It holds a newer value than its place says; move it back like a fresh post
+                if (requeueItem(lane, item)) {
+                    continue;
+                }
+
+                // No room to move it back, so it is dropped after all; a post may have
+                // rewritten or superseded it since the lock was released
+                lockKeyedItem(item);
+                superseded = item->superseded;
+                if (_keyIndex.find(item->key) == item) {
+                    _keyIndex.erase(item->key);
+                }
+                portEXIT_CRITICAL(&_keyMux);
+            }
+        }
 
-    while (queue->_running) {
-        // Wait for item in queue (with timeout to check _running flag periodically)
-        if (xQueueReceive(queue->_queue, &item, pdMS_TO_TICKS(100)) == pdTRUE) {
-            Serial.println("PostQueue: Processing item");
-            queue->processPostItem(item);
-            queue->freePostItem(item);
+        // A superseded item has its newer value queued behind it, so nothing is lost
+        releaseSlot(lane);
+        if (!superseded) {
+            portENTER_CRITICAL(&_statsMux);
+            _lanes[lane].evicted++;
+            portEXIT_CRITICAL(&_statsMux);
         }
-        
-        // Small delay to prevent tight loop
-        vTaskDelay(pdMS_TO_TICKS(10));
+        freePostItem(item);
+        return true;
     }
+    return false;
+}
 
-    Serial.println("PostQueue: Worker task stopped");
-    vTaskDelete(NULL);
+void PostQueue::checkWatermarks() {
+    // The exchange makes each crossing run the callback once when producers and workers race
+    size_t queued = queuedItems();
+    if (queued >= _highWatermark) {
+        if (!_aboveWatermark.load(std::memory_order_relaxed) && !_aboveWatermark.exchange(true)) {
+            _watermarkCallback(true, queued);
+        }
+    } else if (queued <= _lowWatermark) {
+        if (_aboveWatermark.load(std::memory_order_relaxed) && _aboveWatermark.exchange(false)) {
+            _watermarkCallback(false, queued);
+        }
+    }
 }
 
-void PostQueue::processPostItem(PostItem* item) {
-    if (item == NULL) {
+void PostQueue::setOverflowPolicy(OverflowPolicy policy, uint32_t timeout) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Overflow policy must be set before begin()");
         return;
     }
+    _overflowPolicy = policy;
+    _overflowTimeout = timeout;
+}
 
-    _totalProcessed++;
-
-    int httpCode = 0;
-    String response = "";
-    
-    Serial.print("PostQueue: Sending POST to ");
-    Serial.println(item->url);
-
-    bool success = performPost(item->url, item->jsonPayload, item->customHeaders, 
-                               item->useSSL, httpCode, response);
+void PostQueue::setDecimation(uint8_t thresholdPercent, uint8_t keepEvery) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Decimation must be set before begin()");
+        return;
+    }
+    if (thresholdPercent == 0) {
+        thresholdPercent = 1;
+    } else if (thresholdPercent > 100) {
+        thresholdPercent = 100;
+    }
+    _decimationThreshold = thresholdPercent;
+    _decimationKeepEvery = keepEvery;
+}
 
-    if (success) {
-        _totalSuccessful++;
-        Serial.print("PostQueue: POST successful, HTTP code: ");
-        Serial.println(httpCode);
-    } else {
-        _totalFailed++;
-        Serial.print("PostQueue: POST failed, HTTP code: ");
-        Serial.println(httpCode);
+void PostQueue::getOverflowStats(OverflowStats& stats) {
+    portENTER_CRITICAL(&_statsMux);
+    stats.rejected = 0;
+    stats.evicted = 0;
+    stats.decimated = 0;
+    for (uint8_t lane = 0; lane < MAX_PRIORITY_LANES; lane++) {
+        stats.rejected += _lanes[lane].rejected;
+        stats.evicted += _lanes[lane].evicted;
+        stats.decimated += _lanes[lane].decimated;
     }
+    stats.blocked = _postsBlocked;
+    portEXIT_CRITICAL(&_statsMux);
+}
 
-    // Call callback if set
-    if (_callback != NULL) {
-        _callback(success, httpCode, response);
+void PostQueue::setDeduplication(bool enabled) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Deduplication must be set before begin()");
+        return;
     }
+    _deduplication = enabled;
 }
 
-bool PostQueue::performPost(const char* url, const char* jsonPayload, const char* customHeaders,
-                           bool useSSL, int& httpCode, String& response) {
-    HTTPClient http;
-    WiFiClient client;
-    WiFiClientSecure secureClient;
+void PostQueue::getDeduplicationStats(uint32_t& replaced, size_t& keysQueued) {
+    portENTER_CRITICAL(&_statsMux);
+    replaced = _itemsReplaced;
+    portEXIT_CRITICAL(&_statsMux);
+    portENTER_CRITICAL(&_keyMux);
+    keysQueued = _keyIndex.size();
+    portEXIT_CRITICAL(&_keyMux);
+}
 
-    // Configure SSL client if using SSL
-    if (useSSL) {
-        if (!_verifySSL) {
-            secureClient.setInsecure(); // Skip SSL verification
+PostItem* PostQueue::prepareItem(uint32_t key, const char* url, size_t payloadLength, bool useSSL,
+                                 const char* customHeaders, uint8_t headerSet, uint8_t lane, bool& reserved) {
+    reserved = false;
+    bool keyed = key != 0 && _keyIndex.isOpen();
+    if (keyed && _running) {
+        size_t headersLength;
+        uint8_t headerCount;
+        size_t size = measurePostItem(url, payloadLength, customHeaders, headerSet, headersLength, headerCount);
+        if (size == 0) {
+            return NULL;
+        }
+        PostItem* queued = claimKeyedItem(key, size);
+        if (queued != NULL) {
+            // Written over the queued item, which keeps its lane, position and queue time
+            fillPostItem(queued, url, payloadLength, useSSL, customHeaders, headerSet, headersLength, headerCount);
+            return queued;
         }
-        http.begin(secureClient, url);
-    } else {
-        http.begin(client, url);
     }
 
-    // Set timeout
-    http.setTimeout(_httpTimeout);
+    if (!reserveSlot(lane, reserved)) {
+        return NULL;
+    }
+    PostItem* item = createPostItem(url, payloadLength, useSSL, customHeaders, headerSet, lane);
+    if (item == NULL) {
+        if (reserved) {
+            releaseSlot(lane);
+        }
+        return NULL;
+    }
+    // Without a slot the item goes to flash, where keys are not tracked
+    if (keyed && reserved) {
+        item->key = key;
+    }
+    return item;
+}
 
-    // Follow redirects
-    http.setFollowRedirects(_maxRedirects > 0 ? HTTPC_FORCE_FOLLOW_REDIRECTS : HTTPC_DISABLE_FOLLOW_REDIRECTS);
-    http.setRedirectLimit(_maxRedirects);
+bool PostQueue::queuePreparedItem(PostItem* item, bool reserved) {
+    if (item->claimed) {
+        portENTER_CRITICAL(&_keyMux);
+        item->claimed = false;
+        item->refreshed = true;
+        portEXIT_CRITICAL(&_keyMux);
+        portENTER_CRITICAL(&_statsMux);
+        _itemsReplaced++;
+        portEXIT_CRITICAL(&_statsMux);
+        return true;
+    }
+    if (item->key != 0) {
+        return enqueueKeyedItem(item);
+    }
+    return enqueuePostItem(item, reserved);
+}
 
-    // Set headers
-    http.addHeader("Content-Type", "application/json");
-    
-    // Add custom headers if provided
-    if (customHeaders != NULL && strlen(customHeaders) > 0) {
-        // Parse custom headers (format: "Header1: Value1\nHeader2: Value2")
-        String headers = String(customHeaders);
-        int startPos = 0;
-        int endPos = headers.indexOf('\n');
-        
-        while (endPos >= 0 || startPos < headers.length()) {
-            String headerLine = (endPos >= 0) ? headers.substring(startPos, endPos) : headers.substring(startPos);
-            headerLine.trim();
-            
-            if (headerLine.length() > 0) {
-                int colonPos = headerLine.indexOf(':');
-                if (colonPos > 0) {
-                    String headerName = headerLine.substring(0, colonPos);
-                    String headerValue = headerLine.substring(colonPos + 1);
-                    headerName.trim();
-                    headerValue.trim();
-                    http.addHeader(headerName, headerValue);
-                }
+PostItem* PostQueue::claimKeyedItem(uint32_t key, size_t size) {
+    while (true) {
+        portENTER_CRITICAL(&_keyMux);
+        PostItem* queued = static_cast<PostItem*>(_keyIndex.find(key));
+        bool busy = queued != NULL && queued->claimed;
+        if (queued != NULL && !busy) {
+            if (size <= queued->capacity) {
+                queued->claimed = true;
+            } else {
+                queued = NULL; // A heap block sized for a shorter value; a new item supersedes it
             }
-            
-            if (endPos < 0) break;
-            startPos = endPos + 1;
-            endPos = headers.indexOf('\n', startPos);
         }
+        portEXIT_CRITICAL(&_keyMux);
+
+        if (!busy) {
+            return queued;
+        }
+        vTaskDelay(1); // Another post with this key is writing over it
     }
+}
 
-    // Perform POST request
-    httpCode = http.POST(jsonPayload);
+bool PostQueue::enqueueKeyedItem(PostItem* item) {
+    portENTER_CRITICAL(&_keyMux);
+    PostItem* queued = static_cast<PostItem*>(_keyIndex.find(item->key));
+    if (queued != NULL) {
+        queued->superseded = true; // Freed, unsent, when a worker or an eviction reaches it
+    }
+    _keyIndex.insert(item->key, item);
+    portEXIT_CRITICAL(&_keyMux);
 
-    // Check response
-    bool success = false;
-    if (httpCode > 0) {
-        if (httpCode >= 200 && httpCode < 300) {
-            success = true;
-            response = http.getString();
-        } else {
-            response = http.getString();
-        }
-    } else {
-        Serial.print("PostQueue: HTTP error: ");
-        Serial.println(http.errorToString(httpCode).c_str());
+    if (queued != NULL) {
+        portENTER_CRITICAL(&_statsMux);
+        _itemsReplaced++;
+        portEXIT_CRITICAL(&_statsMux);
     }
 
-    http.end();
-    return success;
-}
+    // Keyed items skip the spill ordering rule: they hold the newest value and have a
+    // slot, so sending them ahead of older spilled data loses nothing
+    if (pushItem(item)) {
+        return true;
+    }
+
+    lockKeyedItem(item);
+    if (_keyIndex.find(item->key) == item) {
+        _keyIndex.erase(item->key);
+    }
+    portEXIT_CRITICAL(&_keyMux);
+
+    POSTQUEUE_LOG_WARN("Queue is full");
+    releaseSlot(item->priority);
+    portENTER_CRITICAL(&_statsMux);
+    _lanes[item->priority].rejected++;
+    portEXIT_CRITICAL(&_statsMux);
+    freePostItem(item);
+    return false;
+}
+
+void PostQueue::lockKeyedItem(PostItem* item) {
+    portENTER_CRITICAL(&_keyMux);
+    while (item->claimed) {
+        // Rewriting takes no longer than building a new item, so wait it out
+        portEXIT_CRITICAL(&_keyMux);
+        vTaskDelay(1);
+        portENTER_CRITICAL(&_keyMux);
+    }
+}
+
+bool PostQueue::takeKeyedItem(PostItem* item) {
+    if (item == NULL || item->key == 0 || !_keyIndex.isOpen()) {
+        return true; // Not keyed, or the shutdown sentinel
+    }
+
+    // Retried items are no longer in the index, so only remove the entry for this item
+    lockKeyedItem(item);
+    if (_keyIndex.find(item->key) == item) {
+        _keyIndex.erase(item->key);
+    }
+    item->refreshed = false;
+    bool superseded = item->superseded;
+    portEXIT_CRITICAL(&_keyMux);
+
+    if (superseded) {
+        freePostItem(item);
+        return false;
+    }
+    return true;
+}
+
+void PostQueue::setWatermarks(size_t highWatermark, size_t lowWatermark, WatermarkCallback callback) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Watermarks must be set before begin()");
+        return;
+    }
+    if (callback == NULL || lowWatermark >= highWatermark) {
+        highWatermark = 0; // Disabled
+    }
+    _highWatermark = highWatermark;
+    _lowWatermark = lowWatermark;
+    _watermarkCallback = callback;
+}
+
+bool PostQueue::enqueuePostItem(PostItem* item, bool reserved) {
+    // Once anything has spilled, later normal-priority items follow it to flash to keep
+    // their order; higher lanes only spill when full so they are not held up
+    if (_spill.isOpen() && item->producer == NULL) {
+        xSemaphoreTake(_spillLock, portMAX_DELAY);
+        bool spilled = false;
+        bool stored = true;
+        if (!reserved || (item->priority == 0 && !_spill.isEmpty()) || !pushItem(item)) {
+            if (reserved) {
+                releaseSlot(item->priority);
+            }
+            spilled = true;
+            stored = spillPostItem(item);
+        }
+        xSemaphoreGive(_spillLock);
+
+        if (spilled) {
+            freePostItem(item);
+        }
+        return stored;
+    }
+
+    // Add to queue; only a streamed item for a full lane with spilling enabled arrives
+    // here without a slot
+    if (!reserved || !pushItem(item)) {
+        POSTQUEUE_LOG_WARN("Queue is full");
+        if (reserved) {
+            releaseSlot(item->priority);
+        }
+        portENTER_CRITICAL(&_statsMux);
+        _lanes[item->priority].rejected++;
+        portEXIT_CRITICAL(&_statsMux);
+        freePostItem(item);
+        return false;
+    }
+
+    return true;
+}
+
+bool PostQueue::pushItem(PostItem* item) {
+    PriorityLane& lane = _lanes[item->priority];
+    bool pushed;
+    if (_backend == QUEUE_BACKEND_RING) {
+        pushed = lane.ring.push(item);
+    } else {
+        pushed = xQueueSend(lane.queue, &item, 0) == pdTRUE;
+    }
+    if (!pushed) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    lane.enqueued++;
+    portEXIT_CRITICAL(&_statsMux);
+    if (_laneCount > 1) {
+        _laneSignal.notify();
+    }
+    return true;
+}
+
+bool PostQueue::popLane(uint8_t lane, PostItem*& item) {
+    while (pullLane(lane, item)) {
+        if (item == RECORD_WAKE) {
+            return true;
+        }
+        releaseSlot(lane);
+        if (takeKeyedItem(item)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PostQueue::pullLane(uint8_t lane, PostItem*& item) {
+    if (_backend == QUEUE_BACKEND_RING) {
+        void* slot;
+        if (!_lanes[lane].ring.isOpen() || !_lanes[lane].ring.pop(slot)) {
+            return false;
+        }
+        item = static_cast<PostItem*>(slot);
+        return true;
+    }
+    return _lanes[lane].queue != NULL && xQueueReceive(_lanes[lane].queue, &item, 0) == pdTRUE;
+}
+
+bool PostQueue::requeueItem(uint8_t lane, PostItem* item) {
+    // The entry still holds its slot, so there should be room
+    bool pushed;
+    if (_backend == QUEUE_BACKEND_RING) {
+        pushed = _lanes[lane].ring.push(item);
+    } else {
+        pushed = xQueueSend(_lanes[lane].queue, &item, 0) == pdTRUE;
+    }
+    if (pushed && _laneCount > 1) {
+        _laneSignal.notify();
+    }
+    return pushed;
+}
+
+bool PostQueue::takeItem(PostItem*& item) {
+    for (uint8_t lane = _laneCount; lane-- > 0;) {
+        while (popLane(lane, item)) {
+            if (item != RECORD_WAKE) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool PostQueue::takeScheduledItem(PostItem*& item) {
+    uint8_t order[MAX_PRIORITY_LANES];
+    uint8_t count = 0;
+    uint32_t now = millis();
+
+    if (_laneScheduling == LANE_SCHEDULING_WEIGHTED) {
+        // The lane whose turn it is first, then the others from high to low priority
+        portENTER_CRITICAL(&_statsMux);
+        uint8_t turn = _turnLane;
+        portEXIT_CRITICAL(&_statsMux);
+        for (uint8_t i = 0; i < _laneCount; i++) {
+            order[count++] = (uint8_t)((turn + _laneCount - i) % _laneCount);
+        }
+    } else {
+        // Highest lane first, unless a lower lane has waited unserved past the starvation limit
+        int starved = -1;
+        for (uint8_t lane = 0; lane + 1 < _laneCount; lane++) {
+            bool waiting = laneItems(lane) > 0;
+            portENTER_CRITICAL(&_statsMux);
+            if (!waiting) {
+                _lanes[lane].lastServed = now; // Only time spent waiting counts towards starvation
+            } else if (starved < 0 && _starvationLimit > 0 && now - _lanes[lane].lastServed >= _starvationLimit) {
+                starved = lane;
+            }
+            portEXIT_CRITICAL(&_statsMux);
+        }
+        if (starved >= 0) {
+            order[count++] = (uint8_t)starved;
+        }
+        for (uint8_t lane = _laneCount; lane-- > 0;) {
+            if (lane != starved) {
+                order[count++] = lane;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t lane = order[i];
+        if (!popLane(lane, item)) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&_statsMux);
+        _lanes[lane].lastServed = now;
+        if (_laneScheduling == LANE_SCHEDULING_WEIGHTED) {
+            // A lane served out of turn (the turn lane was empty) starts its own turn
+            if (lane != _turnLane) {
+                _turnLane = lane;
+                _turnCredit = _lanes[lane].weight;
+            }
+            if (_turnCredit <= 1) {
+                _turnLane = (uint8_t)((lane + _laneCount - 1) % _laneCount);
+                _turnCredit = _lanes[_turnLane].weight;
+            } else {
+                _turnCredit--;
+            }
+        }
+        portEXIT_CRITICAL(&_statsMux);
+        return true;
+    }
+    return false;
+}
+
+void PostQueue::noteDequeued(const PostItem* item) {
+    uint32_t wait = millis() - item->timestamp;
+    // micros() wraps after about 71 minutes; a wait that long lands in the top bucket
+    uint32_t waitMicros = (wait < UINT32_MAX / 1000) ? micros() - item->queuedAt : UINT32_MAX;
+    PriorityLane& lane = _lanes[item->priority];
+    portENTER_CRITICAL(&_statsMux);
+    lane.dequeued++;
+    if (wait > lane.maxWait) {
+        lane.maxWait = wait;
+    }
+    _queueWaitLatency.record(waitMicros);
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+bool PostQueue::waitForItem(PostItem*& item, TickType_t wait) {
+    while (true) {
+        // Once end() has started every worker stops; the FreeRTOS sentinel and the ring
+        // wake-up only get sleeping workers here in time
+        if (!_running) {
+            item = NULL;
+            return true;
+        }
+
+        bool received;
+        if (_laneCount > 1) {
+            // Sleep on all lanes at once; re-check after announcing so no push is missed
+            received = takeScheduledItem(item);
+            if (!received && wait > 0) {
+                _laneSignal.prepareWait();
+                received = takeScheduledItem(item);
+                if (!received) {
+                    _laneSignal.sleep(wait);
+                    received = takeScheduledItem(item);
+                }
+                _laneSignal.finishWait();
+            }
+        } else if (_backend == QUEUE_BACKEND_RING) {
+            void* slot;
+            received = _lanes[0].ring.pop(slot, wait);
+            if (received) {
+                item = static_cast<PostItem*>(slot);
+            }
+        } else {
+            received = xQueueReceive(_lanes[0].queue, &item, wait) == pdTRUE;
+        }
+
+        if (!received) {
+            if (!_running) {
+                item = NULL;
+                return true;
+            }
+            return false;
+        }
+
+        if (item == NULL) {
+            return true; // Shutdown sentinel
+        }
+        if (item != RECORD_WAKE) {
+            if (_laneCount == 1) {
+                releaseSlot(0); // With several lanes popLane() releases it
+                if (!takeKeyedItem(item)) {
+                    continue; // Superseded by a newer item queued behind it
+                }
+            }
+            noteDequeued(item);
+            return true;
+        }
+
+        // Turn records from postFromISR() into items queued behind this point;
+        // clear the flag first so a record arriving meanwhile queues a new marker
+        _recordWakePending = false;
+        drainRecords();
+    }
+}
+
+size_t PostQueue::laneItems(uint8_t lane) {
+    return _lanes[lane].occupied.load(std::memory_order_relaxed);
+}
+
+size_t PostQueue::queuedItems() {
+    size_t count = 0;
+    for (uint8_t lane = 0; lane < _laneCount; lane++) {
+        count += laneItems(lane);
+    }
+    return count;
+}
+
+size_t PostQueue::queueCapacity() const {
+    size_t capacity = 0;
+    for (uint8_t lane = 0; lane < _laneCount; lane++) {
+        capacity += laneLimit(lane);
+    }
+    return capacity;
+}
+
+void PostQueue::destroyLanes() {
+    for (uint8_t i = 0; i < MAX_PRIORITY_LANES; i++) {
+        if (_lanes[i].queue != NULL) {
+            vQueueDelete(_lanes[i].queue);
+            _lanes[i].queue = NULL;
+        }
+        _lanes[i].ring.end();
+        _lanes[i].space.end();
+    }
+    _laneSignal.end();
+}
+
+bool PostQueue::setPriorityLanes(uint8_t count, LaneScheduling scheduling) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Priority lanes must be set before begin()");
+        return false;
+    }
+    if (count == 0 || count > MAX_PRIORITY_LANES) {
+        POSTQUEUE_LOG_ERROR("Invalid priority lane count");
+        return false;
+    }
+    _laneCount = count;
+    _laneScheduling = scheduling;
+    return true;
+}
+
+void PostQueue::setLaneLimit(uint8_t lane, size_t maxItems) {
+    if (_running || lane >= MAX_PRIORITY_LANES) {
+        POSTQUEUE_LOG_WARN("Lane limits must be set before begin()");
+        return;
+    }
+    _lanes[lane].limit = maxItems;
+}
+
+void PostQueue::setLaneWeight(uint8_t lane, uint8_t weight) {
+    if (lane >= MAX_PRIORITY_LANES) {
+        return;
+    }
+    portENTER_CRITICAL(&_statsMux);
+    _lanes[lane].weight = weight == 0 ? 1 : weight;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setStarvationLimit(uint32_t limit) {
+    _starvationLimit = limit;
+}
+
+bool PostQueue::getLaneStats(uint8_t lane, LaneStats& stats) {
+    if (lane >= _laneCount) {
+        return false;
+    }
+    stats.queued = laneItems(lane);
+    portENTER_CRITICAL(&_statsMux);
+    stats.enqueued = _lanes[lane].enqueued;
+    stats.rejected = _lanes[lane].rejected;
+    stats.evicted = _lanes[lane].evicted;
+    stats.decimated = _lanes[lane].decimated;
+    stats.dequeued = _lanes[lane].dequeued;
+    stats.maxWait = _lanes[lane].maxWait;
+    portEXIT_CRITICAL(&_statsMux);
+    return true;
+}
+
+size_t PostQueue::getQueueSize() {
+    return queuedItems();
+}
+
+bool PostQueue::isEmpty() {
+    return getQueueSize() == 0;
+}
+
+bool PostQueue::isFull(uint8_t priority) {
+    if (!_running) {
+        return false;
+    }
+    if (_arena != NULL && freeArenaSlots() == 0) {
+        return true;
+    }
+    uint8_t lane = laneFor(priority);
+    return laneItems(lane) >= laneLimit(lane);
+}
+
+void PostQueue::clear() {
+    PostItem* item;
+    while (takeItem(item)) {
+        freePostItem(item);
+    }
+    if (_records != NULL) {
+        xQueueReset(_records);
+    }
+    clearRetries();
+}
+
+bool PostQueue::spillPostItem(PostItem* item) {
+    // Bit 0 holds useSSL, bits 1-5 the header set, which keeps its id across reboots
+    // as long as sets are added in the same order, and bits 6-7 the payload encoding
+    uint8_t flags = (uint8_t)((item->encoding << 6) | (item->headerSet << 1) | (item->useSSL ? 1 : 0));
+    if (!_spill.append(item->url(), item->urlLength, item->jsonPayload(), item->payloadLength,
+                       item->customHeaders(), item->headersLength, flags, item->headerCount)) {
+        POSTQUEUE_LOG_WARN("Spill log is full");
+        return false;
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    _spilledItems++;
+    portEXIT_CRITICAL(&_statsMux);
+    return true;
+}
+
+bool PostQueue::enableSpill(fs::FS& fs, const char* directory, size_t maxBytes) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Spilling must be configured before begin()");
+        return false;
+    }
+    _spillFs = &fs;
+    _spillDirectory = directory;
+    _spillMaxBytes = maxBytes;
+    return true;
+}
+
+void PostQueue::clearSpill() {
+    if (_spillLock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(_spillLock, portMAX_DELAY);
+    _spill.clear();
+    xSemaphoreGive(_spillLock);
+}
+
+void PostQueue::getSpillStats(size_t& pendingBytes, uint32_t& spilled, uint32_t& corrupted) {
+    pendingBytes = 0;
+    corrupted = 0;
+    if (_spillLock != NULL) {
+        xSemaphoreTake(_spillLock, portMAX_DELAY);
+        pendingBytes = _spill.pendingBytes();
+        corrupted = _spill.corruptedRecords();
+        xSemaphoreGive(_spillLock);
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    spilled = _spilledItems;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setTimeout(uint32_t timeout) {
+    _httpTimeout = timeout;
+}
+
+void PostQueue::setMaxRedirects(uint8_t maxRedirects) {
+    _maxRedirects = maxRedirects;
+}
+
+void PostQueue::setPacing(uint32_t interval) {
+    _pacingInterval = interval;
+}
+
+void PostQueue::setBatching(uint8_t maxItems, size_t maxBytes, uint32_t maxLinger) {
+    _batchMaxItems = maxItems > MAX_BATCH_ITEMS ? MAX_BATCH_ITEMS : maxItems;
+    _batchMaxBytes = maxBytes;
+    _batchLinger = maxLinger;
+}
+
+void PostQueue::getBatchStats(uint32_t& batchesSent, uint32_t& itemsBatched) {
+    portENTER_CRITICAL(&_statsMux);
+    batchesSent = _batchesSent;
+    itemsBatched = _itemsBatched;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setRetry(uint8_t maxAttempts, uint32_t baseDelay, uint32_t maxDelay, uint8_t jitter) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Retries must be set before begin()");
+        return;
+    }
+    _retryMaxAttempts = maxAttempts == 0 ? 1 : (maxAttempts > MAX_RETRY_ATTEMPTS ? MAX_RETRY_ATTEMPTS : maxAttempts);
+    _retryBaseDelay = baseDelay;
+    _retryMaxDelay = maxDelay < baseDelay ? baseDelay : maxDelay;
+    _retryJitter = jitter > 100 ? 100 : jitter;
+}
+
+void PostQueue::setRetryBudget(uint8_t percent, uint8_t burst) {
+    portENTER_CRITICAL(&_statsMux);
+    _retryBudgetPercent = percent;
+    _retryBudgetBurst = burst;
+    if (_retryTokens > (uint32_t)burst * 100) {
+        _retryTokens = (uint32_t)burst * 100;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setRetryQueueSize(size_t size) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Retry queue size must be set before begin()");
+        return;
+    }
+    _retryQueueSize = size == 0 ? 1 : size;
+}
+
+void PostQueue::getRetryStats(RetryStats& stats) {
+    stats.pending = 0;
+    if (_retryLock != NULL) {
+        xSemaphoreTake(_retryLock, portMAX_DELAY);
+        stats.pending = _retryCount;
+        xSemaphoreGive(_retryLock);
+    }
+
+    uint32_t successes = 0;
+    uint32_t attempts = 0;
+    portENTER_CRITICAL(&_statsMux);
+    stats.scheduled = _retriesScheduled;
+    stats.exhausted = _retriesExhausted;
+    stats.budgetDenied = _retriesBudgetDenied;
+    stats.overflowed = _retriesOverflowed;
+    for (uint8_t i = 0; i < MAX_RETRY_ATTEMPTS; i++) {
+        stats.succeededAfter[i] = _succeededAfter[i];
+        successes += _succeededAfter[i];
+        attempts += _succeededAfter[i] * (i + 1);
+    }
+    portEXIT_CRITICAL(&_statsMux);
+    stats.attemptsPerSuccess = successes > 0 ? (float)attempts / successes : 0.0f;
+}
+
+bool PostQueue::scheduleRetry(PostItem* item, int httpCode, uint32_t retryAfter) {
+    if (_retryItems == NULL || !_running || item->producer != NULL || !isRetryable(httpCode)) {
+        return false;
+    }
+    if (httpCode != 429 && httpCode != 503) {
+        retryAfter = 0;
+    }
+    if (item->attempts >= _retryMaxAttempts || retryAfter > MAX_RETRY_AFTER) {
+        portENTER_CRITICAL(&_statsMux);
+        _retriesExhausted++;
+        portEXIT_CRITICAL(&_statsMux);
+        return false;
+    }
+
+    // Spend one retry from the budget
+    portENTER_CRITICAL(&_statsMux);
+    bool allowed = _retryBudgetPercent == 0 || _retryTokens >= 100;
+    if (!allowed) {
+        _retriesBudgetDenied++;
+    } else if (_retryBudgetPercent > 0) {
+        _retryTokens -= 100;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+    if (!allowed) {
+        return false;
+    }
+
+    // Exponential backoff, capped, with part of it randomized so clients that
+    // failed together do not retry together
+    uint32_t delay = _retryBaseDelay;
+    for (uint8_t i = 1; i < item->attempts && delay < _retryMaxDelay; i++) {
+        delay *= 2;
+    }
+    if (delay > _retryMaxDelay) {
+        delay = _retryMaxDelay;
+    }
+    uint32_t spread = (uint32_t)((uint64_t)delay * _retryJitter / 100);
+    if (spread > 0) {
+        delay -= (uint32_t)random((long)spread + 1);
+    }
+    if (retryAfter > delay) {
+        delay = retryAfter;
+    }
+    item->retryAt = millis() + delay;
+
+    // Keep the retry queue ordered by due time
+    xSemaphoreTake(_retryLock, portMAX_DELAY);
+    bool queued = _retryCount < _retryQueueSize;
+    if (queued) {
+        size_t position = _retryCount;
+        while (position > 0 && (int32_t)(_retryItems[position - 1]->retryAt - item->retryAt) > 0) {
+            _retryItems[position] = _retryItems[position - 1];
+            position--;
+        }
+        _retryItems[position] = item;
+        _retryCount++;
+    }
+    xSemaphoreGive(_retryLock);
+
+    portENTER_CRITICAL(&_statsMux);
+    if (queued) {
+        _retriesScheduled++;
+    } else {
+        _retriesOverflowed++;
+        if (_retryBudgetPercent > 0) {
+            _retryTokens += 100; // Refund the unused retry
+        }
+    }
+    portEXIT_CRITICAL(&_statsMux);
+
+    if (queued) {
+        POSTQUEUE_LOG_INFO("Retrying in %lu ms (attempt %u of %u)", (unsigned long)delay,
+                           (unsigned)item->attempts + 1, (unsigned)_retryMaxAttempts);
+    }
+    return queued;
+}
+
+void PostQueue::creditRetryBudget(size_t count) {
+    if (_retryItems == NULL || _retryBudgetPercent == 0 || count == 0) {
+        return;
+    }
+    uint32_t cap = (uint32_t)_retryBudgetBurst * 100;
+    portENTER_CRITICAL(&_statsMux);
+    _retryTokens += (uint32_t)(count * _retryBudgetPercent);
+    if (_retryTokens > cap) {
+        _retryTokens = cap;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+TickType_t PostQueue::promoteRetries() {
+    if (_retryItems == NULL) {
+        return portMAX_DELAY;
+    }
+
+    TickType_t wait = portMAX_DELAY;
+    xSemaphoreTake(_retryLock, portMAX_DELAY);
+    uint32_t now = millis();
+    size_t promoted = 0;
+    while (promoted < _retryCount) {
+        PostItem* item = _retryItems[promoted];
+        int32_t remaining = (int32_t)(item->retryAt - now);
+        if (remaining > 0) {
+            wait = pdMS_TO_TICKS(remaining);
+            break;
+        }
+        // Back of its lane like a fresh post; a full lane keeps it here a little longer
+        item->timestamp = now;
+        item->queuedAt = micros();
+        if (!tryReserveSlot(item->priority)) {
+            wait = 1;
+            break;
+        }
+        if (!pushItem(item)) {
+            releaseSlot(item->priority);
+            wait = 1;
+            break;
+        }
+        promoted++;
+    }
+    if (promoted > 0) {
+        _retryCount -= promoted;
+        memmove(_retryItems, _retryItems + promoted, _retryCount * sizeof(PostItem*));
+    }
+    xSemaphoreGive(_retryLock);
+    return wait;
+}
+
+void PostQueue::clearRetries() {
+    if (_retryItems == NULL || _retryLock == NULL) {
+        return;
+    }
+    xSemaphoreTake(_retryLock, portMAX_DELAY);
+    for (size_t i = 0; i < _retryCount; i++) {
+        freePostItem(_retryItems[i]);
+    }
+    _retryCount = 0;
+    xSemaphoreGive(_retryLock);
+}
+
+void PostQueue::setCallback(PostCallback callback) {
+    _callback = callback;
+}
+
+void PostQueue::setResponseMode(ResponseMode mode, size_t captureLimit) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Response mode must be set before begin()");
+        return;
+    }
+    _responseMode = mode;
+    _responseCaptureLimit = captureLimit;
+}
+
+void PostQueue::setResponseChunkCallback(ResponseChunkCallback callback) {
+    _responseChunkCallback = callback;
+}
+
+void PostQueue::setSSLVerification(bool verify) {
+    _verifySSL = verify;
+}
+
+void PostQueue::getStats(uint32_t& totalProcessed, uint32_t& totalSuccessful, uint32_t& totalFailed) {
+    portENTER_CRITICAL(&_statsMux);
+    totalProcessed = (uint32_t)_totalProcessed;
+    totalSuccessful = (uint32_t)_totalSuccessful;
+    totalFailed = (uint32_t)_totalFailed;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::getStatsSnapshot(StatsSnapshot& snapshot) {
+    portENTER_CRITICAL(&_statsMux);
+    snapshot.processed = _totalProcessed;
+    snapshot.successful = _totalSuccessful;
+    snapshot.failed = _totalFailed;
+    snapshot.queueWait = _queueWaitLatency;
+    snapshot.connect = _connectLatency;
+    snapshot.firstByte = _firstByteLatency;
+    snapshot.total = _totalLatency;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::resetStats() {
+    portENTER_CRITICAL(&_statsMux);
+    _totalProcessed = 0;
+    _totalSuccessful = 0;
+    _totalFailed = 0;
+    _queueWaitLatency.reset();
+    _connectLatency.reset();
+    _firstByteLatency.reset();
+    _totalLatency.reset();
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+bool PostQueue::setArena(size_t bytesPerSlot) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Arena must be configured before begin()");
+        return false;
+    }
+    // Keep every slot aligned for the item header
+    _arenaSlotSize = (bytesPerSlot + 3) & ~(size_t)3;
+    return true;
+}
+
+bool PostQueue::setArenaBudget(size_t totalBytes) {
+    size_t retrySlots = _retryMaxAttempts > 1 ? _retryQueueSize : 0;
+    return setArena((totalBytes / (queueCapacity() + _workerCount * _maxInFlight * _pipelineDepth + retrySlots)) & ~(size_t)3);
+}
+
+size_t PostQueue::getArenaSlotCapacity(uint8_t headerFields) {
+    // Same layout as measurePostItem(): header, field table, three NUL-terminated strings
+    size_t overhead = sizeof(PostItem) + headerFields * sizeof(HeaderField) + 3;
+    if (_arenaSlotSize <= overhead) {
+        return 0;
+    }
+    return _arenaSlotSize - overhead;
+}
+
+void PostQueue::setConnectionPool(uint8_t maxConnections, uint32_t idleTimeout) {
+    _maxPooledConnections = maxConnections > MAX_POOLED_CONNECTIONS ? MAX_POOLED_CONNECTIONS : maxConnections;
+    _connectionIdleTimeout = idleTimeout;
+}
+
+void PostQueue::getConnectionStats(uint32_t& hits, uint32_t& misses) {
+    portENTER_CRITICAL(&_statsMux);
+    hits = _poolHits;
+    misses = _poolMisses;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setMaxInFlight(uint8_t count) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Requests in flight must be set before begin()");
+        return;
+    }
+    _maxInFlight = count == 0 ? 1 : (count > MAX_IN_FLIGHT ? MAX_IN_FLIGHT : count);
+}
+
+void PostQueue::setPipelining(uint8_t depth) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Pipelining must be set before begin()");
+        return;
+    }
+    _pipelineDepth = depth == 0 ? 1 : (depth > MAX_PIPELINE_DEPTH ? MAX_PIPELINE_DEPTH : depth);
+}
+
+void PostQueue::getPipelineStats(uint32_t& pipelined, uint32_t& resent) {
+    portENTER_CRITICAL(&_statsMux);
+    pipelined = _requestsPipelined;
+    resent = _pipelineResent;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setCompression(CompressionFormat format, size_t minSize) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Compression must be set before begin()");
+        return;
+    }
+    _compression = format;
+    _compressionMinSize = minSize;
+}
+
+void PostQueue::getCompressionStats(uint32_t& compressed, uint32_t& bytesIn, uint32_t& bytesOut) {
+    portENTER_CRITICAL(&_statsMux);
+    compressed = _itemsCompressed;
+    bytesIn = _compressionBytesIn;
+    bytesOut = _compressionBytesOut;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::setEncoding(PayloadEncoding encoding) {
+    if (_running) {
+        POSTQUEUE_LOG_WARN("Encoding must be set before begin()");
+        return;
+    }
+    if (encoding == ENCODING_DEFAULT) {
+        encoding = ENCODING_JSON;
+    }
+    _encoding = encoding;
+}
+
+void PostQueue::workerTask(void* parameter) {
+    PostQueue* queue = static_cast<PostQueue*>(parameter);
+
+    POSTQUEUE_LOG_INFO("Worker task started");
+
+    if ((queue->_maxInFlight > 1 || queue->_pipelineDepth > 1) && queue->_batchMaxItems == 0) {
+        queue->inFlightWorkerLoop();
+    } else {
+        queue->workerLoop();
+    }
+
+    POSTQUEUE_LOG_INFO("Worker task stopped");
+
+    // Tell end() this worker exited on its own so it is not force-deleted
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&queue->_statsMux);
+    for (uint8_t i = 0; i < MAX_WORKERS; i++) {
+        if (queue->_taskHandles[i] == self) {
+            queue->_taskHandles[i] = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&queue->_statsMux);
+
+    xTaskNotifyGive(queue->_stopNotifyTask);
+    vTaskDelete(NULL);
+}
+
+void PostQueue::workerLoop() {
+    PostItem* carried = NULL;
+    TickType_t wait = portMAX_DELAY;
+
+    while (true) {
+        // Take the item left over from the last batch, or block until one arrives,
+        // waking early only to close idle pooled connections or drain spilled requests
+        PostItem* item = carried;
+        carried = NULL;
+        if (item == NULL) {
+            if (!waitForItem(item, wait)) {
+                drainSpill();
+                wait = maintain();
+                continue;
+            }
+            if (item == NULL) {
+                break; // end() is stopping the workers
+            }
+        }
+
+        waitForPacingSlot();
+        if (_batchMaxItems > 0 && item->producer == NULL && item->encoding == ENCODING_JSON) {
+            carried = processBatch(item);
+        } else {
+            POSTQUEUE_LOG_DEBUG("Processing item");
+            if (!processPostItem(item)) {
+                freePostItem(item);
+            }
+        }
+
+        // The wake marker is lost when postFromISR() finds the item queue full, so
+        // pick up records here too
+        if (_records != NULL && uxQueueMessagesWaiting(_records) > 0) {
+            drainRecords();
+        }
+
+        wait = maintain();
+    }
+}
+
+void PostQueue::inFlightWorkerLoop() {
+    uint8_t requestCount = _maxInFlight * _pipelineDepth;
+    InFlightConnection* connections = new (std::nothrow) InFlightConnection[_maxInFlight];
+    InFlightRequest* requests = new (std::nothrow) InFlightRequest[requestCount];
+    if (connections == NULL || requests == NULL) {
+        POSTQUEUE_LOG_WARN("Failed to allocate in-flight requests, sending one at a time");
+        delete[] connections;
+        delete[] requests;
+        workerLoop();
+        return;
+    }
+
+    uint8_t inFlight = 0;
+    bool stopping = false;
+    PostItem* held = NULL;
+    TickType_t wait = portMAX_DELAY;
+
+    // Once end() is stopping the workers, take nothing new but finish what is in flight
+    while (!stopping || inFlight > 0 || held != NULL) {
+        bool progressed = false;
+
+        // Fill free slots without waiting; block for an item only when nothing is in flight
+        while (inFlight < requestCount) {
+            PostItem* item = held;
+            held = NULL;
+            if (item == NULL) {
+                if (stopping) {
+                    break;
+                }
+                if (!waitForItem(item, inFlight == 0 ? wait : 0)) {
+                    if (inFlight == 0) {
+                        drainSpill();
+                    }
+                    break;
+                }
+                if (item == NULL) {
+                    stopping = true;
+                    break;
+                }
+
+                progressed = true;
+                waitForPacingSlot();
+                if (item->producer != NULL) {
+                    // Streamed bodies are pulled from their producer while they are sent
+                    if (!processPostItem(item)) {
+                        freePostItem(item);
+                    }
+                    continue;
+                }
+            }
+
+            // Keep the item until a connection is idle or can take it behind its requests
+            InFlightConnection* connection = chooseConnection(connections, item);
+            if (connection == NULL) {
+                held = item;
+                break;
+            }
+
+            InFlightRequest* request = requests;
+            while (request->item != NULL) {
+                request++;
+            }
+            request->item = item;
+            request->sent = false;
+            request->next = NULL;
+            if (connection->head == NULL) {
+                connection->head = request;
+            } else {
+                connection->tail->next = request;
+            }
+            connection->tail = request;
+            connection->depth++;
+            inFlight++;
+
+            if (++item->attempts == 1) {
+                creditRetryBudget(1);
+            }
+        }
+
+        // Write new requests, collect whatever has arrived and complete the requests that are done
+        for (uint8_t i = 0; i < _maxInFlight; i++) {
+            InFlightConnection& connection = connections[i];
+            if (connection.head == NULL) {
+                continue;
+            }
+            int httpCode = sendRequests(connection);
+            if (httpCode == 0) {
+                InFlightRequest& polled = *connection.head;
+                httpCode = pollResponse(*connection.client, polled.parser, connection.received, connection.lastData);
+                if (!polled.answered && polled.parser.statusCode() != 0) {
+                    polled.answered = true;
+                    recordLatency(_firstByteLatency, micros() - polled.sentAt);
+                }
+            }
+            if (httpCode == 0) {
+                continue;
+            }
+
+            progressed = true;
+            InFlightRequest* head = connection.head;
+            if (httpCode < 0 && httpCode != HTTPC_ERROR_READ_TIMEOUT && head->pipelined &&
+                head->parser.statusCode() == 0) {
+                // Closed before answering a request written behind others: not an attempt
+                resendUnanswered(connection, head);
+                continue;
+            }
+            finishRequest(connection, httpCode);
+            inFlight--;
+        }
+        if (inFlight > 0 && !progressed) {
+            vTaskDelay(1);
+        }
+
+        // The wake marker is lost when postFromISR() finds the item queue full, so
+        // pick up records here too
+        if (_records != NULL && uxQueueMessagesWaiting(_records) > 0) {
+            drainRecords();
+        }
+
+        wait = maintain();
+    }
+
+    delete[] requests;
+    delete[] connections;
+}
+
+TickType_t PostQueue::maintain() {
+    TickType_t wait = evictIdleConnections();
+    TickType_t spillWait = this->spillWait();
+    if (spillWait < wait) {
+        wait = spillWait;
+    }
+    TickType_t retryWait = promoteRetries();
+    if (retryWait < wait) {
+        wait = retryWait;
+    }
+    return wait;
+}
+
+void PostQueue::waitForPacingSlot() {
+    if (_pacingInterval == 0) {
+        return;
+    }
+
+    // Reserve the next start slot so pacing holds across all workers
+    portENTER_CRITICAL(&_statsMux);
+    uint32_t now = millis();
+    int32_t delay = (int32_t)(_nextSendTime - now);
+    if (delay < 0) {
+        delay = 0;
+    }
+    _nextSendTime = now + delay + _pacingInterval;
+    portEXIT_CRITICAL(&_statsMux);
+
+    if (delay > 0) {
+        vTaskDelay(pdMS_TO_TICKS(delay));
+    }
+}
+
+bool PostQueue::processPostItem(PostItem* item) {
+    if (item == NULL) {
+        return false;
+    }
+
+    if (++item->attempts == 1) {
+        creditRetryBudget(1);
+    }
+
+    int httpCode = 0;
+    String response = "";
+    uint32_t retryAfter = 0;
+    bool success = sendPostItem(item, httpCode, response, retryAfter);
+    return finishAttempt(item, success, httpCode, response, retryAfter);
+}
+
+bool PostQueue::finishAttempt(PostItem* item, bool success, int httpCode, const String& response,
+                              uint32_t retryAfter) {
+    if (!success && scheduleRetry(item, httpCode, retryAfter)) {
+        return true;
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    _totalProcessed++;
+    portEXIT_CRITICAL(&_statsMux);
+    completePostItem(success, httpCode, response, item->attempts);
+    return false;
+}
+
+void PostQueue::collectResponse(const uint8_t* data, size_t length, void* context) {
+    ResponseCollector* collector = static_cast<ResponseCollector*>(context);
+    PostQueue* queue = collector->queue;
+
+    if (queue->_responseMode == RESPONSE_CAPTURE) {
+        size_t limit = queue->_responseCaptureLimit;
+        size_t captured = collector->response->length();
+        if (limit > 0) {
+            length = (captured >= limit) ? 0 : (length < limit - captured ? length : limit - captured);
+        }
+        if (length > 0) {
+            collector->response->concat((const char*)data, length);
+        }
+    } else if (queue->_responseMode == RESPONSE_STREAM && queue->_responseChunkCallback != NULL) {
+        int httpCode = (collector->parser != NULL) ? collector->parser->statusCode() : collector->httpCode;
+        xSemaphoreTake(queue->_callbackLock, portMAX_DELAY);
+        queue->_responseChunkCallback(httpCode, data, length);
+        xSemaphoreGive(queue->_callbackLock);
+    }
+    // RESPONSE_DISCARD: the bytes were read off the connection; nothing to keep
+}
+
+void PostQueue::beginResponse(ResponseCollector& collector, HttpResponseParser& parser, String& response) {
+    collector.queue = this;
+    collector.response = &response;
+    collector.parser = &parser;
+    if (_responseMode == RESPONSE_STATUS_ONLY) {
+        parser.reset(NULL, NULL, true);
+    } else if (_responseMode == RESPONSE_DISCARD) {
+        parser.reset();
+    } else {
+        parser.reset(collectResponse, &collector);
+    }
+}
+
+PostQueue::InFlightConnection* PostQueue::chooseConnection(InFlightConnection* connections, const PostItem* item) {
+    InFlightConnection* pipeline = NULL;
+    for (uint8_t i = 0; i < _maxInFlight; i++) {
+        InFlightConnection& connection = connections[i];
+        if (connection.head == NULL) {
+            return &connection; // Idle connections first, so requests also run in parallel
+        }
+
+        // Pipelining needs a pooled connection that has carried every earlier request
+        // and whose server has not refused it, and responses that are read to the end
+        if (pipeline == NULL && _responseMode != RESPONSE_STATUS_ONLY &&
+            connection.depth < _pipelineDepth && connection.conn != NULL &&
+            !connection.conn->noPipelining && connection.tail->sent &&
+            sameEndpoint(connection.head->item, item)) {
+            pipeline = &connection;
+        }
+    }
+    return pipeline;
+}
+
+int PostQueue::sendRequests(InFlightConnection& connection) {
+    for (InFlightRequest* request = connection.head; request != NULL; request = request->next) {
+        if (request->sent) {
+            continue;
+        }
+        if (request != connection.head && (connection.conn == NULL || connection.conn->noPipelining)) {
+            break; // Waits until the requests ahead of it are answered
+        }
+
+        int httpCode = writeRequest(connection, *request);
+        if (httpCode != 0) {
+            // A request behind others is sent again once it reaches the head
+            return request == connection.head ? httpCode : 0;
+        }
+    }
+    return 0;
+}
+
+int PostQueue::writeRequest(InFlightConnection& connection, InFlightRequest& request) {
+    PostItem* item = request.item;
+    bool head = (&request == connection.head);
+    request.startedAt = micros();
+
+    POSTQUEUE_LOG_DEBUG("Sending POST to %s", item->url());
+
+    UrlParts url;
+    if (!parseUrl(item->url(), item->useSSL, url)) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    if (connection.client == NULL) {
+        connection.conn = acquireConnection(item->url(), item->useSSL);
+        if (connection.conn != NULL) {
+            connection.client = connection.conn->client;
+        } else if (item->useSSL) {
+            if (!_verifySSL) {
+                connection.oneShotSecureClient.setInsecure(); // Skip SSL verification
+            }
+            connection.client = &connection.oneShotSecureClient;
+        } else {
+            connection.client = &connection.oneShotClient;
+        }
+    }
+
+    WiFiClient* client = connection.client;
+    if (!client->connected()) {
+        if (!head) {
+            return HTTPC_ERROR_CONNECTION_LOST; // Only goes on the connection of the requests ahead
+        }
+        connection.received.start = connection.received.end = 0;
+        if (!connectClient(*client, url)) {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+    }
+    request.sentAt = micros();
+
+    // Compressed and empty bodies are announced as chunked
+    DeflateEncoder* encoder = shouldCompress(item->payloadLength) ? acquireEncoder() : NULL;
+    size_t contentLength = (encoder != NULL) ? 0 : item->payloadLength;
+    int error = HTTPC_ERROR_SEND_HEADER_FAILED;
+    if (writeRequestHead(*client, url, item, contentLength, encoder != NULL)) {
+        error = writeRequestBody(*client, item, (const uint8_t*)item->jsonPayload(), item->payloadLength,
+                                 contentLength == 0, encoder);
+    }
+    releaseEncoder(encoder);
+    if (error != 0) {
+        return error;
+    }
+
+    request.sent = true;
+    request.pipelined = !head;
+    request.answered = false;
+    request.response = "";
+    beginResponse(request.collector, request.parser, request.response);
+    if (head) {
+        connection.lastData = millis();
+    } else {
+        portENTER_CRITICAL(&_statsMux);
+        _requestsPipelined++;
+        portEXIT_CRITICAL(&_statsMux);
+    }
+    return 0;
+}
+
+void PostQueue::resendUnanswered(InFlightConnection& connection, InFlightRequest* from) {
+    connection.client->stop();
+    connection.received.start = connection.received.end = 0;
+    if (connection.conn != NULL) {
+        connection.conn->noPipelining = true; // Send one request at a time to this server from now on
+    }
+
+    uint32_t resent = 0;
+    for (InFlightRequest* request = from; request != NULL; request = request->next) {
+        if (request->sent) {
+            request->sent = false;
+            resent++;
+        }
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    _pipelineResent += resent;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PostQueue::finishRequest(InFlightConnection& connection, int httpCode) {
+    InFlightRequest* request = connection.head;
+    connection.head = request->next;
+    connection.depth--;
+    PostItem* item = request->item;
+    request->item = NULL;
+    request->next = NULL;
+    recordLatency(_totalLatency, micros() - request->startedAt);
+
+    bool success = (httpCode >= 200 && httpCode < 300);
+    uint32_t retryAfter = 0;
+    bool closed = true;
+    if (httpCode < 0) {
+        POSTQUEUE_LOG_WARN("HTTP error: %s", HTTPClient::errorToString(httpCode).c_str());
+    } else {
+        retryAfter = request->parser.retryAfter() * 1000;
+        closed = !request->parser.keepAlive();
+    }
+
+    if (connection.head == NULL) {
+        if (closed) {
+            connection.client->stop();
+        }
+        if (connection.conn != NULL) {
+            releaseConnection(connection.conn);
+            connection.conn = NULL;
+        } else {
+            connection.client->stop();
+        }
+        connection.client = NULL;
+        connection.tail = NULL;
+        connection.received.start = connection.received.end = 0;
+    } else if (closed) {
+        // The requests written behind this one will get no answer on this connection
+        resendUnanswered(connection, connection.head);
+    } else {
+        connection.lastData = millis(); // The next response is due from now
+    }
+    logPostResult(success, httpCode);
+
+    if (httpCode >= 300 && httpCode < 400 && _maxRedirects > 0 && !shouldCompress(item->payloadLength)) {
+        // Let HTTPClient follow the redirect, as when sending one at a time
+        request->response = "";
+        success = sendPostItem(item, httpCode, request->response, retryAfter);
+    }
+
+    if (!finishAttempt(item, success, httpCode, request->response, retryAfter)) {
+        freePostItem(item);
+    }
+}
+
+bool PostQueue::sendPostItem(PostItem* item, int& httpCode, String& response, uint32_t& retryAfter) {
+    POSTQUEUE_LOG_DEBUG("Sending POST to %s", item->url());
+
+    uint32_t start = micros();
+    bool success;
+    if (item->producer != NULL) {
+        success = performRawPost(item, NULL, 0, httpCode, response, retryAfter);
+    } else if (shouldCompress(item->payloadLength)) {
+        success = performRawPost(item, (const uint8_t*)item->jsonPayload(), item->payloadLength,
+                                 httpCode, response, retryAfter);
+    } else {
+        success = performPost(item, item->jsonPayload(), item->payloadLength, httpCode, response, retryAfter);
+    }
+    recordLatency(_totalLatency, micros() - start);
+
+    logPostResult(success, httpCode);
+    return success;
+}
+
+void PostQueue::logPostResult(bool success, int httpCode) {
+    if (success) {
+        POSTQUEUE_LOG_DEBUG("POST successful, HTTP code: %d", httpCode);
+    } else {
+        POSTQUEUE_LOG_WARN("POST failed, HTTP code: %d", httpCode);
+    }
+}
+
+void PostQueue::drainSpill() {
+    if (!_spill.isOpen() || queuedItems() > 0) {
+        return;
+    }
+
+    // Claim the oldest record; only one worker drains at a time to keep the order
+    xSemaphoreTake(_spillLock, portMAX_DELAY);
+    if (_spillBusy || (_spillBackoff && (int32_t)(_spillRetryTime - millis()) > 0)) {
+        xSemaphoreGive(_spillLock);
+        return;
+    }
+    _spillBackoff = false;
+
+    SpillRecordHeader header;
+    PostItem* item = NULL;
+    while (item == NULL && _spill.peek(header)) {
+        size_t size = sizeof(PostItem) + header.headerCount * sizeof(HeaderField) +
+                      header.urlLength + header.payloadLength + header.headersLength + 3;
+        item = allocPostItem(size);
+        if (item == NULL) {
+            break; // Try again once memory frees up
+        }
+
+        item->urlLength = header.urlLength;
+        item->headersLength = header.headersLength;
+        item->payloadLength = header.payloadLength;
+        item->useSSL = (header.flags & 1) != 0;
+        item->headerCount = header.headerCount;
+        item->headerSet = (header.flags >> 1) & 0x1F;
+        item->priority = 0;
+        item->attempts = 0;
+        item->encoding = header.flags >> 6;
+        item->timestamp = millis();
+        item->queuedAt = micros();
+        item->producer = NULL;
+        item->producerContext = NULL;
+        item->contentLength = 0;
+        item->key = 0;
+        item->claimed = false;
+        item->refreshed = false;
+        item->superseded = false;
+
+        char* url = const_cast<char*>(item->url());
+        char* payload = item->jsonPayload();
+        char* headers = payload + header.payloadLength + 1;
+        size_t headersLength;
+        uint8_t headerCount;
+        bool intact = _spill.read(url, payload, headers);
+        if (intact) {
+            url[header.urlLength] = '\0';
+            payload[header.payloadLength] = '\0';
+            headers[header.headersLength] = '\0';
+
+            // The headers were stored normalized, so this only rebuilds the field table
+            intact = parseHeaders(headers, NULL, const_cast<HeaderField*>(item->headerFields()),
+                                  headersLength, headerCount) &&
+                     headerCount == header.headerCount && headersLength == header.headersLength;
+        }
+        if (!intact) {
+            POSTQUEUE_LOG_WARN("Skipping corrupted spilled request");
+            _spill.pop();
+            freePostItem(item);
+            item = NULL;
+            continue;
+        }
+
+        if (item->headerSet > _headerSetCount) {
+            POSTQUEUE_LOG_WARN("Spilled request references an unknown header set");
+            item->headerSet = 0;
+        }
+    }
+
+    if (item == NULL) {
+        xSemaphoreGive(_spillLock);
+        return;
+    }
+    _spillBusy = true;
+    xSemaphoreGive(_spillLock);
+
+    waitForPacingSlot();
+    POSTQUEUE_LOG_DEBUG("Processing spilled item");
+    int httpCode = 0;
+    String response = "";
+    uint32_t retryAfter = 0; // Spilled requests keep their own retry interval
+    bool success = sendPostItem(item, httpCode, response, retryAfter);
+    freePostItem(item);
+
+    // Keep the record on network errors; any HTTP response completes it
+    bool delivered = (httpCode >= 0);
+    xSemaphoreTake(_spillLock, portMAX_DELAY);
+    if (delivered) {
+        _spill.pop();
+    } else {
+        _spillBackoff = true;
+        _spillRetryTime = millis() + SPILL_RETRY_INTERVAL;
+    }
+    _spillBusy = false;
+    xSemaphoreGive(_spillLock);
+
+    if (delivered) {
+        portENTER_CRITICAL(&_statsMux);
+        _totalProcessed++;
+        portEXIT_CRITICAL(&_statsMux);
+        completePostItem(success, httpCode, response, 1);
+    }
+}
+
+TickType_t PostQueue::spillWait() {
+    if (!_spill.isOpen()) {
+        return portMAX_DELAY;
+    }
+
+    TickType_t wait = portMAX_DELAY;
+    xSemaphoreTake(_spillLock, portMAX_DELAY);
+    if (!_spillBusy && !_spill.isEmpty()) {
+        int32_t remaining = (int32_t)(_spillRetryTime - millis());
+        wait = (_spillBackoff && remaining > 0) ? pdMS_TO_TICKS(remaining) : 0;
+    }
+    xSemaphoreGive(_spillLock);
+    return wait;
+}
+
+void PostQueue::completePostItem(bool success, int httpCode, const String& response, uint8_t attempts) {
+    portENTER_CRITICAL(&_statsMux);
+    if (success) {
+        _totalSuccessful++;
+        if (attempts > 0 && attempts <= MAX_RETRY_ATTEMPTS) {
+            _succeededAfter[attempts - 1]++;
+        }
+    } else {
+        _totalFailed++;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+
+    // Call callback if set, one worker at a time
+    if (_callback != NULL) {
+        xSemaphoreTake(_callbackLock, portMAX_DELAY);
+        _callback(success, httpCode, response);
+        xSemaphoreGive(_callbackLock);
+    }
+}
+
+PostItem* PostQueue::processBatch(PostItem* first) {
+    PostItem* batch[MAX_BATCH_ITEMS];
+    size_t count = 0;
+    size_t bodyLength = first->payloadLength + 2; // "[" ... "]"
+    PostItem* carried = NULL;
+    uint32_t deadline = millis() + _batchLinger;
+
+    batch[count++] = first;
+
+    // Take following items while they target the same request; the first one that
+    // does not is carried to the next round so queue order is preserved
+    while (count < _batchMaxItems) {
+        PostItem* next;
+        int32_t remaining = (int32_t)(deadline - millis());
+        if (!waitForItem(next, remaining > 0 ? pdMS_TO_TICKS(remaining) : 0)) {
+            break;
+        }
+        if (next == NULL) {
+            break; // Stopping; the worker loop sees it on its next wait
+        }
+        if (!sameBatch(first, next) || bodyLength + next->payloadLength + 1 > _batchMaxBytes) {
+            carried = next;
+            break;
+        }
+
+        batch[count++] = next;
+        bodyLength += next->payloadLength + 1;
+    }
+
+    portENTER_CRITICAL(&_statsMux);
+    _batchesSent++;
+    _itemsBatched += count;
+    portEXIT_CRITICAL(&_statsMux);
+
+    size_t fresh = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (++batch[i]->attempts == 1) {
+            fresh++;
+        }
+    }
+    creditRetryBudget(fresh);
+
+    int httpCode = 0;
+    String response = "";
+    uint32_t retryAfter = 0;
+    bool success = false;
+
+    // Join the payloads into one JSON array
+    char* body = (char*)malloc(bodyLength + 1);
+    if (body != NULL) {
+        char* cursor = body;
+        *cursor++ = '[';
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) {
+                *cursor++ = ',';
+            }
+            memcpy(cursor, batch[i]->jsonPayload(), batch[i]->payloadLength);
+            cursor += batch[i]->payloadLength;
+        }
+        *cursor++ = ']';
+        *cursor = '\0';
+
+        POSTQUEUE_LOG_DEBUG("Sending batch of %u items to %s", (unsigned)count, first->url());
+        uint32_t start = micros();
+        if (shouldCompress(bodyLength)) {
+            success = performRawPost(first, (const uint8_t*)body, bodyLength, httpCode, response, retryAfter);
+        } else {
+            success = performPost(first, body, bodyLength, httpCode, response, retryAfter);
+        }
+        recordLatency(_totalLatency, micros() - start);
+        free(body);
+    } else {
+        POSTQUEUE_LOG_ERROR("Failed to allocate batch body");
+        httpCode = HTTPC_ERROR_TOO_LESS_RAM;
+    }
+
+    if (success) {
+        POSTQUEUE_LOG_DEBUG("Batch successful, HTTP code: %d", httpCode);
+    } else {
+        POSTQUEUE_LOG_WARN("Batch failed, HTTP code: %d", httpCode);
+    }
+
+    // Fan the batch result out to every item; failed items are retried one by one
+    // and may be batched again with whatever is queued by then
+    for (size_t i = 0; i < count; i++) {
+        if (!success && scheduleRetry(batch[i], httpCode, retryAfter)) {
+            continue;
+        }
+        portENTER_CRITICAL(&_statsMux);
+        _totalProcessed++;
+        portEXIT_CRITICAL(&_statsMux);
+        completePostItem(success, httpCode, response, batch[i]->attempts);
+        freePostItem(batch[i]);
+    }
+
+    return carried;
+}
+
+bool PostQueue::sameBatch(const PostItem* first, const PostItem* item) {
+    if (item->producer != NULL || item->encoding != first->encoding || item->useSSL != first->useSSL ||
+        item->headerSet != first->headerSet ||
+        item->priority != first->priority ||
+        item->urlLength != first->urlLength || item->headersLength != first->headersLength) {
+        return false;
+    }
+    if (strcmp(item->url(), first->url()) != 0) {
+        return false;
+    }
+    return first->headersLength == 0 || strcmp(item->customHeaders(), first->customHeaders()) == 0;
+}
+
+bool PostQueue::performPost(const PostItem* item, const char* payload, size_t payloadLength,
+                            int& httpCode, String& response, uint32_t& retryAfter) {
+    bool useSSL = item->useSSL;
+    PooledConnection* conn = acquireConnection(item->url(), useSSL);
+    if (conn == NULL) {
+        // Pooling disabled or every slot busy: use a one-shot connection
+        HTTPClient http;
+        WiFiClient client;
+        WiFiClientSecure secureClient;
+
+        if (useSSL && !_verifySSL) {
+            secureClient.setInsecure(); // Skip SSL verification
+        }
+        http.setReuse(false);
+        return sendPost(http, useSSL ? secureClient : client, item, payload, payloadLength,
+                        httpCode, response, retryAfter);
+    }
+
+    bool success = sendPost(*conn->http, *conn->client, item, payload, payloadLength,
+                            httpCode, response, retryAfter);
+    releaseConnection(conn);
+    return success;
+}
+
+bool PostQueue::performRawPost(PostItem* item, const uint8_t* body, size_t bodyLength,
+                               int& httpCode, String& response, uint32_t& retryAfter) {
+    UrlParts url;
+    if (!parseUrl(item->url(), item->useSSL, url)) {
+        httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+        return false;
+    }
+
+    PooledConnection* conn = acquireConnection(item->url(), item->useSSL);
+    if (conn == NULL) {
+        // Pooling disabled or every slot busy: use a one-shot connection
+        WiFiClient client;
+        WiFiClientSecure secureClient;
+
+        if (item->useSSL && !_verifySSL) {
+            secureClient.setInsecure(); // Skip SSL verification
+        }
+        WiFiClient& oneShot = item->useSSL ? secureClient : client;
+        bool success = sendRawPost(oneShot, url, item, body, bodyLength, httpCode, response, retryAfter);
+        oneShot.stop();
+        return success;
+    }
+
+    bool success = sendRawPost(*conn->client, url, item, body, bodyLength, httpCode, response, retryAfter);
+    releaseConnection(conn);
+    return success;
+}
+
+bool PostQueue::sendRawPost(WiFiClient& client, const UrlParts& url, PostItem* item, const uint8_t* body,
+                            size_t bodyLength, int& httpCode, String& response, uint32_t& retryAfter) {
+    bool success = false;
+    httpCode = 0;
+
+    if (!client.connected() && !connectClient(client, url)) {
+        httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    uint32_t sentAt = micros();
+
+    // Streams of unknown length are chunked anyway, so they are always worth compressing
+    size_t length = (body != NULL) ? bodyLength : (item->contentLength > 0 ? item->contentLength : (size_t)-1);
+    DeflateEncoder* encoder = (httpCode == 0 && shouldCompress(length)) ? acquireEncoder() : NULL;
+    size_t contentLength = (encoder != NULL) ? 0 : (body != NULL ? bodyLength : item->contentLength);
+    if (httpCode == 0 && !writeRequestHead(client, url, item, contentLength, encoder != NULL)) {
+        httpCode = HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (httpCode == 0) {
+        httpCode = writeRequestBody(client, item, body, bodyLength, contentLength == 0, encoder);
+    }
+    releaseEncoder(encoder);
+
+    if (httpCode == 0) {
+        HttpResponseParser parser;
+        ResponseCollector collector;
+        beginResponse(collector, parser, response);
+        httpCode = readResponse(client, parser, sentAt);
+        success = (httpCode >= 200 && httpCode < 300);
+        retryAfter = parser.retryAfter() * 1000;
+        if (!parser.keepAlive()) {
+            client.stop();
+        }
+    } else {
+        POSTQUEUE_LOG_WARN("HTTP error: %s", HTTPClient::errorToString(httpCode).c_str());
+        client.stop();
+    }
+    return success;
+}
+
+bool PostQueue::writeRequestHead(Client& client, const UrlParts& url, const PostItem* item,
+                                 size_t contentLength, bool compressed) {
+    const HeaderSet* set = (item->headerSet > 0) ? _headerSets[item->headerSet - 1] : NULL;
+    String head;
+    head.reserve(128 + url.hostLength + strlen(url.path) + item->headersLength + (set ? set->length : 0));
+
+    head += "POST ";
+    if (url.path[0] != '/') {
+        head += "/";
+    }
+    head += url.path;
+    head += " HTTP/1.1\r\nHost: ";
+    head.concat(url.host, url.hostLength);
+    if (url.port != (item->useSSL ? 443 : 80)) {
+        head += ":";
+        head += String((unsigned int)url.port);
+    }
+    head += "\r\nConnection: keep-alive\r\nContent-Type: ";
+    head += contentType(item);
+    head += "\r\n";
+    if (contentLength > 0) {
+        head += "Content-Length: ";
+        head += String((unsigned long)contentLength);
+        head += "\r\n";
+    } else {
+        head += "Transfer-Encoding: chunked\r\n";
+    }
+    if (compressed) {
+        head += (_compression == COMPRESSION_GZIP) ? "Content-Encoding: gzip\r\n" : "Content-Encoding: deflate\r\n";
+    }
+
+    // Header blocks are stored as ready-to-send "Name: Value\r\n" lines
+    if (set != NULL) {
+        head.concat(set->headers(), set->length);
+    }
+    if (item->headersLength > 0) {
+        head.concat(item->customHeaders(), item->headersLength);
+    }
+    head += "\r\n";
+
+    return client.write((const uint8_t*)head.c_str(), head.length()) == head.length();
+}
+
+int PostQueue::writeRequestBody(Client& client, PostItem* item, const uint8_t* body, size_t bodyLength,
+                                bool chunked, DeflateEncoder* encoder) {
+    if (encoder != NULL) {
+        encoder->begin(_compression == COMPRESSION_GZIP ? DEFLATE_FORMAT_GZIP : DEFLATE_FORMAT_ZLIB,
+                       writeChunk, &client);
+    }
+
+    // Take the body whole, or pull it from the producer and write it as it is produced
+    bool written;
+    if (body != NULL) {
+        written = writeBodyPart(client, body, bodyLength, chunked, encoder);
+    } else {
+        uint8_t buffer[STREAM_CHUNK_SIZE];
+        size_t produced;
+        written = true;
+        while (written && (produced = item->producer(buffer, sizeof(buffer), item->producerContext)) > 0) {
+            written = writeBodyPart(client, buffer, produced, chunked, encoder);
+        }
+    }
+    if (written && encoder != NULL) {
+        written = encoder->finish();
+    }
+    if (written && chunked) {
+        written = client.write((const uint8_t*)"0\r\n\r\n", 5) == 5;
+    }
+
+    if (encoder != NULL) {
+        portENTER_CRITICAL(&_statsMux);
+        _itemsCompressed++;
+        _compressionBytesIn += encoder->bytesIn();
+        _compressionBytesOut += encoder->bytesOut();
+        portEXIT_CRITICAL(&_statsMux);
+    }
+    return written ? 0 : HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+}
+
+bool PostQueue::writeBodyPart(Client& client, const uint8_t* data, size_t length, bool chunked,
+                              DeflateEncoder* encoder) {
+    if (encoder != NULL) {
+        return encoder->write(data, length);
+    }
+    if (chunked) {
+        return writeChunk(data, length, &client);
+    }
+    return client.write(data, length) == length;
+}
+
+bool PostQueue::writeChunk(const uint8_t* data, size_t length, void* context) {
+    Client* client = static_cast<Client*>(context);
+    if (length == 0) {
+        return true; // An empty chunk would end the body
+    }
+    char sizeLine[12];
+    int sizeLength = snprintf(sizeLine, sizeof(sizeLine), "%x\r\n", (unsigned)length);
+
+    // Compressed output arrives in small pieces; frame those in one write rather than three segments
+    if (length <= DEFLATE_OUTPUT_SIZE) {
+        uint8_t frame[sizeof(sizeLine) + DEFLATE_OUTPUT_SIZE + 2];
+        memcpy(frame, sizeLine, sizeLength);
+        memcpy(frame + sizeLength, data, length);
+        memcpy(frame + sizeLength + length, "\r\n", 2);
+        size_t frameLength = sizeLength + length + 2;
+        return client->write(frame, frameLength) == frameLength;
+    }
+    return client->write((const uint8_t*)sizeLine, sizeLength) == (size_t)sizeLength &&
+           client->write(data, length) == length &&
+           client->write((const uint8_t*)"\r\n", 2) == 2;
+}
+
+bool PostQueue::shouldCompress(size_t bodyLength) const {
+    return _compression != COMPRESSION_NONE && bodyLength >= _compressionMinSize;
+}
+
+bool PostQueue::connectClient(WiFiClient& client, const UrlParts& url) {
+    String host;
+    host.concat(url.host, url.hostLength);
+    uint32_t start = micros();
+    if (!client.connect(host.c_str(), url.port, _httpTimeout)) {
+        return false;
+    }
+    recordLatency(_connectLatency, micros() - start);
+    return true;
+}
+
+void PostQueue::recordLatency(LatencyHistogram& histogram, uint32_t duration) {
+    portENTER_CRITICAL(&_statsMux);
+    histogram.record(duration);
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+const char* PostQueue::contentType(const PostItem* item) {
+    switch (item->encoding) {
+        case ENCODING_MSGPACK:
+            return "application/msgpack";
+        case ENCODING_CBOR:
+            return "application/cbor";
+        default:
+            return "application/json";
+    }
+}
+
+DeflateEncoder* PostQueue::acquireEncoder() {
+    DeflateEncoder* encoder = NULL;
+    portENTER_CRITICAL(&_statsMux);
+    for (uint8_t i = 0; i < MAX_WORKERS && encoder == NULL; i++) {
+        if (_encoders[i] != NULL && (_encodersInUse & (1UL << i)) == 0) {
+            _encodersInUse |= 1UL << i;
+            encoder = _encoders[i];
+        }
+    }
+    portEXIT_CRITICAL(&_statsMux);
+    return encoder;
+}
+
+void PostQueue::releaseEncoder(DeflateEncoder* encoder) {
+    if (encoder == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&_statsMux);
+    for (uint8_t i = 0; i < MAX_WORKERS; i++) {
+        if (_encoders[i] == encoder) {
+            _encodersInUse &= ~(1UL << i);
+        }
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+int PostQueue::readResponse(Client& client, HttpResponseParser& parser, uint32_t sentAt) {
+    ReceiveBuffer received;
+    uint32_t lastData = millis();
+    bool answered = false;
+    while (true) {
+        int httpCode = pollResponse(client, parser, received, lastData);
+        if (!answered && parser.statusCode() != 0) {
+            answered = true;
+            recordLatency(_firstByteLatency, micros() - sentAt);
+        }
+        if (httpCode != 0) {
+            return httpCode;
+        }
+        vTaskDelay(1);
+    }
+}
+
+int PostQueue::pollResponse(Client& client, HttpResponseParser& parser, ReceiveBuffer& received,
+                            uint32_t& lastData) {
+    while (!parser.isComplete() && !parser.hasError()) {
+        // Bytes left over from the previous response on the connection come first
+        if (received.start < received.end) {
+            received.start += parser.feed(received.data + received.start, received.end - received.start);
+            continue;
+        }
+
+        int available = client.available();
+        if (available > 0) {
+            int count = client.read(received.data, available < (int)sizeof(received.data) ? available
+                                                                                          : sizeof(received.data));
+            if (count <= 0) {
+                return 0;
+            }
+            received.start = 0;
+            received.end = (uint8_t)count;
+            lastData = millis();
+        } else if (!client.connected()) {
+            parser.finish();
+        } else if (millis() - lastData >= _httpTimeout) {
+            return HTTPC_ERROR_READ_TIMEOUT;
+        } else {
+            return 0; // Nothing more has arrived yet
+        }
+    }
+
+    if (parser.hasError()) {
+        return parser.headersComplete() ? HTTPC_ERROR_CONNECTION_LOST : HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+    return parser.statusCode();
+}
+
+bool PostQueue::sameEndpoint(const PostItem* first, const PostItem* item) {
+    UrlParts a;
+    UrlParts b;
+    if (first->useSSL != item->useSSL || !parseUrl(first->url(), first->useSSL, a) ||
+        !parseUrl(item->url(), item->useSSL, b)) {
+        return false;
+    }
+    return a.port == b.port && a.hostLength == b.hostLength && strncmp(a.host, b.host, a.hostLength) == 0;
+}
+
+bool PostQueue::parseUrl(const char* url, bool useSSL, UrlParts& parts) {
+    const char* host = strstr(url, "://");
+    host = (host != NULL) ? host + 3 : url;
+    size_t authorityLength = strcspn(host, "/?");
+    const char* at = (const char*)memchr(host, '@', authorityLength);
+    if (at != NULL) {
+        host = at + 1;
+    }
+
+    parts.host = host;
+    parts.hostLength = strcspn(host, ":/?");
+    parts.port = useSSL ? 443 : 80;
+    if (host[parts.hostLength] == ':') {
+        parts.port = (uint16_t)atoi(host + parts.hostLength + 1);
+    }
+    parts.path = host + strcspn(host, "/?");
+
+    return parts.hostLength > 0;
+}
+
+bool PostQueue::sendPost(HTTPClient& http, WiFiClient& client, const PostItem* item, const char* payload,
+                         size_t payloadLength, int& httpCode, String& response, uint32_t& retryAfter) {
+    // Connect here rather than in POST() so the connect time can be told apart; HTTPClient
+    // takes over an open connection, and parses any URL this cannot itself
+    UrlParts url;
+    if (!client.connected() && parseUrl(item->url(), item->useSSL, url) && !connectClient(client, url)) {
+        httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+        POSTQUEUE_LOG_WARN("HTTP error: %s", HTTPClient::errorToString(httpCode).c_str());
+        return false;
+    }
+
+    http.begin(client, item->url());
+
+    // Set timeout
+    http.setTimeout(_httpTimeout);
+
+    // Follow redirects
+    http.setFollowRedirects(_maxRedirects > 0 ? HTTPC_FORCE_FOLLOW_REDIRECTS : HTTPC_DISABLE_FOLLOW_REDIRECTS);
+    http.setRedirectLimit(_maxRedirects);
+
+    // Set headers
+    http.addHeader("Content-Type", contentType(item));
+
+    // Custom headers were split into fields when queued; reuse two scratch strings for them
+    if (item->headerSet > 0 || item->headerCount > 0) {
+        String name;
+        String value;
+        name.reserve(32);
+        value.reserve(64);
+        if (item->headerSet > 0) {
+            const HeaderSet* set = _headerSets[item->headerSet - 1];
+            addHeaderFields(http, set->headers(), set->fields(), set->count, name, value);
+        }
+        addHeaderFields(http, item->customHeaders(), item->headerFields(), item->headerCount, name, value);
+    }
+
+    // Only ask for Retry-After when it can be used; collecting headers allocates
+    if (_retryMaxAttempts > 1) {
+        static const char* retryHeaders[] = { "Retry-After" };
+        http.collectHeaders(retryHeaders, 1);
+    }
+
+    // Perform POST request without copying the payload into a String; it returns once the headers are in
+    uint32_t sentAt = micros();
+    httpCode = http.POST((uint8_t*)payload, payloadLength);
+    if (httpCode > 0) {
+        recordLatency(_firstByteLatency, micros() - sentAt);
+    }
+    if (_retryMaxAttempts > 1 && http.hasHeader("Retry-After")) {
+        retryAfter = (uint32_t)strtoul(http.header("Retry-After").c_str(), NULL, 10) * 1000; // An HTTP date parses as 0
+    }
+
+    // Check response
+    bool success = false;
+    bool unread = false;
+    if (httpCode > 0) {
+        success = (httpCode >= 200 && httpCode < 300);
+        unread = readResponseBody(http, httpCode, response);
+    } else {
+        POSTQUEUE_LOG_WARN("HTTP error: %s", http.errorToString(httpCode).c_str());
+    }
+
+    http.end();
+    if (unread) {
+        client.stop(); // The body is still on the connection, so it cannot carry another request
+    }
+    return success;
+}
+
+bool PostQueue::readResponseBody(HTTPClient& http, int httpCode, String& response) {
+    if (_responseMode == RESPONSE_CAPTURE && _responseCaptureLimit == 0) {
+        response = http.getString();
+        return false;
+    }
+    if (_responseMode == RESPONSE_STATUS_ONLY) {
+        return http.getSize() != 0 && httpCode != 204 && httpCode != 304;
+    }
+
+    // Decode the body piece by piece, as getString() does, without keeping more than asked
+    ResponseCollector collector;
+    collector.queue = this;
+    collector.response = &response;
+    collector.httpCode = httpCode;
+    BodySinkStream sink(collectResponse, &collector);
+    http.writeToStream(&sink);
+    return false;
+}
+
+void PostQueue::addHeaderFields(HTTPClient& http, const char* headers, const HeaderField* fields, uint8_t count,
+                                String& name, String& value) {
+    for (uint8_t i = 0; i < count; i++) {
+        name = "";
+        name.concat(headers + fields[i].nameOffset, fields[i].nameLength);
+        value = "";
+        value.concat(headers + fields[i].valueOffset, fields[i].valueLength);
+        http.addHeader(name, value);
+    }
+}
+
+bool PostQueue::createArena() {
+    if (_arenaSlotSize == 0) {
+        return true;
+    }
+    if (getArenaSlotCapacity() == 0) {
+        POSTQUEUE_LOG_ERROR("Arena slot too small for an item");
+        return false;
+    }
+
+    // Workers hold their in-flight items while sending, on top of full lanes and retry queue
+    _arenaSlotCount = queueCapacity() + _workerCount * _maxInFlight * _pipelineDepth + (_retryMaxAttempts > 1 ? _retryQueueSize : 0);
+    _arena = (uint8_t*)malloc(_arenaSlotSize * _arenaSlotCount);
+    bool created;
+    if (_backend == QUEUE_BACKEND_RING) {
+        created = _arenaRing.begin(_arenaSlotCount);
+    } else {
+        _arenaFree = xQueueCreate(_arenaSlotCount, sizeof(uint8_t*));
+        created = _arenaFree != NULL;
+    }
+    if (_arena == NULL || !created) {
+        return false;
+    }
+
+    for (size_t i = 0; i < _arenaSlotCount; i++) {
+        uint8_t* slot = _arena + i * _arenaSlotSize;
+        if (_backend == QUEUE_BACKEND_RING) {
+            _arenaRing.push(slot);
+        } else {
+            xQueueSend(_arenaFree, &slot, 0);
+        }
+    }
+    return true;
+}
+
+size_t PostQueue::freeArenaSlots() {
+    if (_backend == QUEUE_BACKEND_RING) {
+        return _arenaRing.size();
+    }
+    return _arenaFree != NULL ? uxQueueMessagesWaiting(_arenaFree) : 0;
+}
+
+PostItem* PostQueue::createPostItem(const char* url, size_t payloadLength, bool useSSL, const char* customHeaders,
+                                    uint8_t headerSet, uint8_t lane) {
+    size_t headersLength;
+    uint8_t headerCount;
+    size_t size = measurePostItem(url, payloadLength, customHeaders, headerSet, headersLength, headerCount);
+    if (size == 0) {
+        return NULL;
+    }
+    PostItem* item = allocPostItem(size);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    item->priority = lane;
+    item->timestamp = millis();
+    item->queuedAt = micros();
+    item->key = 0;
+    item->claimed = false;
+    item->refreshed = false;
+    item->superseded = false;
+    fillPostItem(item, url, payloadLength, useSSL, customHeaders, headerSet, headersLength, headerCount);
+    return item;
+}
+
+size_t PostQueue::measurePostItem(const char* url, size_t payloadLength, const char* customHeaders,
+                                  uint8_t headerSet, size_t& headersLength, uint8_t& headerCount) {
+    if (headerSet > _headerSetCount) {
+        POSTQUEUE_LOG_ERROR("Unknown header set");
+        return 0;
+    }
+
+    size_t urlLength = strlen(url);
+    if (urlLength > UINT16_MAX || !parseHeaders(customHeaders, NULL, NULL, headersLength, headerCount)) {
+        POSTQUEUE_LOG_ERROR("Item too large");
+        return 0;
+    }
+
+    // Header, field table, then url, payload and headers, each NUL-terminated
+    return sizeof(PostItem) + headerCount * sizeof(HeaderField) + urlLength + payloadLength + headersLength + 3;
+}
+
+void PostQueue::fillPostItem(PostItem* item, const char* url, size_t payloadLength, bool useSSL,
+                             const char* customHeaders, uint8_t headerSet, size_t headersLength,
+                             uint8_t headerCount) {
+    size_t urlLength = strlen(url);
+    item->urlLength = (uint16_t)urlLength;
+    item->headersLength = (uint16_t)headersLength;
+    item->payloadLength = (uint32_t)payloadLength;
+    item->useSSL = useSSL;
+    item->headerCount = headerCount;
+    item->headerSet = headerSet;
+    item->attempts = 0;
+    item->encoding = ENCODING_JSON;
+    item->producer = NULL;
+    item->producerContext = NULL;
+    item->contentLength = 0;
+
+    char* data = const_cast<char*>(item->url());
+    memcpy(data, url, urlLength + 1);
+    char* headers = data + urlLength + 1 + payloadLength + 1;
+    parseHeaders(customHeaders, headers, const_cast<HeaderField*>(item->headerFields()), headersLength, headerCount);
+    headers[headersLength] = '\0';
+}
+
+bool PostQueue::parseHeaders(const char* headers, char* output, HeaderField* fields, size_t& length, uint8_t& count) {
+    length = 0;
+    count = 0;
+
+    const char* line = headers;
+    while (line != NULL && *line != '\0') {
+        const char* end = strchr(line, '\n');
+        const char* next = (end != NULL) ? end + 1 : NULL;
+        if (end == NULL) {
+            end = line + strlen(line);
+        }
+
+        const char* colon = (const char*)memchr(line, ':', end - line);
+        if (colon != NULL) {
+            // Trim "  Name :  Value \r" down to its name and value
+            const char* name = line;
+            const char* nameEnd = colon;
+            const char* value = colon + 1;
+            const char* valueEnd = end;
+            while (name < nameEnd && isspace((unsigned char)*name)) {
+                name++;
+            }
+            while (nameEnd > name && isspace((unsigned char)nameEnd[-1])) {
+                nameEnd--;
+            }
+            while (value < valueEnd && isspace((unsigned char)*value)) {
+                value++;
+            }
+            while (valueEnd > value && isspace((unsigned char)valueEnd[-1])) {
+                valueEnd--;
+            }
+
+            size_t nameLength = nameEnd - name;
+            size_t valueLength = valueEnd - value;
+            if (nameLength > 0) {
+                if (count >= MAX_HEADER_FIELDS || length + nameLength + valueLength + 4 > UINT16_MAX) {
+                    return false;
+                }
+                if (fields != NULL) {
+                    fields[count].nameOffset = (uint16_t)length;
+                    fields[count].nameLength = (uint16_t)nameLength;
+                    fields[count].valueOffset = (uint16_t)(length + nameLength + 2);
+                    fields[count].valueLength = (uint16_t)valueLength;
+                }
+                if (output != NULL) {
+                    memcpy(output + length, name, nameLength);
+                    memcpy(output + length + nameLength, ": ", 2);
+                    memcpy(output + length + nameLength + 2, value, valueLength);
+                    memcpy(output + length + nameLength + 2 + valueLength, "\r\n", 2);
+                }
+                length += nameLength + valueLength + 4;
+                count++;
+            }
+        }
+        line = next;
+    }
+    return true;
+}
+
+PostItem* PostQueue::allocPostItem(size_t size) {
+    PostItem* item = NULL;
+
+    if (_arena != NULL) {
+        if (size > _arenaSlotSize) {
+            POSTQUEUE_LOG_ERROR("Item too large for arena slot");
+            return NULL;
+        }
+        void* slot;
+        if (_backend == QUEUE_BACKEND_RING ? _arenaRing.pop(slot) : xQueueReceive(_arenaFree, &slot, 0) == pdTRUE) {
+            item = static_cast<PostItem*>(slot);
+            item->capacity = (uint32_t)_arenaSlotSize;
+            return item;
+        }
+        // An item headed for the spill log only passes through RAM briefly
+        if (!_spill.isOpen()) {
+            POSTQUEUE_LOG_WARN("Arena is full");
+            return NULL;
+        }
+    }
+
+    item = (PostItem*)malloc(size);
+    if (item == NULL) {
+        POSTQUEUE_LOG_ERROR("Failed to allocate PostItem");
+        return NULL;
+    }
+    item->capacity = (uint32_t)size;
+    return item;
+}
 
 void PostQueue::freePostItem(PostItem* item) {
     if (item == NULL) {
         return;
     }
 
-    if (item->url != NULL) {
-        free(item->url);
+    uint8_t* block = reinterpret_cast<uint8_t*>(item);
+    if (_arena != NULL && block >= _arena && block < _arena + _arenaSlotSize * _arenaSlotCount) {
+        if (_backend == QUEUE_BACKEND_RING) {
+            _arenaRing.push(block); // The ring always has room for every slot
+        } else {
+            xQueueSend(_arenaFree, &block, 0);
+        }
+    } else {
+        free(item);
+    }
+}
+
+PooledConnection* PostQueue::acquireConnection(const char* url, bool useSSL) {
+    if (_maxPooledConnections == 0) {
+        return NULL;
+    }
+
+    UrlParts parts;
+    if (!parseUrl(url, useSSL, parts)) {
+        return NULL;
+    }
+    const char* host = parts.host;
+    size_t hostLen = parts.hostLength;
+    uint16_t port = parts.port;
+
+    xSemaphoreTake(_poolLock, portMAX_DELAY);
+
+    PooledConnection* freeSlot = NULL;
+    PooledConnection* oldest = NULL;
+    for (uint8_t i = 0; i < _maxPooledConnections; i++) {
+        PooledConnection* conn = &_pool[i];
+        if (conn->http == NULL) {
+            if (freeSlot == NULL) {
+                freeSlot = conn;
+            }
+            continue;
+        }
+        if (conn->inUse) {
+            continue;
+        }
+
+        if (conn->useSSL == useSSL && conn->port == port &&
+            strlen(conn->host) == hostLen && strncmp(conn->host, host, hostLen) == 0) {
+            // Same endpoint: reuse the socket if the server kept it open,
+            // otherwise HTTPClient reconnects on the same client
+            bool connected = conn->client->connected();
+            portENTER_CRITICAL(&_statsMux);
+            if (connected) {
+                _poolHits++;
+            } else {
+                _poolMisses++;
+            }
+            portEXIT_CRITICAL(&_statsMux);
+
+            conn->inUse = true;
+            xSemaphoreGive(_poolLock);
+            return conn;
+        }
+
+        if (oldest == NULL || (int32_t)(conn->lastUsed - oldest->lastUsed) < 0) {
+            oldest = conn;
+        }
+    }
+
+    // New endpoint: take a free slot or evict the least recently used idle connection
+    PooledConnection* conn = (freeSlot != NULL) ? freeSlot : oldest;
+    if (conn == NULL) {
+        xSemaphoreGive(_poolLock);
+        return NULL; // Every slot is busy on another worker
+    }
+    closeConnection(conn);
+
+    portENTER_CRITICAL(&_statsMux);
+    _poolMisses++;
+    portEXIT_CRITICAL(&_statsMux);
+
+    if (useSSL) {
+        WiFiClientSecure* secureClient = new WiFiClientSecure();
+        if (secureClient != NULL && !_verifySSL) {
+            secureClient->setInsecure(); // Skip SSL verification
+        }
+        conn->client = secureClient;
+    } else {
+        conn->client = new WiFiClient();
+    }
+    conn->http = new HTTPClient();
+    conn->host = (char*)malloc(hostLen + 1);
+
+    if (conn->client == NULL || conn->http == NULL || conn->host == NULL) {
+        POSTQUEUE_LOG_ERROR("Failed to allocate pooled connection");
+        closeConnection(conn);
+        xSemaphoreGive(_poolLock);
+        return NULL;
+    }
+
+    memcpy(conn->host, host, hostLen);
+    conn->host[hostLen] = '\0';
+    conn->port = port;
+    conn->useSSL = useSSL;
+    conn->inUse = true;
+    conn->http->setReuse(true);
+
+    xSemaphoreGive(_poolLock);
+    return conn;
+}
+
+void PostQueue::releaseConnection(PooledConnection* conn) {
+    xSemaphoreTake(_poolLock, portMAX_DELAY);
+    conn->lastUsed = millis();
+    conn->inUse = false;
+    xSemaphoreGive(_poolLock);
+}
+
+TickType_t PostQueue::evictIdleConnections() {
+    TickType_t wait = portMAX_DELAY;
+
+    xSemaphoreTake(_poolLock, portMAX_DELAY);
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < MAX_POOLED_CONNECTIONS; i++) {
+        PooledConnection* conn = &_pool[i];
+        if (conn->http == NULL || conn->inUse) {
+            continue;
+        }
+
+        uint32_t idle = now - conn->lastUsed;
+        if (i >= _maxPooledConnections || idle >= _connectionIdleTimeout) {
+            closeConnection(conn);
+            continue;
+        }
+
+        TickType_t remaining = pdMS_TO_TICKS(_connectionIdleTimeout - idle) + 1;
+        if (remaining < wait) {
+            wait = remaining;
+        }
+    }
+    xSemaphoreGive(_poolLock);
+
+    return wait;
+}
+
+void PostQueue::closeConnection(PooledConnection* conn) {
+    if (conn == NULL) {
+        return;
+    }
+
+    // HTTPClient stops its client on destruction, so delete it first
+    if (conn->http != NULL) {
+        delete conn->http;
     }
-    if (item->jsonPayload != NULL) {
-        free(item->jsonPayload);
+    if (conn->client != NULL) {
+        conn->client->stop();
+        delete conn->client;
     }
-    if (item->customHeaders != NULL) {
-        free(item->customHeaders);
+    if (conn->host != NULL) {
+        free(conn->host);
     }
-    delete item;
+    memset(conn, 0, sizeof(PooledConnection));
 }
@@ -5,7 +5,8 @@
  * @date 2025-11-12
  * 
  * This library provides a thread-safe queue system for HTTP POST requests using FreeRTOS.
- * It handles SSL/TLS connections, follows redirects, and manages request retries.
+ * It handles SSL/TLS connections, follows redirects, and retries transient failures
+ * with exponential backoff.
  */
 
 #ifndef POST_QUEUE_H
@@ -17,7 +18,16 @@
 #include <ArduinoJson.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
+#include "CborSerializer.h"
+#include "DeflateEncoder.h"
+#include "HttpResponseParser.h"
+#include "KeyIndex.h"
+#include "LatencyHistogram.h"
+#include "PostQueueLog.h"
+#include "PostRing.h"
+#include "SpillLog.h"
 
 /**
  * @brief Default maximum queue size to prevent memory issues
@@ -44,15 +54,460 @@
  */
 #define DEFAULT_TASK_PRIORITY 1
 
+/**
+ * @brief Default number of worker tasks draining the queue
+ */
+#define DEFAULT_WORKER_COUNT 1
+
+/**
+ * @brief Maximum number of worker tasks
+ */
+#ifndef MAX_WORKERS
+#define MAX_WORKERS 4
+#endif
+
+/**
+ * @brief Worker core value that pins worker i to core (i % portNUM_PROCESSORS)
+ */
+#define WORKER_CORES_SPREAD (-2)
+
+/**
+ * @brief Maximum number of keep-alive connections the pool can hold
+ */
+#ifndef MAX_POOLED_CONNECTIONS
+#define MAX_POOLED_CONNECTIONS 4
+#endif
+
+/**
+ * @brief Default number of keep-alive connections kept open (0 disables pooling)
+ */
+#define DEFAULT_POOLED_CONNECTIONS 2
+
+/**
+ * @brief Default time in milliseconds after which an unused pooled connection is closed
+ */
+#define DEFAULT_CONNECTION_IDLE_TIMEOUT 30000
+
+/**
+ * @brief Extra time in milliseconds end() waits beyond the HTTP timeout for the worker to stop
+ */
+#define WORKER_STOP_MARGIN 1000
+
+/**
+ * @brief Maximum number of items coalesced into one batched POST
+ */
+#ifndef MAX_BATCH_ITEMS
+#define MAX_BATCH_ITEMS 32
+#endif
+
+/**
+ * @brief Default maximum size in bytes of a batched request body
+ */
+#define DEFAULT_BATCH_MAX_BYTES 4096
+
+/**
+ * @brief Default time in milliseconds a worker waits for more items to fill a batch
+ */
+#define DEFAULT_BATCH_LINGER 0
+
+/**
+ * @brief Size of the stack buffer used to pull streamed request bodies from a producer
+ */
+#ifndef STREAM_CHUNK_SIZE
+#define STREAM_CHUNK_SIZE 512
+#endif
+
+/**
+ * @brief Default directory for spilled requests
+ */
+#define DEFAULT_SPILL_DIRECTORY "/postqueue"
+
+/**
+ * @brief Default flash budget in bytes for spilled requests
+ */
+#define DEFAULT_SPILL_MAX_BYTES 65536
+
+/**
+ * @brief Time in milliseconds to wait before retrying a spilled request after a network error
+ */
+#define SPILL_RETRY_INTERVAL 5000
+
+/**
+ * @brief Maximum number of custom header fields per request or header set
+ */
+#ifndef MAX_HEADER_FIELDS
+#define MAX_HEADER_FIELDS 16
+#endif
+
+/**
+ * @brief Maximum number of named header sets
+ */
+#ifndef MAX_HEADER_SETS
+#define MAX_HEADER_SETS 8
+#endif
+
+/**
+ * @brief Maximum data bytes in a record posted from an interrupt handler
+ */
+#ifndef POST_RECORD_SIZE
+#define POST_RECORD_SIZE 32
+#endif
+
+/**
+ * @brief Default number of records buffered between interrupt handlers and the workers
+ */
+#define DEFAULT_RECORD_QUEUE_SIZE 16
+
+/**
+ * @brief Maximum number of record channels
+ */
+#ifndef MAX_RECORD_CHANNELS
+#define MAX_RECORD_CHANNELS 4
+#endif
+
+/**
+ * @brief Largest JSON body a record formatter may produce, including the terminator
+ */
+#ifndef RECORD_JSON_MAX_SIZE
+#define RECORD_JSON_MAX_SIZE 256
+#endif
+
+/**
+ * @brief Maximum number of priority lanes
+ */
+#ifndef MAX_PRIORITY_LANES
+#define MAX_PRIORITY_LANES 4
+#endif
+
+/**
+ * @brief Default time in milliseconds a waiting lower lane may go unserved under strict scheduling
+ */
+#define DEFAULT_LANE_STARVATION_LIMIT 5000
+
+/**
+ * @brief Priority classes for post(); values above the configured lanes use the top lane
+ */
+#define POST_PRIORITY_NORMAL 0
+#define POST_PRIORITY_HIGH 1
+#define POST_PRIORITY_CRITICAL 2
+
+/**
+ * @brief Maximum attempts per item, including the first
+ */
+#ifndef MAX_RETRY_ATTEMPTS
+#define MAX_RETRY_ATTEMPTS 8
+#endif
+
+/**
+ * @brief Default attempts per item (1 = no retries)
+ */
+#define DEFAULT_RETRY_ATTEMPTS 1
+
+/**
+ * @brief Default delay in milliseconds before the first retry; doubles per attempt
+ */
+#define DEFAULT_RETRY_BASE_DELAY 500
+
+/**
+ * @brief Default cap in milliseconds on the delay between attempts
+ */
+#define DEFAULT_RETRY_MAX_DELAY 30000
+
+/**
+ * @brief Default share of each retry delay, in percent, replaced by a random amount
+ */
+#define DEFAULT_RETRY_JITTER 50
+
+/**
+ * @brief Default number of items that can wait for a retry at once
+ */
+#define DEFAULT_RETRY_QUEUE_SIZE 8
+
+/**
+ * @brief Default retries allowed per 100 first attempts (0 = no budget)
+ */
+#define DEFAULT_RETRY_BUDGET_PERCENT 20
+
+/**
+ * @brief Default number of retries the budget can bank
+ */
+#define DEFAULT_RETRY_BUDGET_BURST 10
+
+/**
+ * @brief Longest Retry-After in milliseconds that is honored; longer ones end the retries
+ */
+#ifndef MAX_RETRY_AFTER
+#define MAX_RETRY_AFTER 300000
+#endif
+
+/**
+ * @brief Maximum number of requests one worker can have in flight at once
+ */
+#ifndef MAX_IN_FLIGHT
+#define MAX_IN_FLIGHT 8
+#endif
+
+/**
+ * @brief Default number of requests in flight per worker (1 = one at a time)
+ */
+#define DEFAULT_MAX_IN_FLIGHT 1
+
+/**
+ * @brief Maximum number of requests written ahead on one connection
+ */
+#ifndef MAX_PIPELINE_DEPTH
+#define MAX_PIPELINE_DEPTH 8
+#endif
+
+/**
+ * @brief Default number of requests outstanding per connection (1 = no pipelining)
+ */
+#define DEFAULT_PIPELINE_DEPTH 1
+
+/**
+ * @brief Default smallest body, in bytes, that is compressed
+ */
+#define DEFAULT_COMPRESSION_MIN_SIZE 256
+
+/**
+ * @brief How workers choose the next priority lane to take an item from
+ */
+enum LaneScheduling {
+    LANE_SCHEDULING_STRICT,     ///< Highest non-empty lane first, with a starvation guard for lower lanes
+    LANE_SCHEDULING_WEIGHTED    ///< Weighted round-robin: up to a lane's weight in items per turn
+};
+
+/**
+ * @brief What post() does when the lane of a new item is full
+ */
+enum OverflowPolicy {
+    OVERFLOW_REJECT,            ///< Drop the newest: return false at once, before the item is allocated (default)
+    OVERFLOW_BLOCK,             ///< Wait up to the overflow timeout for a worker to take an item
+    OVERFLOW_DROP_OLDEST        ///< Free the oldest item in the lane to make room
+};
+
+/**
+ * @brief Overflow timeout that makes OVERFLOW_BLOCK wait until there is room
+ */
+#define OVERFLOW_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief Per-lane queue statistics
+ */
+struct LaneStats {
+    size_t queued;              ///< Items currently waiting in the lane
+    uint32_t enqueued;          ///< Items added to the lane
+    uint32_t rejected;          ///< Items refused because the lane was full
+    uint32_t evicted;           ///< Queued items dropped to make room (OVERFLOW_DROP_OLDEST)
+    uint32_t decimated;         ///< Items refused by decimation (setDecimation())
+    uint32_t dequeued;          ///< Items taken by workers
+    uint32_t maxWait;           ///< Longest time in milliseconds an item waited in the lane
+};
+
+/**
+ * @brief Items dropped under pressure, by cause, across all lanes
+ */
+struct OverflowStats {
+    uint32_t rejected;          ///< New items refused by a full lane (OVERFLOW_REJECT, or OVERFLOW_BLOCK timing out)
+    uint32_t evicted;           ///< Queued items dropped to make room (OVERFLOW_DROP_OLDEST)
+    uint32_t decimated;         ///< New items refused by decimation above its threshold
+    uint32_t blocked;           ///< Posts that waited for room (OVERFLOW_BLOCK), whether or not they got it
+};
+
+/**
+ * @brief Retry statistics
+ */
+struct RetryStats {
+    size_t pending;             ///< Items waiting for their next attempt
+    uint32_t scheduled;         ///< Retries scheduled
+    uint32_t exhausted;         ///< Items that failed their last allowed attempt
+    uint32_t budgetDenied;      ///< Retries refused because the retry budget was spent
+    uint32_t overflowed;        ///< Retries refused because the retry queue was full
+    uint32_t succeededAfter[MAX_RETRY_ATTEMPTS]; ///< Items that succeeded on attempt i + 1
+    float attemptsPerSuccess;   ///< Mean attempts taken by successful items (0 if none)
+};
+
+/**
+ * @brief Request counters and latency histograms, copied together
+ *
+ * Latencies are in microseconds. Connect and first-byte times are per request
+ * sent; a request on an already open connection records no connect time.
+ */
+struct StatsSnapshot {
+    uint64_t processed;         ///< Items completed, after their last attempt
+    uint64_t successful;        ///< Items completed with a 2xx status
+    uint64_t failed;            ///< Items completed otherwise
+    LatencyHistogram queueWait; ///< Time items waited in a lane before a worker took them
+    LatencyHistogram connect;   ///< Time to open a connection, TLS handshake included
+    LatencyHistogram firstByte; ///< Time from starting to write a request to the first response byte
+    LatencyHistogram total;     ///< Time per request sent, from starting to send it to the end of its response
+};
+
+/**
+ * @brief Queue implementation handing items from post() to the workers
+ */
+enum QueueBackend {
+    QUEUE_BACKEND_FREERTOS,     ///< FreeRTOS queue; every operation enters its critical section
+    QUEUE_BACKEND_RING          ///< Lock-free ring; producers never lock unless a worker is asleep
+};
+
+/**
+ * @brief Wire format of JsonDocument payloads
+ */
+enum PayloadEncoding {
+    ENCODING_JSON,              ///< application/json
+    ENCODING_MSGPACK,           ///< application/msgpack, via serializeMsgPack()
+    ENCODING_CBOR,              ///< application/cbor, via serializeCbor()
+    ENCODING_DEFAULT = 0xFF     ///< The queue's setEncoding() choice
+};
+
+/**
+ * @brief Content-Encoding applied to request bodies
+ */
+enum CompressionFormat {
+    COMPRESSION_NONE,           ///< Bodies are sent as they are
+    COMPRESSION_GZIP,           ///< Content-Encoding: gzip
+    COMPRESSION_DEFLATE         ///< Content-Encoding: deflate (zlib-wrapped, as HTTP defines it)
+};
+
+/**
+ * @brief What workers do with a response body
+ */
+enum ResponseMode {
+    RESPONSE_CAPTURE,           ///< Pass the body to the callback, optionally only its first bytes
+    RESPONSE_DISCARD,           ///< Read and drop the body so the connection stays reusable
+    RESPONSE_STATUS_ONLY,       ///< Stop after the status line; a connection with an unread body is closed
+    RESPONSE_STREAM             ///< Hand the body to the response chunk callback as it arrives
+};
+
+/**
+ * @brief Callback that produces a streamed request body while it is being sent
+ * @param buffer Destination for the next part of the body
+ * @param size Capacity of buffer in bytes
+ * @param context User pointer passed to postStream()
+ * @return Number of bytes written to buffer, 0 once the body is complete
+ */
+typedef size_t (*BodyProducer)(uint8_t* buffer, size_t size, void* context);
+
+/**
+ * @brief Callback that turns a record from postFromISR() into a JSON body, run on a worker
+ * @param data Record data as passed to postFromISR()
+ * @param length Length of the record data
+ * @param json Destination for the NUL-terminated JSON body
+ * @param size Capacity of json in bytes (RECORD_JSON_MAX_SIZE)
+ * @return Length of the JSON body, or 0 to drop the record; like snprintf, a value
+ *         of size or more means the body did not fit and the record is dropped
+ */
+typedef size_t (*RecordFormatter)(const uint8_t* data, size_t length, char* json, size_t size);
+
+/**
+ * @brief Location of one custom header field inside a header block
+ *
+ * Header blocks are stored normalized as "Name: Value\r\n" lines, so they can
+ * be written to a socket as-is or walked field by field without parsing.
+ */
+struct HeaderField {
+    uint16_t nameOffset;        ///< Offset of the name in the header block
+    uint16_t nameLength;        ///< Length of the name
+    uint16_t valueOffset;       ///< Offset of the value in the header block
+    uint16_t valueLength;       ///< Length of the value
+};
+
 /**
  * @brief Structure to hold a POST request item
+ *
+ * An item is a single heap block: this header, the table of custom header
+ * fields, then the NUL-terminated url, payload and normalized custom header
+ * strings, located through their lengths.
  */
 struct PostItem {
-    char* url;                  ///< Target URL for the POST request
-    char* jsonPayload;          ///< JSON payload as string
-    char* customHeaders;        ///< Optional custom headers (can be NULL)
+    uint16_t urlLength;         ///< Length of the URL (excluding terminator)
+    uint16_t headersLength;     ///< Length of the normalized custom headers (0 if none)
+    uint32_t payloadLength;     ///< Length of the payload (excluding terminator)
+    bool useSSL;                ///< Whether to use SSL/TLS
+    uint8_t headerCount;        ///< Number of entries in the header field table
+    uint8_t headerSet;          ///< Named header set sent before the custom headers (0 = none)
+    uint8_t priority;           ///< Priority lane the item is queued in
+    uint8_t attempts;           ///< Send attempts made so far
+    uint8_t encoding;           ///< PayloadEncoding of the payload
+    bool claimed;               ///< A postLatest() call is writing a newer value over the item
+    bool refreshed;             ///< Rewritten in place since it was queued or last moved back
+    bool superseded;            ///< Replaced by a newer item with the same key; dropped when dequeued
+    uint32_t timestamp;         ///< millis() when the item was queued
+    uint32_t queuedAt;          ///< micros() when the item was queued, for the queue wait histogram
+    uint32_t retryAt;           ///< millis() at which a waiting retry is due
+    BodyProducer producer;      ///< Streams the body when set (payload is then empty)
+    void* producerContext;      ///< User pointer passed to the producer
+    uint32_t contentLength;     ///< Streamed body length (0 = unknown, sent chunked)
+    uint32_t key;               ///< Deduplication key from postLatest() (0 = none)
+    uint32_t capacity;          ///< Size of the item's block, which a newer value may reuse
+
+    /** @brief Custom header fields, indexing into customHeaders() */
+    const HeaderField* headerFields() const { return reinterpret_cast<const HeaderField*>(this + 1); }
+
+    /** @brief Target URL for the POST request */
+    const char* url() const { return reinterpret_cast<const char*>(headerFields() + headerCount); }
+
+    /** @brief Payload: a JSON string, or MessagePack or CBOR bytes as set by encoding */
+    char* jsonPayload() { return const_cast<char*>(url()) + urlLength + 1; }
+    const char* jsonPayload() const { return url() + urlLength + 1; }
+
+    /** @brief Optional normalized custom headers (NULL if none) */
+    const char* customHeaders() const {
+        return headersLength > 0 ? jsonPayload() + payloadLength + 1 : NULL;
+    }
+};
+
+/**
+ * @brief Named set of custom headers registered once and referenced by id
+ *
+ * A single heap block: this header, the field table, then the normalized,
+ * NUL-terminated header string.
+ */
+struct HeaderSet {
+    uint16_t length;            ///< Length of the normalized header string
+    uint8_t count;              ///< Number of fields
+
+    /** @brief Header fields, indexing into headers() */
+    const HeaderField* fields() const { return reinterpret_cast<const HeaderField*>(this + 1); }
+
+    /** @brief Normalized header string */
+    const char* headers() const { return reinterpret_cast<const char*>(fields() + count); }
+};
+
+/**
+ * @brief Fixed-size record copied by postFromISR() for a worker to format later
+ */
+struct PostRecord {
+    uint8_t channel;            ///< Record channel id from addRecordChannel()
+    uint8_t length;             ///< Bytes used in data
+    uint8_t data[POST_RECORD_SIZE]; ///< Raw record data
+};
+
+/**
+ * @brief Destination and formatter shared by every record posted on one channel
+ */
+struct RecordChannel {
+    const char* url;            ///< Target URL (must stay valid)
+    RecordFormatter formatter;  ///< Turns records into JSON bodies
     bool useSSL;                ///< Whether to use SSL/TLS
-    uint32_t timestamp;         ///< Timestamp when the item was queued
+    const char* customHeaders;  ///< Custom headers (can be NULL, must stay valid)
+    uint8_t headerSet;          ///< Header set id (0 = none)
+    uint8_t priority;           ///< Priority class
+};
+
+/**
+ * @brief Keep-alive connection reused across POST requests to the same scheme/host/port
+ */
+struct PooledConnection {
+    HTTPClient* http;           ///< HTTP client bound to the connection (NULL if slot unused)
+    WiFiClient* client;         ///< WiFiClient or WiFiClientSecure owning the socket
+    char* host;                 ///< Host the connection is keyed on
+    uint16_t port;              ///< Port the connection is keyed on
+    bool useSSL;                ///< Scheme the connection is keyed on
+    bool inUse;                 ///< Whether a worker is currently sending on the connection
+    bool noPipelining;          ///< Server closed with pipelined requests unanswered; send one at a time
+    uint32_t lastUsed;          ///< millis() when the connection was last released
 };
 
 /**
@@ -60,9 +515,28 @@ struct PostItem {
  * @param success Whether the POST request was successful
  * @param httpCode HTTP response code (0 if failed before getting response)
  * @param response Response body from server
+ * @note Callbacks are serialized: with several workers they never run concurrently
  */
 typedef void (*PostCallback)(bool success, int httpCode, const String& response);
 
+/**
+ * @brief Callback receiving a response body piece by piece (RESPONSE_STREAM)
+ * @param httpCode HTTP response code
+ * @param data Next part of the body
+ * @param length Number of bytes
+ * @note Runs on a worker task, serialized with PostCallback; the PostCallback follows with an empty response
+ */
+typedef void (*ResponseChunkCallback)(int httpCode, const uint8_t* data, size_t length);
+
+/**
+ * @brief Callback for the queue crossing the watermarks set with setWatermarks()
+ * @param high true when the queue rose to the high watermark, false when it fell back to the low one
+ * @param queued Items queued across all lanes at the crossing
+ * @note Rising crossings run on the posting task and falling ones on a worker task;
+ *       keep it short and do not post from it
+ */
+typedef void (*WatermarkCallback)(bool high, size_t queued);
+
 /**
  * @brief Main PostQueue class for managing HTTP POST requests
  */
@@ -73,10 +547,16 @@ public:
      * @param maxQueueSize Maximum number of items in the queue (default: 10)
      * @param taskStackSize Stack size for worker task (default: 8192)
      * @param taskPriority Priority for worker task (default: 1)
+     * @param workerCount Number of worker tasks draining the queue, 1 to MAX_WORKERS (default: 1)
+     * @param workerCore Core to pin workers to, tskNO_AFFINITY (default) or WORKER_CORES_SPREAD
+     * @param backend Queue implementation, QUEUE_BACKEND_FREERTOS (default) or QUEUE_BACKEND_RING
      */
     PostQueue(size_t maxQueueSize = DEFAULT_MAX_QUEUE_SIZE, 
               size_t taskStackSize = DEFAULT_TASK_STACK_SIZE,
-              UBaseType_t taskPriority = DEFAULT_TASK_PRIORITY);
+              UBaseType_t taskPriority = DEFAULT_TASK_PRIORITY,
+              uint8_t workerCount = DEFAULT_WORKER_COUNT,
+              BaseType_t workerCore = tskNO_AFFINITY,
+              QueueBackend backend = QUEUE_BACKEND_FREERTOS);
 
     /**
      * @brief Destroy the PostQueue object and cleanup resources
@@ -100,9 +580,12 @@ public:
      * @param jsonPayload JSON string payload
      * @param useSSL Whether to use SSL/TLS (default: true)
      * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class, 0 (POST_PRIORITY_NORMAL, default) up to the top lane
      * @return true if successfully queued, false if queue is full
      */
-    bool post(const char* url, const char* jsonPayload, bool useSSL = true, const char* customHeaders = NULL);
+    bool post(const char* url, const char* jsonPayload, bool useSSL = true, const char* customHeaders = NULL,
+              uint8_t headerSet = 0, uint8_t priority = POST_PRIORITY_NORMAL);
 
     /**
      * @brief Add a POST request to the queue using JsonDocument
@@ -110,94 +593,1262 @@ public:
      * @param jsonDoc ArduinoJson document
      * @param useSSL Whether to use SSL/TLS (default: true)
      * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class (default: POST_PRIORITY_NORMAL)
+     * @param encoding Wire format (default: ENCODING_DEFAULT, the setEncoding() choice)
      * @return true if successfully queued, false if queue is full
      */
-    bool post(const char* url, JsonDocument& jsonDoc, bool useSSL = true, const char* customHeaders = NULL);
+    bool post(const char* url, JsonDocument& jsonDoc, bool useSSL = true, const char* customHeaders = NULL,
+              uint8_t headerSet = 0, uint8_t priority = POST_PRIORITY_NORMAL,
+              PayloadEncoding encoding = ENCODING_DEFAULT);
 
     /**
-     * @brief Get the current number of items in the queue
-     * @return Number of items waiting to be processed
+     * @brief Queue a POST request that replaces any queued request with the same key
+     *
+     * For "current state" documents only the newest value matters. If an item
+     * posted with the same key is still waiting in its lane, the new request is
+     * written over it in its block, so the backlog holds at most one item per
+     * key and a replacement takes no slot and no allocation. It keeps the lane
+     * and position of the item it replaces. Arena slots always have room for
+     * the new request; a heap item that is too small is dropped when a worker
+     * reaches it and the new one is queued behind it. Once a worker has taken
+     * an item, a new post with its key is queued normally. Keys are only
+     * tracked with setDeduplication(true) and for items queued in RAM.
+     * @param key Any non-zero number naming the state, e.g. a sensor id (0 behaves like post())
+     * @param url Target URL
+     * @param jsonPayload JSON string payload
+     * @param useSSL Whether to use SSL/TLS (default: true)
+     * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class (default: POST_PRIORITY_NORMAL)
+     * @return true if queued or replaced, false if queue is full
      */
-    size_t getQueueSize();
+    bool postLatest(uint32_t key, const char* url, const char* jsonPayload, bool useSSL = true,
+                    const char* customHeaders = NULL, uint8_t headerSet = 0,
+                    uint8_t priority = POST_PRIORITY_NORMAL);
 
     /**
-     * @brief Check if the queue is empty
-     * @return true if queue is empty, false otherwise
+     * @brief Queue a JsonDocument POST that replaces any queued request with the same key
+     * @param key Any non-zero number naming the state (0 behaves like post())
+     * @param url Target URL
+     * @param jsonDoc ArduinoJson document
+     * @param useSSL Whether to use SSL/TLS (default: true)
+     * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class (default: POST_PRIORITY_NORMAL)
+     * @param encoding Wire format (default: ENCODING_DEFAULT, the setEncoding() choice)
+     * @return true if queued or replaced, false if queue is full
      */
-    bool isEmpty();
+    bool postLatest(uint32_t key, const char* url, JsonDocument& jsonDoc, bool useSSL = true,
+                    const char* customHeaders = NULL, uint8_t headerSet = 0,
+                    uint8_t priority = POST_PRIORITY_NORMAL, PayloadEncoding encoding = ENCODING_DEFAULT);
 
     /**
-     * @brief Check if the queue is full
-     * @return true if queue is full, false otherwise
+     * @brief Track postLatest() keys so newer items replace queued ones
+     *
+     * Allocates a hash index with room for twice the queue capacity at begin(),
+     * so finding the queued item for a key takes constant time.
+     * Must be called before begin().
+     * @param enabled Whether to deduplicate keyed items (default: false)
      */
-    bool isFull();
+    void setDeduplication(bool enabled);
 
     /**
-     * @brief Clear all items from the queue
+     * @brief Get deduplication statistics
+     * @param replaced Output: queued items replaced by a newer one with the same key
+     * @param keysQueued Output: keys with an item waiting in a lane
      */
-    void clear();
+    void getDeduplicationStats(uint32_t& replaced, size_t& keysQueued);
 
     /**
-     * @brief Set the HTTP timeout
-     * @param timeout Timeout in milliseconds
+     * @brief Add a POST request whose body is generated while it is sent
+     *
+     * The body never has to fit in RAM: the worker calls the producer for
+     * STREAM_CHUNK_SIZE bytes at a time and writes them straight to the socket.
+     * With an unknown length the body is sent with chunked transfer encoding.
+     * Streamed requests do not follow redirects, and the context must stay
+     * valid until the completion callback runs.
+     * @param url Target URL
+     * @param producer Callback producing the body
+     * @param context User pointer passed to the producer
+     * @param contentLength Body length in bytes, or 0 if unknown (default: 0)
+     * @param useSSL Whether to use SSL/TLS (default: true)
+     * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class (default: POST_PRIORITY_NORMAL)
+     * @return true if successfully queued, false if queue is full
      */
-    void setTimeout(uint32_t timeout);
+    bool postStream(const char* url, BodyProducer producer, void* context, size_t contentLength = 0,
+                    bool useSSL = true, const char* customHeaders = NULL, uint8_t headerSet = 0,
+                    uint8_t priority = POST_PRIORITY_NORMAL);
 
     /**
-     * @brief Set maximum redirects to follow
-     * @param maxRedirects Maximum number of redirects (0 to disable)
+     * @brief Add a POST request whose body is read from a Stream while it is sent
+     * @param url Target URL
+     * @param body Stream to read the body from; must stay valid until the callback runs
+     * @param contentLength Body length in bytes, or 0 to read until the stream times out (default: 0)
+     * @param useSSL Whether to use SSL/TLS (default: true)
+     * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() sent before the custom headers (default: 0, none)
+     * @param priority Priority class (default: POST_PRIORITY_NORMAL)
+     * @return true if successfully queued, false if queue is full
      */
-    void setMaxRedirects(uint8_t maxRedirects);
+    bool postStream(const char* url, Stream& body, size_t contentLength = 0,
+                    bool useSSL = true, const char* customHeaders = NULL, uint8_t headerSet = 0,
+                    uint8_t priority = POST_PRIORITY_NORMAL);
 
     /**
-     * @brief Set callback for POST completion
-     * @param callback Function to call when POST completes
+     * @brief Queue a fixed-size record from an interrupt handler
+     *
+     * Copies the record into a preallocated FreeRTOS queue and wakes a worker,
+     * which formats it into a JSON body with the channel's formatter and queues
+     * it like post(). Never allocates, locks or prints. Interrupts that call this
+     * must be detached before end().
+     * @param channel Record channel id from addRecordChannel()
+     * @param data Record data
+     * @param length Length of data, at most POST_RECORD_SIZE
+     * @param higherPriorityTaskWoken Set to pdTRUE if a woken worker should run when the
+     *        interrupt returns; if NULL the yield is requested here (default: NULL)
+     * @return true if the record was buffered, false if the record queue is full or
+     *         the arguments are invalid
      */
-    void setCallback(PostCallback callback);
+    bool postFromISR(uint8_t channel, const void* data, size_t length, BaseType_t* higherPriorityTaskWoken = NULL);
 
     /**
-     * @brief Set whether to verify SSL certificates
-     * @param verify true to verify (default), false to skip verification
+     * @brief Register the destination and formatter for records from postFromISR()
+     *
+     * The url and customHeaders strings are not copied and must stay valid.
+     * Must be called before begin().
+     * @param url Target URL
+     * @param formatter Turns a record into a JSON body on a worker
+     * @param useSSL Whether to use SSL/TLS (default: true)
+     * @param customHeaders Optional custom headers (default: NULL)
+     * @param headerSet Header set id from addHeaderSet() (default: 0, none)
+     * @param priority Priority class of the resulting requests (default: POST_PRIORITY_NORMAL)
+     * @return Record channel id (1 to MAX_RECORD_CHANNELS), or 0 if it cannot be added
      */
-    void setSSLVerification(bool verify);
+    uint8_t addRecordChannel(const char* url, RecordFormatter formatter, bool useSSL = true,
+                             const char* customHeaders = NULL, uint8_t headerSet = 0,
+                             uint8_t priority = POST_PRIORITY_NORMAL);
 
     /**
-     * @brief Get statistics about processed requests
-     * @param totalProcessed Output: total requests processed
-     * @param totalSuccessful Output: total successful requests
-     * @param totalFailed Output: total failed requests
+     * @brief Set how many records postFromISR() can buffer before workers format them
+     * @param size Record queue length (default: 16); must be called before begin()
      */
-    void getStats(uint32_t& totalProcessed, uint32_t& totalSuccessful, uint32_t& totalFailed);
+    void setRecordQueueSize(size_t size);
 
-private:
-    QueueHandle_t _queue;           ///< FreeRTOS queue handle
-    TaskHandle_t _taskHandle;       ///< Worker task handle
-    size_t _maxQueueSize;           ///< Maximum queue size
-    size_t _taskStackSize;          ///< Stack size for worker task
-    UBaseType_t _taskPriority;      ///< Priority for worker task
-    uint32_t _httpTimeout;          ///< HTTP request timeout
-    uint8_t _maxRedirects;          ///< Maximum redirects to follow
-    bool _verifySSL;                ///< Whether to verify SSL certificates
-    PostCallback _callback;         ///< Callback for POST completion
-    
-    // Statistics
-    uint32_t _totalProcessed;       ///< Total requests processed
-    uint32_t _totalSuccessful;      ///< Total successful requests
-    uint32_t _totalFailed;          ///< Total failed requests
-    
-    bool _running;                  ///< Whether the worker task is running
+    /**
+     * @brief Get record statistics
+     * @param posted Output: records formatted and queued as requests
+     * @param dropped Output: records lost because a queue was full or formatting failed
+     */
+    void getRecordStats(uint32_t& posted, uint32_t& dropped);
 
     /**
-     * @brief Worker task function that processes the queue
-     * @param parameter Pointer to the PostQueue instance
+     * @brief Register a set of custom headers to reference by id from post()
+     *
+     * The headers are parsed once here instead of on every request, which suits
+     * headers shared by many requests such as authentication. Sets live until the
+     * PostQueue is destroyed. Must be called before begin().
+     * @param headers Headers in the same "Name: Value\nName: Value" format as customHeaders
+     * @return Header set id (1 to MAX_HEADER_SETS), or 0 if it cannot be added
      */
-    static void workerTask(void* parameter);
+    uint8_t addHeaderSet(const char* headers);
 
     /**
-     * @brief Process a single POST request
-     * @param item PostItem to process
+     * @brief Split the queue into priority lanes, each a separate queue
+     *
+     * Lane 0 takes POST_PRIORITY_NORMAL items and higher lanes take higher
+     * priorities. Each lane holds up to maxQueueSize items unless limited with
+     * setLaneLimit(). Must be called before begin().
+     * @param count Number of lanes, 1 to MAX_PRIORITY_LANES (default: 1)
+     * @param scheduling LANE_SCHEDULING_STRICT (default) or LANE_SCHEDULING_WEIGHTED
+     * @return true if applied, false if called after begin() or count is out of range
      */
-    void processPostItem(PostItem* item);
+    bool setPriorityLanes(uint8_t count, LaneScheduling scheduling = LANE_SCHEDULING_STRICT);
+
+    /**
+     * @brief Limit the number of items a lane can hold
+     * @param lane Lane index
+     * @param maxItems Maximum items (0 = maxQueueSize); must be called before begin()
+     */
+    void setLaneLimit(uint8_t lane, size_t maxItems);
+
+    /**
+     * @brief Set how many items a lane may send per turn under weighted scheduling
+     * @param lane Lane index
+     * @param weight Items per turn, at least 1 (default: 1 for lane 0, doubling per lane)
+     */
+    void setLaneWeight(uint8_t lane, uint8_t weight);
+
+    /**
+     * @brief Set how long a waiting lower lane may go unserved under strict scheduling
+     *
+     * Once exceeded, the lane sends one item ahead of higher lanes, so background
+     * traffic keeps moving while a high-priority backlog drains.
+     * @param limit Limit in milliseconds (0 = pure strict priority, default: 5000)
+     */
+    void setStarvationLimit(uint32_t limit);
+
+    /**
+     * @brief Get statistics for one priority lane
+     * @param lane Lane index
+     * @param stats Output: the lane's statistics
+     * @return true if the lane exists, false otherwise
+     */
+    bool getLaneStats(uint8_t lane, LaneStats& stats);
+
+    /**
+     * @brief Retry failed requests with exponential backoff and jitter
+     *
+     * Network errors (negative HTTPClient codes), 5xx responses and 429 are
+     * retried; a Retry-After in seconds on 429 or 503 sets the minimum delay.
+     * Other responses complete the item at once. The delay before attempt n + 1
+     * is baseDelay * 2^(n - 1), capped at maxDelay, less a random share of up to
+     * jitter percent. Waiting items sit in a retry queue, not in a lane, so they
+     * never block a worker. Streamed items are not retried. The callback runs
+     * once per item with its final outcome. Must be called before begin().
+     * @param maxAttempts Attempts per item including the first, 1 to MAX_RETRY_ATTEMPTS (1 disables, default)
+     * @param baseDelay Delay before the first retry in milliseconds (default: 500)
+     * @param maxDelay Cap on the delay in milliseconds (default: 30000)
+     * @param jitter Share of each delay, in percent, replaced by a random amount (default: 50)
+     */
+    void setRetry(uint8_t maxAttempts, uint32_t baseDelay = DEFAULT_RETRY_BASE_DELAY,
+                  uint32_t maxDelay = DEFAULT_RETRY_MAX_DELAY, uint8_t jitter = DEFAULT_RETRY_JITTER);
+
+    /**
+     * @brief Limit retries to a share of fresh traffic
+     *
+     * Every first attempt earns percent / 100 of a retry and every retry spends
+     * one, with at most burst retries banked, so an outage cannot turn the queue
+     * into a retry storm that starves new requests.
+     * @param percent Retries allowed per 100 first attempts (0 = unlimited, default: 20)
+     * @param burst Retries that can be banked, also the starting balance (default: 10)
+     */
+    void setRetryBudget(uint8_t percent, uint8_t burst = DEFAULT_RETRY_BUDGET_BURST);
+
+    /**
+     * @brief Set how many items can wait for a retry at once
+     * @param size Retry queue length (default: 8); must be called before begin()
+     */
+    void setRetryQueueSize(size_t size);
+
+    /**
+     * @brief Get retry statistics
+     * @param stats Output: retry counters and attempts per success
+     */
+    void getRetryStats(RetryStats& stats);
+
+    /**
+     * @brief Get the current number of items in the queue
+     * @return Number of items waiting to be processed, across all lanes
+     */
+    size_t getQueueSize();
+
+    /**
+     * @brief Check if the queue is empty
+     * @return true if queue is empty, false otherwise
+     */
+    bool isEmpty();
+
+    /**
+     * @brief Check if the queue is full
+     * @param priority Priority class whose lane to check (default: POST_PRIORITY_NORMAL)
+     * @return true if the lane (or the item arena) is full, false otherwise
+     */
+    bool isFull(uint8_t priority = POST_PRIORITY_NORMAL);
+
+    /**
+     * @brief Choose what post() does when the lane of a new item is full
+     *
+     * Every post reserves a slot in its lane before the item is allocated, so
+     * a full lane is detected without allocating and concurrent producers can
+     * never overfill it. OVERFLOW_BLOCK sleeps until a worker takes an item
+     * from the lane or the timeout passes; do not use it when posting from the
+     * completion callback with a single worker. OVERFLOW_DROP_OLDEST frees the
+     * oldest queued item of the lane without running its callback. With
+     * spilling enabled, items for a full lane go to flash instead.
+     * Must be called before begin().
+     * @param policy Overflow policy (OVERFLOW_REJECT by default)
+     * @param timeout Longest wait in milliseconds for OVERFLOW_BLOCK (OVERFLOW_WAIT_FOREVER for no limit)
+     */
+    void setOverflowPolicy(OverflowPolicy policy, uint32_t timeout = 0);
+
+    /**
+     * @brief Report when the queue fills up and drains again
+     *
+     * The callback runs with high = true when the items queued across all lanes
+     * reach highWatermark, and with high = false when they next fall to
+     * lowWatermark, so producers can lower their sampling rate in between.
+     * Must be called before begin().
+     * @param highWatermark Items at which the queue counts as filling up (0 disables)
+     * @param lowWatermark Items at which it counts as drained again, below highWatermark
+     * @param callback Function to call at each crossing
+     */
+    void setWatermarks(size_t highWatermark, size_t lowWatermark, WatermarkCallback callback);
+
+    /**
+     * @brief Thin out new items once a lane passes an occupancy threshold
+     *
+     * While a lane holds at least thresholdPercent of its limit, only every
+     * keepEvery-th post to it is queued and the others return false, so a
+     * long outage keeps a regular sample of readings instead of only the first
+     * or last ones. The count restarts when the lane drops below the threshold.
+     * The overflow policy still applies once the lane is full.
+     * Must be called before begin().
+     * @param thresholdPercent Lane occupancy, in percent of its limit, from which to decimate (1 to 100)
+     * @param keepEvery Keep one post in this many (0 or 1 disables decimation, default)
+     */
+    void setDecimation(uint8_t thresholdPercent, uint8_t keepEvery);
+
+    /**
+     * @brief Get how many items were dropped under pressure, by cause
+     * @param stats Output: drop counters summed over all lanes
+     */
+    void getOverflowStats(OverflowStats& stats);
+
+    /**
+     * @brief Clear all items from the queue
+     */
+    void clear();
+
+    /**
+     * @brief Set the HTTP timeout
+     * @param timeout Timeout in milliseconds
+     */
+    void setTimeout(uint32_t timeout);
+
+    /**
+     * @brief Set maximum redirects to follow
+     * @param maxRedirects Maximum number of redirects (0 to disable)
+     */
+    void setMaxRedirects(uint8_t maxRedirects);
+
+    /**
+     * @brief Set a minimum interval between consecutive requests
+     * @param interval Minimum time in milliseconds between request starts (0 to disable, default)
+     */
+    void setPacing(uint32_t interval);
+
+    /**
+     * @brief Coalesce queued items for the same URL into one POST with a JSON array body
+     *
+     * Consecutive queued items with the same URL, SSL setting and custom headers are
+     * sent together as "[item1,item2,...]". Every body is sent as an array while
+     * batching is enabled, and the callback runs once per item with the batch result.
+     * Streamed items are never batched.
+     * @param maxItems Maximum items per batch, up to MAX_BATCH_ITEMS (0 disables batching, default)
+     * @param maxBytes Maximum batched body size in bytes (default: 4096)
+     * @param maxLinger Time in milliseconds to wait for more items before sending (default: 0)
+     */
+    void setBatching(uint8_t maxItems, size_t maxBytes = DEFAULT_BATCH_MAX_BYTES,
+                     uint32_t maxLinger = DEFAULT_BATCH_LINGER);
+
+    /**
+     * @brief Get statistics about batching
+     * @param batchesSent Output: batched requests sent
+     * @param itemsBatched Output: items carried by those requests
+     */
+    void getBatchStats(uint32_t& batchesSent, uint32_t& itemsBatched);
+
+    /**
+     * @brief Set callback for POST completion
+     * @param callback Function to call when POST completes
+     */
+    void setCallback(PostCallback callback);
+
+    /**
+     * @brief Choose what workers do with response bodies
+     *
+     * By default the whole body is read into the String passed to the callback.
+     * RESPONSE_CAPTURE with a limit keeps only the first captureLimit bytes and
+     * drops the rest; RESPONSE_DISCARD drops the whole body without allocating;
+     * RESPONSE_STATUS_ONLY does not read the body at all, so a response that has
+     * one costs its connection; RESPONSE_STREAM hands the body to the callback set
+     * with setResponseChunkCallback(). Except in capture mode the callback gets an
+     * empty response. Must be called before begin().
+     * @param mode Response mode (RESPONSE_CAPTURE by default)
+     * @param captureLimit Bytes kept in RESPONSE_CAPTURE mode (0 = whole body)
+     */
+    void setResponseMode(ResponseMode mode, size_t captureLimit = 0);
+
+    /**
+     * @brief Set the callback receiving response bodies in RESPONSE_STREAM mode
+     * @param callback Function to call with each part of a body (NULL drops bodies)
+     */
+    void setResponseChunkCallback(ResponseChunkCallback callback);
+
+    /**
+     * @brief Set whether to verify SSL certificates
+     * @param verify true to verify (default), false to skip verification
+     */
+    void setSSLVerification(bool verify);
+
+    /**
+     * @brief Preallocate a slab arena with a fixed size per item
+     *
+     * begin() reserves one slot per queue entry plus one per worker, and post()
+     * carves items out of it instead of using the heap. Must be called before begin().
+     * @param bytesPerSlot Bytes per slot, including the item header (0 disables the arena)
+     * @return true if applied, false if the queue is already running
+     */
+    bool setArena(size_t bytesPerSlot);
+
+    /**
+     * @brief Preallocate a slab arena with a total byte budget split evenly across slots
+     * @param totalBytes Total arena size in bytes (0 disables the arena)
+     * @return true if applied, false if the queue is already running
+     */
+    bool setArenaBudget(size_t totalBytes);
+
+    /**
+     * @brief Get the largest payload plus URL and header bytes an arena slot can hold
+     *
+     * Each custom header line is also parsed into a HeaderField entry stored in
+     * the slot, so the capacity shrinks with the number of header lines.
+     * @param headerFields Custom header lines the item carries (default: none)
+     * @return Usable bytes per slot, or 0 if the arena is disabled or too small
+     */
+    size_t getArenaSlotCapacity(uint8_t headerFields = 0);
+
+    /**
+     * @brief Spill requests to flash when the queue is full
+     *
+     * Once the queue fills up, new requests are appended to a segmented log on the
+     * filesystem and later requests follow them there to keep their order. Workers
+     * drain the log whenever the queue is empty. A spilled request that fails with
+     * a network error stays in the log and is retried after SPILL_RETRY_INTERVAL.
+     * Spilled requests survive a reboot and are sent at least once. Streamed
+     * requests are never spilled. Must be called before begin().
+     * @param fs Mounted filesystem, e.g. LittleFS
+     * @param directory Directory for the log files (default: "/postqueue")
+     * @param maxBytes Flash budget in bytes (default: 65536)
+     * @return true if applied, false if the queue is already running
+     */
+    bool enableSpill(fs::FS& fs, const char* directory = DEFAULT_SPILL_DIRECTORY,
+                     size_t maxBytes = DEFAULT_SPILL_MAX_BYTES);
+
+    /**
+     * @brief Delete every spilled request
+     */
+    void clearSpill();
+
+    /**
+     * @brief Get statistics about spilling
+     * @param pendingBytes Output: flash bytes held by requests not yet sent
+     * @param spilled Output: requests written to flash
+     * @param corrupted Output: spilled requests skipped because they were damaged
+     */
+    void getSpillStats(size_t& pendingBytes, uint32_t& spilled, uint32_t& corrupted);
+
+    /**
+     * @brief Get statistics about processed requests
+     * @param totalProcessed Output: total requests processed
+     * @param totalSuccessful Output: total successful requests
+     * @param totalFailed Output: total failed requests
+     */
+    void getStats(uint32_t& totalProcessed, uint32_t& totalSuccessful, uint32_t& totalFailed);
+
+    /**
+     * @brief Copy the counters and latency histograms in one consistent snapshot
+     *
+     * Workers record into the statistics under the same short critical section
+     * that guards the other counters, and the copy is taken inside it, so the
+     * histograms and counters always agree with each other. Use
+     * snapshot.total.percentile(99) and the like for percentiles.
+     * @param snapshot Output: statistics since begin() or resetStats()
+     */
+    void getStatsSnapshot(StatsSnapshot& snapshot);
+
+    /**
+     * @brief Zero the counters and latency histograms
+     */
+    void resetStats();
+
+    /**
+     * @brief Configure the keep-alive connection pool
+     * @param maxConnections Connections kept open, clamped to MAX_POOLED_CONNECTIONS (0 disables pooling)
+     * @param idleTimeout Close connections unused for this many milliseconds (default: 30000)
+     */
+    void setConnectionPool(uint8_t maxConnections, uint32_t idleTimeout = DEFAULT_CONNECTION_IDLE_TIMEOUT);
+
+    /**
+     * @brief Get statistics about connection reuse
+     * @param hits Output: requests sent on an already open connection
+     * @param misses Output: requests that had to open a new connection
+     */
+    void getConnectionStats(uint32_t& hits, uint32_t& misses);
+
+    /**
+     * @brief Let each worker keep several requests in flight at once
+     *
+     * A worker sends up to count requests, each on its own connection, and then
+     * collects their responses as they arrive instead of waiting for each one in
+     * turn, so one worker overlaps server latency without the stack of extra worker
+     * tasks. Connecting, the TLS handshake and writing a request still hold the
+     * worker for up to the timeout; keep-alive connections make them rare, so size
+     * the connection pool to at least count. Streamed items and redirects are sent
+     * one at a time, and the setting is ignored while batching is enabled. Must be
+     * called before begin().
+     * @param count Requests per worker, up to MAX_IN_FLIGHT (1 = one at a time, default)
+     */
+    void setMaxInFlight(uint8_t count);
+
+    /**
+     * @brief Write several requests back-to-back on one keep-alive connection
+     *
+     * HTTP/1.1 pipelining: a worker writes up to depth queued requests for the same
+     * endpoint on a pooled connection without waiting for each response, and
+     * matches the responses in order, so requests no longer wait a round trip
+     * each. If the server closes the connection with requests unanswered, they
+     * are sent again one at a time and that connection is no longer pipelined.
+     * As with other network errors, a request may then reach the server twice.
+     * Needs the connection pool; combines with setMaxInFlight(), which sets the
+     * number of connections per worker. Ignored while batching is enabled. Must
+     * be called before begin().
+     * @param depth Requests outstanding per connection, up to MAX_PIPELINE_DEPTH (1 disables, default)
+     */
+    void setPipelining(uint8_t depth);
+
+    /**
+     * @brief Get statistics about pipelining
+     * @param pipelined Output: requests written while earlier ones were unanswered
+     * @param resent Output: requests sent again because the server closed before answering them
+     */
+    void getPipelineStats(uint32_t& pipelined, uint32_t& resent);
+
+    /**
+     * @brief Compress request bodies with gzip or deflate
+     *
+     * Bodies of at least minSize bytes, from either post() overload, batches and
+     * postStream(), are compressed while they are written and sent with chunked
+     * transfer encoding and a Content-Encoding header; smaller ones are sent as
+     * they are. Each worker reserves one compressor of about 10 KB at begin().
+     * Compressed requests, like streamed ones, do not follow redirects, and the
+     * server must accept compressed request bodies. Must be called before begin().
+     * @param format COMPRESSION_GZIP, COMPRESSION_DEFLATE or COMPRESSION_NONE (default)
+     * @param minSize Smallest body compressed, in bytes (streams of unknown length always are)
+     */
+    void setCompression(CompressionFormat format, size_t minSize = DEFAULT_COMPRESSION_MIN_SIZE);
+
+    /**
+     * @brief Get statistics about compression
+     * @param compressed Output: requests sent compressed
+     * @param bytesIn Output: body bytes before compression
+     * @param bytesOut Output: body bytes after compression
+     */
+    void getCompressionStats(uint32_t& compressed, uint32_t& bytesIn, uint32_t& bytesOut);
+
+    /**
+     * @brief Choose the wire format of JsonDocument posts
+     *
+     * MessagePack and CBOR bodies are usually 15 to 30% smaller than JSON and
+     * are sent with a matching Content-Type. Only post(url, JsonDocument&) is
+     * affected; string payloads and records stay JSON, and binary items are
+     * never batched. Must be called before begin().
+     * @param encoding ENCODING_JSON (default), ENCODING_MSGPACK or ENCODING_CBOR
+     */
+    void setEncoding(PayloadEncoding encoding);
+
+private:
+    /**
+     * @brief Components of a URL, pointing into the original string
+     */
+    struct UrlParts {
+        const char* host;           ///< Start of the host name
+        size_t hostLength;          ///< Length of the host name
+        uint16_t port;              ///< Explicit or scheme default port
+        const char* path;           ///< Path and query ("" means "/")
+    };
+
+    /**
+     * @brief One priority class: its queue, scheduling state and statistics
+     */
+    struct PriorityLane {
+        QueueHandle_t queue;        ///< FreeRTOS queue handle (QUEUE_BACKEND_FREERTOS)
+        PostRing ring;              ///< Lock-free item ring (QUEUE_BACKEND_RING)
+        std::atomic<uint32_t> occupied; ///< Items queued or reserved by producers about to queue them
+        WakeSignal space;           ///< Wakes producers waiting for room (OVERFLOW_BLOCK)
+        size_t limit;               ///< Maximum items (0 = maxQueueSize)
+        uint8_t weight;             ///< Items per turn under weighted scheduling
+        uint32_t lastServed;        ///< millis() when the lane was last served or seen empty
+        uint32_t enqueued;          ///< Items added
+        uint32_t rejected;          ///< Items refused because the lane was full
+        uint32_t evicted;           ///< Items dropped to make room
+        uint32_t decimated;         ///< Items refused by decimation
+        std::atomic<uint32_t> decimationCount; ///< Posts seen since the lane passed the decimation threshold
+        uint32_t dequeued;          ///< Items taken by workers
+        uint32_t maxWait;           ///< Longest queue wait in milliseconds
+    };
+
+    /**
+     * @brief Bytes read from a connection and not yet consumed by a response parser
+     */
+    struct ReceiveBuffer {
+        uint8_t data[128];          ///< Received bytes
+        uint8_t start;              ///< Offset of the first unconsumed byte
+        uint8_t end;                ///< Offset past the last received byte
+
+        ReceiveBuffer() : start(0), end(0) {}
+    };
+
+    /**
+     * @brief Destination of a response body, passed to the body sink
+     */
+    struct ResponseCollector {
+        PostQueue* queue;           ///< Queue whose response mode applies
+        String* response;           ///< Captured body (RESPONSE_CAPTURE)
+        const HttpResponseParser* parser; ///< Source of the status code (NULL to use httpCode)
+        int httpCode;               ///< Status code when the body is read through HTTPClient
+
+        ResponseCollector() : queue(NULL), response(NULL), parser(NULL), httpCode(0) {}
+    };
+
+    /**
+     * @brief A request a worker has taken and whose response it is waiting for
+     */
+    struct InFlightRequest {
+        PostItem* item;             ///< Item being sent (NULL if the slot is free)
+        bool sent;                  ///< Whether the request is written on the connection
+        bool pipelined;             ///< Whether it was written while earlier requests were unanswered
+        bool answered;              ///< Whether the first response byte has arrived
+        uint32_t startedAt;         ///< micros() when the worker began sending it
+        uint32_t sentAt;            ///< micros() when writing it began, after connecting
+        HttpResponseParser parser;  ///< Parses the response as it arrives
+        String response;            ///< Response body received so far
+        ResponseCollector collector; ///< Routes the body according to the response mode
+        InFlightRequest* next;      ///< Request queued behind this one on the same connection
+
+        InFlightRequest()
+            : item(NULL), sent(false), pipelined(false), answered(false), startedAt(0), sentAt(0), next(NULL) {}
+    };
+
+    /**
+     * @brief A connection of a worker and the requests queued on it, answered in order
+     */
+    struct InFlightConnection {
+        PooledConnection* conn;     ///< Pooled connection in use (NULL if one-shot or idle)
+        WiFiClient* client;         ///< Client the requests are written to (NULL while idle)
+        WiFiClient oneShotClient;   ///< Used when no pooled connection is free
+        WiFiClientSecure oneShotSecureClient; ///< Used for HTTPS when no pooled connection is free
+        ReceiveBuffer received;     ///< Bytes read past the end of the last response
+        InFlightRequest* head;      ///< Oldest request, whose response is read next (NULL while idle)
+        InFlightRequest* tail;      ///< Newest request
+        uint8_t depth;              ///< Requests queued on the connection
+        uint32_t lastData;          ///< millis() when data last arrived or the head was sent
+
+        InFlightConnection() : conn(NULL), client(NULL), head(NULL), tail(NULL), depth(0), lastData(0) {}
+    };
+
+    QueueBackend _backend;          ///< Queue implementation chosen at construction
+    PriorityLane _lanes[MAX_PRIORITY_LANES]; ///< Priority lanes, lowest priority first
+    uint8_t _laneCount;             ///< Number of lanes in use
+    LaneScheduling _laneScheduling; ///< How workers pick the next lane
+    uint32_t _starvationLimit;      ///< Strict scheduling starvation guard in milliseconds
+    uint8_t _turnLane;              ///< Lane whose turn it is under weighted scheduling
+    uint8_t _turnCredit;            ///< Items the turn lane may still send this turn
+    WakeSignal _laneSignal;         ///< Wakes workers sleeping on several lanes
+    OverflowPolicy _overflowPolicy; ///< What post() does when a lane is full
+    uint32_t _overflowTimeout;      ///< Longest OVERFLOW_BLOCK wait in milliseconds
+    std::atomic<uint8_t> _blockedPosts; ///< Producers waiting in post() for room
+    uint32_t _postsBlocked;         ///< Posts that waited for room
+    uint8_t _decimationThreshold;   ///< Lane occupancy in percent from which to decimate
+    uint8_t _decimationKeepEvery;   ///< Keep one post in this many above the threshold (0/1 = off)
+    bool _deduplication;            ///< Whether postLatest() keys are tracked
+    KeyIndex _keyIndex;             ///< Queued keyed item for each key (open only with deduplication)
+    uint32_t _itemsReplaced;        ///< Queued items replaced by a newer one with the same key
+    portMUX_TYPE _keyMux;           ///< Guards the key index and the claim flags of keyed items
+    WatermarkCallback _watermarkCallback; ///< Called at watermark crossings (NULL = none)
+    size_t _highWatermark;          ///< Queued items that trigger the high callback (0 = disabled)
+    size_t _lowWatermark;           ///< Queued items that trigger the low callback
+    std::atomic<bool> _aboveWatermark; ///< Whether the queue reached the high watermark and has not drained
+    TaskHandle_t _taskHandles[MAX_WORKERS]; ///< Worker task handles (NULL once a worker exits)
+    size_t _maxQueueSize;           ///< Maximum queue size
+    size_t _taskStackSize;          ///< Stack size for worker task
+    UBaseType_t _taskPriority;      ///< Priority for worker task
+    uint8_t _workerCount;           ///< Number of worker tasks
+    BaseType_t _workerCore;         ///< Core affinity for worker tasks
+    uint8_t _maxInFlight;           ///< Connections each worker keeps requests in flight on (1 = one at a time)
+    uint8_t _pipelineDepth;         ///< Requests outstanding per connection (1 = no pipelining)
+    SemaphoreHandle_t _poolLock;    ///< Guards the connection pool between workers
+    SemaphoreHandle_t _callbackLock; ///< Serializes user callbacks between workers
+    portMUX_TYPE _statsMux;         ///< Guards statistics and pacing state
+    uint32_t _nextSendTime;         ///< Earliest millis() the next paced request may start
+    uint8_t* _arena;                ///< Preallocated item slots (NULL when items use the heap)
+    size_t _arenaSlotSize;          ///< Bytes per arena slot (0 = arena disabled)
+    size_t _arenaSlotCount;         ///< Number of arena slots
+    QueueHandle_t _arenaFree;       ///< Free arena slots (QUEUE_BACKEND_FREERTOS)
+    PostRing _arenaRing;            ///< Free arena slots (QUEUE_BACKEND_RING)
+    uint32_t _httpTimeout;          ///< HTTP request timeout
+    uint8_t _maxRedirects;          ///< Maximum redirects to follow
+    bool _verifySSL;                ///< Whether to verify SSL certificates
+    uint32_t _pacingInterval;       ///< Minimum milliseconds between request starts (0 = no pacing)
+    uint8_t _batchMaxItems;         ///< Maximum items per batch (0 = batching disabled)
+    size_t _batchMaxBytes;          ///< Maximum batched body size
+    uint32_t _batchLinger;          ///< Time to wait for more items to fill a batch
+    PostCallback _callback;         ///< Callback for POST completion
+    ResponseMode _responseMode;     ///< What workers do with response bodies
+    size_t _responseCaptureLimit;   ///< Bytes of the body captured (0 = whole body)
+    ResponseChunkCallback _responseChunkCallback; ///< Receives bodies in RESPONSE_STREAM mode
+    CompressionFormat _compression; ///< Content-Encoding of request bodies
+    size_t _compressionMinSize;     ///< Smallest body compressed
+    PayloadEncoding _encoding;      ///< Wire format of JsonDocument posts
+    DeflateEncoder* _encoders[MAX_WORKERS]; ///< One compressor per worker (NULL when compression is off)
+    uint32_t _encodersInUse;        ///< Bit i set while _encoders[i] is taken
+    
+    // Statistics
+    uint64_t _totalProcessed;       ///< Total requests processed
+    uint64_t _totalSuccessful;      ///< Total successful requests
+    uint64_t _totalFailed;          ///< Total failed requests
+    LatencyHistogram _queueWaitLatency; ///< Time items waited in a lane
+    LatencyHistogram _connectLatency; ///< Time to open connections
+    LatencyHistogram _firstByteLatency; ///< Time from writing a request to its first response byte
+    LatencyHistogram _totalLatency; ///< Time per request sent
+    uint32_t _batchesSent;          ///< Batched requests sent
+    uint32_t _itemsBatched;         ///< Items carried by batched requests
+    uint32_t _requestsPipelined;    ///< Requests written while earlier ones were unanswered
+    uint32_t _pipelineResent;       ///< Pipelined requests sent again after the server closed
+    uint32_t _itemsCompressed;      ///< Requests sent compressed
+    uint32_t _compressionBytesIn;   ///< Body bytes before compression
+    uint32_t _compressionBytesOut;  ///< Body bytes after compression
+
+    // Retries
+    uint8_t _retryMaxAttempts;      ///< Attempts per item (1 = retries disabled)
+    uint32_t _retryBaseDelay;       ///< Delay before the first retry
+    uint32_t _retryMaxDelay;        ///< Cap on the retry delay
+    uint8_t _retryJitter;           ///< Random share of each delay in percent
+    uint8_t _retryBudgetPercent;    ///< Retries earned per 100 first attempts (0 = unlimited)
+    uint8_t _retryBudgetBurst;      ///< Retries that can be banked
+    uint32_t _retryTokens;          ///< Banked retries in hundredths
+    size_t _retryQueueSize;         ///< Retry queue length
+    PostItem** _retryItems;         ///< Items waiting for a retry, earliest first (NULL when disabled)
+    size_t _retryCount;             ///< Items in _retryItems
+    SemaphoreHandle_t _retryLock;   ///< Guards the retry queue
+    uint32_t _retriesScheduled;     ///< Retries scheduled
+    uint32_t _retriesExhausted;     ///< Items that used up their attempts
+    uint32_t _retriesBudgetDenied;  ///< Retries refused by the budget
+    uint32_t _retriesOverflowed;    ///< Retries refused by a full retry queue
+    uint32_t _succeededAfter[MAX_RETRY_ATTEMPTS]; ///< Successes by attempt number
+
+    // Connection pool
+    PooledConnection _pool[MAX_POOLED_CONNECTIONS]; ///< Keep-alive connection slots
+    uint8_t _maxPooledConnections;  ///< Number of slots in use
+    uint32_t _connectionIdleTimeout; ///< Idle time before a pooled connection is closed
+    uint32_t _poolHits;             ///< Requests that reused an open connection
+    uint32_t _poolMisses;           ///< Requests that opened a new connection
+    
+    // Spill log
+    SpillLog _spill;                ///< Requests spilled to flash
+    fs::FS* _spillFs;               ///< Filesystem for the spill log (NULL = spilling disabled)
+    const char* _spillDirectory;    ///< Directory for the spill log
+    size_t _spillMaxBytes;          ///< Flash budget for the spill log
+    SemaphoreHandle_t _spillLock;   ///< Guards the spill log
+    bool _spillBusy;                ///< Whether a worker is sending a spilled request
+    bool _spillBackoff;             ///< Whether draining waits for _spillRetryTime
+    uint32_t _spillRetryTime;       ///< millis() at which draining resumes after a network error
+    uint32_t _spilledItems;         ///< Requests written to the spill log
+
+    // Named header sets
+    HeaderSet* _headerSets[MAX_HEADER_SETS]; ///< Registered header sets, id i at index i - 1
+    uint8_t _headerSetCount;        ///< Number of registered header sets
+
+    // Records from interrupt handlers
+    RecordChannel _recordChannels[MAX_RECORD_CHANNELS]; ///< Registered channels, id i at index i - 1
+    uint8_t _recordChannelCount;    ///< Number of registered record channels
+    size_t _recordQueueSize;        ///< Record queue length
+    QueueHandle_t _records;         ///< Records waiting to be formatted (NULL without channels)
+    std::atomic<bool> _recordWakePending; ///< Whether a wake marker is in the item queue
+    uint32_t _recordsPosted;        ///< Records queued as requests
+    uint32_t _recordsDropped;       ///< Records lost
+
+    bool _running;                  ///< Whether the worker task is running
+    TaskHandle_t _stopNotifyTask;   ///< Task waiting in end() for the worker to exit
+
+    /**
+     * @brief Worker task function that processes the queue
+     * @param parameter Pointer to the PostQueue instance
+     */
+    static void workerTask(void* parameter);
+
+    /**
+     * @brief Take items one at a time and send each before taking the next
+     */
+    void workerLoop();
+
+    /**
+     * @brief Keep requests in flight on up to _maxInFlight connections and collect their responses
+     */
+    void inFlightWorkerLoop();
+
+    /**
+     * @brief Close idle pooled connections and move due retries back into their lanes
+     * @return Ticks an idle worker may block before this needs to run again
+     */
+    TickType_t maintain();
+
+    /**
+     * @brief Block until pacing allows the next request to start
+     */
+    void waitForPacingSlot();
+
+    /**
+     * @brief Process a single POST request
+     * @param item PostItem to process
+     * @return true if the item now waits for a retry and must not be freed
+     */
+    bool processPostItem(PostItem* item);
+
+    /**
+     * @brief Retry a failed attempt or complete the item
+     * @param item Item whose attempt ended
+     * @param success Whether the attempt succeeded
+     * @param httpCode HTTP response code or negative HTTPClient error
+     * @param response Response body
+     * @param retryAfter Retry-After in milliseconds, 0 if absent
+     * @return true if the item now waits for a retry and must not be freed
+     */
+    bool finishAttempt(PostItem* item, bool success, int httpCode, const String& response, uint32_t retryAfter);
+
+    /**
+     * @brief Pick the connection for a new item: an idle one, else one it can be pipelined on
+     * @param connections The worker's connections
+     * @param item Item to send
+     * @return Connection, or NULL if every connection is busy and none can take the item
+     */
+    InFlightConnection* chooseConnection(InFlightConnection* connections, const PostItem* item);
+
+    /**
+     * @brief Write the requests queued on a connection that are not written yet
+     * @param connection Connection with at least one request
+     * @return 0, or a negative HTTPClient error if the oldest request could not be sent
+     */
+    int sendRequests(InFlightConnection& connection);
+
+    /**
+     * @brief Connect if needed and write one request without waiting for the response
+     * @param connection Connection the request is queued on
+     * @param request Request to write
+     * @return 0 once the request is written, or a negative HTTPClient error
+     */
+    int writeRequest(InFlightConnection& connection, InFlightRequest& request);
+
+    /**
+     * @brief Close a connection and mark its written requests from one onwards to be sent again
+     * @param connection Connection the server closed
+     * @param from First request that got no answer
+     */
+    void resendUnanswered(InFlightConnection& connection, InFlightRequest* from);
+
+    /**
+     * @brief Remove the oldest request of a connection and retry or complete its item
+     * @param connection Connection whose oldest request got its response or failed
+     * @param httpCode HTTP response code or negative HTTPClient error
+     */
+    void finishRequest(InFlightConnection& connection, int httpCode);
+
+    /**
+     * @brief Log the outcome of a POST
+     * @param success Whether the POST succeeded
+     * @param httpCode HTTP response code or negative HTTPClient error
+     */
+    static void logPostResult(bool success, int httpCode);
+
+    /**
+     * @brief Body sink routing response bytes according to the response mode
+     * @param context ResponseCollector of the response
+     */
+    static void collectResponse(const uint8_t* data, size_t length, void* context);
+
+    /**
+     * @brief Prepare a collector and parser for the next response on the raw send path
+     */
+    void beginResponse(ResponseCollector& collector, HttpResponseParser& parser, String& response);
+
+    /**
+     * @brief Read a response body through HTTPClient according to the response mode
+     * @return true if the connection must be closed because the body was left unread
+     */
+    bool readResponseBody(HTTPClient& http, int httpCode, String& response);
+
+    /**
+     * @brief Send a single POST request and log the outcome
+     * @param item PostItem to send
+     * @param httpCode Output: HTTP response code or negative HTTPClient error
+     * @param response Output: Response body
+     * @param retryAfter Output: Retry-After in milliseconds, 0 if absent
+     * @return true if successful, false otherwise
+     */
+    bool sendPostItem(PostItem* item, int& httpCode, String& response, uint32_t& retryAfter);
+
+    /**
+     * @brief Check whether a failed attempt may succeed if repeated
+     * @param httpCode HTTP response code or negative HTTPClient error
+     * @return true for network errors, 5xx and 429
+     */
+    static bool isRetryable(int httpCode) { return httpCode < 0 || httpCode == 429 || (httpCode >= 500 && httpCode < 600); }
+
+    /**
+     * @brief Put a failed item in the retry queue if its attempts, the budget and the queue allow
+     * @param item Item whose attempt failed
+     * @param httpCode HTTP response code or negative HTTPClient error
+     * @param retryAfter Retry-After in milliseconds, 0 if absent
+     * @return true if the item now waits for a retry, false if it is complete
+     */
+    bool scheduleRetry(PostItem* item, int httpCode, uint32_t retryAfter);
+
+    /**
+     * @brief Earn retry budget for items on their first attempt
+     * @param count Items sent for the first time
+     */
+    void creditRetryBudget(size_t count);
+
+    /**
+     * @brief Move due retries back into their lanes
+     * @return Ticks until the next retry is due, or portMAX_DELAY if none is waiting
+     */
+    TickType_t promoteRetries();
+
+    /**
+     * @brief Free every item waiting for a retry
+     */
+    void clearRetries();
+
+    /**
+     * @brief Send the oldest spilled request unless another worker is already doing so
+     */
+    void drainSpill();
+
+    /**
+     * @brief Get how long an idle worker may block before draining the spill log
+     * @return 0 if a spilled request is ready, ticks until the retry backoff ends,
+     *         or portMAX_DELAY if there is nothing to drain
+     */
+    TickType_t spillWait();
+
+    /**
+     * @brief Append an item to the spill log
+     * @param item Item to store (not freed)
+     * @return true if stored, false otherwise
+     */
+    bool spillPostItem(PostItem* item);
+
+    /**
+     * @brief Check that the queue is running and reserve room before building an item
+     *
+     * Applies the overflow policy when the lane is full. Without a reservation
+     * the item may still be built when it can spill to flash.
+     * @param lane Lane the item will be queued in
+     * @param reserved Output: whether a lane slot was reserved and must be used or released
+     * @return true if an item may be built, false if it is rejected
+     */
+    bool reserveSlot(uint8_t lane, bool& reserved);
+
+    /**
+     * @brief Reserve a lane slot if the lane is below its limit, without waiting
+     * @param lane Lane index
+     * @return true if reserved
+     */
+    bool tryReserveSlot(uint8_t lane);
+
+    /**
+     * @brief Give back a slot when an item leaves its lane or a reservation goes unused
+     * @param lane Lane index
+     */
+    void releaseSlot(uint8_t lane);
+
+    /**
+     * @brief Get the item a post is written into, with its url and headers laid out
+     *
+     * That is the queued item with the same key, claimed so it can be rewritten
+     * in place, or else a new item with a slot reserved in its lane.
+     * @param key Deduplication key (0 = none)
+     * @param url Target URL
+     * @param payloadLength Length of the payload the caller writes next
+     * @param useSSL Whether to use SSL/TLS
+     * @param customHeaders Optional custom headers
+     * @param headerSet Header set id (0 = none)
+     * @param lane Lane a new item is queued in
+     * @param reserved Output: whether a lane slot was reserved
+     * @return The item, or NULL if the post is rejected
+     */
+    PostItem* prepareItem(uint32_t key, const char* url, size_t payloadLength, bool useSSL,
+                          const char* customHeaders, uint8_t headerSet, uint8_t lane, bool& reserved);
+
+    /**
+     * @brief Queue an item from prepareItem() once its payload is written, or release its claim
+     * @param item Prepared item
+     * @param reserved Whether prepareItem() reserved a slot
+     * @return true if queued or replaced, false if queue is full
+     */
+    bool queuePreparedItem(PostItem* item, bool reserved);
+
+    /**
+     * @brief Claim the queued item with a key so a newer value can be written over it
+     * @param key Non-zero key
+     * @param size Block size the newer value needs
+     * @return The claimed item, or NULL if none is queued or its block is too small
+     */
+    PostItem* claimKeyedItem(uint32_t key, size_t size);
+
+    /**
+     * @brief Queue a new keyed item, superseding a queued one with its key that was too small
+     * @param item Item with its key set and a slot reserved in its lane
+     * @return true if queued, false if queue is full
+     */
+    bool enqueueKeyedItem(PostItem* item);
+
+    /**
+     * @brief Enter the key spinlock once no post is writing over an item
+     * @param item Keyed item
+     */
+    void lockKeyedItem(PostItem* item);
+
+    /**
+     * @brief Drop an item taken from its lane out of the key index
+     * @param item Item just taken from its lane
+     * @return true to send it, false if it was superseded and has been freed
+     */
+    bool takeKeyedItem(PostItem* item);
+
+    /**
+     * @brief Decide whether decimation lets a new item into a lane
+     * @param lane Lane index
+     * @return true if the item may be queued
+     */
+    bool passesDecimation(uint8_t lane);
+
+    /**
+     * @brief Sleep until a lane slot can be reserved, the overflow timeout passes or the queue stops
+     * @param lane Lane index
+     * @return true if reserved
+     */
+    bool waitForSlot(uint8_t lane);
+
+    /**
+     * @brief Free the oldest item of a lane to make room
+     * @param lane Lane index
+     * @return true if an item was dropped
+     */
+    bool evictOldest(uint8_t lane);
+
+    /**
+     * @brief Run the watermark callback if the queue crossed a watermark
+     */
+    void checkWatermarks();
+
+    /**
+     * @brief Map a priority class to a configured lane
+     * @param priority Priority class
+     * @return Lane index, the top lane for priorities above it
+     */
+    uint8_t laneFor(uint8_t priority) const { return priority < _laneCount ? priority : _laneCount - 1; }
+
+    /**
+     * @brief Get the item limit of a lane
+     * @param lane Lane index
+     * @return Maximum items the lane holds
+     */
+    size_t laneLimit(uint8_t lane) const { return _lanes[lane].limit > 0 ? _lanes[lane].limit : _maxQueueSize; }
+
+    /**
+     * @brief Get the total item limit across lanes
+     * @return Sum of lane limits
+     */
+    size_t queueCapacity() const;
+
+    /**
+     * @brief Get the number of items in one lane
+     * @param lane Lane index
+     * @return Queued items, including slots reserved by producers
+     */
+    size_t laneItems(uint8_t lane);
+
+    /**
+     * @brief Remove the oldest item from one lane without blocking, releasing its slot
+     *
+     * Superseded keyed items are freed on the way and never returned.
+     * @param lane Lane index
+     * @param item Output: the item
+     * @return true if an item was removed, false if the lane is empty
+     */
+    bool popLane(uint8_t lane, PostItem*& item);
+
+    /**
+     * @brief Remove the oldest entry from one lane as it is, keeping its slot
+     * @param lane Lane index
+     * @param item Output: the item or wake marker
+     * @return true if an entry was removed, false if the lane is empty
+     */
+    bool pullLane(uint8_t lane, PostItem*& item);
+
+    /**
+     * @brief Put an entry pulled by pullLane() back at the end of its lane, in its slot
+     * @param lane Lane index
+     * @param item Item or wake marker
+     * @return true if queued; on false the caller still owns the item and its slot
+     */
+    bool requeueItem(uint8_t lane, PostItem* item);
+
+    /**
+     * @brief Remove the next item according to the lane scheduling, without blocking
+     * @param item Output: the item
+     * @return true if an item was removed, false if every lane is empty
+     */
+    bool takeScheduledItem(PostItem*& item);
+
+    /**
+     * @brief Record that a worker took an item from its lane
+     * @param item Item taken
+     */
+    void noteDequeued(const PostItem* item);
+
+    /**
+     * @brief Delete the lane queues
+     */
+    void destroyLanes();
+
+    /**
+     * @brief Hand a fully built item to the workers, freeing it on failure
+     * @param item Item to enqueue
+     * @param reserved Whether reserveSlot() reserved a slot in the item's lane
+     * @return true if successfully queued, false if queue is full
+     */
+    bool enqueuePostItem(PostItem* item, bool reserved);
+
+    /**
+     * @brief Add an item to the queue backend without blocking, into a reserved slot
+     * @param item Item to add
+     * @return true if added, false if the queue is full
+     */
+    bool pushItem(PostItem* item);
+
+    /**
+     * @brief Remove the oldest item from the queue backend without blocking
+     * @param item Output: the item
+     * @return true if an item was removed, false if the queue is empty
+     */
+    bool takeItem(PostItem*& item);
+
+    /**
+     * @brief Wait for the next item for a worker
+     * @param item Output: the item, or NULL when the queue is stopping
+     * @param wait Ticks to wait for an item
+     * @return true if an item or the stop signal was received, false on timeout
+     */
+    bool waitForItem(PostItem*& item, TickType_t wait);
+
+    /**
+     * @brief Format buffered records from postFromISR() and queue them as items
+     */
+    void drainRecords();
+
+    /**
+     * @brief Get the number of items in the queue backend
+     * @return Queued items
+     */
+    size_t queuedItems();
+
+    /**
+     * @brief Allocate a PostItem in one block and copy the URL and headers into it
+     * @param url Target URL
+     * @param payloadLength Length of the payload the caller will write to jsonPayload()
+     * @param useSSL Whether to use SSL
+     * @param customHeaders Custom headers (can be NULL)
+     * @param headerSet Header set id (0 = none)
+     * @param lane Priority lane the item will be queued in
+     * @return New item with an unterminated payload area, or NULL if it does not fit
+     */
+    PostItem* createPostItem(const char* url, size_t payloadLength, bool useSSL, const char* customHeaders,
+                             uint8_t headerSet, uint8_t lane);
+
+    /**
+     * @brief Compute the block size of an item
+     * @param url Target URL
+     * @param payloadLength Length of the payload
+     * @param customHeaders Custom headers (can be NULL)
+     * @param headerSet Header set id (0 = none)
+     * @param headersLength Output: length of the normalized custom headers
+     * @param headerCount Output: number of custom header fields
+     * @return Block size including the item header, or 0 if the item is invalid
+     */
+    size_t measurePostItem(const char* url, size_t payloadLength, const char* customHeaders, uint8_t headerSet,
+                           size_t& headersLength, uint8_t& headerCount);
+
+    /**
+     * @brief Lay out the request fields, URL and headers of an item, leaving its payload area
+     *
+     * The lane, timestamp, key and block fields are left alone, so a queued item
+     * can be rewritten in place.
+     * @param item Block at least measurePostItem() bytes long
+     * @param url Target URL
+     * @param payloadLength Length of the payload the caller will write to jsonPayload()
+     * @param useSSL Whether to use SSL
+     * @param customHeaders Custom headers (can be NULL)
+     * @param headerSet Header set id (0 = none)
+     * @param headersLength Normalized header length from measurePostItem()
+     * @param headerCount Header field count from measurePostItem()
+     */
+    void fillPostItem(PostItem* item, const char* url, size_t payloadLength, bool useSSL, const char* customHeaders,
+                      uint8_t headerSet, size_t headersLength, uint8_t headerCount);
+
+    /**
+     * @brief Normalize custom headers into "Name: Value\r\n" lines and index their fields
+     *
+     * Lines without a colon or a name are dropped and whitespace around names and
+     * values is trimmed. Offsets refer to the normalized output, so running this on
+     * an already normalized string rebuilds its field table.
+     * @param headers Headers separated by newlines (can be NULL)
+     * @param output Destination for the normalized string, or NULL to only measure
+     * @param fields Destination for the field table, or NULL to skip it
+     * @param length Output: length of the normalized string
+     * @param count Output: number of fields
+     * @return true if successful, false if there are more than MAX_HEADER_FIELDS fields
+     *         or the result is longer than UINT16_MAX
+     */
+    static bool parseHeaders(const char* headers, char* output, HeaderField* fields, size_t& length, uint8_t& count);
+
+    /**
+     * @brief Allocate a PostItem block from the arena or the heap
+     * @param size Block size including the item header
+     * @return Block with only its capacity set, or NULL if it cannot be allocated
+     */
+    PostItem* allocPostItem(size_t size);
+
+    /**
+     * @brief Allocate and fill the arena free list
+     * @return true if successful or the arena is disabled, false otherwise
+     */
+    bool createArena();
+
+    /**
+     * @brief Get the number of unused arena slots
+     * @return Free slots
+     */
+    size_t freeArenaSlots();
+
+    /**
+     * @brief Record the outcome of an item and run the callback
+     * @param success Whether the POST request was successful
+     * @param httpCode HTTP response code
+     * @param response Response body
+     * @param attempts Attempts the item took
+     */
+    void completePostItem(bool success, int httpCode, const String& response, uint8_t attempts);
+
+    /**
+     * @brief Collect queued items that can share a request with the first one and send them
+     * @param first Item already taken from the queue
+     * @return An item taken from the queue that did not fit the batch, to be processed next, or NULL
+     */
+    PostItem* processBatch(PostItem* first);
+
+    /**
+     * @brief Check whether an item can be sent in the same batch as another
+     * @param first First item of the batch
+     * @param item Candidate item
+     * @return true if both target the same request
+     */
+    static bool sameBatch(const PostItem* first, const PostItem* item);
 
     /**
      * @brief Free memory allocated for a PostItem
@@ -207,16 +1858,203 @@ private:
 
     /**
      * @brief Perform HTTP POST with redirect following
-     * @param url Target URL
-     * @param jsonPayload JSON payload
-     * @param customHeaders Custom headers
-     * @param useSSL Whether to use SSL
+     * @param item Item providing the URL, SSL setting and headers
+     * @param payload Request body
+     * @param payloadLength Length of the request body
+     * @param httpCode Output: HTTP response code
+     * @param response Output: Response body
+     * @param retryAfter Output: Retry-After in milliseconds, 0 if absent
+     * @return true if successful, false otherwise
+     */
+    bool performPost(const PostItem* item, const char* payload, size_t payloadLength,
+                     int& httpCode, String& response, uint32_t& retryAfter);
+
+    /**
+     * @brief Perform a POST on the raw send path, streaming and compressing the body as it is written
+     * @param item Item providing the URL, SSL setting and headers, and the producer when body is NULL
+     * @param body Request body, or NULL to pull it from the item's producer
+     * @param bodyLength Length of body
+     * @param httpCode Output: HTTP response code or negative HTTPClient error
+     * @param response Output: Response body
+     * @param retryAfter Output: Retry-After in milliseconds, 0 if absent
+     * @return true if successful, false otherwise
+     */
+    bool performRawPost(PostItem* item, const uint8_t* body, size_t bodyLength,
+                        int& httpCode, String& response, uint32_t& retryAfter);
+
+    /**
+     * @brief Write a POST request line and headers to a connected client
+     * @param client Connected client
+     * @param url Parsed target URL
+     * @param item Item providing the header set and custom headers
+     * @param contentLength Body length, or 0 for chunked transfer encoding
+     * @param compressed Whether to announce the Content-Encoding of the queue
+     * @return true if everything was written, false otherwise
+     */
+    bool writeRequestHead(Client& client, const UrlParts& url, const PostItem* item, size_t contentLength,
+                          bool compressed = false);
+
+    /**
+     * @brief Write a request body after writeRequestHead()
+     * @param client Connected client
+     * @param item Item whose producer supplies the body when body is NULL
+     * @param body Request body, or NULL to pull it from the item's producer
+     * @param bodyLength Length of body
+     * @param chunked Whether the head announced chunked transfer encoding
+     * @param encoder Compressor to pass the body through (NULL to send it as it is)
+     * @return 0 if everything was written, or HTTPC_ERROR_SEND_PAYLOAD_FAILED
+     */
+    int writeRequestBody(Client& client, PostItem* item, const uint8_t* body, size_t bodyLength, bool chunked,
+                         DeflateEncoder* encoder);
+
+    /**
+     * @brief Write one part of a body, compressing or chunk-framing it as needed
+     * @return true if written, false otherwise
+     */
+    static bool writeBodyPart(Client& client, const uint8_t* data, size_t length, bool chunked,
+                              DeflateEncoder* encoder);
+
+    /**
+     * @brief Write data as one chunk of a chunked body; a DeflateSink taking the Client as context
+     */
+    static bool writeChunk(const uint8_t* data, size_t length, void* context);
+
+    /**
+     * @brief Check whether a body of the given length is compressed
+     * @param bodyLength Body length ((size_t)-1 for a stream of unknown length)
+     */
+    bool shouldCompress(size_t bodyLength) const;
+
+    /**
+     * @brief Get the Content-Type header value for an item's payload encoding
+     */
+    static const char* contentType(const PostItem* item);
+
+    /**
+     * @brief Open a connection, recording how long it took
+     * @return true if connected
+     */
+    bool connectClient(WiFiClient& client, const UrlParts& url);
+
+    /**
+     * @brief Add a duration to one of the latency histograms
+     * @param histogram Histogram to add to
+     * @param duration Duration in microseconds
+     */
+    void recordLatency(LatencyHistogram& histogram, uint32_t duration);
+
+    /**
+     * @brief Take the compressor of the calling worker
+     * @return Compressor, or NULL if none is free (the body is then sent as it is)
+     */
+    DeflateEncoder* acquireEncoder();
+
+    /**
+     * @brief Return a compressor taken with acquireEncoder()
+     */
+    void releaseEncoder(DeflateEncoder* encoder);
+
+    /**
+     * @brief Read a response from a client until the parser completes or times out
+     * @param client Client the request was written to
+     * @param parser Parser prepared with the desired body sink
+     * @param sentAt micros() when writing the request began, for the first-byte time
+     * @return HTTP status code, or a negative HTTPClient error
+     */
+    int readResponse(Client& client, HttpResponseParser& parser, uint32_t sentAt);
+
+    /**
+     * @brief Feed the parser whatever a client has received, without waiting
+     * @param client Connected client
+     * @param parser Parser for the response
+     * @param received In/out: bytes read from the client but not yet parsed, left over for the next response
+     * @param lastData In/out: millis() when data last arrived, for the timeout
+     * @return 0 while the response is incomplete, else the status code or a negative HTTPClient error
+     */
+    int pollResponse(Client& client, HttpResponseParser& parser, ReceiveBuffer& received, uint32_t& lastData);
+
+    /**
+     * @brief Check whether two items go to the same host, port and scheme
+     */
+    static bool sameEndpoint(const PostItem* first, const PostItem* item);
+
+    /**
+     * @brief Split a URL into host, port and path
+     * @param url URL of the form "scheme://[user@]host[:port][/path]"
+     * @param useSSL Whether the default port is 443 rather than 80
+     * @param parts Output: URL components
+     * @return true if a host was found, false otherwise
+     */
+    static bool parseUrl(const char* url, bool useSSL, UrlParts& parts);
+
+    /**
+     * @brief Send a POST request on the given client
+     * @param http HTTP client to use
+     * @param client Underlying network client
+     * @param item Item providing the URL and headers
+     * @param payload Request body
+     * @param payloadLength Length of the request body
      * @param httpCode Output: HTTP response code
      * @param response Output: Response body
+     * @param retryAfter Output: Retry-After in milliseconds, 0 if absent
      * @return true if successful, false otherwise
      */
-    bool performPost(const char* url, const char* jsonPayload, const char* customHeaders, 
-                    bool useSSL, int& httpCode, String& response);
+    bool sendPost(HTTPClient& http, WiFiClient& client, const PostItem* item, const char* payload,
+                  size_t payloadLength, int& httpCode, String& response, uint32_t& retryAfter);
+
+    /**
+     * @brief Send a POST request on the given client over the raw send path
+     * @param client Network client, connected here if it is not already
+     * @param url Parsed target URL
+     * @param item Item providing the headers, and the producer when body is NULL
+     * @param body Request body, or NULL to pull it from the item's producer
+     * @param bodyLength Length of body
+     * @param httpCode Output: HTTP response code or negative HTTPClient error
+     * @param response Output: Response body
+     * @param retryAfter Output: Retry-After in milliseconds, 0 if absent
+     * @return true if successful, false otherwise
+     */
+    bool sendRawPost(WiFiClient& client, const UrlParts& url, PostItem* item, const uint8_t* body,
+                     size_t bodyLength, int& httpCode, String& response, uint32_t& retryAfter);
+
+    /**
+     * @brief Add the header fields of a header block to an HTTPClient request
+     * @param http HTTP client to add the headers to
+     * @param headers Normalized header string
+     * @param fields Field table indexing into headers
+     * @param count Number of fields
+     * @param name Scratch string reused for each name
+     * @param value Scratch string reused for each value
+     */
+    static void addHeaderFields(HTTPClient& http, const char* headers, const HeaderField* fields, uint8_t count,
+                                String& name, String& value);
+
+    /**
+     * @brief Get a pooled connection for the URL, reusing an open one when possible
+     * @param url Target URL
+     * @param useSSL Whether to use SSL
+     * @return Pooled connection, or NULL if pooling is disabled, every slot is busy
+     *         or the URL cannot be parsed
+     */
+    PooledConnection* acquireConnection(const char* url, bool useSSL);
+
+    /**
+     * @brief Return a connection to the pool after a request
+     * @param conn Connection returned by acquireConnection()
+     */
+    void releaseConnection(PooledConnection* conn);
+
+    /**
+     * @brief Close pooled connections that have been idle longer than the idle timeout
+     * @return Ticks until the next open connection expires, or portMAX_DELAY if none are open
+     */
+    TickType_t evictIdleConnections();
+
+    /**
+     * @brief Close a pooled connection and free its clients
+     * @param conn Connection to close
+     */
+    void closeConnection(PooledConnection* conn);
 };
 
 #endif // POST_QUEUE_H
@@ -0,0 +1,103 @@
+/**
+ * @file PostQueueLog.cpp
+ * @brief Implementation of PostQueue logging
+ */
+
+#include "PostQueueLog.h"
+
+#if POSTQUEUE_LOG_RING_LINES < 1
+#error "POSTQUEUE_LOG_RING_LINES must be at least 1"
+#endif
+
+#if POSTQUEUE_LOG_LINE_SIZE < 16
+#error "POSTQUEUE_LOG_LINE_SIZE must be at least 16"
+#endif
+
+// Letters used for each level in ring lines
+static const char levelLetters[] = { '-', 'E', 'W', 'I', 'D' };
+
+std::atomic<uint8_t> PostQueueLog::_level(POSTQUEUE_LOG_LEVEL);
+std::atomic<uint8_t> PostQueueLog::_output(LOG_OUTPUT_SERIAL);
+std::atomic<uint32_t> PostQueueLog::_head(0);
+PostQueueLog::Line PostQueueLog::_ring[POSTQUEUE_LOG_RING_LINES];
+
+void PostQueueLog::setLevel(uint8_t level) {
+    if (level > POSTQUEUE_LOG_LEVEL_DEBUG) {
+        level = POSTQUEUE_LOG_LEVEL_DEBUG;
+    }
+    _level.store(level, std::memory_order_relaxed);
+}
+
+void PostQueueLog::setOutput(LogOutput output) {
+    _output.store(output, std::memory_order_relaxed);
+}
+
+void PostQueueLog::write(uint8_t level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (_output.load(std::memory_order_relaxed) == LOG_OUTPUT_RING) {
+        append(level, format, args);
+    } else {
+        char text[POSTQUEUE_LOG_LINE_SIZE];
+        vsnprintf(text, sizeof(text), format, args);
+        Serial.print("PostQueue: ");
+        Serial.println(text);
+    }
+    va_end(args);
+}
+
+void PostQueueLog::append(uint8_t level, const char* format, va_list args) {
+    uint32_t position = _head.fetch_add(1, std::memory_order_relaxed);
+    Line& line = _ring[position % POSTQUEUE_LOG_RING_LINES];
+
+    // Odd while the text is being replaced, so readers skip the torn line
+    line.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    line.timestamp = millis();
+    line.level = level;
+    vsnprintf(line.text, sizeof(line.text), format, args);
+    line.sequence.store(2 * position + 2, std::memory_order_release);
+}
+
+bool PostQueueLog::readLine(uint32_t& cursor, char* line, size_t size) {
+    uint32_t head = _head.load(std::memory_order_acquire);
+    if (head - cursor > POSTQUEUE_LOG_RING_LINES && head > POSTQUEUE_LOG_RING_LINES) {
+        cursor = head - POSTQUEUE_LOG_RING_LINES; // Older lines were overwritten
+    }
+
+    while (cursor < head) {
+        const Line& slot = _ring[cursor % POSTQUEUE_LOG_RING_LINES];
+        uint32_t published = 2 * cursor + 2;
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence < published) {
+            return false; // Claimed but not written yet; keep the order and try later
+        }
+        if (sequence > published) {
+            cursor++; // Overwritten by a newer line
+            continue;
+        }
+
+        uint8_t level = slot.level < sizeof(levelLetters) ? slot.level : 0;
+        snprintf(line, size, "%lu %c %s", (unsigned long)slot.timestamp, levelLetters[level], slot.text);
+
+        // A writer that reused the slot meanwhile may have torn the copy
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool intact = slot.sequence.load(std::memory_order_relaxed) == sequence;
+        cursor++;
+        if (intact) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t PostQueueLog::dump(Print& out) {
+    char line[POSTQUEUE_LOG_LINE_SIZE + 16];
+    uint32_t cursor = 0;
+    size_t printed = 0;
+    while (readLine(cursor, line, sizeof(line))) {
+        out.println(line);
+        printed++;
+    }
+    return printed;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file PostQueueLog.h
+ * @brief Leveled logging for PostQueue, removable at compile time
+ *
+ * The library logs through the POSTQUEUE_LOG_ERROR/WARN/INFO/DEBUG macros.
+ * Messages above POSTQUEUE_LOG_LEVEL compile to nothing, arguments included,
+ * so a build with -DPOSTQUEUE_LOG_LEVEL=POSTQUEUE_LOG_LEVEL_NONE carries no
+ * logging code at all. The remaining messages are checked against a runtime
+ * level, one relaxed load, before they are formatted.
+ *
+ * Lines go to Serial, which blocks on the UART, or to an in-memory ring that
+ * keeps the last POSTQUEUE_LOG_RING_LINES lines. Writers claim a ring slot
+ * with one atomic increment and publish it through the slot's sequence
+ * number, so logging to the ring never takes a lock and never waits for the
+ * UART; readLine() and dump() copy lines out later, skipping any that were
+ * overwritten while being read.
+ */
+
+#ifndef POSTQUEUE_LOG_H
+#define POSTQUEUE_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <stdarg.h>
+
+#define POSTQUEUE_LOG_LEVEL_NONE 0
+#define POSTQUEUE_LOG_LEVEL_ERROR 1
+#define POSTQUEUE_LOG_LEVEL_WARN 2
+#define POSTQUEUE_LOG_LEVEL_INFO 3
+#define POSTQUEUE_LOG_LEVEL_DEBUG 4
+
+/**
+ * @brief Most verbose level compiled in; per-request messages are DEBUG
+ */
+#ifndef POSTQUEUE_LOG_LEVEL
+#define POSTQUEUE_LOG_LEVEL POSTQUEUE_LOG_LEVEL_INFO
+#endif
+
+/**
+ * @brief Lines kept by the in-memory ring
+ */
+#ifndef POSTQUEUE_LOG_RING_LINES
+#define POSTQUEUE_LOG_RING_LINES 32
+#endif
+
+/**
+ * @brief Longest line, including the terminator; longer messages are truncated
+ */
+#ifndef POSTQUEUE_LOG_LINE_SIZE
+#define POSTQUEUE_LOG_LINE_SIZE 96
+#endif
+
+/**
+ * @brief Where log lines go
+ */
+enum LogOutput {
+    LOG_OUTPUT_SERIAL,  ///< Print each line to Serial as it is logged
+    LOG_OUTPUT_RING     ///< Keep the last lines in memory for readLine() or dump()
+};
+
+/**
+ * @brief Log a message at a level, if compiled in and enabled at runtime
+ */
+#define POSTQUEUE_LOG_AT(level, ...)                         \
+    do {                                                      \
+        if (PostQueueLog::enabled(level)) {                   \
+            PostQueueLog::write(level, __VA_ARGS__);          \
+        }                                                     \
+    } while (0)
+
+#if POSTQUEUE_LOG_LEVEL >= POSTQUEUE_LOG_LEVEL_ERROR
+#define POSTQUEUE_LOG_ERROR(...) POSTQUEUE_LOG_AT(POSTQUEUE_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define POSTQUEUE_LOG_ERROR(...) do {} while (0)
+#endif
+
+#if POSTQUEUE_LOG_LEVEL >= POSTQUEUE_LOG_LEVEL_WARN
+#define POSTQUEUE_LOG_WARN(...) POSTQUEUE_LOG_AT(POSTQUEUE_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define POSTQUEUE_LOG_WARN(...) do {} while (0)
+#endif
+
+#if POSTQUEUE_LOG_LEVEL >= POSTQUEUE_LOG_LEVEL_INFO
+#define POSTQUEUE_LOG_INFO(...) POSTQUEUE_LOG_AT(POSTQUEUE_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define POSTQUEUE_LOG_INFO(...) do {} while (0)
+#endif
+
+#if POSTQUEUE_LOG_LEVEL >= POSTQUEUE_LOG_LEVEL_DEBUG
+#define POSTQUEUE_LOG_DEBUG(...) POSTQUEUE_LOG_AT(POSTQUEUE_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define POSTQUEUE_LOG_DEBUG(...) do {} while (0)
+#endif
+
+/**
+ * @brief Process-wide log level, output and ring shared by every PostQueue
+ */
+class PostQueueLog {
+public:
+    /**
+     * @brief Set the most verbose level logged at runtime
+     * @param level POSTQUEUE_LOG_LEVEL_NONE to POSTQUEUE_LOG_LEVEL_DEBUG; levels
+     *              above POSTQUEUE_LOG_LEVEL have been compiled out and stay silent
+     */
+    static void setLevel(uint8_t level);
+
+    /**
+     * @brief Get the runtime level (default: POSTQUEUE_LOG_LEVEL)
+     */
+    static uint8_t getLevel() { return _level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Check whether a message at a level would be logged
+     */
+    static bool enabled(uint8_t level) { return level <= _level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Choose where lines go (default: LOG_OUTPUT_SERIAL)
+     */
+    static void setOutput(LogOutput output);
+
+    /**
+     * @brief Format and log a message; use the POSTQUEUE_LOG_* macros instead
+     * @param level Level of the message
+     * @param format printf-style format, without the "PostQueue: " prefix or newline
+     */
+    static void write(uint8_t level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * @brief Copy the next ring line after a cursor
+     *
+     * Start with cursor 0. Lines overwritten before they were read are skipped,
+     * so a jump in the cursor by more than one means lines were lost.
+     *
+     * @param cursor Sequence number of the next line to read; advanced past the line returned
+     * @param line Destination, prefixed with the time in milliseconds and level letter
+     * @param size Capacity of line in bytes
+     * @return true if a line was copied, false if no newer line is available
+     */
+    static bool readLine(uint32_t& cursor, char* line, size_t size);
+
+    /**
+     * @brief Print every line still in the ring, oldest first
+     * @param out Destination, e.g. Serial
+     * @return Number of lines printed
+     */
+    static size_t dump(Print& out);
+
+private:
+    /**
+     * @brief One ring line; sequence is odd while it is written and even once published
+     */
+    struct Line {
+        std::atomic<uint32_t> sequence;
+        uint32_t timestamp;
+        uint8_t level;
+        char text[POSTQUEUE_LOG_LINE_SIZE];
+    };
+
+    static std::atomic<uint8_t> _level;     ///< Runtime level
+    static std::atomic<uint8_t> _output;    ///< LogOutput in use
+    static std::atomic<uint32_t> _head;     ///< Lines ever written to the ring
+    static Line _ring[POSTQUEUE_LOG_RING_LINES]; ///< Last lines written
+
+    /**
+     * @brief Format a line straight into the next ring slot
+     */
+    static void append(uint8_t level, const char* format, va_list args);
+};
+
+#endif // POSTQUEUE_LOG_H
@@ -0,0 +1,217 @@
+/**
+ * @file PostRing.cpp
+ * @brief Implementation of the lock-free MPMC ring
+ */
+
+#include "PostRing.h"
+#include <freertos/task.h>
+#include <new>
+
+WakeSignal::WakeSignal()
+    : _signal(NULL),
+      _sleepers(0) {
+}
+
+WakeSignal::~WakeSignal() {
+    end();
+}
+
+bool WakeSignal::begin(uint8_t maxSleepers) {
+    end();
+    _signal = xSemaphoreCreateCounting(maxSleepers == 0 ? 1 : maxSleepers, 0);
+    _sleepers.store(0, std::memory_order_release);
+    return _signal != NULL;
+}
+
+void WakeSignal::end() {
+    if (_signal != NULL) {
+        vSemaphoreDelete(_signal);
+        _signal = NULL;
+    }
+}
+
+bool IRAM_ATTR WakeSignal::hasSleepers() {
+    // Pairs with the fence in prepareWait(): either the consumer sees the work
+    // or this sees the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return _sleepers.load(std::memory_order_relaxed) > 0;
+}
+
+void WakeSignal::notify() {
+    if (hasSleepers()) {
+        xSemaphoreGive(_signal);
+    }
+}
+
+void IRAM_ATTR WakeSignal::notifyFromISR(BaseType_t* higherPriorityTaskWoken) {
+    if (hasSleepers()) {
+        xSemaphoreGiveFromISR(_signal, higherPriorityTaskWoken);
+    }
+}
+
+void WakeSignal::prepareWait() {
+    _sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void WakeSignal::sleep(TickType_t wait) {
+    // Extra gives left by notify() only cause a spurious wake-up; callers wait again
+    xSemaphoreTake(_signal, wait);
+}
+
+void WakeSignal::finishWait() {
+    _sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void WakeSignal::wake(uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        xSemaphoreGive(_signal);
+    }
+}
+
+PostRing::PostRing()
+    : _cells(NULL),
+      _mask(0),
+      _capacity(0),
+      _enqueuePos(0),
+      _dequeuePos(0),
+      _count(0) {
+}
+
+PostRing::~PostRing() {
+    end();
+}
+
+bool PostRing::begin(size_t capacity, uint8_t maxSleepers) {
+    end();
+    if (capacity == 0) {
+        return false;
+    }
+
+    uint32_t cellCount = 1;
+    while (cellCount < capacity) {
+        cellCount <<= 1;
+    }
+
+    _cells = new (std::nothrow) Cell[cellCount];
+    if (_cells == NULL || !_signal.begin(maxSleepers)) {
+        end();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < cellCount; i++) {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+        _cells[i].item = NULL;
+    }
+    _mask = cellCount - 1;
+    _capacity = capacity;
+    _enqueuePos.store(0, std::memory_order_relaxed);
+    _dequeuePos.store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_release);
+    return true;
+}
+
+void PostRing::end() {
+    delete[] _cells;
+    _cells = NULL;
+    _signal.end();
+    _capacity = 0;
+}
+
+bool IRAM_ATTR PostRing::store(void* item, bool fromISR) {
+    // Reserve room first so the ring never holds more than the requested capacity
+    if (_count.fetch_add(1, std::memory_order_acq_rel) >= _capacity) {
+        _count.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+
+    Cell* cell;
+    uint32_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &_cells[pos & _mask];
+        int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The reservation guarantees room, so a consumer has claimed this cell from
+            // the previous lap and not released it yet. An interrupt cannot wait for a
+            // task and reports full; a task gives the consumer a tick to finish.
+            if (fromISR) {
+                _count.fetch_sub(1, std::memory_order_acq_rel);
+                return false;
+            }
+            vTaskDelay(1);
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->item = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool PostRing::push(void* item) {
+    if (!store(item, false)) {
+        return false;
+    }
+    _signal.notify();
+    return true;
+}
+
+bool IRAM_ATTR PostRing::pushFromISR(void* item, BaseType_t* higherPriorityTaskWoken) {
+    if (!store(item, true)) {
+        return false;
+    }
+    _signal.notifyFromISR(higherPriorityTaskWoken);
+    return true;
+}
+
+bool PostRing::pop(void*& item) {
+    Cell* cell;
+    uint32_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &_cells[pos & _mask];
+        int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // Empty
+        } else {
+            pos = _dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    item = cell->item;
+    cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+    _count.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+bool PostRing::pop(void*& item, TickType_t wait) {
+    if (pop(item)) {
+        return true;
+    }
+    if (wait == 0) {
+        return false;
+    }
+
+    _signal.prepareWait();
+    bool popped = pop(item);
+    if (!popped) {
+        // Another consumer may take the item that woke us; the caller simply waits again
+        _signal.sleep(wait);
+        popped = pop(item);
+    }
+    _signal.finishWait();
+    return popped;
+}
+
+void PostRing::wake(uint8_t count) {
+    _signal.wake(count);
+}
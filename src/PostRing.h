@@ -0,0 +1,191 @@
+/**
+ * @file PostRing.h
+ * @brief Bounded lock-free multi-producer, multi-consumer ring of pointers
+ *
+ * An alternative to a FreeRTOS queue for handing items from application tasks
+ * to PostQueue workers. push() and pop() never take a lock or enter a critical
+ * section: each cell carries a sequence number and producers and consumers
+ * claim positions with a compare-and-swap (D. Vyukov's bounded MPMC queue).
+ * The cell array is rounded up to a power of two while an atomic counter keeps
+ * the number of items within the requested capacity, so size() is exact.
+ *
+ * Consumers may sleep in pop(item, wait). A producer only touches the FreeRTOS
+ * semaphore that wakes them when a consumer is actually asleep, so under load
+ * the enqueue path stays entirely lock-free. WakeSignal holds that logic so a
+ * consumer can also sleep on several queues at once.
+ */
+
+#ifndef POST_RING_H
+#define POST_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * @brief Wakes sleeping consumers, touching a semaphore only when one is asleep
+ *
+ * A consumer calls prepareWait(), checks for work once more, then sleep() if
+ * there is none, and finishWait() in every case. A producer publishes its work
+ * and then calls notify(). Either the consumer's re-check sees the work or the
+ * producer sees the sleeper, so no wake-up is lost.
+ */
+class WakeSignal {
+public:
+    WakeSignal();
+    ~WakeSignal();
+
+    /**
+     * @brief Create the semaphore
+     * @param maxSleepers Number of consumers that may sleep at once
+     * @return true if created, false otherwise
+     */
+    bool begin(uint8_t maxSleepers);
+
+    /**
+     * @brief Delete the semaphore; no consumer may be asleep
+     */
+    void end();
+
+    /**
+     * @brief Wake a sleeping consumer, if any, after publishing work
+     */
+    void notify();
+
+    /**
+     * @brief Wake a sleeping consumer, if any, from an interrupt handler
+     * @param higherPriorityTaskWoken Set to pdTRUE if the woken consumer should run on return
+     */
+    void notifyFromISR(BaseType_t* higherPriorityTaskWoken);
+
+    /**
+     * @brief Announce that the caller is about to sleep; re-check for work afterwards
+     */
+    void prepareWait();
+
+    /**
+     * @brief Sleep until notified or wait ticks pass; call between prepareWait() and finishWait()
+     */
+    void sleep(TickType_t wait);
+
+    /**
+     * @brief Withdraw the announcement made by prepareWait()
+     */
+    void finishWait();
+
+    /**
+     * @brief Wake consumers without giving them work
+     * @param count Number of consumers to wake
+     */
+    void wake(uint8_t count);
+
+private:
+    SemaphoreHandle_t _signal;              ///< Given once per wake-up
+    std::atomic<uint32_t> _sleepers;        ///< Consumers between prepareWait() and finishWait()
+
+    /**
+     * @brief Check whether a consumer is asleep and must be woken
+     */
+    bool hasSleepers();
+};
+
+/**
+ * @brief Bounded lock-free MPMC ring of pointers with optional blocking pop
+ */
+class PostRing {
+public:
+    PostRing();
+    ~PostRing();
+
+    /**
+     * @brief Allocate the ring
+     * @param capacity Maximum number of pointers held at once
+     * @param maxSleepers Number of consumers that may block in pop() at once
+     * @return true if allocated, false otherwise
+     */
+    bool begin(size_t capacity, uint8_t maxSleepers = 1);
+
+    /**
+     * @brief Free the ring; it must no longer be in use
+     */
+    void end();
+
+    /**
+     * @brief Add a pointer
+     *
+     * Fails at once if the ring is full. If there is room but a consumer that
+     * was preempted mid-pop still holds the next cell, waits for it a tick at a time.
+     * @return true if added, false if the ring is full
+     */
+    bool push(void* item);
+
+    /**
+     * @brief Add a pointer from an interrupt handler, never waiting
+     * @param higherPriorityTaskWoken Set to pdTRUE if a woken consumer should run on return
+     * @return true if added, false if the ring is full or its next cell is still being popped
+     */
+    bool pushFromISR(void* item, BaseType_t* higherPriorityTaskWoken);
+
+    /**
+     * @brief Remove the oldest pointer without blocking
+     * @return true if a pointer was removed, false if the ring is empty
+     */
+    bool pop(void*& item);
+
+    /**
+     * @brief Remove the oldest pointer, sleeping up to wait ticks for one
+     * @return true if a pointer was removed, false on timeout or wake()
+     */
+    bool pop(void*& item, TickType_t wait);
+
+    /**
+     * @brief Wake consumers sleeping in pop(item, wait) without giving them an item
+     * @param count Number of consumers to wake
+     */
+    void wake(uint8_t count);
+
+    /**
+     * @brief Get the number of pointers in the ring
+     * @return Pointers added and not yet removed
+     */
+    size_t size() const { return _count.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Get the capacity passed to begin()
+     * @return Maximum number of pointers
+     */
+    size_t capacity() const { return _capacity; }
+
+    /**
+     * @brief Check whether the ring is allocated
+     * @return true after a successful begin()
+     */
+    bool isOpen() const { return _cells != NULL; }
+
+private:
+    /**
+     * @brief One slot; sequence tells producers and consumers whose turn it is
+     */
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        void* item;
+    };
+
+    Cell* _cells;                           ///< Cell array, a power of two long
+    uint32_t _mask;                         ///< Cell count minus one
+    size_t _capacity;                       ///< Maximum number of pointers
+    WakeSignal _signal;                     ///< Wakes consumers sleeping in pop(item, wait)
+    std::atomic<uint32_t> _enqueuePos;      ///< Next position to write
+    std::atomic<uint32_t> _dequeuePos;      ///< Next position to read
+    std::atomic<uint32_t> _count;           ///< Pointers reserved or held
+
+    /**
+     * @brief Claim a cell and store the pointer, without waking anyone
+     * @param fromISR Whether to fail instead of waiting for a consumer to release the cell
+     * @return true if stored, false if the ring is full
+     */
+    bool store(void* item, bool fromISR);
+};
+
+#endif // POST_RING_H
@@ -0,0 +1,392 @@
+/**
+ * @file SpillLog.cpp
+ * @brief Implementation of the durable spill log
+ */
+
+#include "SpillLog.h"
+
+#define SPILL_RECORD_MAGIC 0x5051   // "PQ"
+#define SPILL_CURSOR_MAGIC 0x50514355 // "PQCU"
+#define SPILL_SEGMENT_SUFFIX ".seg"
+#define SPILL_CURSOR_NAME "cursor"
+#define SPILL_MAX_PATH_LENGTH (SPILL_MAX_DIRECTORY_LENGTH + 16)
+
+/**
+ * @brief Drain position as stored in the cursor file
+ */
+struct SpillCursor {
+    uint32_t magic;             ///< SPILL_CURSOR_MAGIC
+    uint32_t segment;           ///< Segment holding the oldest record
+    uint32_t offset;            ///< Offset of the oldest record
+    uint32_t crc;               ///< CRC-32 of the fields above
+};
+
+SpillLog::SpillLog()
+    : _fs(NULL),
+      _maxBytes(0),
+      _segmentSize(DEFAULT_SPILL_SEGMENT_SIZE),
+      _totalBytes(0),
+      _readSegment(1),
+      _readOffset(0),
+      _readFileSize(0),
+      _writeSegment(1),
+      _writeOffset(0),
+      _hasPeeked(false),
+      _popsSinceCursor(0),
+      _corrupted(0) {
+    _directory[0] = '\0';
+}
+
+bool SpillLog::begin(fs::FS& fs, const char* directory, size_t maxBytes, size_t segmentSize) {
+    if (strlen(directory) >= SPILL_MAX_DIRECTORY_LENGTH) {
+        return false;
+    }
+
+    _fs = &fs;
+    strcpy(_directory, directory);
+    _maxBytes = maxBytes;
+    _segmentSize = segmentSize;
+    _totalBytes = 0;
+    _hasPeeked = false;
+    _popsSinceCursor = 0;
+    _corrupted = 0;
+
+    if (!_fs->exists(_directory)) {
+        _fs->mkdir(_directory);
+    }
+
+    uint32_t cursorSegment = 0;
+    uint32_t cursorOffset = 0;
+    bool haveCursor = loadCursor(cursorSegment, cursorOffset);
+
+    // Find the segment range from the directory listing alone
+    uint32_t oldest = UINT32_MAX;
+    uint32_t newest = 0;
+    fs::File root = _fs->open(_directory);
+    if (!root || !root.isDirectory()) {
+        _fs = NULL;
+        return false;
+    }
+    for (fs::File file = root.openNextFile(); file; file = root.openNextFile()) {
+        const char* name = strrchr(file.name(), '/');
+        name = (name != NULL) ? name + 1 : file.name();
+        char* end = NULL;
+        uint32_t segment = strtoul(name, &end, 16);
+        size_t size = file.size();
+        file.close();
+
+        if (end == name || strcmp(end, SPILL_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        if (haveCursor && segment < cursorSegment) {
+            // Drained before the last shutdown but not yet deleted
+            char path[SPILL_MAX_PATH_LENGTH];
+            segmentPath(segment, path, sizeof(path));
+            _fs->remove(path);
+            continue;
+        }
+        if (segment < oldest) {
+            oldest = segment;
+        }
+        if (segment > newest) {
+            newest = segment;
+        }
+        _totalBytes += size;
+    }
+    root.close();
+
+    // Appends always go to a fresh segment, so a torn record from a power
+    // loss can only ever sit at the end of a sealed segment
+    _writeSegment = (newest > cursorSegment ? newest : cursorSegment) + 1;
+    _writeOffset = 0;
+
+    if (oldest == UINT32_MAX) {
+        _readSegment = _writeSegment;
+        _readOffset = 0;
+    } else if (haveCursor && cursorSegment == oldest) {
+        _readSegment = oldest;
+        _readOffset = cursorOffset;
+    } else {
+        _readSegment = oldest;
+        _readOffset = 0;
+    }
+
+    return true;
+}
+
+void SpillLog::end() {
+    if (_fs == NULL) {
+        return;
+    }
+
+    saveCursor();
+    _readFile.close();
+    _writeFile.close();
+    _fs = NULL;
+}
+
+bool SpillLog::append(const char* url, size_t urlLength, const char* payload, size_t payloadLength,
+                      const char* headers, size_t headersLength, uint8_t flags, uint8_t headerCount) {
+    if (_fs == NULL || urlLength > UINT16_MAX || headersLength > UINT16_MAX) {
+        return false;
+    }
+
+    SpillRecordHeader header;
+    header.magic = SPILL_RECORD_MAGIC;
+    header.flags = flags;
+    header.headerCount = headerCount;
+    header.urlLength = (uint16_t)urlLength;
+    header.headersLength = (uint16_t)headersLength;
+    header.payloadLength = (uint32_t)payloadLength;
+    header.crc = 0;
+
+    size_t size = recordSize(header);
+    if (_totalBytes + size > _maxBytes) {
+        return false;
+    }
+
+    // Seal the current segment once the record would overflow it
+    if (_writeFile && _writeOffset > 0 && _writeOffset + size > _segmentSize) {
+        _writeFile.close();
+        _writeSegment++;
+        _writeOffset = 0;
+    }
+
+    if (!_writeFile) {
+        char path[SPILL_MAX_PATH_LENGTH];
+        segmentPath(_writeSegment, path, sizeof(path));
+        _writeFile = _fs->open(path, FILE_APPEND);
+        if (!_writeFile) {
+            return false;
+        }
+        _writeOffset = _writeFile.size();
+    }
+
+    uint32_t crc = crc32(0, &header, sizeof(header));
+    crc = crc32(crc, url, urlLength);
+    crc = crc32(crc, payload, payloadLength);
+    crc = crc32(crc, headers, headersLength);
+    header.crc = crc;
+
+    bool written = _writeFile.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                   _writeFile.write((const uint8_t*)url, urlLength) == urlLength &&
+                   _writeFile.write((const uint8_t*)payload, payloadLength) == payloadLength &&
+                   _writeFile.write((const uint8_t*)headers, headersLength) == headersLength;
+    _writeFile.flush();
+
+    if (!written) {
+        // Leave the partial record at the end of a sealed segment; the reader skips it
+        _writeFile.close();
+        _totalBytes += size;
+        _writeSegment++;
+        _writeOffset = 0;
+        return false;
+    }
+
+    _writeOffset += size;
+    _totalBytes += size;
+    return true;
+}
+
+bool SpillLog::peek(SpillRecordHeader& header) {
+    if (_fs == NULL) {
+        return false;
+    }
+    if (_hasPeeked) {
+        header = _peeked;
+        return true;
+    }
+
+    while (!isEmpty()) {
+        if (!_readFile) {
+            char path[SPILL_MAX_PATH_LENGTH];
+            segmentPath(_readSegment, path, sizeof(path));
+            _readFile = _fs->open(path, FILE_READ);
+            if (!_readFile) {
+                if (_readSegment == _writeSegment) {
+                    return false;
+                }
+                advanceSegment();
+                continue;
+            }
+            _readFileSize = _readFile.size();
+        }
+
+        // A clean end of segment, a torn record or garbage all end the segment
+        size_t read = 0;
+        if (_readOffset < _readFileSize && _readFile.seek(_readOffset)) {
+            read = _readFile.read((uint8_t*)&_peeked, sizeof(_peeked));
+        }
+        bool valid = read == sizeof(_peeked) && _peeked.magic == SPILL_RECORD_MAGIC &&
+                     _readOffset + recordSize(_peeked) <= _readFileSize;
+
+        if (valid) {
+            _hasPeeked = true;
+            header = _peeked;
+            return true;
+        }
+
+        if (_readSegment == _writeSegment) {
+            // Caught up with the writer; reopen next time to see new appends
+            _readFile.close();
+            return false;
+        }
+        if (read > 0) {
+            _corrupted++;
+        }
+        advanceSegment();
+    }
+
+    return false;
+}
+
+bool SpillLog::read(char* url, char* payload, char* headers) {
+    if (!_hasPeeked) {
+        return false;
+    }
+
+    SpillRecordHeader header = _peeked;
+    header.crc = 0;
+
+    bool complete = _readFile.seek(_readOffset + sizeof(_peeked)) &&
+                    _readFile.read((uint8_t*)url, _peeked.urlLength) == _peeked.urlLength &&
+                    _readFile.read((uint8_t*)payload, _peeked.payloadLength) == _peeked.payloadLength &&
+                    _readFile.read((uint8_t*)headers, _peeked.headersLength) == _peeked.headersLength;
+    if (!complete) {
+        _corrupted++;
+        return false;
+    }
+
+    uint32_t crc = crc32(0, &header, sizeof(header));
+    crc = crc32(crc, url, _peeked.urlLength);
+    crc = crc32(crc, payload, _peeked.payloadLength);
+    crc = crc32(crc, headers, _peeked.headersLength);
+    if (crc != _peeked.crc) {
+        _corrupted++;
+        return false;
+    }
+    return true;
+}
+
+void SpillLog::pop() {
+    if (!_hasPeeked) {
+        return;
+    }
+
+    _readOffset += recordSize(_peeked);
+    _hasPeeked = false;
+
+    if (_readSegment == _writeSegment) {
+        _readFile.close();
+    }
+
+    if (isEmpty() || ++_popsSinceCursor >= SPILL_CURSOR_INTERVAL) {
+        saveCursor();
+    }
+}
+
+void SpillLog::clear() {
+    if (_fs == NULL) {
+        return;
+    }
+
+    _readFile.close();
+    _writeFile.close();
+    for (uint32_t segment = _readSegment; segment <= _writeSegment; segment++) {
+        char path[SPILL_MAX_PATH_LENGTH];
+        segmentPath(segment, path, sizeof(path));
+        _fs->remove(path);
+    }
+
+    _writeSegment++;
+    _writeOffset = 0;
+    _readSegment = _writeSegment;
+    _readOffset = 0;
+    _totalBytes = 0;
+    _hasPeeked = false;
+    saveCursor();
+}
+
+bool SpillLog::isEmpty() const {
+    return _readSegment == _writeSegment && _readOffset >= _writeOffset;
+}
+
+void SpillLog::segmentPath(uint32_t segment, char* path, size_t size) const {
+    snprintf(path, size, "%s/%08lx" SPILL_SEGMENT_SUFFIX, _directory, (unsigned long)segment);
+}
+
+void SpillLog::advanceSegment() {
+    char path[SPILL_MAX_PATH_LENGTH];
+    segmentPath(_readSegment, path, sizeof(path));
+    _readFile.close();
+    _fs->remove(path);
+
+    _totalBytes = (_totalBytes > _readFileSize) ? _totalBytes - _readFileSize : 0;
+    _readFileSize = 0;
+    _readSegment++;
+    _readOffset = 0;
+    _hasPeeked = false;
+    saveCursor();
+}
+
+void SpillLog::saveCursor() {
+    SpillCursor cursor;
+    cursor.magic = SPILL_CURSOR_MAGIC;
+    cursor.segment = _readSegment;
+    cursor.offset = _readOffset;
+    cursor.crc = crc32(0, &cursor, offsetof(SpillCursor, crc));
+
+    char path[SPILL_MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/" SPILL_CURSOR_NAME, _directory);
+    fs::File file = _fs->open(path, FILE_WRITE);
+    if (file) {
+        file.write((const uint8_t*)&cursor, sizeof(cursor));
+        file.close();
+    }
+    _popsSinceCursor = 0;
+}
+
+bool SpillLog::loadCursor(uint32_t& segment, uint32_t& offset) {
+    char path[SPILL_MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/" SPILL_CURSOR_NAME, _directory);
+    if (!_fs->exists(path)) {
+        return false;
+    }
+
+    SpillCursor cursor;
+    fs::File file = _fs->open(path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    size_t read = file.read((uint8_t*)&cursor, sizeof(cursor));
+    file.close();
+
+    if (read != sizeof(cursor) || cursor.magic != SPILL_CURSOR_MAGIC ||
+        cursor.crc != crc32(0, &cursor, offsetof(SpillCursor, crc))) {
+        return false;
+    }
+
+    segment = cursor.segment;
+    offset = cursor.offset;
+    return true;
+}
+
+size_t SpillLog::recordSize(const SpillRecordHeader& header) {
+    return sizeof(SpillRecordHeader) + header.urlLength + header.payloadLength + header.headersLength;
+}
+
+uint32_t SpillLog::crc32(uint32_t crc, const void* data, size_t length) {
+    // Nibble-wise table keeps the code small without a 1 KB lookup table
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file SpillLog.h
+ * @brief Durable, append-only segmented log used by PostQueue to spill requests to flash
+ *
+ * Records are appended to fixed-size segment files in a directory on any
+ * Arduino filesystem (LittleFS, SPIFFS, SD). Each record carries a CRC-32 and is
+ * flushed when written. Segments are never rewritten: a segment is deleted once
+ * fully drained, and the drain position is kept in a small cursor file saved
+ * every few records. Recovery on boot only lists the directory and reads the
+ * cursor, without scanning segment contents. Records drained after the last
+ * cursor save are delivered again after a reboot (at-least-once).
+ *
+ * The class is not thread-safe; PostQueue serializes access to it.
+ */
+
+#ifndef SPILL_LOG_H
+#define SPILL_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+/**
+ * @brief Default size in bytes at which a segment is sealed and a new one started
+ */
+#define DEFAULT_SPILL_SEGMENT_SIZE 16384
+
+/**
+ * @brief Number of drained records between cursor file updates
+ */
+#ifndef SPILL_CURSOR_INTERVAL
+#define SPILL_CURSOR_INTERVAL 16
+#endif
+
+/**
+ * @brief Maximum length of the spill directory path
+ */
+#define SPILL_MAX_DIRECTORY_LENGTH 32
+
+/**
+ * @brief Header stored in front of every spilled record
+ */
+struct SpillRecordHeader {
+    uint16_t magic;             ///< SPILL_RECORD_MAGIC
+    uint8_t flags;              ///< Caller-defined flags
+    uint8_t headerCount;        ///< Number of header fields in the headers string
+    uint16_t urlLength;         ///< Length of the URL
+    uint16_t headersLength;     ///< Length of the custom headers
+    uint32_t payloadLength;     ///< Length of the payload
+    uint32_t crc;               ///< CRC-32 of this header (with crc = 0) and the record data
+};
+
+/**
+ * @brief Append-only segmented log of POST requests on a filesystem
+ */
+class SpillLog {
+public:
+    SpillLog();
+
+    /**
+     * @brief Open the log, recovering the drain position from a previous run
+     * @param fs Filesystem to store segments on (must already be mounted)
+     * @param directory Directory for segment and cursor files
+     * @param maxBytes Total bytes the segments may occupy
+     * @param segmentSize Size at which a segment is sealed (default: 16384)
+     * @return true if the log is ready, false otherwise
+     */
+    bool begin(fs::FS& fs, const char* directory, size_t maxBytes,
+               size_t segmentSize = DEFAULT_SPILL_SEGMENT_SIZE);
+
+    /**
+     * @brief Save the drain position and close open files
+     */
+    void end();
+
+    /**
+     * @brief Append a request to the log and flush it
+     * @param flags Caller-defined flags stored with the record
+     * @param headerCount Number of header fields, stored so readers can size their buffers
+     * @return true if stored, false if the log is full or the write failed
+     */
+    bool append(const char* url, size_t urlLength, const char* payload, size_t payloadLength,
+                const char* headers, size_t headersLength, uint8_t flags, uint8_t headerCount);
+
+    /**
+     * @brief Locate the oldest record without consuming it
+     * @param header Output: the record header
+     * @return true if a record is available, false if the log is empty
+     */
+    bool peek(SpillRecordHeader& header);
+
+    /**
+     * @brief Read the data of the record returned by peek() and verify its CRC
+     *
+     * The buffers must hold the lengths given in the header; no terminators are written.
+     * @return true if the record is intact, false if it is corrupted
+     */
+    bool read(char* url, char* payload, char* headers);
+
+    /**
+     * @brief Consume the record returned by peek()
+     */
+    void pop();
+
+    /**
+     * @brief Delete every stored record
+     */
+    void clear();
+
+    /**
+     * @brief Check whether the log may hold records
+     * @return true if no records are pending
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Check whether the log is open
+     * @return true after a successful begin()
+     */
+    bool isOpen() const { return _fs != NULL; }
+
+    /**
+     * @brief Get the bytes occupied by segments that are not fully drained
+     * @return Stored bytes
+     */
+    size_t pendingBytes() const { return _totalBytes; }
+
+    /**
+     * @brief Get the number of records skipped because they were torn or corrupted
+     * @return Corrupted record count since begin()
+     */
+    uint32_t corruptedRecords() const { return _corrupted; }
+
+private:
+    fs::FS* _fs;                    ///< Filesystem (NULL when closed)
+    char _directory[SPILL_MAX_DIRECTORY_LENGTH]; ///< Directory holding the log
+    size_t _maxBytes;               ///< Byte budget for all segments
+    size_t _segmentSize;            ///< Size at which a segment is sealed
+    size_t _totalBytes;             ///< Bytes in segments not yet deleted
+    uint32_t _readSegment;          ///< Segment holding the oldest record
+    uint32_t _readOffset;           ///< Offset of the oldest record in its segment
+    size_t _readFileSize;           ///< Size of the open read segment
+    uint32_t _writeSegment;         ///< Segment receiving appends
+    uint32_t _writeOffset;          ///< Bytes written to the write segment
+    fs::File _readFile;             ///< Open read segment
+    fs::File _writeFile;            ///< Open write segment
+    SpillRecordHeader _peeked;      ///< Header returned by the last peek()
+    bool _hasPeeked;                ///< Whether _peeked is valid
+    uint32_t _popsSinceCursor;      ///< Records drained since the cursor was saved
+    uint32_t _corrupted;            ///< Corrupted records skipped
+
+    /**
+     * @brief Build the path of a segment file
+     */
+    void segmentPath(uint32_t segment, char* path, size_t size) const;
+
+    /**
+     * @brief Delete the drained read segment and move to the next one
+     */
+    void advanceSegment();
+
+    /**
+     * @brief Persist the drain position
+     */
+    void saveCursor();
+
+    /**
+     * @brief Load the drain position saved by a previous run
+     * @return true if a valid cursor was found
+     */
+    bool loadCursor(uint32_t& segment, uint32_t& offset);
+
+    /**
+     * @brief Total size of a record with the given header
+     */
+    static size_t recordSize(const SpillRecordHeader& header);
+
+    /**
+     * @brief Update a CRC-32 (IEEE 802.3) with more data
+     */
+    static uint32_t crc32(uint32_t crc, const void* data, size_t length);
+};
+
+#endif // SPILL_LOG_H